@@ -0,0 +1,207 @@
+// Report scheduling for NSGamepad pads, see NSGamepadRouter.h
+
+#include <string.h>
+
+#include "NSGamepadRouter.h"
+
+// HID report descriptor using TinyUSB's template
+// Gamepad for Nintendo Switch: 14 buttons, 1 8-way dpad, 2 analog sticks (4 axes)
+#define DESCRIPTOR_REPORT_ID_OFFSET 6   // after Collection (Application)
+
+static const uint8_t report_descriptor[] = {
+  0x05, 0x01,        // Usage Page (Generic Desktop Ctrls)
+  0x09, 0x05,        // Usage (Game Pad)
+  0xA1, 0x01,        // Collection (Application)
+  0x15, 0x00,        //   Logical Minimum (0)
+  0x25, 0x01,        //   Logical Maximum (1)
+  0x35, 0x00,        //   Physical Minimum (0)
+  0x45, 0x01,        //   Physical Maximum (1)
+  0x75, 0x01,        //   Report Size (1)
+  0x95, 0x0E,        //   Report Count (14)
+  0x05, 0x09,        //   Usage Page (Button)
+  0x19, 0x01,        //   Usage Minimum (0x01)
+  0x29, 0x0E,        //   Usage Maximum (0x0E)
+  0x81, 0x02,        //   Input (Data,Var,Abs,No Wrap,Linear,
+                     //   Preferred State,No Null Position)
+  0x95, 0x02,        //   Report Count (2)
+  0x81, 0x01,        //   Input (Const,Array,Abs,No Wrap,Linear,
+                     //   Preferred State,No Null Position)
+  0x05, 0x01,        //   Usage Page (Generic Desktop Ctrls)
+  0x25, 0x07,        //   Logical Maximum (7)
+  0x46, 0x3B, 0x01,  //   Physical Maximum (315)
+  0x75, 0x04,        //   Report Size (4)
+  0x95, 0x01,        //   Report Count (1)
+  0x65, 0x14,        //   Unit (System: English Rotation, Length: Centimeter)
+  0x09, 0x39,        //   Usage (Hat switch)
+  0x81, 0x42,        //   Input (Data,Var,Abs,No Wrap,Linear,
+                     //   Preferred State,Null State)
+  0x65, 0x00,        //   Unit (None)
+  0x95, 0x01,        //   Report Count (1)
+  0x81, 0x01,        //   Input (Const,Array,Abs,No Wrap,Linear,
+                     //   Preferred State,No Null Position)
+  0x26, 0xFF, 0x00,  //   Logical Maximum (255)
+  0x46, 0xFF, 0x00,  //   Physical Maximum (255)
+  0x09, 0x30,        //   Usage (X)
+  0x09, 0x31,        //   Usage (Y)
+  0x09, 0x32,        //   Usage (Z)
+  0x09, 0x35,        //   Usage (Rz)
+  0x75, 0x08,        //   Report Size (8)
+  0x95, 0x04,        //   Report Count (4)
+  0x81, 0x02,        //   Input (Data,Var,Abs,No Wrap,Linear,
+                     //   Preferred State,No Null Position)
+  0x75, 0x08,        //   Report Size (8)
+  0x95, 0x01,        //   Report Count (1)
+  0x81, 0x01,        //   Input (Const,Array,Abs,No Wrap,Linear,
+                     //   Preferred State,No Null Position)
+  0xC0,              // End Collection
+};
+
+uint16_t nsGamepadReportDescriptor(uint8_t reportId, uint8_t* dst) {
+  uint16_t size = sizeof(report_descriptor) + (reportId != 0 ? 2 : 0);
+  if (dst == NULL) {
+    return size;
+  }
+  if (reportId == 0) {
+    memcpy(dst, report_descriptor, sizeof(report_descriptor));
+    return size;
+  }
+  memcpy(dst, report_descriptor, DESCRIPTOR_REPORT_ID_OFFSET);
+  dst[DESCRIPTOR_REPORT_ID_OFFSET] = 0x85;      // Report ID
+  dst[DESCRIPTOR_REPORT_ID_OFFSET + 1] = reportId;
+  memcpy(dst + DESCRIPTOR_REPORT_ID_OFFSET + 2, report_descriptor + DESCRIPTOR_REPORT_ID_OFFSET,
+         sizeof(report_descriptor) - DESCRIPTOR_REPORT_ID_OFFSET);
+  return size;
+}
+
+NSGamepadRouter::NSGamepadRouter(void) {
+  clear();
+}
+
+void NSGamepadRouter::clear(void) {
+  memset(_pads, 0, sizeof(_pads));
+  _padCount = 0;
+  _next = 0;
+}
+
+uint8_t NSGamepadRouter::addPad(uint8_t reportId) {
+  if (_padCount == NSGAMEPAD_MAX_PADS) {
+    return NSGAMEPAD_NO_PAD;
+  }
+  for (uint8_t i = 0; i < _padCount; i++) {
+    if (reportId == 0 || _pads[i].reportId == 0 || _pads[i].reportId == reportId) {
+      return NSGAMEPAD_NO_PAD;
+    }
+  }
+  Pad& p = _pads[_padCount];
+  memset(&p, 0, sizeof(p));
+  p.reportId = reportId;
+  p.keepaliveMs = NSGAMEPAD_KEEPALIVE_MS;
+  return _padCount++;
+}
+
+bool NSGamepadRouter::update(uint8_t pad, const HID_NSGamepadReport_Data_t& report, uint32_t generation,
+                             bool endpointBusy, uint32_t tag) {
+  Pad& p = _pads[pad];
+  if (generation == p.queuedGeneration) {
+    return true;
+  }
+  p.queuedGeneration = generation;
+  p.last = report;
+  if (p.count > 0) {
+    uint8_t tail = (p.head + p.count - 1) % NSGAMEPAD_QUEUE;
+    HID_NSGamepadReport_Data_t& last = p.queue[tail];
+    if (last.buttons == report.buttons && last.dPad == report.dPad) {
+      last = report;
+      if (p.tags[tail] == 0) {
+        p.tags[tail] = tag;
+      }
+      p.stats.coalesced++;
+      return true;
+    }
+    if (p.count == NSGAMEPAD_QUEUE) {
+      // Keep the newest state so the host ends up with the right buttons; the change
+      // it replaces never reaches the host
+      last = report;
+      if (p.tags[tail] == 0) {
+        p.tags[tail] = tag;
+      }
+      p.stats.dropped++;
+      return false;
+    }
+  }
+  if (p.count > 0 || endpointBusy || pending()) {
+    p.stats.queued++;
+  }
+  uint8_t slot = (p.head + p.count) % NSGAMEPAD_QUEUE;
+  p.queue[slot] = report;
+  p.tags[slot] = tag;
+  p.count++;
+  return true;
+}
+
+void NSGamepadRouter::wrote(uint8_t pad, const HID_NSGamepadReport_Data_t& report, uint32_t generation, bool ok,
+                            uint32_t nowMs) {
+  Pad& p = _pads[pad];
+  // Anything still queued is older than this report
+  p.count = 0;
+  p.queuedGeneration = generation;
+  p.last = report;
+  p.lastSubmitMillis = nowMs;
+  if (ok) {
+    p.stats.submitted++;
+  } else {
+    p.stats.failed++;
+  }
+}
+
+bool NSGamepadRouter::pending(void) const {
+  for (uint8_t i = 0; i < _padCount; i++) {
+    if (_pads[i].count != 0) {
+      return true;
+    }
+  }
+  return false;
+}
+
+bool NSGamepadRouter::send(uint8_t pad, const HID_NSGamepadReport_Data_t& report, uint32_t tag, uint32_t nowMs,
+                           NSGamepadSubmit submit, void* context) {
+  Pad& p = _pads[pad];
+  p.lastSubmitMillis = nowMs;
+  // The pad that just sent goes to the back of the line
+  _next = (pad + 1) % _padCount;
+  if (!submit(p.reportId, report, tag, context)) {
+    p.stats.failed++;
+    return false;
+  }
+  p.stats.submitted++;
+  return true;
+}
+
+bool NSGamepadRouter::service(bool endpointReady, uint32_t nowMs, NSGamepadSubmit submit, void* context) {
+  if (!endpointReady || _padCount == 0) {
+    // The previous report is still in the endpoint: keep the queues for the next call
+    return false;
+  }
+  for (uint8_t n = 0; n < _padCount; n++) {
+    uint8_t pad = (_next + n) % _padCount;
+    Pad& p = _pads[pad];
+    if (p.count == 0) {
+      continue;
+    }
+    HID_NSGamepadReport_Data_t report = p.queue[p.head];
+    uint32_t tag = p.tags[p.head];
+    p.head = (p.head + 1) % NSGAMEPAD_QUEUE;
+    p.count--;
+    return send(pad, report, tag, nowMs, submit, context);
+  }
+  for (uint8_t n = 0; n < _padCount; n++) {
+    uint8_t pad = (_next + n) % _padCount;
+    Pad& p = _pads[pad];
+    if (p.keepaliveMs == 0 || nowMs - p.lastSubmitMillis < p.keepaliveMs) {
+      continue;
+    }
+    p.stats.keepalives++;
+    return send(pad, p.last, 0, nowMs, submit, context);
+  }
+  return false;
+}
@@ -0,0 +1,128 @@
+// Report scheduling for one or more NSGamepad pads sharing a HID interface.
+//
+// A single pad keeps the HORIPAD-compatible descriptor without a report ID. With more
+// pads every pad gets its own top-level Game Pad collection with a report ID (1..N) and
+// all of them share the interface's IN endpoint, one report per USB frame.
+//
+// Dirty tracking is per pad: a pad only queues a report when its own generation changed.
+// Pads with queued reports take turns on the endpoint, so a pad that changes every frame
+// never holds back another pad for more than NSGAMEPAD_MAX_PADS - 1 frames; keepalives only
+// go out when no pad has a change waiting.
+//
+// No Arduino or TinyUSB dependency: NSGamepad hands in the endpoint state and a submit
+// callback, so descriptors and routing can be checked on Linux (tools/padroute).
+
+#ifndef NSGAMEPAD_ROUTER_H_
+#define NSGAMEPAD_ROUTER_H_
+
+#include <stdint.h>
+#include <stddef.h>
+
+#define ATTRIBUTE_PACKED  __attribute__((packed, aligned(1)))
+
+// 14 Buttons, 4 Axes, 1 D-Pad
+typedef struct ATTRIBUTE_PACKED {
+  uint16_t buttons;
+
+  uint8_t dPad;
+
+  uint8_t leftXAxis;
+  uint8_t leftYAxis;
+
+  uint8_t rightXAxis;
+  uint8_t rightYAxis;
+  uint8_t filler;
+} HID_NSGamepadReport_Data_t;
+
+// Report scheduling (NSGamepad::loop() queues, NSGamepad::task() submits)
+#define NSGAMEPAD_QUEUE         8     // reports waiting for the IN endpoint, one per button change
+#define NSGAMEPAD_KEEPALIVE_MS  100   // resend an unchanged report this often (0: never)
+#define NSGAMEPAD_WRITE_TIMEOUT_MS 100  // NSGamepad::write() waits this long for the endpoint
+#define NSGAMEPAD_MAX_PADS      4     // pads on one HID interface
+#define NSGAMEPAD_NO_PAD        0xFF
+
+typedef struct {
+  uint32_t submitted;   // reports handed to the IN endpoint (including keepalives)
+  uint32_t keepalives;
+  uint32_t coalesced;   // reports replaced by a newer one with the same buttons and hat
+  uint32_t dropped;     // button changes lost because the queue was full
+  uint32_t queued;      // reports that had to wait for the endpoint
+  uint32_t failed;      // reports the USB stack refused (not mounted, suspended)
+} NSGamepadStats;
+
+// Hands one report to the IN endpoint without waiting; returns false if the stack refused it.
+// tag is the one given to update() for the queued report (0 for keepalives).
+typedef bool (*NSGamepadSubmit)(uint8_t reportId, const HID_NSGamepadReport_Data_t& report, uint32_t tag,
+                                void* context);
+
+/**
+ * Report descriptor of one pad
+ * @param reportId 0 for a single pad without report ID, otherwise 1..255
+ * @param dst may be NULL to only get the size
+ * @return descriptor size
+ */
+uint16_t nsGamepadReportDescriptor(uint8_t reportId, uint8_t* dst);
+
+class NSGamepadRouter {
+  public:
+    NSGamepadRouter(void);
+
+    // Forget all pads (host tests)
+    void clear(void);
+    /**
+     * Register a pad. Report ID 0 is only valid for a single pad; with several pads every
+     * ID must be non-zero and unique.
+     * @return pad index, or NSGAMEPAD_NO_PAD if full or the ID conflicts
+     */
+    uint8_t addPad(uint8_t reportId);
+    uint8_t padCount(void) const { return _padCount; }
+    uint8_t reportId(uint8_t pad) const { return _pads[pad].reportId; }
+
+    void keepalive(uint8_t pad, uint16_t ms) { _pads[pad].keepaliveMs = ms; }
+    /**
+     * Queue the pad's report if it changed since the last update (generation differs).
+     * A report with the same buttons and hat as the last queued one replaces it (only the
+     * axes moved); any other report gets its own slot so short taps reach the host.
+     * @param endpointBusy the previous report is still in the endpoint
+     * @param tag handed back to submit() with the report, e.g. to time it (0: none). A replaced
+     *            report keeps its own non-zero tag, so the tag names the oldest input it carries.
+     * @return false if the queue was full and the last queued button change was lost
+     */
+    bool update(uint8_t pad, const HID_NSGamepadReport_Data_t& report, uint32_t generation, bool endpointBusy,
+                uint32_t tag = 0);
+    // A blocking write sent the pad's current report: drop what was queued before it
+    void wrote(uint8_t pad, const HID_NSGamepadReport_Data_t& report, uint32_t generation, bool ok, uint32_t nowMs);
+    /**
+     * Hand at most one report to the endpoint: the next pad in turn with a queued report,
+     * otherwise the keepalive that is due.
+     * @return true if a report was handed to the endpoint in this call
+     */
+    bool service(bool endpointReady, uint32_t nowMs, NSGamepadSubmit submit, void* context);
+
+    bool pending(uint8_t pad) const { return _pads[pad].count != 0; }
+    bool pending(void) const;
+    const NSGamepadStats& stats(uint8_t pad) const { return _pads[pad].stats; }
+
+  protected:
+    struct Pad {
+      uint8_t reportId;
+      uint8_t head;
+      volatile uint8_t count;
+      uint16_t keepaliveMs;
+      uint32_t queuedGeneration;
+      uint32_t lastSubmitMillis;
+      HID_NSGamepadReport_Data_t last;     // newest report, resent as keepalive
+      HID_NSGamepadReport_Data_t queue[NSGAMEPAD_QUEUE];
+      uint32_t tags[NSGAMEPAD_QUEUE];
+      NSGamepadStats stats;
+    };
+
+    bool send(uint8_t pad, const HID_NSGamepadReport_Data_t& report, uint32_t tag, uint32_t nowMs,
+              NSGamepadSubmit submit, void* context);
+
+    Pad _pads[NSGAMEPAD_MAX_PADS];
+    uint8_t _padCount;
+    uint8_t _next;      // pad whose turn it is
+};
+
+#endif  // NSGAMEPAD_ROUTER_H_
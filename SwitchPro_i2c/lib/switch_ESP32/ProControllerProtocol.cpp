@@ -0,0 +1,507 @@
+// Nintendo Switch Pro Controller USB protocol (device side), see ProControllerProtocol.h
+
+#include "ProControllerProtocol.h"
+#include <string.h>
+
+// Offsets in an input report (out[0] is the report ID)
+#define PRO_OFS_TIMER      1
+#define PRO_OFS_BATTERY    2
+#define PRO_OFS_BUTTONS    3
+#define PRO_OFS_LSTICK     6
+#define PRO_OFS_RSTICK     9
+#define PRO_OFS_VIBRATOR   12
+#define PRO_OFS_ACK        13     // 0x21 only
+#define PRO_OFS_SUBCMD     14
+#define PRO_OFS_DATA       15
+#define PRO_OFS_IMU        13     // 0x30 only: 3 samples x (accel xyz, gyro xyz)
+#define PRO_IMU_SAMPLES    3
+
+#define PRO_BATTERY_USB    0x91   // battery full + charging, Pro Controller, USB powered
+#define PRO_SPI_READ_MAX   0x1D   // largest SPI read that fits in a 0x21 reply
+
+// Subcommands (output 0x01, byte 9)
+#define PRO_SUB_PAIRING        0x01
+#define PRO_SUB_DEVICE_INFO    0x02
+#define PRO_SUB_REPORT_MODE    0x03
+#define PRO_SUB_TRIGGER_TIME   0x04
+#define PRO_SUB_SHIPMENT       0x08
+#define PRO_SUB_SPI_READ       0x10
+#define PRO_SUB_MCU_CONFIG     0x21
+#define PRO_SUB_PLAYER_LIGHTS  0x30
+#define PRO_SUB_GET_LIGHTS     0x31
+#define PRO_SUB_IMU            0x40
+#define PRO_SUB_VIBRATION      0x48
+#define PRO_SUB_VOLTAGE        0x50
+
+// --- report descriptor ---
+
+const uint8_t PRO_CONTROLLER_REPORT_DESCRIPTOR[] = {
+  0x05, 0x01,                    // Usage Page (Generic Desktop Ctrls)
+  0x15, 0x00,                    // Logical Minimum (0)
+  0x09, 0x04,                    // Usage (Joystick)
+  0xA1, 0x01,                    // Collection (Application)
+  0x85, 0x30,                    //   Report ID (0x30)
+  0x05, 0x01,                    //   Usage Page (Generic Desktop Ctrls)
+  0x05, 0x09,                    //   Usage Page (Button)
+  0x19, 0x01,                    //   Usage Minimum (0x01)
+  0x29, 0x0A,                    //   Usage Maximum (0x0A)
+  0x15, 0x00,                    //   Logical Minimum (0)
+  0x25, 0x01,                    //   Logical Maximum (1)
+  0x75, 0x01,                    //   Report Size (1)
+  0x95, 0x0A,                    //   Report Count (10)
+  0x55, 0x00,                    //   Unit Exponent (0)
+  0x65, 0x00,                    //   Unit (None)
+  0x81, 0x02,                    //   Input (Data,Var,Abs)
+  0x05, 0x09,                    //   Usage Page (Button)
+  0x19, 0x0B,                    //   Usage Minimum (0x0B)
+  0x29, 0x0E,                    //   Usage Maximum (0x0E)
+  0x15, 0x00,                    //   Logical Minimum (0)
+  0x25, 0x01,                    //   Logical Maximum (1)
+  0x75, 0x01,                    //   Report Size (1)
+  0x95, 0x04,                    //   Report Count (4)
+  0x81, 0x02,                    //   Input (Data,Var,Abs)
+  0x75, 0x01,                    //   Report Size (1)
+  0x95, 0x02,                    //   Report Count (2)
+  0x81, 0x03,                    //   Input (Const,Var,Abs)
+  0x0B, 0x01, 0x00, 0x01, 0x00,  //   Usage (Pointer)
+  0xA1, 0x00,                    //   Collection (Physical)
+  0x0B, 0x30, 0x00, 0x01, 0x00,  //     Usage (X)
+  0x0B, 0x31, 0x00, 0x01, 0x00,  //     Usage (Y)
+  0x0B, 0x32, 0x00, 0x01, 0x00,  //     Usage (Z)
+  0x0B, 0x35, 0x00, 0x01, 0x00,  //     Usage (Rz)
+  0x15, 0x00,                    //     Logical Minimum (0)
+  0x27, 0xFF, 0xFF, 0x00, 0x00,  //     Logical Maximum (65535)
+  0x75, 0x10,                    //     Report Size (16)
+  0x95, 0x04,                    //     Report Count (4)
+  0x81, 0x02,                    //     Input (Data,Var,Abs)
+  0xC0,                          //   End Collection
+  0x0B, 0x39, 0x00, 0x01, 0x00,  //   Usage (Hat switch)
+  0x15, 0x00,                    //   Logical Minimum (0)
+  0x25, 0x07,                    //   Logical Maximum (7)
+  0x35, 0x00,                    //   Physical Minimum (0)
+  0x46, 0x3B, 0x01,              //   Physical Maximum (315)
+  0x65, 0x14,                    //   Unit (English Rotation, Degrees)
+  0x75, 0x04,                    //   Report Size (4)
+  0x95, 0x01,                    //   Report Count (1)
+  0x81, 0x02,                    //   Input (Data,Var,Abs)
+  0x05, 0x09,                    //   Usage Page (Button)
+  0x19, 0x0F,                    //   Usage Minimum (0x0F)
+  0x29, 0x12,                    //   Usage Maximum (0x12)
+  0x15, 0x00,                    //   Logical Minimum (0)
+  0x25, 0x01,                    //   Logical Maximum (1)
+  0x75, 0x01,                    //   Report Size (1)
+  0x95, 0x04,                    //   Report Count (4)
+  0x81, 0x02,                    //   Input (Data,Var,Abs)
+  0x75, 0x08,                    //   Report Size (8)
+  0x95, 0x34,                    //   Report Count (52)
+  0x81, 0x03,                    //   Input (Const,Var,Abs)
+  0x06, 0x00, 0xFF,              //   Usage Page (Vendor Defined 0xFF00)
+  0x85, 0x21,                    //   Report ID (0x21)
+  0x09, 0x01,                    //   Usage (0x01)
+  0x75, 0x08,                    //   Report Size (8)
+  0x95, 0x3F,                    //   Report Count (63)
+  0x81, 0x03,                    //   Input (Const,Var,Abs)
+  0x85, 0x81,                    //   Report ID (0x81)
+  0x09, 0x02,                    //   Usage (0x02)
+  0x75, 0x08,                    //   Report Size (8)
+  0x95, 0x3F,                    //   Report Count (63)
+  0x81, 0x03,                    //   Input (Const,Var,Abs)
+  0x85, 0x01,                    //   Report ID (0x01)
+  0x09, 0x03,                    //   Usage (0x03)
+  0x75, 0x08,                    //   Report Size (8)
+  0x95, 0x3F,                    //   Report Count (63)
+  0x91, 0x83,                    //   Output (Const,Var,Abs,Volatile)
+  0x85, 0x10,                    //   Report ID (0x10)
+  0x09, 0x04,                    //   Usage (0x04)
+  0x75, 0x08,                    //   Report Size (8)
+  0x95, 0x3F,                    //   Report Count (63)
+  0x91, 0x83,                    //   Output (Const,Var,Abs,Volatile)
+  0x85, 0x80,                    //   Report ID (0x80)
+  0x09, 0x05,                    //   Usage (0x05)
+  0x75, 0x08,                    //   Report Size (8)
+  0x95, 0x3F,                    //   Report Count (63)
+  0x91, 0x83,                    //   Output (Const,Var,Abs,Volatile)
+  0x85, 0x82,                    //   Report ID (0x82)
+  0x09, 0x06,                    //   Usage (0x06)
+  0x75, 0x08,                    //   Report Size (8)
+  0x95, 0x3F,                    //   Report Count (63)
+  0x91, 0x83,                    //   Output (Const,Var,Abs,Volatile)
+  0xC0,                          // End Collection
+};
+const size_t PRO_CONTROLLER_REPORT_DESCRIPTOR_SIZE = sizeof(PRO_CONTROLLER_REPORT_DESCRIPTOR);
+
+// --- emulated SPI flash ---
+
+struct SpiRegion {
+  uint32_t addr;
+  uint8_t len;
+  const uint8_t* data;
+};
+
+// 12-bit pairs are packed little endian: a[7:0] | b[3:0] a[11:8] | b[11:4]
+#define STICK_PAIR(a, b) (uint8_t)((a) & 0xFF), (uint8_t)((((a) >> 8) & 0x0F) | (((b) & 0x0F) << 4)), (uint8_t)((b) >> 4)
+// Our sticks come from 8-bit axes (0x000 ~ 0xFFF, center 0x808); calibrate a slightly smaller
+// range so full deflection always reaches the edge of the circle
+#define STICK_RANGE 0x700
+
+static const uint8_t SPI_DEVICE_TYPE[] = { 0x03 };                  // 0x6012: Pro Controller
+static const uint8_t SPI_COLOR_INFO[] = { 0x01 };                   // 0x601B: colors in SPI
+static const uint8_t SPI_IMU_FACTORY[] = {                          // 0x6020
+  0x00, 0x00, 0x00, 0x00, 0x00, 0x00,   // accel origin
+  0x00, 0x40, 0x00, 0x40, 0x00, 0x40,   // accel sensitivity 16384
+  0x00, 0x00, 0x00, 0x00, 0x00, 0x00,   // gyro origin
+  0x3B, 0x34, 0x3B, 0x34, 0x3B, 0x34,   // gyro sensitivity 13371
+};
+static const uint8_t SPI_STICK_FACTORY[] = {                        // 0x603D
+  // left: above center, center, below center
+  STICK_PAIR(STICK_RANGE, STICK_RANGE), STICK_PAIR(PRO_STICK_CENTER, PRO_STICK_CENTER),
+  STICK_PAIR(STICK_RANGE, STICK_RANGE),
+  // right: center, below center, above center
+  STICK_PAIR(PRO_STICK_CENTER, PRO_STICK_CENTER), STICK_PAIR(STICK_RANGE, STICK_RANGE),
+  STICK_PAIR(STICK_RANGE, STICK_RANGE),
+  0xFF,
+  0x32, 0x32, 0x32,                     // 0x6050 body color
+  0xFF, 0xFF, 0xFF,                     // buttons
+  0x32, 0x32, 0x32,                     // left grip
+  0x32, 0x32, 0x32,                     // right grip
+};
+static const uint8_t SPI_SENSOR_PARAMS[] = {                        // 0x6080
+  0x50, 0xFD, 0x00, 0x00, 0xC6, 0x0F,   // six-axis horizontal offsets
+  // 0x6086 left stick parameters (dead zone, range ratio)
+  0x0F, 0x30, 0x61, 0x96, 0x30, 0xF3, 0xD4, 0x14, 0x54, 0x41, 0x15, 0x54, 0xC7, 0x79, 0x9C, 0x33, 0x36, 0x63,
+  // 0x6098 right stick parameters
+  0x0F, 0x30, 0x61, 0x96, 0x30, 0xF3, 0xD4, 0x14, 0x54, 0x41, 0x15, 0x54, 0xC7, 0x79, 0x9C, 0x33, 0x36, 0x63,
+};
+
+static const SpiRegion SPI_REGIONS[] = {
+  { 0x6012, sizeof(SPI_DEVICE_TYPE), SPI_DEVICE_TYPE },
+  { 0x601B, sizeof(SPI_COLOR_INFO), SPI_COLOR_INFO },
+  { 0x6020, sizeof(SPI_IMU_FACTORY), SPI_IMU_FACTORY },
+  { 0x603D, sizeof(SPI_STICK_FACTORY), SPI_STICK_FACTORY },
+  { 0x6080, sizeof(SPI_SENSOR_PARAMS), SPI_SENSOR_PARAMS },
+};
+
+void proControllerSpiRead(uint32_t addr, uint8_t len, uint8_t* out) {
+  memset(out, 0xFF, len);
+  for (size_t r = 0; r < sizeof(SPI_REGIONS) / sizeof(SPI_REGIONS[0]); r++) {
+    const SpiRegion& region = SPI_REGIONS[r];
+    for (uint8_t i = 0; i < len; i++) {
+      uint32_t a = addr + i;
+      if (a >= region.addr && a < region.addr + region.len) {
+        out[i] = region.data[a - region.addr];
+      }
+    }
+  }
+}
+
+// --- input conversion ---
+
+void proControllerInputReset(ProControllerInput& in) {
+  memset(&in, 0, sizeof(in));
+  in.leftX = in.leftY = in.rightX = in.rightY = PRO_STICK_CENTER;
+}
+
+static uint16_t axis12(uint8_t v) {
+  return (uint16_t)((v << 4) | (v >> 4));
+}
+
+void proControllerInputFromGamepad(ProControllerInput& in, uint16_t ns, uint8_t hat,
+                                   uint8_t leftX, uint8_t leftY, uint8_t rightX, uint8_t rightY) {
+  // NSButtons: Y B A X L R ZL ZR Minus Plus LStick RStick Home Capture
+  static const uint8_t HAT_BITS[8] = {
+    PRO_BTN_UP, PRO_BTN_UP | PRO_BTN_RIGHT, PRO_BTN_RIGHT, PRO_BTN_DOWN | PRO_BTN_RIGHT,
+    PRO_BTN_DOWN, PRO_BTN_DOWN | PRO_BTN_LEFT, PRO_BTN_LEFT, PRO_BTN_UP | PRO_BTN_LEFT,
+  };
+  in.buttons[0] = (uint8_t)(((ns & 0x0001) ? PRO_BTN_Y : 0) | ((ns & 0x0002) ? PRO_BTN_B : 0) |
+                            ((ns & 0x0004) ? PRO_BTN_A : 0) | ((ns & 0x0008) ? PRO_BTN_X : 0) |
+                            ((ns & 0x0020) ? PRO_BTN_R : 0) | ((ns & 0x0080) ? PRO_BTN_ZR : 0));
+  in.buttons[1] = (uint8_t)(((ns & 0x0100) ? PRO_BTN_MINUS : 0) | ((ns & 0x0200) ? PRO_BTN_PLUS : 0) |
+                            ((ns & 0x0400) ? PRO_BTN_LSTICK : 0) | ((ns & 0x0800) ? PRO_BTN_RSTICK : 0) |
+                            ((ns & 0x1000) ? PRO_BTN_HOME : 0) | ((ns & 0x2000) ? PRO_BTN_CAPTURE : 0));
+  in.buttons[2] = (uint8_t)(((ns & 0x0010) ? PRO_BTN_L : 0) | ((ns & 0x0040) ? PRO_BTN_ZL : 0) |
+                            (hat < 8 ? HAT_BITS[hat] : 0));
+  // HID Y grows downwards, the Pro Controller's grows upwards
+  in.leftX = axis12(leftX);
+  in.leftY = axis12((uint8_t)(255 - leftY));
+  in.rightX = axis12(rightX);
+  in.rightY = axis12((uint8_t)(255 - rightY));
+}
+
+// --- protocol ---
+
+ProControllerProtocol::ProControllerProtocol() {
+  memset(_mac, 0, sizeof(_mac));
+  reset();
+}
+
+void ProControllerProtocol::setMac(const uint8_t mac[6]) {
+  memcpy(_mac, mac, sizeof(_mac));
+}
+
+void ProControllerProtocol::reset() {
+  _state = PRO_STATE_IDLE;
+  proControllerInputReset(_input);
+  _inputDirty = true;
+  _timer = 0;
+  _sentOnce = false;
+  _lastFullUs = 0;
+  _imuEnabled = false;
+  _vibrationEnabled = false;
+  _playerLights = 0;
+  _rumble = false;
+  _replyHead = 0;
+  _replyCount = 0;
+  memset(&_stats, 0, sizeof(_stats));
+}
+
+void ProControllerProtocol::handleOutput(uint8_t reportId, const uint8_t* data, size_t len) {
+  _stats.outputs++;
+  switch (reportId) {
+    case PRO_OUTPUT_USB:
+      if (len >= 1) {
+        handleUsbCommand(data[0]);
+      }
+      break;
+    case PRO_OUTPUT_SUBCMD:
+      if (len >= 10) {
+        handleRumble(data + 1);
+        handleSubcommand(data, len);
+      }
+      break;
+    case PRO_OUTPUT_RUMBLE:
+      if (len >= 9) {
+        handleRumble(data + 1);
+      }
+      break;
+    default:
+      _stats.unknown++;
+      break;
+  }
+}
+
+void ProControllerProtocol::handleUsbCommand(uint8_t cmd) {
+  uint8_t* r;
+  switch (cmd) {
+    case 0x01:   // status: controller type and MAC (LSB first)
+      r = queueReply(PRO_REPORT_USB_REPLY);
+      if (r) {
+        r[1] = 0x01;
+        r[2] = 0x00;
+        r[3] = 0x03;
+        for (uint8_t i = 0; i < 6; i++) {
+          r[4 + i] = _mac[5 - i];
+        }
+      }
+      break;
+    case 0x02:   // handshake
+    case 0x03:   // switch UART to 3 Mbit (nothing to do over USB)
+      if (cmd == 0x02 && _state == PRO_STATE_IDLE) {
+        _state = PRO_STATE_HANDSHAKE;
+      }
+      r = queueReply(PRO_REPORT_USB_REPLY);
+      if (r) {
+        r[1] = cmd;
+      }
+      break;
+    case 0x04:   // HID only, no timeout: start streaming 0x30
+      _state = PRO_STATE_STREAMING;
+      _inputDirty = true;
+      break;
+    case 0x05:   // back to Bluetooth timeout mode: stop streaming
+      if (_state == PRO_STATE_STREAMING) {
+        _state = PRO_STATE_HANDSHAKE;
+      }
+      break;
+    default:
+      _stats.unknown++;
+      break;
+  }
+}
+
+void ProControllerProtocol::handleSubcommand(const uint8_t* data, size_t len) {
+  uint8_t sub = data[9];
+  const uint8_t* args = data + 10;
+  size_t argLen = len - 10;
+  uint8_t* r = queueReply(PRO_REPORT_SUBCMD_REPLY);
+  if (!r) {
+    return;
+  }
+  r[PRO_OFS_ACK] = 0x80;
+  r[PRO_OFS_SUBCMD] = sub;
+  uint8_t* out = r + PRO_OFS_DATA;
+  switch (sub) {
+    case PRO_SUB_PAIRING:
+      r[PRO_OFS_ACK] = 0x81;
+      out[0] = 0x03;
+      break;
+    case PRO_SUB_DEVICE_INFO:
+      r[PRO_OFS_ACK] = 0x82;
+      out[0] = 0x03;               // firmware 3.72
+      out[1] = 0x48;
+      out[2] = 0x03;               // Pro Controller
+      out[3] = 0x02;
+      memcpy(out + 4, _mac, 6);
+      out[10] = 0x01;
+      out[11] = 0x01;              // use the colors in SPI
+      break;
+    case PRO_SUB_TRIGGER_TIME:
+      r[PRO_OFS_ACK] = 0x83;       // elapsed times all zero
+      break;
+    case PRO_SUB_SPI_READ:
+      r[PRO_OFS_ACK] = 0x90;
+      if (argLen >= 5) {
+        uint32_t addr = (uint32_t)args[0] | ((uint32_t)args[1] << 8) | ((uint32_t)args[2] << 16) |
+                        ((uint32_t)args[3] << 24);
+        uint8_t n = args[4] > PRO_SPI_READ_MAX ? PRO_SPI_READ_MAX : args[4];
+        memcpy(out, args, 4);
+        out[4] = n;
+        proControllerSpiRead(addr, n, out + 5);
+        _stats.spiReads++;
+      }
+      break;
+    case PRO_SUB_MCU_CONFIG:
+      // No NFC/IR MCU; the host only needs it for amiibo and accepts the default state
+      r[PRO_OFS_ACK] = 0xA0;
+      {
+        static const uint8_t MCU_STATE[] = { 0x01, 0x00, 0xFF, 0x00, 0x03, 0x00, 0x05, 0x01 };
+        memcpy(out, MCU_STATE, sizeof(MCU_STATE));
+      }
+      break;
+    case PRO_SUB_PLAYER_LIGHTS:
+      if (argLen >= 1) {
+        _playerLights = args[0];
+      }
+      break;
+    case PRO_SUB_GET_LIGHTS:
+      r[PRO_OFS_ACK] = 0xB0;
+      out[0] = _playerLights;
+      break;
+    case PRO_SUB_IMU:
+      if (argLen >= 1) {
+        _imuEnabled = args[0] != 0;
+      }
+      break;
+    case PRO_SUB_VIBRATION:
+      if (argLen >= 1) {
+        _vibrationEnabled = args[0] != 0;
+        if (!_vibrationEnabled) {
+          _rumble = false;
+        }
+      }
+      break;
+    case PRO_SUB_VOLTAGE:
+      r[PRO_OFS_ACK] = 0xD0;
+      out[0] = 0x83;               // ~1.6 V
+      out[1] = 0x06;
+      break;
+    case PRO_SUB_REPORT_MODE:
+    case PRO_SUB_SHIPMENT:
+    case 0x06:                     // set HCI state
+    case 0x22:                     // MCU state
+    case 0x38:                     // HOME light
+    case 0x41:                     // IMU sensitivity
+      break;
+    default:
+      _stats.unknown++;
+      break;
+  }
+}
+
+// 4 bytes per side: high band frequency / amplitude, low band frequency / amplitude.
+// Neutral is 00 01 40 40; the Wiimote has a single on/off motor.
+void ProControllerProtocol::handleRumble(const uint8_t* rumble) {
+  bool on = false;
+  for (uint8_t side = 0; side < 2; side++) {
+    const uint8_t* s = rumble + side * 4;
+    uint8_t highAmp = s[1] & 0xFE;
+    uint8_t lowAmp = s[3] & 0x7F;
+    on = on || highAmp != 0 || lowAmp > 0x40;
+  }
+  _rumble = _vibrationEnabled && on;
+}
+
+uint8_t* ProControllerProtocol::queueReply(uint8_t reportId) {
+  if (_replyCount == PRO_REPLY_QUEUE) {
+    _stats.dropped++;
+    return NULL;
+  }
+  uint8_t* r = _replies[(_replyHead + _replyCount) % PRO_REPLY_QUEUE];
+  _replyCount++;
+  memset(r, 0, PRO_REPORT_SIZE);
+  r[0] = reportId;
+  return r;
+}
+
+void ProControllerProtocol::fillInput(uint8_t* r) {
+  r[PRO_OFS_TIMER] = _timer++;
+  r[PRO_OFS_BATTERY] = PRO_BATTERY_USB;
+  memcpy(r + PRO_OFS_BUTTONS, _input.buttons, 3);
+  r[PRO_OFS_LSTICK] = (uint8_t)(_input.leftX & 0xFF);
+  r[PRO_OFS_LSTICK + 1] = (uint8_t)(((_input.leftX >> 8) & 0x0F) | ((_input.leftY & 0x0F) << 4));
+  r[PRO_OFS_LSTICK + 2] = (uint8_t)(_input.leftY >> 4);
+  r[PRO_OFS_RSTICK] = (uint8_t)(_input.rightX & 0xFF);
+  r[PRO_OFS_RSTICK + 1] = (uint8_t)(((_input.rightX >> 8) & 0x0F) | ((_input.rightY & 0x0F) << 4));
+  r[PRO_OFS_RSTICK + 2] = (uint8_t)(_input.rightY >> 4);
+  r[PRO_OFS_VIBRATOR] = 0x00;
+}
+
+bool ProControllerProtocol::setInput(const ProControllerInput& in) {
+  if (memcmp(&in, &_input, sizeof(in)) == 0) {
+    return false;
+  }
+  _input = in;
+  _inputDirty = true;
+  return true;
+}
+
+uint32_t ProControllerProtocol::dueInUs(uint32_t nowUs) const {
+  if (_replyCount > 0) {
+    return 0;
+  }
+  if (_state != PRO_STATE_STREAMING) {
+    return PRO_REPORT_INTERVAL_US;
+  }
+  if (!_sentOnce) {
+    return 0;
+  }
+  uint32_t since = nowUs - _lastFullUs;
+  uint32_t wait = _inputDirty ? PRO_MIN_INTERVAL_US : PRO_REPORT_INTERVAL_US;
+  return since >= wait ? 0 : wait - since;
+}
+
+bool ProControllerProtocol::nextReport(uint8_t* out, uint32_t nowUs, bool force) {
+  if (_replyCount > 0) {
+    // Replies carry the input state of when they are sent, not of when they were queued
+    uint8_t* r = _replies[_replyHead];
+    if (r[0] == PRO_REPORT_SUBCMD_REPLY) {
+      fillInput(r);
+    }
+    memcpy(out, r, PRO_REPORT_SIZE);
+    _replyHead = (_replyHead + 1) % PRO_REPLY_QUEUE;
+    _replyCount--;
+    _stats.replies++;
+    return true;
+  }
+  if (_state != PRO_STATE_STREAMING || (dueInUs(nowUs) != 0 && !(force && _inputDirty))) {
+    return false;
+  }
+  memset(out, 0, PRO_REPORT_SIZE);
+  out[0] = PRO_REPORT_FULL;
+  fillInput(out);
+  if (_imuEnabled) {
+    for (uint8_t s = 0; s < PRO_IMU_SAMPLES; s++) {
+      uint8_t* p = out + PRO_OFS_IMU + s * 12;
+      for (uint8_t i = 0; i < 3; i++) {
+        p[i * 2] = (uint8_t)(_input.accel[i] & 0xFF);
+        p[i * 2 + 1] = (uint8_t)((uint16_t)_input.accel[i] >> 8);
+        p[6 + i * 2] = (uint8_t)(_input.gyro[i] & 0xFF);
+        p[6 + i * 2 + 1] = (uint8_t)((uint16_t)_input.gyro[i] >> 8);
+      }
+    }
+  }
+  _lastFullUs = nowUs;
+  _sentOnce = true;
+  _inputDirty = false;
+  _stats.fullReports++;
+  return true;
+}
@@ -0,0 +1,165 @@
+// Nintendo Switch Pro Controller USB protocol (device side).
+//
+// Host -> device output reports:
+//   0x80 <cmd>                      USB commands: 01 status, 02 handshake, 03 baud rate,
+//                                   04 HID only (start streaming), 05 stop streaming
+//   0x01 <n> <rumble x8> <sub> ...  rumble + subcommand, answered with a 0x21 report
+//   0x10 <n> <rumble x8>            rumble only
+// Device -> host input reports:
+//   0x81 <cmd> ...                  USB command replies
+//   0x21 <input> <ack> <sub> ...    subcommand replies (SPI flash reads, device info, ...)
+//   0x30 <input> <imu x3>           standard full report, every PRO_REPORT_INTERVAL_US
+//                                   and on input changes (at most once per USB frame)
+//
+// No Arduino or TinyUSB dependency: the USB device (switch_ProController.h) feeds
+// output reports in and sends whatever nextReport() returns, so the state machine
+// can be replayed against host transcripts on Linux (tools/proconreplay).
+
+#ifndef PRO_CONTROLLER_PROTOCOL_H_
+#define PRO_CONTROLLER_PROTOCOL_H_
+
+#include <stdint.h>
+#include <stddef.h>
+
+#define PRO_REPORT_SIZE         64      // report ID + 63 bytes
+#define PRO_REPORT_INTERVAL_US  8000    // native 125 Hz cadence of the 0x30 report
+#define PRO_MIN_INTERVAL_US     1000    // input changes are sent at most once per USB frame
+#define PRO_REPLY_QUEUE         4       // pending 0x81 / 0x21 replies
+
+// Input report IDs
+#define PRO_REPORT_SUBCMD_REPLY 0x21
+#define PRO_REPORT_FULL         0x30
+#define PRO_REPORT_USB_REPLY    0x81
+// Output report IDs
+#define PRO_OUTPUT_SUBCMD       0x01
+#define PRO_OUTPUT_RUMBLE       0x10
+#define PRO_OUTPUT_USB          0x80
+
+// Button bits of ProControllerInput::buttons[]
+#define PRO_BTN_Y        0x01   // [0] right
+#define PRO_BTN_X        0x02
+#define PRO_BTN_B        0x04
+#define PRO_BTN_A        0x08
+#define PRO_BTN_R        0x40
+#define PRO_BTN_ZR       0x80
+#define PRO_BTN_MINUS    0x01   // [1] shared
+#define PRO_BTN_PLUS     0x02
+#define PRO_BTN_RSTICK   0x04
+#define PRO_BTN_LSTICK   0x08
+#define PRO_BTN_HOME     0x10
+#define PRO_BTN_CAPTURE  0x20
+#define PRO_BTN_DOWN     0x01   // [2] left
+#define PRO_BTN_UP       0x02
+#define PRO_BTN_RIGHT    0x04
+#define PRO_BTN_LEFT     0x08
+#define PRO_BTN_L        0x40
+#define PRO_BTN_ZL       0x80
+
+#define PRO_STICK_CENTER 0x800
+
+enum ProControllerState : uint8_t {
+  PRO_STATE_IDLE = 0,     // enumerated, no handshake yet
+  PRO_STATE_HANDSHAKE,    // 0x80 0x02 seen, waiting for 0x80 0x04
+  PRO_STATE_STREAMING,    // HID only mode, 0x30 reports flowing
+};
+
+struct ProControllerInput {
+  uint8_t buttons[3];     // right, shared, left (PRO_BTN_*)
+  uint16_t leftX;         // 12-bit, up / right = larger
+  uint16_t leftY;
+  uint16_t rightX;
+  uint16_t rightY;
+  int16_t accel[3];       // sent only after the host enables the IMU (subcommand 0x40)
+  int16_t gyro[3];
+};
+
+struct ProControllerStats {
+  uint32_t outputs;       // output reports handled
+  uint32_t replies;       // 0x81 / 0x21 replies sent
+  uint32_t fullReports;   // 0x30 reports sent
+  uint32_t spiReads;
+  uint32_t unknown;       // unknown commands / subcommands (acknowledged anyway)
+  uint32_t dropped;       // replies lost because the queue was full
+};
+
+// HID report descriptor of the genuine controller (0x30 joystick report, vendor 0x21 / 0x81 inputs,
+// 0x01 / 0x10 / 0x80 / 0x82 outputs, 63 bytes each)
+extern const uint8_t PRO_CONTROLLER_REPORT_DESCRIPTOR[];
+extern const size_t PRO_CONTROLLER_REPORT_DESCRIPTOR_SIZE;
+
+void proControllerInputReset(ProControllerInput& in);
+
+/**
+ * Convert the NSGamepad report fields (NSButtons bits, hat, 8-bit axes with Y down = larger)
+ * into Pro Controller buttons and 12-bit sticks. IMU fields are left untouched.
+ */
+void proControllerInputFromGamepad(ProControllerInput& in, uint16_t nsButtons, uint8_t hat,
+                                   uint8_t leftX, uint8_t leftY, uint8_t rightX, uint8_t rightY);
+
+/**
+ * Read from the emulated SPI flash (factory calibration, colors, device type).
+ * Unprogrammed addresses read 0xFF, which tells the host there is no user calibration.
+ */
+void proControllerSpiRead(uint32_t addr, uint8_t len, uint8_t* out);
+
+class ProControllerProtocol {
+  public:
+    ProControllerProtocol();
+
+    // Bluetooth address reported by 0x81 0x01 and device info (MSB first)
+    void setMac(const uint8_t mac[6]);
+    void reset();
+
+    /**
+     * Handle one output report from the host. Replies are queued for nextReport().
+     * @param data report payload without the report ID
+     */
+    void handleOutput(uint8_t reportId, const uint8_t* data, size_t len);
+
+    // Returns true if the input differs from the last sent report
+    bool setInput(const ProControllerInput& in);
+
+    /**
+     * Next input report to send: queued replies first, then 0x30 while streaming
+     * (every PRO_REPORT_INTERVAL_US, or on input changes).
+     * @param out PRO_REPORT_SIZE bytes, out[0] is the report ID
+     * @param force send a changed input now instead of waiting PRO_MIN_INTERVAL_US
+     * @return false if nothing is due
+     */
+    bool nextReport(uint8_t* out, uint32_t nowUs, bool force = false);
+
+    // Time until nextReport() has something to send (0: now)
+    uint32_t dueInUs(uint32_t nowUs) const;
+
+    ProControllerState state() const { return _state; }
+    bool imuEnabled() const { return _imuEnabled; }
+    bool vibrationEnabled() const { return _vibrationEnabled; }
+    uint8_t playerLights() const { return _playerLights; }   // low nibble on, high nibble flashing
+    bool rumbleActive() const { return _rumble; }
+    const ProControllerStats& stats() const { return _stats; }
+
+  private:
+    void handleUsbCommand(uint8_t cmd);
+    void handleSubcommand(const uint8_t* data, size_t len);
+    void handleRumble(const uint8_t* rumble);
+    uint8_t* queueReply(uint8_t reportId);
+    void fillInput(uint8_t* report);
+
+    ProControllerState _state;
+    uint8_t _mac[6];
+    ProControllerInput _input;
+    bool _inputDirty;
+    uint8_t _timer;
+    bool _sentOnce;
+    uint32_t _lastFullUs;
+    bool _imuEnabled;
+    bool _vibrationEnabled;
+    uint8_t _playerLights;
+    bool _rumble;
+    uint8_t _replies[PRO_REPLY_QUEUE][PRO_REPORT_SIZE];
+    uint8_t _replyHead;
+    uint8_t _replyCount;
+    ProControllerStats _stats;
+};
+
+#endif  // PRO_CONTROLLER_PROTOCOL_H_
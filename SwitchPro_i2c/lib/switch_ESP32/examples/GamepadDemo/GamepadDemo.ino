@@ -52,7 +52,8 @@ void loop() {
     dpad = NSGAMEPAD_DPAD_UP;
 
   // Functions above only set the values.
-  // This writes the report to the host.
+  // loop() queues the report, task() writes it to the host.
   Gamepad.loop();
+  Gamepad.task();
   delay(100);
 }
@@ -27,77 +27,44 @@ SOFTWARE.
 #if CONFIG_TINYUSB_HID_ENABLED
 
 #include "switch_ESP32.h"
+#include "class/hid/hid_device.h"
 
-// HID report descriptor using TinyUSB's template
-// Single Report (no ID) descriptor
-static const uint8_t report_descriptor[] = {
-  // Gamepad for Nintendo Switch
-  // 14 buttons, 1 8-way dpad, 2 analog sticks (4 axes)
-  0x05, 0x01,        // Usage Page (Generic Desktop Ctrls)
-  0x09, 0x05,        // Usage (Game Pad)
-  0xA1, 0x01,        // Collection (Application)
-  0x15, 0x00,        //   Logical Minimum (0)
-  0x25, 0x01,        //   Logical Maximum (1)
-  0x35, 0x00,        //   Physical Minimum (0)
-  0x45, 0x01,        //   Physical Maximum (1)
-  0x75, 0x01,        //   Report Size (1)
-  0x95, 0x0E,        //   Report Count (14)
-  0x05, 0x09,        //   Usage Page (Button)
-  0x19, 0x01,        //   Usage Minimum (0x01)
-  0x29, 0x0E,        //   Usage Maximum (0x0E)
-  0x81, 0x02,        //   Input (Data,Var,Abs,No Wrap,Linear,
-                     //   Preferred State,No Null Position)
-  0x95, 0x02,        //   Report Count (2)
-  0x81, 0x01,        //   Input (Const,Array,Abs,No Wrap,Linear,
-                     //   Preferred State,No Null Position)
-  0x05, 0x01,        //   Usage Page (Generic Desktop Ctrls)
-  0x25, 0x07,        //   Logical Maximum (7)
-  0x46, 0x3B, 0x01,  //   Physical Maximum (315)
-  0x75, 0x04,        //   Report Size (4)
-  0x95, 0x01,        //   Report Count (1)
-  0x65, 0x14,        //   Unit (System: English Rotation, Length: Centimeter)
-  0x09, 0x39,        //   Usage (Hat switch)
-  0x81, 0x42,        //   Input (Data,Var,Abs,No Wrap,Linear,
-                     //   Preferred State,Null State)
-  0x65, 0x00,        //   Unit (None)
-  0x95, 0x01,        //   Report Count (1)
-  0x81, 0x01,        //   Input (Const,Array,Abs,No Wrap,Linear,
-                     //   Preferred State,No Null Position)
-  0x26, 0xFF, 0x00,  //   Logical Maximum (255)
-  0x46, 0xFF, 0x00,  //   Physical Maximum (255)
-  0x09, 0x30,        //   Usage (X)
-  0x09, 0x31,        //   Usage (Y)
-  0x09, 0x32,        //   Usage (Z)
-  0x09, 0x35,        //   Usage (Rz)
-  0x75, 0x08,        //   Report Size (8)
-  0x95, 0x04,        //   Report Count (4)
-  0x81, 0x02,        //   Input (Data,Var,Abs,No Wrap,Linear,
-                     //   Preferred State,No Null Position)
-  0x75, 0x08,        //   Report Size (8)
-  0x95, 0x01,        //   Report Count (1)
-  0x81, 0x01,        //   Input (Const,Array,Abs,No Wrap,Linear,
-                     //   Preferred State,No Null Position)
-  0xC0,              // End Collection
-};
-
-NSGamepad::NSGamepad(void) : hid() {
-  static bool initialized = false;
-  startMillis = 0;
+// Pads that could not be registered
+static NSGamepadStats noPadStats;
+static void (*submitCallback)(uint32_t tag) = NULL;
+
+static bool submitReport(uint8_t reportId, const HID_NSGamepadReport_Data_t& report, uint32_t tag, void* context) {
+  // Hand the report to the IN endpoint without waiting for the transfer (the stack copies it)
+  if (!tud_hid_n_report(0, reportId, &report, sizeof(report))) {
+    return false;
+  }
+  if (tag != 0 && submitCallback != NULL) {
+    submitCallback(tag);
+  }
+  return true;
+}
+
+NSGamepadRouter& NSGamepad::router(void) {
+  static NSGamepadRouter instance;
+  return instance;
+}
+
+NSGamepad::NSGamepad(uint8_t reportId) : hid() {
+  _generation = 0;
   USB.VID(0x0f0d);
   USB.PID(0x00c1);
   USB.usbClass(0);
   USB.usbSubClass(0);
   USB.usbProtocol(0);
   end();
-  if (!initialized) {
-    initialized = true;
-    hid.addDevice(this, sizeof(report_descriptor));
+  _pad = router().addPad(reportId);
+  if (_pad != NSGAMEPAD_NO_PAD) {
+    hid.addDevice(this, nsGamepadReportDescriptor(reportId, NULL));
   }
 }
 
 uint16_t NSGamepad::_onGetDescriptor(uint8_t* dst) {
-  memcpy(dst, report_descriptor, sizeof(report_descriptor));
-  return sizeof(report_descriptor);
+  return nsGamepadReportDescriptor(router().reportId(_pad), dst);
 }
 
 void NSGamepad::begin(void) {
@@ -110,46 +77,87 @@ void NSGamepad::end(void) {
   _report.leftXAxis = _report.leftYAxis = 0x80;
   _report.rightXAxis = _report.rightYAxis = 0x80;
   _report.dPad = NSGAMEPAD_DPAD_CENTERED;
+  _generation++;
 }
 
 bool NSGamepad::write(void) {
-  return hid.SendReport(0, &_report, sizeof(_report));
+  if (_pad == NSGAMEPAD_NO_PAD) {
+    return false;
+  }
+  // Same submit path as task(), so USBHID's own send handshake never runs alongside it
+  uint32_t startMs = millis();
+  while (!tud_hid_n_ready(0)) {
+    if (millis() - startMs >= NSGAMEPAD_WRITE_TIMEOUT_MS) {
+      router().wrote(_pad, _report, _generation, false, millis());
+      return false;
+    }
+    delay(1);
+  }
+  bool ok = submitReport(router().reportId(_pad), _report, 0, NULL);
+  router().wrote(_pad, _report, _generation, ok, millis());
+  return ok;
 }
 
 bool NSGamepad::write(void *report, size_t len) {
-  memcpy(&_report, report, min(len, sizeof(_report)));
+  len = min(len, sizeof(_report));
+  if (memcmp(&_report, report, len) != 0) {
+    memcpy(&_report, report, len);
+    _generation++;
+  }
   return write();
 }
 
-void NSGamepad::loop(void) {
-  if (startMillis != millis()) {
-    write();
-    startMillis = millis();
+bool NSGamepad::loop(uint32_t tag) {
+  if (_pad == NSGAMEPAD_NO_PAD) {
+    return false;
   }
+  return router().update(_pad, _report, _generation, !tud_hid_n_ready(0), tag);
+}
+
+bool NSGamepad::task(void) {
+  return router().service(tud_hid_n_ready(0), millis(), submitReport, NULL);
+}
+
+void NSGamepad::onSubmit(void (*callback)(uint32_t tag)) {
+  submitCallback = callback;
+}
+
+void NSGamepad::keepalive(uint16_t ms) {
+  if (_pad != NSGAMEPAD_NO_PAD) {
+    router().keepalive(_pad, ms);
+  }
+}
+
+bool NSGamepad::pending(void) const {
+  return router().pending();
+}
+
+const NSGamepadStats& NSGamepad::stats(void) const {
+  return _pad == NSGAMEPAD_NO_PAD ? noPadStats : router().stats(_pad);
 }
 
 void NSGamepad::press(uint8_t b) {
   if (b > 15) b = 15;
-  _report.buttons |= (uint16_t)1 << b;
+  buttons(_report.buttons | ((uint16_t)1 << b));
 }
 
 void NSGamepad::release(uint8_t b) {
   if (b > 15) b = 15;
-  _report.buttons &= ~((uint16_t)1 << b);
+  buttons(_report.buttons & ~((uint16_t)1 << b));
 }
 
 void NSGamepad::allAxes(uint32_t RYRXLYLX) {
-  _report.rightYAxis = ((RYRXLYLX >> 24) & 0xFF) ^ 0x80;
-  _report.rightXAxis = ((RYRXLYLX >> 16) & 0xFF) ^ 0x80;
-  _report.leftYAxis  = ((RYRXLYLX >>  8) & 0xFF) ^ 0x80;
-  _report.leftXAxis  = ((RYRXLYLX      ) & 0xFF) ^ 0x80;
+  rightYAxis(((RYRXLYLX >> 24) & 0xFF) ^ 0x80);
+  rightXAxis(((RYRXLYLX >> 16) & 0xFF) ^ 0x80);
+  leftYAxis(((RYRXLYLX >>  8) & 0xFF) ^ 0x80);
+  leftXAxis(((RYRXLYLX      ) & 0xFF) ^ 0x80);
 }
 
 void NSGamepad::allAxes(uint8_t RY, uint8_t RX, uint8_t LY, uint8_t LX) {
-  _report.rightYAxis = RY ^ 0x80;
-  _report.rightXAxis = RX ^ 0x80;
-  _report.leftYAxis  = LY ^ 0x80;
-  _report.leftXAxis  = LX ^ 0x80;
+  rightYAxis(RY ^ 0x80);
+  rightXAxis(RX ^ 0x80);
+  leftYAxis(LY ^ 0x80);
+  leftXAxis(LX ^ 0x80);
 }
 
 // The direction pad is limited to 8 directions plus centered. This means
@@ -177,7 +185,7 @@ void NSGamepad::dPad(bool up, bool down, bool left, bool right) {
     NSGAMEPAD_DPAD_CENTERED     // 1111
   };
   uint8_t dpad_bits = (up << 3) | (down << 2) | (left << 1) | (right << 0);
-  _report.dPad = BITS2DIR[dpad_bits];
+  dPad(BITS2DIR[dpad_bits]);
 }
 
 #endif /* CONFIG_TINYUSB_HID_ENABLED */
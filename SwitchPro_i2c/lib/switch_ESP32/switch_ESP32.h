@@ -28,6 +28,8 @@ SOFTWARE.
 #include "USBHID.h"
 #if CONFIG_TINYUSB_HID_ENABLED
 
+#include "NSGamepadRouter.h"
+
 // Dpad directions
 typedef uint8_t NSDirection_t;
 #define NSGAMEPAD_DPAD_UP  0
@@ -59,50 +61,61 @@ enum NSButtons {
   NSButton_Reserved2
 };
 
-#define ATTRIBUTE_PACKED  __attribute__((packed, aligned(1)))
-
-// 14 Buttons, 4 Axes, 1 D-Pad
-typedef struct ATTRIBUTE_PACKED {
-  uint16_t buttons;
-
-  uint8_t dPad;
-
-  uint8_t leftXAxis;
-  uint8_t leftYAxis;
-
-  uint8_t rightXAxis;
-  uint8_t rightYAxis;
-  uint8_t filler;
-} HID_NSGamepadReport_Data_t;
-
 class NSGamepad: public USBHIDDevice {
   public:
-    NSGamepad(void);
+    // reportId 0: the only pad (HORIPAD compatible). For several pads on one interface
+    // construct each with its own report ID 1..NSGAMEPAD_MAX_PADS before USB.begin().
+    explicit NSGamepad(uint8_t reportId = 0);
 
     void begin(void);
     void end(void);
-    void loop(void);
+    // Non-blocking: queues the report when it changed (in order, see NSGAMEPAD_QUEUE); task()
+    // submits it. Returns false if a button change was lost because the queue was full.
+    // A non-zero tag is passed to the onSubmit() callback once the report is submitted.
+    bool loop(uint32_t tag = 0);
+    // Hands at most one queued report of any pad (in turn) or a due keepalive to the IN endpoint.
+    // The only place reports are submitted besides write(): call it often, from the same task
+    // as loop() and write(). Returns true if a report was submitted in this call.
+    static bool task(void);
+    // Called from task() with the tag of each tagged report the endpoint accepted
+    static void onSubmit(void (*callback)(uint32_t tag));
+    // Blocking: waits up to NSGAMEPAD_WRITE_TIMEOUT_MS for the endpoint, then submits the
+    // report now, changed or not. Call from the task that runs task().
     bool write(void);
     bool write(void *report, size_t len);
     void press(uint8_t b);
     void release(uint8_t b);
-    inline void releaseAll(void) { _report.buttons = 0; }
-    inline void buttons(uint16_t b) { _report.buttons = b; }
-    inline void leftXAxis(uint8_t a) { _report.leftXAxis = a; }
-    inline void leftYAxis(uint8_t a) { _report.leftYAxis = a; }
-    inline void rightXAxis(uint8_t a) { _report.rightXAxis = a; }
-    inline void rightYAxis(uint8_t a) { _report.rightYAxis = a; }
+    inline void releaseAll(void) { buttons(0); }
+    inline void buttons(uint16_t b) { if (_report.buttons != b) { _report.buttons = b; _generation++; } }
+    inline void leftXAxis(uint8_t a) { if (_report.leftXAxis != a) { _report.leftXAxis = a; _generation++; } }
+    inline void leftYAxis(uint8_t a) { if (_report.leftYAxis != a) { _report.leftYAxis = a; _generation++; } }
+    inline void rightXAxis(uint8_t a) { if (_report.rightXAxis != a) { _report.rightXAxis = a; _generation++; } }
+    inline void rightYAxis(uint8_t a) { if (_report.rightYAxis != a) { _report.rightYAxis = a; _generation++; } }
     void allAxes(uint32_t RYRXLYLX);
     void allAxes(uint8_t RY, uint8_t RX, uint8_t LY, uint8_t LX);
-    inline void dPad(NSDirection_t d) { _report.dPad = d; }
+    inline void dPad(NSDirection_t d) { if (_report.dPad != d) { _report.dPad = d; _generation++; } }
     void dPad(bool up, bool down, bool left, bool right);
 
+    // Keepalive period for task() in ms (0: only send on changes)
+    void keepalive(uint16_t ms);
+    // Reports of any pad waiting for the endpoint: call task() again soon
+    bool pending(void) const;
+    // Incremented by every setter that changes the report
+    inline uint32_t generation(void) const { return _generation; }
+    const NSGamepadStats& stats(void) const;
+    // 0 for the only pad; NSGAMEPAD_NO_PAD if the report ID was refused (duplicate, mixed with 0, too many pads)
+    inline uint8_t reportId(void) const { return _pad == NSGAMEPAD_NO_PAD ? NSGAMEPAD_NO_PAD : router().reportId(_pad); }
+
+    // Scheduler shared by all pads on the interface
+    static NSGamepadRouter& router(void);
+
     // internal use
     uint16_t _onGetDescriptor(uint8_t* buffer);
   protected:
     USBHID hid;
     HID_NSGamepadReport_Data_t _report;
-    uint32_t startMillis;
+    uint32_t _generation;
+    uint8_t _pad;
 };
 
 #endif  // CONFIG_TINYUSB_HID_ENABLED
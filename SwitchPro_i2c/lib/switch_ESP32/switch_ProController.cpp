@@ -0,0 +1,123 @@
+// Nintendo Switch Pro Controller over USB, see switch_ProController.h
+
+#include <Arduino.h>
+
+#if CONFIG_TINYUSB_HID_ENABLED
+
+#include "switch_ProController.h"
+
+ProControllerGamepad::ProControllerGamepad(void) : hid() {
+  static bool initialized = false;
+  _outputs = NULL;
+  _outputCallback = NULL;
+  _streaming = false;
+  _nextDueUs = 0;
+  _sendFailures = 0;
+  // The Switch only runs the Pro Controller protocol for this exact identity
+  USB.VID(0x057E);
+  USB.PID(0x2009);
+  USB.firmwareVersion(0x0210);
+  USB.productName("Pro Controller");
+  USB.manufacturerName("Nintendo Co., Ltd.");
+  USB.serialNumber("000000000001");
+  USB.usbClass(0);
+  USB.usbSubClass(0);
+  USB.usbProtocol(0);
+  end();
+  if (!initialized) {
+    initialized = true;
+    hid.addDevice(this, PRO_CONTROLLER_REPORT_DESCRIPTOR_SIZE);
+  }
+}
+
+uint16_t ProControllerGamepad::_onGetDescriptor(uint8_t* dst) {
+  memcpy(dst, PRO_CONTROLLER_REPORT_DESCRIPTOR, PRO_CONTROLLER_REPORT_DESCRIPTOR_SIZE);
+  return PRO_CONTROLLER_REPORT_DESCRIPTOR_SIZE;
+}
+
+// TinyUSB task: only copy the report, the protocol runs in task()
+void ProControllerGamepad::_onOutput(uint8_t report_id, const uint8_t* buffer, uint16_t len) {
+  if (_outputs == NULL) {
+    return;
+  }
+  OutputReport report;
+  report.id = report_id;
+  report.len = (uint8_t)min((size_t)len, sizeof(report.data));
+  memcpy(report.data, buffer, report.len);
+  if (xQueueSend(_outputs, &report, 0) == pdTRUE && _outputCallback) {
+    _outputCallback();
+  }
+}
+
+void ProControllerGamepad::begin(void) {
+  if (_outputs == NULL) {
+    _outputs = xQueueCreate(PRO_OUTPUT_QUEUE, sizeof(OutputReport));
+  }
+  uint64_t efuse = ESP.getEfuseMac();
+  uint8_t mac[6];
+  for (uint8_t i = 0; i < 6; i++) {
+    mac[i] = (uint8_t)(efuse >> (8 * i));
+  }
+  _protocol.setMac(mac);
+  _protocol.reset();
+  hid.begin();
+  end();
+}
+
+void ProControllerGamepad::end(void) {
+  _buttons = 0;
+  _dPad = 0x0F;
+  _leftX = _leftY = _rightX = _rightY = 0x80;
+  proControllerInputReset(_input);
+}
+
+void ProControllerGamepad::imu(const int16_t accel[3], const int16_t gyro[3]) {
+  memcpy(_input.accel, accel, sizeof(_input.accel));
+  memcpy(_input.gyro, gyro, sizeof(_input.gyro));
+}
+
+void ProControllerGamepad::drainOutputs(void) {
+  OutputReport report;
+  while (_outputs != NULL && xQueueReceive(_outputs, &report, 0) == pdTRUE) {
+    _protocol.handleOutput(report.id, report.data, report.len);
+  }
+}
+
+bool ProControllerGamepad::send(uint32_t nowUs, bool force) {
+  proControllerInputFromGamepad(_input, _buttons, _dPad, _leftX, _leftY, _rightX, _rightY);
+  _protocol.setInput(_input);
+  uint8_t report[PRO_REPORT_SIZE];
+  bool sent = false;
+  // Replies first (at most a full queue), then the 0x30 report if due
+  for (uint8_t i = 0; i <= PRO_REPLY_QUEUE && _protocol.nextReport(report, nowUs, force); i++) {
+    if (hid.SendReport(report[0], report + 1, PRO_REPORT_SIZE - 1)) {
+      sent = true;
+    } else {
+      _sendFailures++;
+    }
+  }
+  _streaming = _protocol.state() == PRO_STATE_STREAMING;
+  _nextDueUs = nowUs + _protocol.dueInUs(nowUs);
+  return sent;
+}
+
+bool ProControllerGamepad::write(void) {
+  drainOutputs();
+  return send((uint32_t)micros(), true);
+}
+
+bool ProControllerGamepad::loop(void) {
+  drainOutputs();
+  return send((uint32_t)micros(), false);
+}
+
+bool ProControllerGamepad::task(uint32_t nowUs) {
+  drainOutputs();
+  return send(nowUs, false);
+}
+
+bool ProControllerGamepad::needsTick(uint32_t nowUs) const {
+  return _streaming && (int32_t)(nowUs - _nextDueUs) >= 0;
+}
+
+#endif /* CONFIG_TINYUSB_HID_ENABLED */
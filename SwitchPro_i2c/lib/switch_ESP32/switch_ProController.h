@@ -0,0 +1,91 @@
+// Nintendo Switch Pro Controller over USB (VID 057E / PID 2009).
+//
+// Same setters as NSGamepad (NSButtons bits, NSGAMEPAD_DPAD_* hat, 8-bit axes) so it can
+// replace it without changing the caller, plus the host feedback a HORIPAD cannot get:
+// player lights, rumble and IMU enable. Unlike NSGamepad the host talks back, so task()
+// must be called regularly from the task that writes reports; it answers the handshake
+// and keeps the 0x30 report at its native 125 Hz cadence.
+//
+// Output reports arrive in the TinyUSB task and are queued; all protocol state is only
+// touched by the caller of begin() / write() / loop() / task().
+
+#ifndef SWITCH_PRO_CONTROLLER_H_
+#define SWITCH_PRO_CONTROLLER_H_
+
+#include "USB.h"
+#include "USBHID.h"
+#if CONFIG_TINYUSB_HID_ENABLED
+
+#include "freertos/FreeRTOS.h"
+#include "freertos/queue.h"
+#include "ProControllerProtocol.h"
+
+#define PRO_OUTPUT_QUEUE 8    // output reports waiting for task()
+
+class ProControllerGamepad: public USBHIDDevice {
+  public:
+    ProControllerGamepad(void);
+
+    void begin(void);
+    void end(void);
+    // Send the current state now if the host is streaming. Returns true if a report was sent.
+    bool write(void);
+    // Send the current state if it changed, at most once per PRO_MIN_INTERVAL_US
+    bool loop(void);
+    /**
+     * Answer queued host commands and send due reports (replies, 0x30 keep-alive).
+     * @return true if any report was sent
+     */
+    bool task(uint32_t nowUs);
+    // true when task() has something to send (safe to call from a timer callback)
+    bool needsTick(uint32_t nowUs) const;
+    // Called from the TinyUSB task after an output report was queued (e.g. to wake the caller of task())
+    void onOutput(void (*callback)(void)) { _outputCallback = callback; }
+
+    inline void buttons(uint16_t b) { _buttons = b; }
+    inline void leftXAxis(uint8_t a) { _leftX = a; }
+    inline void leftYAxis(uint8_t a) { _leftY = a; }
+    inline void rightXAxis(uint8_t a) { _rightX = a; }
+    inline void rightYAxis(uint8_t a) { _rightY = a; }
+    inline void dPad(uint8_t d) { _dPad = d; }
+    // Raw IMU samples (accel 4096 / G, gyro 13371 / 1000 dps), sent once the host enables the IMU
+    void imu(const int16_t accel[3], const int16_t gyro[3]);
+
+    ProControllerState state(void) const { return _protocol.state(); }
+    uint8_t playerLights(void) const { return _protocol.playerLights(); }
+    bool rumbleActive(void) const { return _protocol.rumbleActive(); }
+    bool imuEnabled(void) const { return _protocol.imuEnabled(); }
+    const ProControllerStats& stats(void) const { return _protocol.stats(); }
+    uint32_t sendFailures(void) const { return _sendFailures; }
+
+    // internal use
+    uint16_t _onGetDescriptor(uint8_t* buffer);
+    void _onOutput(uint8_t report_id, const uint8_t* buffer, uint16_t len);
+  protected:
+    struct OutputReport {
+      uint8_t id;
+      uint8_t len;
+      uint8_t data[PRO_REPORT_SIZE - 1];
+    };
+
+    void drainOutputs(void);
+    bool send(uint32_t nowUs, bool force);
+
+    USBHID hid;
+    ProControllerProtocol _protocol;
+    ProControllerInput _input;
+    uint16_t _buttons;
+    uint8_t _dPad;
+    uint8_t _leftX;
+    uint8_t _leftY;
+    uint8_t _rightX;
+    uint8_t _rightY;
+    QueueHandle_t _outputs;
+    void (*_outputCallback)(void);
+    volatile bool _streaming;
+    volatile uint32_t _nextDueUs;
+    uint32_t _sendFailures;
+};
+
+#endif  // CONFIG_TINYUSB_HID_ENABLED
+#endif  // SWITCH_PRO_CONTROLLER_H_
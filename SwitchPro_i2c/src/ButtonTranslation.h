@@ -0,0 +1,215 @@
+// 檔案: ButtonTranslation.h
+// 作用: Wiimote 按鈕遮罩 -> NS 按鈕字組 / 十字鍵 (hat) / 搖桿座標 的查表轉換
+//
+// 映射表 (ButtonMapping / DirectionMapping) 展開成查表:
+//   - 按鈕: 遮罩 (wiimoteButtonSet 格式) 的高低位元組各查一次 256 項表、Nunchuk 的 C/Z 查一次 4 項表，
+//     OR 起來就是 NS 按鈕字組
+//   - 方向: Wiimote 的四個方向鍵都在最低 4 位元，查一次 16 項表得到 hat 與兩個搖桿座標
+// 每個封包只需幾次查表，沒有逐項迴圈也沒有 if/else 分支。
+//
+// 內建映射以 makeButtonTranslation() 在編譯期產生 (只用 C++11 constexpr)，
+// 網頁編輯的設定檔則以 buildButtonTranslation() 在編輯時產生。不依賴 Arduino，可在電腦上編譯。
+
+#pragma once
+#include <stdint.h>
+#include <stddef.h>
+
+// hat 數值 (與 switch_ESP32.h 的 NSGAMEPAD_DPAD_* 相同)
+#define BUTTON_HAT_UP          0
+#define BUTTON_HAT_UP_RIGHT    1
+#define BUTTON_HAT_RIGHT       2
+#define BUTTON_HAT_DOWN_RIGHT  3
+#define BUTTON_HAT_DOWN        4
+#define BUTTON_HAT_DOWN_LEFT   5
+#define BUTTON_HAT_LEFT        6
+#define BUTTON_HAT_UP_LEFT     7
+#define BUTTON_HAT_CENTERED    0x0F
+
+#define BUTTON_STICK_MIN     0
+#define BUTTON_STICK_CENTER  128
+#define BUTTON_STICK_MAX     255
+
+// 方向鍵所在的位元 (Wiimote 的 LEFT/RIGHT/DOWN/UP 都在最低 4 位元)
+#define BUTTON_DIRECTION_MASK  0x000F
+
+// Nunchuk 的 C/Z 在 wiimoteButtonSet 的位元 16、17 (BUTTON_C / BUTTON_Z)
+#define BUTTON_EXT_SHIFT  16
+#define BUTTON_EXT_COUNT  4
+
+struct ButtonMapping {
+    uint32_t wiimoteButton; // wiimoteButtonSet 格式
+    uint8_t nsButton;       // NSButton_* (位元編號)
+};
+
+// 哪個 Wiimote 方向鍵對應 NS 的上/下/左/右 (橫握時方向會旋轉)
+struct DirectionMapping {
+    uint16_t up;
+    uint16_t down;
+    uint16_t left;
+    uint16_t right;
+};
+
+// 方向鍵輸出到哪裡
+#define DIRECTION_TARGET_DPAD         0
+#define DIRECTION_TARGET_LEFT_STICK   1   // 8 方向，推到底
+#define DIRECTION_TARGET_RIGHT_STICK  2
+#define DIRECTION_TARGET_COUNT        3
+
+// 方向鍵的完整輸出，未使用的部分維持置中
+struct DirectionOutput {
+    uint8_t hat;
+    uint8_t leftX;
+    uint8_t leftY;
+    uint8_t rightX;
+    uint8_t rightY;
+};
+
+struct ButtonTranslation {
+    uint16_t low[256];             // 遮罩低位元組 -> NS 按鈕
+    uint16_t high[256];            // 遮罩高位元組 -> NS 按鈕
+    uint16_t ext[BUTTON_EXT_COUNT];  // Nunchuk C/Z -> NS 按鈕
+    DirectionOutput direction[16]; // 方向鍵 (遮罩最低 4 位元)
+};
+
+/**
+ * 轉換按鈕遮罩 (方向鍵除外)
+ * @param buttons wiimoteButtonSet 格式
+ * @return NS 按鈕字組，可直接交給 NSGamepad::buttons()
+ */
+inline uint16_t translateButtons(const ButtonTranslation& t, uint32_t buttons) {
+    return t.low[buttons & 0xFF] | t.high[(buttons >> 8) & 0xFF] |
+           t.ext[(buttons >> BUTTON_EXT_SHIFT) & (BUTTON_EXT_COUNT - 1)];
+}
+
+// 轉換方向鍵
+inline const DirectionOutput& translateDirection(const ButtonTranslation& t, uint32_t buttons) {
+    return t.direction[buttons & BUTTON_DIRECTION_MASK];
+}
+
+// --- 編譯期產生查表 ---
+
+namespace button_translation_detail {
+
+template <size_t... I> struct IndexSeq {};
+template <size_t N, size_t... I> struct MakeIndexSeq : MakeIndexSeq<N - 1, N - 1, I...> {};
+template <size_t... I> struct MakeIndexSeq<0, I...> { typedef IndexSeq<I...> type; };
+
+// 與 NSGamepad::press() 相同: 超過 15 的編號視為 15
+constexpr uint16_t nsBit(uint8_t nsButton) {
+    return (uint16_t)(1u << (nsButton > 15 ? 15 : nsButton));
+}
+
+// wiimoteBits 中所有被映射的按鈕對應的 NS 位元
+template <size_t N>
+constexpr uint16_t nsButtonsFor(const ButtonMapping (&m)[N], uint32_t wiimoteBits, size_t i = 0) {
+    return i == N ? 0
+        : (uint16_t)(((m[i].wiimoteButton & wiimoteBits) ? nsBit(m[i].nsButton) : 0)
+                     | nsButtonsFor(m, wiimoteBits, i + 1));
+}
+
+// 與 NSGamepad::dPad(up, down, left, right) 相同: 相反方向同時按下視為置中
+constexpr uint8_t HAT_FROM_BITS[16] = {
+    BUTTON_HAT_CENTERED,   BUTTON_HAT_RIGHT,      BUTTON_HAT_LEFT,      BUTTON_HAT_CENTERED,
+    BUTTON_HAT_DOWN,       BUTTON_HAT_DOWN_RIGHT, BUTTON_HAT_DOWN_LEFT, BUTTON_HAT_CENTERED,
+    BUTTON_HAT_UP,         BUTTON_HAT_UP_RIGHT,   BUTTON_HAT_UP_LEFT,   BUTTON_HAT_CENTERED,
+    BUTTON_HAT_CENTERED,   BUTTON_HAT_CENTERED,   BUTTON_HAT_CENTERED,  BUTTON_HAT_CENTERED
+};
+
+constexpr uint8_t hatFor(const DirectionMapping& d, uint16_t bits) {
+    return HAT_FROM_BITS[((bits & d.up) ? 8 : 0) | ((bits & d.down) ? 4 : 0)
+                         | ((bits & d.left) ? 2 : 0) | ((bits & d.right) ? 1 : 0)];
+}
+
+// 單軸: 只按一邊時推到底，兩邊都按或都沒按時置中
+constexpr uint8_t axisFor(bool negative, bool positive) {
+    return negative == positive ? BUTTON_STICK_CENTER : (negative ? BUTTON_STICK_MIN : BUTTON_STICK_MAX);
+}
+
+constexpr uint8_t stickXFor(const DirectionMapping& d, uint16_t bits) {
+    return axisFor((bits & d.left) != 0, (bits & d.right) != 0);
+}
+
+constexpr uint8_t stickYFor(const DirectionMapping& d, uint16_t bits) {
+    return axisFor((bits & d.up) != 0, (bits & d.down) != 0);
+}
+
+constexpr DirectionOutput directionFor(const DirectionMapping& d, uint8_t target, uint16_t bits) {
+    return DirectionOutput{
+        target == DIRECTION_TARGET_DPAD ? hatFor(d, bits) : (uint8_t)BUTTON_HAT_CENTERED,
+        target == DIRECTION_TARGET_LEFT_STICK ? stickXFor(d, bits) : (uint8_t)BUTTON_STICK_CENTER,
+        target == DIRECTION_TARGET_LEFT_STICK ? stickYFor(d, bits) : (uint8_t)BUTTON_STICK_CENTER,
+        target == DIRECTION_TARGET_RIGHT_STICK ? stickXFor(d, bits) : (uint8_t)BUTTON_STICK_CENTER,
+        target == DIRECTION_TARGET_RIGHT_STICK ? stickYFor(d, bits) : (uint8_t)BUTTON_STICK_CENTER
+    };
+}
+
+template <size_t N, size_t... B, size_t... E, size_t... D>
+constexpr ButtonTranslation make(const ButtonMapping (&m)[N], const DirectionMapping& d, uint8_t target,
+                                 IndexSeq<B...>, IndexSeq<E...>, IndexSeq<D...>) {
+    return ButtonTranslation{
+        { nsButtonsFor(m, (uint32_t)B)... },
+        { nsButtonsFor(m, (uint32_t)B << 8)... },
+        { nsButtonsFor(m, (uint32_t)E << BUTTON_EXT_SHIFT)... },
+        { directionFor(d, target, (uint16_t)D)... }
+    };
+}
+
+}  // namespace button_translation_detail
+
+/**
+ * 由映射表產生查表 (宣告為 constexpr 時在編譯期完成)
+ * @param m 按鈕映射表；方向鍵不應出現在這裡
+ * @param d 方向鍵映射，四個位元都必須在 BUTTON_DIRECTION_MASK 內
+ * @param target DIRECTION_TARGET_*
+ */
+template <size_t N>
+constexpr ButtonTranslation makeButtonTranslation(const ButtonMapping (&m)[N], const DirectionMapping& d,
+                                                  uint8_t target) {
+    return button_translation_detail::make(m, d, target,
+        typename button_translation_detail::MakeIndexSeq<256>::type(),
+        typename button_translation_detail::MakeIndexSeq<BUTTON_EXT_COUNT>::type(),
+        typename button_translation_detail::MakeIndexSeq<16>::type());
+}
+
+/**
+ * 執行期版本的 makeButtonTranslation，供編輯後的設定檔使用
+ * @param count 映射數量；nsButton 超過 15 的項目 (未指定) 會被略過
+ */
+inline void buildButtonTranslation(ButtonTranslation& t, const ButtonMapping* m, size_t count,
+                                   const DirectionMapping& d, uint8_t target) {
+    for (uint16_t b = 0; b < 256; b++) {
+        uint16_t low = 0;
+        uint16_t high = 0;
+        for (size_t i = 0; i < count; i++) {
+            if (m[i].nsButton > 15) {
+                continue;
+            }
+            uint16_t bit = (uint16_t)(1u << m[i].nsButton);
+            if (m[i].wiimoteButton & b) {
+                low |= bit;
+            }
+            if (m[i].wiimoteButton & ((uint32_t)b << 8)) {
+                high |= bit;
+            }
+        }
+        t.low[b] = low;
+        t.high[b] = high;
+    }
+    for (uint32_t e = 0; e < BUTTON_EXT_COUNT; e++) {
+        uint16_t ext = 0;
+        for (size_t i = 0; i < count; i++) {
+            if (m[i].nsButton <= 15 && (m[i].wiimoteButton & (e << BUTTON_EXT_SHIFT))) {
+                ext |= (uint16_t)(1u << m[i].nsButton);
+            }
+        }
+        t.ext[e] = ext;
+    }
+    for (uint16_t bits = 0; bits < 16; bits++) {
+        t.direction[bits] = button_translation_detail::directionFor(d, target, bits);
+    }
+}
+
+// 供 static_assert 檢查方向鍵映射
+constexpr bool directionMappingValid(const DirectionMapping& d) {
+    return ((d.up | d.down | d.left | d.right) & ~BUTTON_DIRECTION_MASK) == 0;
+}
@@ -0,0 +1,146 @@
+// 檔案: ChordSwitch.h
+// 作用: 按住 HOME + 方向鍵的組合鍵 -> 切換設定檔 / 方向鍵模式，組合鍵本身不送給 Switch
+//
+// 每個封包 (映射之前):
+//   - HOME 按下時先扣住不送，等下一步決定:
+//       放開 (短按)           -> 補送一次 CHORD_TAP_US 長的 HOME
+//       按下方向鍵            -> 觸發動作，HOME 與該方向鍵直到放開為止都不送出 (按住 HOME 可連續觸發)
+//       按下其他按鈕          -> 一般的 HOME 組合，立即送出 HOME
+//       單獨按住 CHORD_HOLD_US -> 長按 HOME (快速設定選單)，立即送出 HOME
+//   - 方向依握法換算 (玩家看到的上下左右)
+// 狀態只有幾個位元遮罩，每個封包固定的運算量。時間由呼叫端傳入 (微秒)，可在電腦上重現。
+
+#pragma once
+#include <stdint.h>
+#include <stddef.h>
+#include "WiimoteData.h"
+#include "ButtonTranslation.h"
+
+#define CHORD_MODIFIER    BUTTON_HOME
+#define CHORD_HOLD_US     400000    // 單獨按住 HOME 超過此時間就當成長按
+#define CHORD_TAP_US      80000     // 短按 HOME 放開後補送的長度 (Switch 需要數個報告才會辨識)
+
+// 組合鍵動作
+enum ChordAction : uint8_t {
+    CHORD_ACTION_NONE = 0,
+    CHORD_ACTION_MODE_DPAD,       // HOME + 上: 方向鍵輸出到 D-Pad
+    CHORD_ACTION_MODE_STICK,      // HOME + 下: 方向鍵輸出到左類比搖桿
+    CHORD_ACTION_PROFILE_PREV,    // HOME + 左: 上一個設定檔
+    CHORD_ACTION_PROFILE_NEXT,    // HOME + 右: 下一個設定檔
+};
+
+class ChordSwitch {
+public:
+    ChordSwitch() { reset(); }
+
+    void reset() {
+        _state = CHORD_IDLE;
+        _last = 0;
+        _suppress = 0;
+        _tapping = false;
+        _armedUs = 0;
+        _tapUs = 0;
+        _action = CHORD_ACTION_NONE;
+    }
+
+    /**
+     * 新的按鈕狀態 (同一個狀態重複呼叫不會重複觸發)
+     * @param d 作用中設定檔的握法，決定哪個 Wiimote 方向鍵是玩家的上下左右
+     * @return 要送去映射的按鈕 (扣掉組合鍵、加上補送的 HOME)
+     */
+    uint32_t filter(uint32_t buttons, const DirectionMapping& d, uint32_t nowUs) {
+        uint32_t pressed = buttons & ~_last;
+        _last = buttons;
+        _suppress &= buttons;   // 放開的按鈕不再扣住
+        const uint16_t directions = d.up | d.down | d.left | d.right;
+
+        if (_state == CHORD_IDLE && (pressed & CHORD_MODIFIER)) {
+            _state = CHORD_ARMED;
+            _armedUs = nowUs;
+            _suppress |= CHORD_MODIFIER;
+            _tapping = false;
+        }
+        if (_state == CHORD_ARMED || _state == CHORD_FIRED) {
+            if (!(buttons & CHORD_MODIFIER)) {
+                if (_state == CHORD_ARMED) {
+                    _tapping = true;
+                    _tapUs = nowUs;
+                }
+                _state = CHORD_IDLE;
+            } else if (pressed & directions) {
+                _action = actionFor(pressed, d);
+                _suppress |= pressed & directions;
+                _state = CHORD_FIRED;
+            } else if (_state == CHORD_ARMED && (pressed & ~CHORD_MODIFIER)) {
+                pass();
+            }
+        } else if (_state == CHORD_PASS && !(buttons & CHORD_MODIFIER)) {
+            _state = CHORD_IDLE;
+        }
+        expire(nowUs);
+        return output();
+    }
+
+    /**
+     * 推進時間 (每個 USB frame 呼叫): 長按逾時與補送的 HOME 結束
+     * @return 輸出是否改變 (呼叫端以相同的按鈕重新映射)
+     */
+    bool tick(uint32_t nowUs) {
+        uint32_t before = output();
+        expire(nowUs);
+        return output() != before;
+    }
+
+    bool active() const { return _state == CHORD_ARMED || _tapping; }
+    uint32_t buttons() const { return _last; }   // 最近一次的原始按鈕
+    bool holding() const { return _state == CHORD_ARMED || _state == CHORD_FIRED; }
+
+    // 取出上一次觸發的動作 (每個動作只回傳一次)
+    uint8_t takeAction() {
+        uint8_t action = _action;
+        _action = CHORD_ACTION_NONE;
+        return action;
+    }
+
+private:
+    enum : uint8_t {
+        CHORD_IDLE,
+        CHORD_ARMED,    // HOME 按住中，還沒決定
+        CHORD_FIRED,    // 已觸發動作，等 HOME 放開
+        CHORD_PASS,     // 一般的 HOME，照常送出
+    };
+
+    void pass() {
+        _state = CHORD_PASS;
+        _suppress &= ~CHORD_MODIFIER;
+    }
+
+    void expire(uint32_t nowUs) {
+        if (_state == CHORD_ARMED && nowUs - _armedUs >= CHORD_HOLD_US) {
+            pass();
+        }
+        if (_tapping && nowUs - _tapUs >= CHORD_TAP_US) {
+            _tapping = false;
+        }
+    }
+
+    uint32_t output() const {
+        uint32_t out = _last & ~_suppress;
+        return _tapping ? (out | CHORD_MODIFIER) : out;
+    }
+
+    static uint8_t actionFor(uint32_t pressed, const DirectionMapping& d) {
+        if (pressed & d.up) return CHORD_ACTION_MODE_DPAD;
+        if (pressed & d.down) return CHORD_ACTION_MODE_STICK;
+        if (pressed & d.left) return CHORD_ACTION_PROFILE_PREV;
+        return CHORD_ACTION_PROFILE_NEXT;
+    }
+
+    uint8_t _state;
+    uint32_t _last;        // 上一次的原始按鈕 (wiimoteButtonSet 格式)
+    uint32_t _suppress;    // 放開前不送出的按鈕
+    bool _tapping;         // 補送短按的 HOME 中
+    uint32_t _armedUs;
+    uint32_t _tapUs;
+    uint8_t _action;
+};
@@ -0,0 +1,62 @@
+// 檔案: ClockSync.h
+// 作用: 估計 S1 與 S3 的時鐘差 (offset = S1 時間 - S3 時間)
+//
+// 每次交換得到一組 (offset, rtt)，保留最近 CLOCK_SYNC_WINDOW 組中 rtt 最小的一組，
+// 因為 rtt 越小，單趟延遲不對稱造成的誤差越小。
+
+#pragma once
+#include <stdint.h>
+#include "WiimoteLink.h"
+
+#define CLOCK_SYNC_WINDOW 8
+
+class ClockSync {
+public:
+    ClockSync() : _count(0), _next(0), _best(-1) {}
+
+    // 建立請求 payload
+    void makeRequest(LinkTimeSyncPayload& req, uint32_t nowUs) const {
+        req.t0 = nowUs;
+        req.t1 = 0;
+        req.t2 = 0;
+    }
+
+    // 收到回覆，t3 為本地收到時間
+    void onResponse(const LinkTimeSyncPayload& resp, uint32_t t3) {
+        int32_t rtt = (int32_t)(t3 - resp.t0) - (int32_t)(resp.t2 - resp.t1);
+        if (rtt < 0) {
+            return;
+        }
+        int32_t offset = ((int32_t)(resp.t1 - resp.t0) + (int32_t)(resp.t2 - t3)) / 2;
+        _samples[_next].offsetUs = offset;
+        _samples[_next].rttUs = (uint32_t)rtt;
+        _next = (_next + 1) % CLOCK_SYNC_WINDOW;
+        if (_count < CLOCK_SYNC_WINDOW) {
+            _count++;
+        }
+
+        _best = 0;
+        for (uint8_t i = 1; i < _count; i++) {
+            if (_samples[i].rttUs < _samples[_best].rttUs) {
+                _best = i;
+            }
+        }
+    }
+
+    bool valid() const { return _best >= 0; }
+    int32_t offsetUs() const { return valid() ? _samples[_best].offsetUs : 0; }
+    uint32_t rttUs() const { return valid() ? _samples[_best].rttUs : 0; }
+
+    // 將 S1 的時間換算成 S3 的時間
+    uint32_t toLocal(uint32_t remoteUs) const { return remoteUs - (uint32_t)offsetUs(); }
+
+private:
+    struct Sample {
+        int32_t offsetUs;
+        uint32_t rttUs;
+    };
+    Sample _samples[CLOCK_SYNC_WINDOW];
+    uint8_t _count;
+    uint8_t _next;
+    int8_t _best;
+};
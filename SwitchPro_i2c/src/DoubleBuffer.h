@@ -0,0 +1,59 @@
+// 檔案: DoubleBuffer.h
+// 作用: 單一寫入者 / 單一讀取者的雙緩衝，以原子指標切換
+//
+// 讀取端 (輸入任務) 每次只做一次指標讀取，不上鎖，也不會看到寫到一半的內容。
+// 寫入端 (網頁伺服器) 寫入非作用中的緩衝區後 publish() 切換指標。
+// 被換下的緩衝區要等讀取端呼叫 readerQuiescent() (表示已不再持有舊指標) 後才能再寫入。
+
+#pragma once
+#include <stdint.h>
+#include <stddef.h>
+#include <atomic>
+
+template <typename T>
+class DoubleBuffer {
+public:
+    // initial 可指向外部的唯讀資料 (例如編譯期產生的預設值)
+    explicit DoubleBuffer(const T* initial)
+        : _active(initial), _retired(NULL), _retiredEpoch(0), _readerEpoch(0), _swaps(0) {}
+
+    // --- 讀取端 ---
+
+    const T* current() const { return _active.load(); }
+
+    // 讀取端已不再使用先前由 current() 取得的指標 (例如處理完一批訊框後)
+    void readerQuiescent() { _readerEpoch.fetch_add(1); }
+
+    // --- 寫入端 ---
+
+    /**
+     * 取得可寫入的緩衝區
+     * @return 讀取端可能仍在使用上次換下的緩衝區時回傳 NULL，稍後再試
+     */
+    T* beginWrite() {
+        T* buf = (_active.load() == &_buffers[0]) ? &_buffers[1] : &_buffers[0];
+        if (buf == _retired && _readerEpoch.load() == _retiredEpoch) {
+            return NULL;
+        }
+        return buf;
+    }
+
+    // 將 beginWrite() 取得並寫好的緩衝區設為作用中
+    void publish(T* buf) {
+        const T* old = _active.exchange(buf);
+        _retired = (old == &_buffers[0] || old == &_buffers[1]) ? const_cast<T*>(old) : NULL;
+        // 交換之後才讀取計數: 之後只要計數改變，讀取端就一定已放下舊指標
+        _retiredEpoch = _readerEpoch.load();
+        _swaps++;
+    }
+
+    uint32_t swaps() const { return _swaps; }
+
+private:
+    T _buffers[2];
+    std::atomic<const T*> _active;
+    T* _retired;
+    uint32_t _retiredEpoch;
+    std::atomic<uint32_t> _readerEpoch;
+    uint32_t _swaps;
+};
@@ -0,0 +1,221 @@
+// 檔案: GestureDetector.h
+// 作用: 加速度串流 -> 搖晃 / 揮動手勢 -> 虛擬按鈕
+//
+// 每個加速度樣本 (Wiimote 或 Nunchuk 各一個偵測器):
+//   1. 以校正值換算成以 g 為單位的定點數 (Q8，1g = 256)，減去低通濾波的重力基準，得到動態加速度
+//   2. 更新視窗特徵，每個樣本都是固定的運算量:
+//      - 能量: 最近 GESTURE_WINDOW 個樣本 |a|^2 的和 (環形緩衝區，加新減舊)
+//      - 峰值: |a|^2 的最大值，每個樣本衰減一部分
+//      - 換邊次數: 任一軸越過 ±GESTURE_CROSS_HYSTERESIS 換邊的樣本數 (位元歷史 + popcount)
+//   3. 搖晃 = 能量高且來回換邊 (按住到停止為止)；
+//      揮動 = 峰值越過門檻且不在搖晃中 (按一下 GESTURE_PULSE_US，之後 GESTURE_REFRACTORY_US 內不再觸發)
+// 全部以整數運算，記憶體固定。時間由呼叫端傳入 (微秒)，可在電腦上重現。
+
+#pragma once
+#include <stdint.h>
+#include <stddef.h>
+#include "WiimoteData.h"
+
+#define GESTURE_G_ONE             256        // Q8
+#define GESTURE_G_LIMIT           (4 * GESTURE_G_ONE)   // 讀數上限，視窗能量不會溢位
+#define GESTURE_WINDOW            32         // 視窗樣本數 (100 Hz 約 320 ms)，不超過 32 (換邊歷史是 32 位元)
+#define GESTURE_WINDOW_MASK       (GESTURE_WINDOW >= 32 ? 0xFFFFFFFFUL : (1UL << (GESTURE_WINDOW & 31)) - 1)
+#define GESTURE_BASELINE_SHIFT    5          // 重力基準的低通 (約 32 個樣本)
+#define GESTURE_CROSS_HYSTERESIS  (GESTURE_G_ONE / 2)   // 動態加速度超過 ±0.5g 才算換邊
+#define GESTURE_SHAKE_CROSSINGS   3          // 視窗內至少換邊這麼多次才算搖晃
+#define GESTURE_SWING_CROSSINGS   2          // 揮動: 視窗內換邊不超過這麼多次 (否則是搖晃的一下)
+#define GESTURE_PEAK_DECAY_SHIFT  3          // 峰值每個樣本衰減 1/8
+#define GESTURE_PULSE_US          100000     // 揮動按鈕按住的時間
+#define GESTURE_REFRACTORY_US     300000     // 揮動後不再觸發的時間
+#define GESTURE_IDLE_US           100000     // 這麼久沒有新樣本就放開搖晃 (S1 只在讀數改變時送出)
+
+#define GESTURE_THRESHOLD_MIN     5          // 門檻設定範圍 (0.1 g)
+#define GESTURE_THRESHOLD_MAX     40
+
+// 虛擬按鈕 (buttons())
+#define GESTURE_SHAKE             0x01
+#define GESTURE_SWING             0x02
+#define GESTURE_COUNT             2
+
+// 設定檔編譯後的門檻
+struct GestureResponse {
+    int32_t shakeEnergy;   // 視窗能量門檻 (Q16 g^2 x GESTURE_WINDOW)
+    int32_t swingPeak;     // 峰值門檻 (Q16 g^2)
+};
+
+/**
+ * 產生手勢門檻
+ * @param shakeTenths 搖晃的動態加速度均方根 (0.1 g)
+ * @param swingTenths 揮動的動態加速度峰值 (0.1 g)
+ */
+inline void gestureResponseBuild(GestureResponse& r, uint8_t shakeTenths, uint8_t swingTenths) {
+    if (shakeTenths < GESTURE_THRESHOLD_MIN) shakeTenths = GESTURE_THRESHOLD_MIN;
+    if (shakeTenths > GESTURE_THRESHOLD_MAX) shakeTenths = GESTURE_THRESHOLD_MAX;
+    if (swingTenths < GESTURE_THRESHOLD_MIN) swingTenths = GESTURE_THRESHOLD_MIN;
+    if (swingTenths > GESTURE_THRESHOLD_MAX) swingTenths = GESTURE_THRESHOLD_MAX;
+    int32_t shake = (int32_t)shakeTenths * GESTURE_G_ONE / 10;
+    int32_t swing = (int32_t)swingTenths * GESTURE_G_ONE / 10;
+    r.shakeEnergy = shake * shake * GESTURE_WINDOW;
+    r.swingPeak = swing * swing;
+}
+
+class GestureDetector {
+public:
+    GestureDetector() {
+        WiimoteAccelCalibration cal;
+        wiimoteAccelCalibrationDefault(cal);
+        setCalibration(cal);
+        reset();
+        _shakeCount = 0;
+        _swingCount = 0;
+    }
+
+    // 換算用的係數在這裡算好，每個樣本只需乘法與位移
+    void setCalibration(const WiimoteAccelCalibration& cal) {
+        for (uint8_t i = 0; i < 3; i++) {
+            int32_t span = (int32_t)cal.gravity[i] - cal.zero[i];
+            if (span <= 0) {
+                span = WIIMOTE_ACCEL_GRAVITY_DEFAULT - WIIMOTE_ACCEL_ZERO_DEFAULT;
+            }
+            _zero[i] = cal.zero[i];
+            _scale[i] = (GESTURE_G_ONE << 16) / span;   // Q16 係數
+        }
+    }
+
+    // 回報關閉、斷線或拔掉 Nunchuk: 放開按鈕，下一個樣本重新估計重力
+    void reset() {
+        _hasSample = false;
+        for (uint8_t i = 0; i < 3; i++) {
+            _baseline[i] = 0;
+            _side[i] = 0;
+        }
+        for (uint8_t i = 0; i < GESTURE_WINDOW; i++) {
+            _energy[i] = 0;
+        }
+        _index = 0;
+        _energySum = 0;
+        _peak = 0;
+        _crossHistory = 0;
+        _armed = true;
+        _buttons = 0;
+        _lastUs = 0;
+        _swingUs = 0;
+        _swingSeen = false;
+    }
+
+    /**
+     * 新的加速度樣本 (狀態封包中的 8 位元讀數)
+     * @return 虛擬按鈕是否改變
+     */
+    bool input(uint8_t ax, uint8_t ay, uint8_t az, const GestureResponse& r, uint32_t nowUs) {
+        const uint8_t raw[3] = { ax, ay, az };
+        uint8_t before = _buttons;
+        int32_t energy = 0;
+        bool crossed = false;
+        for (uint8_t i = 0; i < 3; i++) {
+            int32_t g = (((int32_t)raw[i] * 4 - _zero[i]) * _scale[i]) >> 16;
+            if (g > GESTURE_G_LIMIT) g = GESTURE_G_LIMIT;
+            if (g < -GESTURE_G_LIMIT) g = -GESTURE_G_LIMIT;
+            if (!_hasSample) {
+                _baseline[i] = g << GESTURE_BASELINE_SHIFT;
+            }
+            _baseline[i] += g - (_baseline[i] >> GESTURE_BASELINE_SHIFT);
+            int32_t d = g - (_baseline[i] >> GESTURE_BASELINE_SHIFT);
+            energy += d * d;
+            // 有遲滯的換邊: 從 +側到 -側 (或反過來) 才算一次
+            if (d > GESTURE_CROSS_HYSTERESIS) {
+                crossed = crossed || _side[i] < 0;
+                _side[i] = 1;
+            } else if (d < -GESTURE_CROSS_HYSTERESIS) {
+                crossed = crossed || _side[i] > 0;
+                _side[i] = -1;
+            }
+        }
+        _hasSample = true;
+        _lastUs = nowUs;
+
+        _energySum += energy - _energy[_index];
+        _energy[_index] = energy;
+        _index = (uint8_t)((_index + 1) % GESTURE_WINDOW);
+        _crossHistory = ((_crossHistory << 1) | (crossed ? 1 : 0)) & GESTURE_WINDOW_MASK;
+        _peak -= _peak >> GESTURE_PEAK_DECAY_SHIFT;
+        if (energy > _peak) {
+            _peak = energy;
+        }
+        uint8_t crossings = crossingCount();
+
+        // 搖晃: 能量與換邊次數都要夠，放開時門檻減半 (遲滯)
+        if (_buttons & GESTURE_SHAKE) {
+            if (_energySum < r.shakeEnergy / 2 || crossings < GESTURE_SHAKE_CROSSINGS - 1) {
+                _buttons &= ~GESTURE_SHAKE;
+            }
+        } else if (_energySum >= r.shakeEnergy && crossings >= GESTURE_SHAKE_CROSSINGS) {
+            _buttons |= GESTURE_SHAKE;
+            _buttons &= ~GESTURE_SWING;
+            _shakeCount++;
+        }
+
+        // 揮動: 峰值衰減到門檻的 1/4 (加速度一半) 以下才能再次觸發
+        if (_peak < r.swingPeak / 4) {
+            _armed = true;
+        }
+        bool refractory = _swingSeen && nowUs - _swingUs < GESTURE_REFRACTORY_US;
+        if (_armed && !refractory && energy >= r.swingPeak && !(_buttons & GESTURE_SHAKE) &&
+            crossings <= GESTURE_SWING_CROSSINGS) {
+            _armed = false;
+            _buttons |= GESTURE_SWING;
+            _swingUs = nowUs;
+            _swingSeen = true;
+            _swingCount++;
+        }
+        expire(nowUs);
+        return _buttons != before;
+    }
+
+    /**
+     * 推進時間 (每個 USB frame 呼叫): 揮動按鈕放開、樣本中斷時放開搖晃
+     * @return 虛擬按鈕是否改變
+     */
+    bool tick(uint32_t nowUs) {
+        uint8_t before = _buttons;
+        expire(nowUs);
+        return _buttons != before;
+    }
+
+    bool active() const { return _buttons != 0; }
+    uint8_t buttons() const { return _buttons; }
+    // 狀態查詢用
+    int32_t meanEnergy() const { return _energySum / GESTURE_WINDOW; }
+    int32_t peak() const { return _peak; }
+    uint8_t crossingCount() const { return (uint8_t)__builtin_popcount(_crossHistory); }
+    uint32_t shakeCount() const { return _shakeCount; }
+    uint32_t swingCount() const { return _swingCount; }
+
+private:
+    void expire(uint32_t nowUs) {
+        if ((_buttons & GESTURE_SWING) && nowUs - _swingUs >= GESTURE_PULSE_US) {
+            _buttons &= ~GESTURE_SWING;
+        }
+        if ((_buttons & GESTURE_SHAKE) && nowUs - _lastUs >= GESTURE_IDLE_US) {
+            _buttons &= ~GESTURE_SHAKE;
+        }
+    }
+
+    bool _hasSample;
+    int32_t _zero[3];          // 10 位元讀數
+    int32_t _scale[3];
+    int32_t _baseline[3];      // 重力基準 (Q8 << GESTURE_BASELINE_SHIFT)
+    int8_t _side[3];           // 上一次越過遲滯的方向
+    int32_t _energy[GESTURE_WINDOW];
+    uint8_t _index;
+    int32_t _energySum;
+    int32_t _peak;
+    uint32_t _crossHistory;    // bit0 = 最新樣本
+    bool _armed;
+    uint8_t _buttons;
+    uint32_t _lastUs;
+    uint32_t _swingUs;
+    bool _swingSeen;
+    uint32_t _shakeCount;
+    uint32_t _swingCount;
+};
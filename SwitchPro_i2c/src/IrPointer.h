@@ -0,0 +1,322 @@
+// 檔案: IrPointer.h
+// 作用: Wiimote 紅外線鏡頭 -> 感應棒中點 -> 類比搖桿 (瞄準)
+//
+// 每組點座標 (LINK_MSG_IR):
+//   1. 換成玩家視角的座標 (往右、往上為正，以鏡頭中心為原點，1/16 像素)
+//   2. 在最多 4 個點中找出感應棒的兩個點: 有上一組時選位置與間距最接近的，沒有時選最水平的一對；
+//      只看到一個點時依上一組的間距推算另一個點
+//   3. 以兩點連線的角度抵消 Wiimote 的翻滾，取中點
+//   4. 平滑: 移動量小時用長時間常數 (壓住手抖)，移動量大時用短時間常數 (瞄準不延遲)
+//   5. 扣掉死區後線性放大到滿刻度範圍
+// 感應棒離開畫面後維持最後位置 IR_POINTER_HOLD_US，之後回到中心。
+// 時間由呼叫端傳入 (微秒)，可在電腦上重現。
+
+#pragma once
+#include <stdint.h>
+#include <stddef.h>
+#include "WiimoteIr.h"
+
+#define IR_POINTER_SUBPIXEL      16          // 座標精度: 1/16 像素
+#define IR_POINTER_HOLD_US       150000      // 感應棒消失後維持最後位置的時間
+#define IR_POINTER_MIN_SEPARATION (16 * IR_POINTER_SUBPIXEL)   // 兩點距離小於此值不視為感應棒
+#define IR_POINTER_TAU_SLOW_US   80000       // 靜止 (手抖) 時的平滑時間常數
+#define IR_POINTER_TAU_FAST_US   4000        // 快速移動時
+#define IR_POINTER_JITTER        (3 * IR_POINTER_SUBPIXEL)     // 小於此移動量視為手抖
+#define IR_POINTER_ALPHA_ONE     4096        // 平滑係數 (Q12)
+#define IR_POINTER_MAX_DT_US     100000
+#define IR_POINTER_SETTLED       (IR_POINTER_SUBPIXEL / 4)
+#define IR_POINTER_Q15_ONE       32767
+
+#define IR_POINTER_RANGE_MIN     10          // 滿刻度範圍 (鏡頭半寬的百分比)
+#define IR_POINTER_RANGE_MAX     100
+#define IR_POINTER_INVERT_X      0x01
+#define IR_POINTER_INVERT_Y      0x02
+
+// 設定檔編譯後的指標映射參數
+struct IrResponse {
+    int8_t signX;        // 1 或 -1
+    int8_t signY;
+    int32_t deadzone;    // 1/16 像素
+    int32_t fullScale;   // 1/16 像素
+};
+
+/**
+ * 產生指標映射參數
+ * @param rangePercent 中點離開畫面中心鏡頭半寬的這個比例時輸出最大值
+ * @param deadzonePercent 小於此比例時輸出中心
+ * @param invert IR_POINTER_INVERT_*
+ */
+inline void irResponseBuild(IrResponse& r, uint8_t rangePercent, uint8_t deadzonePercent, uint8_t invert) {
+    if (rangePercent < IR_POINTER_RANGE_MIN) rangePercent = IR_POINTER_RANGE_MIN;
+    if (rangePercent > IR_POINTER_RANGE_MAX) rangePercent = IR_POINTER_RANGE_MAX;
+    if (deadzonePercent >= rangePercent) deadzonePercent = 0;
+    const int32_t half = WIIMOTE_IR_WIDTH / 2 * IR_POINTER_SUBPIXEL;
+    r.signX = (invert & IR_POINTER_INVERT_X) ? -1 : 1;
+    r.signY = (invert & IR_POINTER_INVERT_Y) ? -1 : 1;
+    r.deadzone = half * deadzonePercent / 100;
+    r.fullScale = half * rangePercent / 100;
+}
+
+class IrPointer {
+public:
+    IrPointer() { reset(); }
+
+    // 鏡頭關閉或斷線: 回到中心，並忘記上一組感應棒
+    void reset() {
+        _hasBar = false;
+        _tracking = false;
+        _settled = true;
+        _holding = false;
+        _x = _y = 128;
+        _pointX = _pointY = 0;
+        _targetX = _targetY = 0;
+        _barLX = _barLY = _barRX = _barRY = 0;
+        _barDX = _barDY = 0;
+        _barLength = 1;
+        _lastUs = 0;
+        _lostUs = 0;
+    }
+
+    /**
+     * 新的一組點座標
+     * @return 輸出是否改變
+     */
+    bool input(const WiimoteIrState& ir, const IrResponse& r, uint32_t nowUs) {
+        int32_t px[WIIMOTE_IR_DOTS];
+        int32_t py[WIIMOTE_IR_DOTS];
+        uint8_t count = 0;
+        for (uint8_t i = 0; i < WIIMOTE_IR_DOTS; i++) {
+            const WiimoteIrDot& d = ir.dots[i];
+            if (d.x == WIIMOTE_IR_NO_DOT) {
+                continue;
+            }
+            // 瞄準右方時點往畫面左側移動、瞄準上方時往下移動
+            px[count] = ((int32_t)WIIMOTE_IR_WIDTH / 2 - d.x) * IR_POINTER_SUBPIXEL;
+            py[count] = ((int32_t)WIIMOTE_IR_HEIGHT / 2 - d.y) * IR_POINTER_SUBPIXEL;
+            count++;
+        }
+
+        if (!findBar(px, py, count)) {
+            if (_tracking && !_holding) {
+                _holding = true;
+                _lostUs = nowUs;
+            }
+            return tick(r, nowUs);
+        }
+
+        // 以感應棒的角度抵消翻滾 (cos = dx / 距離, sin = dy / 距離)
+        int32_t midX = (_barLX + _barRX) / 2;
+        int32_t midY = (_barLY + _barRY) / 2;
+        int64_t rx = (int64_t)midX * _barDX + (int64_t)midY * _barDY;
+        int64_t ry = (int64_t)midY * _barDX - (int64_t)midX * _barDY;
+        _targetX = (int32_t)(rx / _barLength);
+        _targetY = (int32_t)(ry / _barLength);
+
+        _holding = false;
+        if (!_tracking) {
+            _tracking = true;
+            _pointX = _targetX;
+            _pointY = _targetY;
+            _lastUs = nowUs;
+            _settled = true;
+            return update(r);
+        }
+        advance(nowUs);
+        return update(r);
+    }
+
+    /**
+     * 推進時間 (每個 USB frame 呼叫): 平滑收斂與感應棒消失的逾時
+     * @return 輸出是否改變
+     */
+    bool tick(const IrResponse& r, uint32_t nowUs) {
+        if (_holding && nowUs - _lostUs >= IR_POINTER_HOLD_US) {
+            bool hadOutput = _x != 128 || _y != 128;
+            reset();
+            return hadOutput;
+        }
+        if (!_tracking || _settled) {
+            _lastUs = nowUs;
+            return false;
+        }
+        advance(nowUs);
+        return update(r);
+    }
+
+    bool active() const { return _holding || (_tracking && !_settled); }
+    bool tracking() const { return _tracking; }
+    bool holding() const { return _holding; }
+    uint8_t x() const { return _x; }
+    uint8_t y() const { return _y; }
+    // 平滑後的中點 (玩家視角，1/16 像素)
+    int32_t pointX() const { return _pointX; }
+    int32_t pointY() const { return _pointY; }
+
+private:
+    // 從看到的點中找出感應棒的左右兩點，結果放在 _barL* / _barR*
+    bool findBar(const int32_t* px, const int32_t* py, uint8_t count) {
+        int64_t bestCost = -1;
+        uint8_t bestL = 0;
+        uint8_t bestR = 0;
+        for (uint8_t i = 0; i < count; i++) {
+            for (uint8_t j = i + 1; j < count; j++) {
+                uint8_t l = px[i] <= px[j] ? i : j;
+                uint8_t rr = l == i ? j : i;
+                int32_t dx = px[rr] - px[l];
+                int32_t dy = py[rr] - py[l];
+                // 翻滾超過 45 度或距離太近 (反光、同一個燈的兩個亮點) 不列入
+                if (dx < IR_POINTER_MIN_SEPARATION || dx <= absValue(dy)) {
+                    continue;
+                }
+                int64_t cost;
+                if (_hasBar) {
+                    cost = (int64_t)absValue(px[l] - _barLX) + absValue(py[l] - _barLY) +
+                           absValue(px[rr] - _barRX) + absValue(py[rr] - _barRY);
+                } else {
+                    cost = absValue(dy);
+                }
+                if (bestCost < 0 || cost < bestCost) {
+                    bestCost = cost;
+                    bestL = l;
+                    bestR = rr;
+                }
+            }
+        }
+        if (bestCost >= 0) {
+            setBar(px[bestL], py[bestL], px[bestR], py[bestR]);
+            return true;
+        }
+        if (count == 0 || !_hasBar) {
+            return false;
+        }
+        // 只剩一個可用的點: 判斷它是左點或右點，另一點沿用上一組的間距
+        uint8_t best = 0;
+        int32_t bestDist = -1;
+        bool isLeft = true;
+        for (uint8_t i = 0; i < count; i++) {
+            int32_t dl = absValue(px[i] - _barLX) + absValue(py[i] - _barLY);
+            int32_t dr = absValue(px[i] - _barRX) + absValue(py[i] - _barRY);
+            int32_t d = dl < dr ? dl : dr;
+            if (bestDist < 0 || d < bestDist) {
+                bestDist = d;
+                best = i;
+                isLeft = dl < dr;
+            }
+        }
+        int32_t dx = _barRX - _barLX;
+        int32_t dy = _barRY - _barLY;
+        if (isLeft) {
+            setBar(px[best], py[best], px[best] + dx, py[best] + dy);
+        } else {
+            setBar(px[best] - dx, py[best] - dy, px[best], py[best]);
+        }
+        return true;
+    }
+
+    void setBar(int32_t lx, int32_t ly, int32_t rx, int32_t ry) {
+        _barLX = lx;
+        _barLY = ly;
+        _barRX = rx;
+        _barRY = ry;
+        _barDX = rx - lx;
+        _barDY = ry - ly;
+        _barLength = (int32_t)isqrt((uint32_t)((int64_t)_barDX * _barDX + (int64_t)_barDY * _barDY));
+        if (_barLength <= 0) {
+            _barLength = 1;
+        }
+        _hasBar = true;
+    }
+
+    void advance(uint32_t nowUs) {
+        uint32_t dt = nowUs - _lastUs;
+        _lastUs = nowUs;
+        if (dt > IR_POINTER_MAX_DT_US) {
+            dt = IR_POINTER_MAX_DT_US;
+        }
+        int32_t diffX = _targetX - _pointX;
+        int32_t diffY = _targetY - _pointY;
+        int32_t move = absValue(diffX) + absValue(diffY);
+        // 時間常數與移動量成反比: 手抖時接近 TAU_SLOW，大幅移動時接近 TAU_FAST
+        uint32_t tau = move <= IR_POINTER_JITTER
+            ? IR_POINTER_TAU_SLOW_US
+            : (uint32_t)((uint64_t)IR_POINTER_TAU_SLOW_US * IR_POINTER_JITTER / move);
+        if (tau < IR_POINTER_TAU_FAST_US) {
+            tau = IR_POINTER_TAU_FAST_US;
+        }
+        int32_t alpha = (int32_t)(((uint64_t)dt * IR_POINTER_ALPHA_ONE + (tau + dt) / 2) / (tau + dt));
+        _pointX += step(diffX, alpha);
+        _pointY += step(diffY, alpha);
+        _settled = absValue(_targetX - _pointX) <= IR_POINTER_SETTLED &&
+                   absValue(_targetY - _pointY) <= IR_POINTER_SETTLED;
+    }
+
+    // 每次至少移動 1/16 像素，否則剩下的小差距在捨入後永遠追不上
+    static int32_t step(int32_t diff, int32_t alpha) {
+        int32_t s = (int32_t)(((int64_t)diff * alpha + (diff >= 0 ? IR_POINTER_ALPHA_ONE / 2 : -IR_POINTER_ALPHA_ONE / 2)) /
+                              IR_POINTER_ALPHA_ONE);
+        if (s == 0 && diff != 0) {
+            s = diff > 0 ? 1 : -1;
+        }
+        return s;
+    }
+
+    // 中點位移 -> Q15 搖桿幅度
+    static int32_t shape(int32_t v, const IrResponse& r) {
+        int32_t mag = absValue(v);
+        if (mag <= r.deadzone) {
+            return 0;
+        }
+        int32_t out = mag >= r.fullScale
+            ? IR_POINTER_Q15_ONE
+            : (int32_t)((int64_t)(mag - r.deadzone) * IR_POINTER_Q15_ONE / (r.fullScale - r.deadzone));
+        return v < 0 ? -out : out;
+    }
+
+    // Q15 (-1 ~ 1) -> 0~255
+    static uint8_t axis(int32_t v) {
+        if (v >= 0) {
+            return (uint8_t)(128 + ((v * 127 + 16384) >> 15));
+        }
+        return (uint8_t)(128 - ((-v * 128 + 16384) >> 15));
+    }
+
+    bool update(const IrResponse& r) {
+        uint8_t x = axis(shape(r.signX * _pointX, r));
+        uint8_t y = axis(-shape(r.signY * _pointY, r));   // 往上為正，NS 往上為 0
+        bool changed = x != _x || y != _y;
+        _x = x;
+        _y = y;
+        return changed;
+    }
+
+    static int32_t absValue(int32_t v) { return v < 0 ? -v : v; }
+
+    static uint32_t isqrt(uint32_t v) {
+        uint32_t res = 0;
+        uint32_t bit = 1UL << 30;
+        while (bit > v) bit >>= 2;
+        while (bit) {
+            if (v >= res + bit) {
+                v -= res + bit;
+                res = (res >> 1) + bit;
+            } else {
+                res >>= 1;
+            }
+            bit >>= 2;
+        }
+        return res;
+    }
+
+    bool _hasBar;        // 已知上一組感應棒 (用來追蹤與補點)
+    bool _tracking;
+    bool _settled;
+    bool _holding;       // 感應棒消失，維持最後位置中
+    int32_t _barLX, _barLY, _barRX, _barRY;
+    int32_t _barDX, _barDY, _barLength;
+    int32_t _targetX, _targetY;   // 翻滾補償後的中點
+    int32_t _pointX, _pointY;     // 平滑後的中點
+    uint32_t _lastUs;
+    uint32_t _lostUs;
+    uint8_t _x;
+    uint8_t _y;
+};
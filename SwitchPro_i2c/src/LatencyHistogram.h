@@ -0,0 +1,81 @@
+// 檔案: LatencyHistogram.h
+// 作用: 固定記憶體的延遲直方圖 (最小/平均/百分位/最大)
+//
+// 桶子以 1/4 個 2 的冪次為寬度 (類似 HDR histogram)，相對誤差約 19%，
+// 96 個桶子涵蓋 0 ~ 33 秒 (更大的值都在最後一個桶子)，每次記錄只需幾個整數運算。
+
+#pragma once
+#include <stdint.h>
+#include <string.h>
+
+#define LATENCY_BUCKETS 96
+
+class LatencyHistogram {
+public:
+    LatencyHistogram() { reset(); }
+
+    void reset() {
+        memset(_buckets, 0, sizeof(_buckets));
+        _count = 0;
+        _sum = 0;
+        _min = UINT32_MAX;
+        _max = 0;
+    }
+
+    void record(uint32_t us) {
+        _buckets[bucketOf(us)]++;
+        _count++;
+        _sum += us;
+        if (us < _min) _min = us;
+        if (us > _max) _max = us;
+    }
+
+    uint32_t count() const { return _count; }
+    uint32_t min() const { return _count ? _min : 0; }
+    uint32_t max() const { return _max; }
+    uint32_t mean() const { return _count ? (uint32_t)(_sum / _count) : 0; }
+
+    // permille: 990 = p99；回傳該桶子的上界，且不超過實際最大值
+    uint32_t percentile(uint16_t permille) const {
+        if (_count == 0) {
+            return 0;
+        }
+        uint32_t target = (uint32_t)(((uint64_t)_count * permille + 999) / 1000);
+        uint32_t seen = 0;
+        for (uint8_t b = 0; b < LATENCY_BUCKETS; b++) {
+            seen += _buckets[b];
+            if (seen >= target) {
+                if (b == LATENCY_BUCKETS - 1) {
+                    return _max;   // 最後一個桶子收容所有更大的值，沒有上界
+                }
+                uint32_t upper = bucketLowerBound(b + 1) - 1;
+                return upper < _max ? upper : _max;
+            }
+        }
+        return _max;
+    }
+
+private:
+    static uint8_t bucketOf(uint32_t us) {
+        if (us < 4) {
+            return (uint8_t)us;
+        }
+        uint8_t msb = 31 - __builtin_clz(us);
+        uint32_t b = (uint32_t)(msb - 1) * 4 + ((us >> (msb - 2)) & 3);
+        return b < LATENCY_BUCKETS ? (uint8_t)b : LATENCY_BUCKETS - 1;
+    }
+
+    static uint32_t bucketLowerBound(uint8_t b) {
+        if (b < 4) {
+            return b;
+        }
+        uint8_t msb = b / 4 + 1;
+        return (uint32_t)(4 + (b % 4)) << (msb - 2);
+    }
+
+    uint32_t _buckets[LATENCY_BUCKETS];
+    uint32_t _count;
+    uint64_t _sum;
+    uint32_t _min;
+    uint32_t _max;
+};
@@ -0,0 +1,201 @@
+// 檔案: MacroEngine.h
+// 作用: 連發 (turbo) 與巨集，位於按鈕映射與 USB 報告之間
+//
+// 映射後的報告 (GamepadFrame) 交給 input()，再由 1ms 計時器呼叫 tick() 推進時間；
+// 輸出有變化時回傳 true，由呼叫端立即送出 USB 報告。
+// 所有時間都由呼叫端傳入 (微秒)，不讀取系統時鐘，在電腦上可用任意時間序列重現。
+
+#pragma once
+#include <stdint.h>
+#include <stddef.h>
+#include <string.h>
+
+#define MACRO_MAX          4
+#define MACRO_NONE         0xFF
+#define MACRO_TICK_US      1000    // 呼叫 tick() 的週期
+#define TURBO_MAX_HZ       30      // 半週期至少 16ms，Switch 才能穩定看到每次按放
+#define TURBO_BUTTON_COUNT 16
+
+// 一個 USB 報告的內容 (與 NSGamepad 的欄位相同)
+struct GamepadFrame {
+    uint16_t buttons;
+    uint8_t hat;
+    uint8_t leftX;
+    uint8_t leftY;
+    uint8_t rightX;
+    uint8_t rightY;
+};
+
+inline bool gamepadFrameEqual(const GamepadFrame& a, const GamepadFrame& b) {
+    return a.buttons == b.buttons && a.hat == b.hat && a.leftX == b.leftX && a.leftY == b.leftY &&
+           a.rightX == b.rightX && a.rightY == b.rightY;
+}
+
+// 巨集的一個步驟: 在 durationMs 內輸出指定的按鈕與十字鍵 (搖桿沿用玩家的輸入)
+struct MacroStep {
+    uint16_t buttons;      // NS 按鈕字組
+    uint8_t hat;
+    uint16_t durationMs;
+};
+
+struct MacroDef {
+    uint32_t chord;        // 觸發組合 (wiimoteButtonSet 格式，全部按下的瞬間觸發)
+    const MacroStep* steps;
+    uint8_t stepCount;
+};
+
+struct MacroStats {
+    uint32_t frames;       // 因連發或巨集而改變的報告數
+    uint32_t lateFrames;   // 比預定時間晚超過一個 tick
+    uint32_t maxLateUs;
+    uint32_t macrosRun;
+};
+
+class MacroEngine {
+public:
+    MacroEngine()
+        : _macros(NULL), _macroCount(0), _wiimoteButtons(0), _running(MACRO_NONE), _step(0),
+          _stepStartUs(0), _dueUs(0), _hasDue(false), _stats() {
+        memset(&_mapped, 0, sizeof(_mapped));
+        memset(&_output, 0, sizeof(_output));
+        memset(_turboHalfUs, 0, sizeof(_turboHalfUs));
+        memset(_heldSinceUs, 0, sizeof(_heldSinceUs));
+    }
+
+    // 巨集表需在整個執行期間有效 (通常是常數表)
+    void setMacros(const MacroDef* macros, uint8_t count) {
+        _macros = macros;
+        _macroCount = count > MACRO_MAX ? MACRO_MAX : count;
+    }
+
+    /**
+     * 新的輸入 (每個封包一次)
+     * @param wiimoteButtons 原始 Wiimote 按鈕，用來比對巨集組合
+     * @param mapped 映射後的報告
+     * @param turboHalfUs 每個 NS 按鈕的連發半週期 (0: 不連發)，內容會被複製
+     * @return 輸出是否改變
+     */
+    bool input(uint32_t wiimoteButtons, const GamepadFrame& mapped, const uint32_t* turboHalfUs, uint32_t nowUs) {
+        uint16_t pressed = mapped.buttons & ~_mapped.buttons;
+        for (uint8_t b = 0; b < TURBO_BUTTON_COUNT; b++) {
+            if (pressed & (1u << b)) {
+                _heldSinceUs[b] = nowUs;   // 連發從按下的瞬間開始，第一個半週期是按下
+            }
+        }
+        memcpy(_turboHalfUs, turboHalfUs, sizeof(_turboHalfUs));
+
+        if (_running == MACRO_NONE) {
+            for (uint8_t i = 0; i < _macroCount; i++) {
+                uint32_t chord = _macros[i].chord;
+                if (chord && (wiimoteButtons & chord) == chord && (_wiimoteButtons & chord) != chord &&
+                    _macros[i].stepCount > 0) {
+                    _running = i;
+                    _step = 0;
+                    _stepStartUs = nowUs;
+                    _stats.macrosRun++;
+                    break;
+                }
+            }
+        }
+        _wiimoteButtons = wiimoteButtons;
+        _mapped = mapped;
+        return update(nowUs, false);
+    }
+
+    /**
+     * 推進時間 (每 MACRO_TICK_US 呼叫一次)
+     * @return 輸出是否改變 (需要送出 USB 報告)
+     */
+    bool tick(uint32_t nowUs) {
+        if (!_hasDue || (int32_t)(nowUs - _dueUs) < 0) {
+            return false;
+        }
+        return update(nowUs, true);
+    }
+
+    // 是否有連發或巨集正在進行 (需要 tick)
+    bool active() const { return _hasDue; }
+    bool macroRunning() const { return _running != MACRO_NONE; }
+    const GamepadFrame& output() const { return _output; }
+    const MacroStats& stats() const { return _stats; }
+
+private:
+    /**
+     * 依目前時間計算輸出，並找出下一次輸出會改變的時間
+     * @param scheduled true: 由 tick() 在預定時間到達後呼叫，需統計延遲
+     */
+    bool update(uint32_t nowUs, bool scheduled) {
+        uint32_t dueUs = _dueUs;
+        GamepadFrame out = _mapped;
+        _hasDue = false;
+
+        if (_running != MACRO_NONE) {
+            const MacroDef& m = _macros[_running];
+            // 以上一步的預定結束時間當作下一步的開始，步驟長度不會因 tick 延遲而累積誤差
+            while (_step < m.stepCount && nowUs - _stepStartUs >= (uint32_t)m.steps[_step].durationMs * 1000) {
+                _stepStartUs += (uint32_t)m.steps[_step].durationMs * 1000;
+                _step++;
+            }
+            if (_step < m.stepCount) {
+                out.buttons = m.steps[_step].buttons;
+                out.hat = m.steps[_step].hat;
+                setDue(_stepStartUs + (uint32_t)m.steps[_step].durationMs * 1000, nowUs);
+            } else {
+                _running = MACRO_NONE;
+            }
+        }
+
+        if (_running == MACRO_NONE) {
+            uint16_t turbo = out.buttons;
+            for (uint8_t b = 0; turbo && b < TURBO_BUTTON_COUNT; b++) {
+                uint16_t bit = (uint16_t)(1u << b);
+                if (!(turbo & bit) || _turboHalfUs[b] == 0) {
+                    continue;
+                }
+                uint32_t half = _turboHalfUs[b];
+                uint32_t elapsed = nowUs - _heldSinceUs[b];
+                uint32_t phase = elapsed / half;
+                if (phase & 1) {
+                    out.buttons &= (uint16_t)~bit;
+                }
+                setDue(_heldSinceUs[b] + (phase + 1) * half, nowUs);
+            }
+        }
+
+        bool changed = !gamepadFrameEqual(out, _output);
+        _output = out;
+        if (changed && scheduled) {
+            uint32_t lateUs = nowUs - dueUs;
+            _stats.frames++;
+            if (lateUs >= MACRO_TICK_US) {
+                _stats.lateFrames++;
+            }
+            if (lateUs > _stats.maxLateUs) {
+                _stats.maxLateUs = lateUs;
+            }
+        }
+        return changed;
+    }
+
+    // 記錄最早的下一次變化時間
+    void setDue(uint32_t dueUs, uint32_t nowUs) {
+        if (!_hasDue || dueUs - nowUs < _dueUs - nowUs) {
+            _dueUs = dueUs;
+            _hasDue = true;
+        }
+    }
+
+    const MacroDef* _macros;
+    uint8_t _macroCount;
+    uint32_t _wiimoteButtons;
+    GamepadFrame _mapped;
+    GamepadFrame _output;
+    uint32_t _turboHalfUs[TURBO_BUTTON_COUNT];
+    uint32_t _heldSinceUs[TURBO_BUTTON_COUNT];
+    uint8_t _running;
+    uint8_t _step;
+    uint32_t _stepStartUs;
+    uint32_t _dueUs;
+    bool _hasDue;
+    MacroStats _stats;
+};
@@ -0,0 +1,382 @@
+// 檔案: MappingProfile.h
+// 作用: 可在網頁上編輯的按鈕映射設定檔，以及編譯成查表的 CompiledProfile
+//
+// MappingProfile 是可編輯、可存入 NVS 的格式 (每個 Wiimote 按鈕對應一個 NS 按鈕)；
+// 編輯完成後以 mappingProfileCompile() 轉成 ButtonTranslation 查表，輸入路徑只讀取查表。
+
+#pragma once
+#include <stdint.h>
+#include <stddef.h>
+#include <string.h>
+#include "WiimoteData.h"
+#include "ButtonTranslation.h"
+#include "MacroEngine.h"
+#include "StickRamp.h"
+#include "MotionTilt.h"
+#include "IrPointer.h"
+#include "GestureDetector.h"
+#include "SocdResolver.h"
+
+#define MAPPING_PROFILE_MAX       4
+#define MAPPING_PROFILE_NAME_LEN  16    // 含結尾 '\0'
+#define MAPPING_NS_NONE           0xFF  // 不輸出
+#define MAPPING_SLOT_NONE         0xFF  // 沒有修飾鍵 / 慢走鍵
+#define MAPPING_RAMP_MAX_MS       2000
+#define MAPPING_MOTION_RANGE_DEFAULT     45   // 傾斜 45 度輸出最大值
+#define MAPPING_MOTION_DEADZONE_DEFAULT  5
+#define MAPPING_IR_RANGE_DEFAULT         40   // 中點離開中心鏡頭半寬的 40% 輸出最大值
+#define MAPPING_IR_DEADZONE_DEFAULT      2
+#define MAPPING_SHAKE_DEFAULT            12   // 搖晃: 動態加速度均方根 1.2g
+#define MAPPING_SWING_DEFAULT            20   // 揮動: 動態加速度峰值 2.0g
+
+// Nunchuk 搖桿 / 體感傾斜輸出到哪裡
+#define MAPPING_STICK_NONE   0
+#define MAPPING_STICK_LEFT   1
+#define MAPPING_STICK_RIGHT  2
+#define MAPPING_STICK_COUNT  3
+
+// 握法 (決定方向鍵的旋轉)
+#define MAPPING_HOLD_SIDEWAYS  0   // 橫握，方向旋轉 90 度
+#define MAPPING_HOLD_UPRIGHT   1   // 直握 (搭配 Nunchuk)
+#define MAPPING_HOLD_COUNT     2
+
+// 可映射的 Wiimote 按鈕 (方向鍵另由 DirectionMapping 處理)
+struct MappingSlot {
+    uint32_t button;    // wiimoteButtonSet 格式
+    const char* key;    // 網頁表單參數名稱
+    const char* label;
+};
+
+#define MAPPING_SLOT_COUNT 9
+static const MappingSlot MAPPING_SLOTS[MAPPING_SLOT_COUNT] = {
+    { BUTTON_A,     "a",     "A" },
+    { BUTTON_B,     "b",     "B" },
+    { BUTTON_ONE,   "one",   "1" },
+    { BUTTON_TWO,   "two",   "2" },
+    { BUTTON_PLUS,  "plus",  "+" },
+    { BUTTON_MINUS, "minus", "-" },
+    { BUTTON_HOME,  "home",  "Home" },
+    { BUTTON_C,     "c",     "C (Nunchuk)" },
+    { BUTTON_Z,     "z",     "Z (Nunchuk)" },
+};
+
+// 體感手勢的虛擬按鈕 (Wiimote 與 Nunchuk 各一個 GestureDetector)
+#define MAPPING_GESTURE_WIIMOTE  0
+#define MAPPING_GESTURE_NUNCHUK  1
+
+struct MappingGesture {
+    uint8_t source;     // MAPPING_GESTURE_WIIMOTE / MAPPING_GESTURE_NUNCHUK
+    uint8_t gesture;    // GESTURE_SHAKE / GESTURE_SWING
+    const char* key;    // 網頁表單參數名稱
+    const char* label;
+};
+
+#define MAPPING_GESTURE_COUNT 4
+static const MappingGesture MAPPING_GESTURES[MAPPING_GESTURE_COUNT] = {
+    { MAPPING_GESTURE_WIIMOTE, GESTURE_SHAKE, "wiiShake", "搖晃 Wiimote" },
+    { MAPPING_GESTURE_WIIMOTE, GESTURE_SWING, "wiiSwing", "揮動 Wiimote" },
+    { MAPPING_GESTURE_NUNCHUK, GESTURE_SHAKE, "nunShake", "搖晃 Nunchuk" },
+    { MAPPING_GESTURE_NUNCHUK, GESTURE_SWING, "nunSwing", "揮動 Nunchuk" },
+};
+
+// NS 按鈕名稱，索引與 NSButton_* 相同
+#define MAPPING_NS_BUTTON_COUNT 14
+static const char* const MAPPING_NS_BUTTON_NAMES[MAPPING_NS_BUTTON_COUNT] = {
+    "Y", "B", "A", "X", "L", "R", "ZL", "ZR", "-", "+", "L3", "R3", "Home", "Capture"
+};
+
+constexpr DirectionMapping MAPPING_HOLD_DIRECTIONS[MAPPING_HOLD_COUNT] = {
+    { BUTTON_RIGHT, BUTTON_LEFT, BUTTON_UP, BUTTON_DOWN },   // 橫握
+    { BUTTON_UP, BUTTON_DOWN, BUTTON_LEFT, BUTTON_RIGHT },   // 直握
+};
+
+struct MappingProfile {
+    char name[MAPPING_PROFILE_NAME_LEN];
+    uint8_t buttons[MAPPING_SLOT_COUNT];       // 每個 slot 對應的 NS 按鈕 (MAPPING_NS_NONE: 不輸出)
+    uint8_t shiftButtons[MAPPING_SLOT_COUNT];  // 按住修飾鍵時使用
+    uint8_t modifierSlot;                      // 修飾鍵 (本身不輸出)，MAPPING_SLOT_NONE: 無
+    uint8_t hold;                              // MAPPING_HOLD_*
+    uint8_t dPadTarget;                        // DIRECTION_TARGET_*
+    uint8_t socdMode;                          // SOCD_MODE_*: 相反方向同時按下時的輸出
+    uint8_t stickTarget;                       // MAPPING_STICK_*
+    uint8_t turboHz[MAPPING_SLOT_COUNT];       // 連發頻率 (0: 關閉，最高 TURBO_MAX_HZ)
+    // 方向鍵輸出到搖桿時的反應
+    uint16_t rampUpMs;                         // 0: 立即推到底
+    uint16_t rampDownMs;                       // 0: 立即回中心
+    uint8_t rampCurve;                         // STICK_CURVE_*
+    uint8_t walkSlot;                          // 慢走鍵 (本身不輸出)，MAPPING_SLOT_NONE: 無
+    uint8_t walkPercent;                       // 慢走時的幅度 (1~100)
+    // 體感: Wiimote 傾斜輸出到搖桿 (需要加速度計回報)
+    uint8_t motionTarget;                      // MAPPING_STICK_*
+    uint8_t motionRangeDeg;                    // 傾斜到此角度輸出最大值
+    uint8_t motionDeadzoneDeg;
+    uint8_t motionInvert;                      // MOTION_INVERT_*
+    // 紅外線指標: 感應棒中點輸出到搖桿 (需要紅外線鏡頭回報)
+    uint8_t irTarget;                          // MAPPING_STICK_*
+    uint8_t irSensitivity;                     // 鏡頭靈敏度 1~5
+    uint8_t irRangePercent;                    // 中點離開中心此比例時輸出最大值
+    uint8_t irDeadzonePercent;
+    uint8_t irInvert;                          // IR_POINTER_INVERT_*
+    // 體感手勢: 每個手勢對應的 NS 按鈕 (Wiimote 的手勢需要加速度計回報)
+    uint8_t gestureButtons[MAPPING_GESTURE_COUNT];   // MAPPING_NS_NONE: 不輸出
+    uint8_t shakeTenths;                       // 搖晃門檻 (0.1 g)
+    uint8_t swingTenths;                       // 揮動門檻 (0.1 g)
+};
+
+// 輸入路徑使用的查表形式
+struct CompiledProfile {
+    ButtonTranslation layers[2];   // [0] 一般, [1] 按住修飾鍵
+    uint32_t modifier;             // 修飾鍵的 Wiimote 位元 (wiimoteButtonSet 格式)，0 表示沒有
+    uint8_t stickTarget;
+    uint32_t turboHalfUs[TURBO_BUTTON_COUNT];  // 每個 NS 按鈕的連發半週期 (0: 不連發)
+    uint8_t dPadTarget;
+    uint8_t socdMode;
+    StickResponse stickResponse;               // 方向鍵輸出到搖桿時使用
+    uint8_t motionTarget;                      // MAPPING_STICK_*
+    MotionResponse motion;
+    uint8_t irTarget;                          // MAPPING_STICK_*
+    uint8_t irSensitivity;
+    IrResponse ir;
+    uint16_t gestureMasks[MAPPING_GESTURE_COUNT];   // 手勢按下時加上的 NS 按鈕位元 (0: 不輸出)
+    bool wiimoteGestures;                      // 有 Wiimote 手勢需要加速度計
+    GestureResponse gesture;
+    DirectionMapping directions;               // 握法對應的方向鍵 (組合鍵判斷玩家的上下左右)
+};
+
+// 依目前按鈕選擇查表層
+inline const ButtonTranslation& compiledProfileLayer(const CompiledProfile& p, uint32_t buttons) {
+    return p.layers[(buttons & p.modifier) != 0];
+}
+
+// 複製名稱，過長時在 UTF-8 字元邊界截斷
+inline void mappingProfileSetName(MappingProfile& p, const char* name) {
+    size_t len = strlen(name);
+    if (len > MAPPING_PROFILE_NAME_LEN - 1) {
+        len = MAPPING_PROFILE_NAME_LEN - 1;
+        while (len > 0 && ((uint8_t)name[len] & 0xC0) == 0x80) {
+            len--;
+        }
+    }
+    memset(p.name, 0, sizeof(p.name));
+    memcpy(p.name, name, len);
+}
+
+inline int mappingSlotForButton(uint32_t button) {
+    for (uint8_t i = 0; i < MAPPING_SLOT_COUNT; i++) {
+        if (MAPPING_SLOTS[i].button == button) {
+            return i;
+        }
+    }
+    return -1;
+}
+
+/**
+ * 由 ButtonMapping 表建立設定檔 (兩層相同、沒有修飾鍵)
+ */
+inline void mappingProfileFromTable(MappingProfile& p, const char* name, const ButtonMapping* m, size_t count,
+                                    uint8_t hold, uint8_t dPadTarget, uint8_t stickTarget) {
+    memset(&p, 0, sizeof(p));
+    mappingProfileSetName(p, name);
+    memset(p.buttons, MAPPING_NS_NONE, sizeof(p.buttons));
+    for (size_t i = 0; i < count; i++) {
+        int slot = mappingSlotForButton(m[i].wiimoteButton);
+        if (slot >= 0) {
+            p.buttons[slot] = m[i].nsButton;
+        }
+    }
+    memcpy(p.shiftButtons, p.buttons, sizeof(p.buttons));
+    p.modifierSlot = MAPPING_SLOT_NONE;
+    p.walkSlot = MAPPING_SLOT_NONE;
+    p.walkPercent = 50;
+    p.rampCurve = STICK_CURVE_LINEAR;
+    p.motionTarget = MAPPING_STICK_NONE;
+    p.motionRangeDeg = MAPPING_MOTION_RANGE_DEFAULT;
+    p.motionDeadzoneDeg = MAPPING_MOTION_DEADZONE_DEFAULT;
+    p.irTarget = MAPPING_STICK_NONE;
+    p.irSensitivity = WIIMOTE_IR_SENSITIVITY_DEFAULT;
+    p.irRangePercent = MAPPING_IR_RANGE_DEFAULT;
+    p.irDeadzonePercent = MAPPING_IR_DEADZONE_DEFAULT;
+    memset(p.gestureButtons, MAPPING_NS_NONE, sizeof(p.gestureButtons));
+    p.shakeTenths = MAPPING_SHAKE_DEFAULT;
+    p.swingTenths = MAPPING_SWING_DEFAULT;
+    p.hold = hold;
+    p.dPadTarget = dPadTarget;
+    p.socdMode = SOCD_MODE_NEUTRAL;
+    p.stickTarget = stickTarget;
+}
+
+/**
+ * 修正超出範圍的欄位 (從 NVS 或網頁讀入後呼叫)
+ * @return 是否有欄位被修正
+ */
+inline bool mappingProfileSanitize(MappingProfile& p) {
+    bool fixed = false;
+    p.name[MAPPING_PROFILE_NAME_LEN - 1] = '\0';
+    for (char* c = p.name; *c; c++) {
+        // 名稱會直接放進 HTML / JSON
+        if ((uint8_t)*c < 0x20 || *c == '"' || *c == '\\' || *c == '<' || *c == '>' || *c == '&') {
+            *c = '_';
+            fixed = true;
+        }
+    }
+    for (uint8_t i = 0; i < MAPPING_SLOT_COUNT; i++) {
+        if (p.buttons[i] >= MAPPING_NS_BUTTON_COUNT && p.buttons[i] != MAPPING_NS_NONE) {
+            p.buttons[i] = MAPPING_NS_NONE;
+            fixed = true;
+        }
+        if (p.shiftButtons[i] >= MAPPING_NS_BUTTON_COUNT && p.shiftButtons[i] != MAPPING_NS_NONE) {
+            p.shiftButtons[i] = MAPPING_NS_NONE;
+            fixed = true;
+        }
+    }
+    if (p.modifierSlot >= MAPPING_SLOT_COUNT && p.modifierSlot != MAPPING_SLOT_NONE) {
+        p.modifierSlot = MAPPING_SLOT_NONE;
+        fixed = true;
+    }
+    if (p.hold >= MAPPING_HOLD_COUNT) {
+        p.hold = MAPPING_HOLD_SIDEWAYS;
+        fixed = true;
+    }
+    if (p.dPadTarget >= DIRECTION_TARGET_COUNT) {
+        p.dPadTarget = DIRECTION_TARGET_DPAD;
+        fixed = true;
+    }
+    if (p.socdMode >= SOCD_MODE_COUNT) {
+        p.socdMode = SOCD_MODE_NEUTRAL;
+        fixed = true;
+    }
+    if (p.stickTarget >= MAPPING_STICK_COUNT) {
+        p.stickTarget = MAPPING_STICK_NONE;
+        fixed = true;
+    }
+    if (p.rampUpMs > MAPPING_RAMP_MAX_MS) {
+        p.rampUpMs = MAPPING_RAMP_MAX_MS;
+        fixed = true;
+    }
+    if (p.rampDownMs > MAPPING_RAMP_MAX_MS) {
+        p.rampDownMs = MAPPING_RAMP_MAX_MS;
+        fixed = true;
+    }
+    if (p.rampCurve >= STICK_CURVE_COUNT) {
+        p.rampCurve = STICK_CURVE_LINEAR;
+        fixed = true;
+    }
+    if (p.walkSlot >= MAPPING_SLOT_COUNT && p.walkSlot != MAPPING_SLOT_NONE) {
+        p.walkSlot = MAPPING_SLOT_NONE;
+        fixed = true;
+    }
+    if (p.walkPercent == 0 || p.walkPercent > 100) {
+        p.walkPercent = 50;
+        fixed = true;
+    }
+    if (p.motionTarget >= MAPPING_STICK_COUNT) {
+        p.motionTarget = MAPPING_STICK_NONE;
+        fixed = true;
+    }
+    if (p.motionRangeDeg < MOTION_RANGE_MIN_DEG || p.motionRangeDeg > MOTION_RANGE_MAX_DEG) {
+        p.motionRangeDeg = MAPPING_MOTION_RANGE_DEFAULT;
+        fixed = true;
+    }
+    if (p.motionDeadzoneDeg >= p.motionRangeDeg) {
+        p.motionDeadzoneDeg = 0;
+        fixed = true;
+    }
+    if (p.motionInvert & ~(MOTION_INVERT_X | MOTION_INVERT_Y)) {
+        p.motionInvert &= MOTION_INVERT_X | MOTION_INVERT_Y;
+        fixed = true;
+    }
+    if (p.irTarget >= MAPPING_STICK_COUNT) {
+        p.irTarget = MAPPING_STICK_NONE;
+        fixed = true;
+    }
+    if (p.irSensitivity < WIIMOTE_IR_SENSITIVITY_MIN || p.irSensitivity > WIIMOTE_IR_SENSITIVITY_MAX) {
+        p.irSensitivity = WIIMOTE_IR_SENSITIVITY_DEFAULT;
+        fixed = true;
+    }
+    if (p.irRangePercent < IR_POINTER_RANGE_MIN || p.irRangePercent > IR_POINTER_RANGE_MAX) {
+        p.irRangePercent = MAPPING_IR_RANGE_DEFAULT;
+        fixed = true;
+    }
+    if (p.irDeadzonePercent >= p.irRangePercent) {
+        p.irDeadzonePercent = 0;
+        fixed = true;
+    }
+    if (p.irInvert & ~(IR_POINTER_INVERT_X | IR_POINTER_INVERT_Y)) {
+        p.irInvert &= IR_POINTER_INVERT_X | IR_POINTER_INVERT_Y;
+        fixed = true;
+    }
+    for (uint8_t i = 0; i < MAPPING_GESTURE_COUNT; i++) {
+        if (p.gestureButtons[i] >= MAPPING_NS_BUTTON_COUNT && p.gestureButtons[i] != MAPPING_NS_NONE) {
+            p.gestureButtons[i] = MAPPING_NS_NONE;
+            fixed = true;
+        }
+    }
+    if (p.shakeTenths < GESTURE_THRESHOLD_MIN || p.shakeTenths > GESTURE_THRESHOLD_MAX) {
+        p.shakeTenths = MAPPING_SHAKE_DEFAULT;
+        fixed = true;
+    }
+    if (p.swingTenths < GESTURE_THRESHOLD_MIN || p.swingTenths > GESTURE_THRESHOLD_MAX) {
+        p.swingTenths = MAPPING_SWING_DEFAULT;
+        fixed = true;
+    }
+    for (uint8_t i = 0; i < MAPPING_SLOT_COUNT; i++) {
+        if (p.turboHz[i] > TURBO_MAX_HZ) {
+            p.turboHz[i] = TURBO_MAX_HZ;
+            fixed = true;
+        }
+    }
+    return fixed;
+}
+
+/**
+ * 將設定檔編譯成查表 (在網頁伺服器中執行，不在輸入路徑上)
+ */
+inline void mappingProfileCompile(const MappingProfile& p, CompiledProfile& out) {
+    ButtonMapping layer[MAPPING_SLOT_COUNT];
+    const DirectionMapping& d = MAPPING_HOLD_DIRECTIONS[p.hold < MAPPING_HOLD_COUNT ? p.hold : 0];
+    for (uint8_t l = 0; l < 2; l++) {
+        const uint8_t* ns = l ? p.shiftButtons : p.buttons;
+        for (uint8_t i = 0; i < MAPPING_SLOT_COUNT; i++) {
+            layer[i].wiimoteButton = MAPPING_SLOTS[i].button;
+            layer[i].nsButton = (i == p.modifierSlot || i == p.walkSlot) ? MAPPING_NS_NONE : ns[i];
+        }
+        buildButtonTranslation(out.layers[l], layer, MAPPING_SLOT_COUNT, d, p.dPadTarget);
+    }
+    out.modifier = p.modifierSlot < MAPPING_SLOT_COUNT ? MAPPING_SLOTS[p.modifierSlot].button : 0;
+    out.stickTarget = p.stickTarget;
+    out.dPadTarget = p.dPadTarget;
+    out.socdMode = p.socdMode;
+    out.directions = d;
+    stickResponseBuild(out.stickResponse, p.rampUpMs, p.rampDownMs, p.rampCurve,
+                       p.walkSlot < MAPPING_SLOT_COUNT ? MAPPING_SLOTS[p.walkSlot].button : 0, p.walkPercent);
+    out.motionTarget = p.motionTarget;
+    motionResponseBuild(out.motion, p.hold == MAPPING_HOLD_UPRIGHT, p.motionRangeDeg, p.motionDeadzoneDeg,
+                        p.motionInvert);
+    out.irTarget = p.irTarget;
+    out.irSensitivity = p.irSensitivity;
+    irResponseBuild(out.ir, p.irRangePercent, p.irDeadzonePercent, p.irInvert);
+    out.wiimoteGestures = false;
+    for (uint8_t i = 0; i < MAPPING_GESTURE_COUNT; i++) {
+        uint8_t ns = p.gestureButtons[i];
+        out.gestureMasks[i] = ns < MAPPING_NS_BUTTON_COUNT ? (uint16_t)(1U << ns) : 0;
+        if (out.gestureMasks[i] && MAPPING_GESTURES[i].source == MAPPING_GESTURE_WIIMOTE) {
+            out.wiimoteGestures = true;
+        }
+    }
+    gestureResponseBuild(out.gesture, p.shakeTenths, p.swingTenths);
+
+    // 連發設定在 Wiimote 按鈕上，套用到它在兩層輸出的 NS 按鈕
+    memset(out.turboHalfUs, 0, sizeof(out.turboHalfUs));
+    for (uint8_t i = 0; i < MAPPING_SLOT_COUNT; i++) {
+        if (p.turboHz[i] == 0 || i == p.modifierSlot || i == p.walkSlot) {
+            continue;
+        }
+        uint32_t halfUs = 500000UL / p.turboHz[i];
+        if (p.buttons[i] < TURBO_BUTTON_COUNT) {
+            out.turboHalfUs[p.buttons[i]] = halfUs;
+        }
+        if (p.shiftButtons[i] < TURBO_BUTTON_COUNT) {
+            out.turboHalfUs[p.shiftButtons[i]] = halfUs;
+        }
+    }
+}
@@ -0,0 +1,230 @@
+// 檔案: MotionTilt.h
+// 作用: Wiimote 加速度計 -> 傾斜角 -> 類比搖桿
+//
+// 每個加速度樣本:
+//   1. 以 EEPROM 校正值換算成以 g 為單位的定點數 (Q16，1g = 65536)
+//   2. 低通濾波估計重力方向。Wiimote 沒有陀螺儀可以互補，改依總加速度決定信任程度:
+//      連續幾個樣本都接近 1g (沒有在甩動) 時用短時間常數跟上傾斜，否則用長時間常數，甩動不會讓搖桿亂跳
+//   3. 依握法取出兩個軸的分量 (= sin(傾斜角))，扣掉死區後線性放大到滿刻度角度
+// 濾波係數依實際的樣本間隔計算；樣本停止變化時由 tick() 以同一個輸入繼續收斂。
+// 時間由呼叫端傳入 (微秒)，可在電腦上重現。
+
+#pragma once
+#include <stdint.h>
+#include <stddef.h>
+#include <math.h>
+#include "WiimoteData.h"
+
+#define MOTION_G_ONE            65536      // Q16
+#define MOTION_G_LIMIT          (4 * MOTION_G_ONE)   // 甩動時的讀數上限，避免乘法溢位
+#define MOTION_ALPHA_ONE        4096       // 濾波係數 (Q12)
+#define MOTION_FAST_TAU_US      40000      // 靜止傾斜時的時間常數
+#define MOTION_SLOW_TAU_US      2000000    // 甩動時的時間常數 (幾乎保持，校正值偏差太大時仍會慢慢跟上)
+#define MOTION_STEADY_TOLERANCE 8          // 總加速度在 1g ± 1/8 g 內視為沒有甩動
+#define MOTION_STEADY_SAMPLES   4          // 甩動經過 1g 的瞬間不算: 要連續這麼多個樣本
+#define MOTION_MAX_DT_US        100000
+#define MOTION_SETTLED          64         // 濾波輸出與輸入相差小於此值 (約 0.001g) 視為收斂
+#define MOTION_Q15_ONE          32767
+
+#define MOTION_RANGE_MIN_DEG    10
+#define MOTION_RANGE_MAX_DEG    90
+#define MOTION_INVERT_X         0x01
+#define MOTION_INVERT_Y         0x02
+
+// 設定檔編譯後的傾斜映射參數
+struct MotionResponse {
+    uint8_t axisX;       // 搖桿 X 取自哪個加速度軸 (0: X, 1: Y, 2: Z)
+    uint8_t axisY;       // 搖桿 Y (往上為正)
+    int8_t signX;        // 1 或 -1
+    int8_t signY;
+    int32_t deadzone;    // Q16，sin(死區角度)
+    int32_t fullScale;   // Q16，sin(滿刻度角度)
+};
+
+/**
+ * 產生傾斜映射參數
+ * @param upright true: 直握 (搖桿 X = 左右傾，Y = 前後傾)；false: 橫握 (旋轉 90 度)
+ * @param rangeDeg 傾斜到此角度時輸出最大值
+ * @param deadzoneDeg 小於此角度時輸出中心
+ * @param invert MOTION_INVERT_*
+ */
+inline void motionResponseBuild(MotionResponse& r, bool upright, uint8_t rangeDeg, uint8_t deadzoneDeg,
+                                uint8_t invert) {
+    if (rangeDeg < MOTION_RANGE_MIN_DEG) rangeDeg = MOTION_RANGE_MIN_DEG;
+    if (rangeDeg > MOTION_RANGE_MAX_DEG) rangeDeg = MOTION_RANGE_MAX_DEG;
+    if (deadzoneDeg >= rangeDeg) deadzoneDeg = 0;
+    // Wiimote 座標 (直握指向螢幕): +X 朝左、+Y 朝前 (紅外線鏡頭)、+Z 朝上。
+    // 靜止時讀到的是向上的 1g，所以往右傾時 +X 讀數變大、往前傾時 +Y 讀數變小。
+    // 橫握 (十字鍵在左) 時整支旋轉 90 度: 玩家的右方是 -Y、前方是 -X。
+    r.axisX = upright ? 0 : 1;
+    r.axisY = upright ? 1 : 0;
+    r.signX = 1;
+    r.signY = upright ? -1 : 1;
+    if (invert & MOTION_INVERT_X) r.signX = (int8_t)-r.signX;
+    if (invert & MOTION_INVERT_Y) r.signY = (int8_t)-r.signY;
+    // 只在編譯設定檔時計算，不在輸入路徑上
+    const double radPerDeg = 3.14159265358979323846 / 180.0;
+    r.deadzone = (int32_t)(sin(deadzoneDeg * radPerDeg) * MOTION_G_ONE + 0.5);
+    r.fullScale = (int32_t)(sin(rangeDeg * radPerDeg) * MOTION_G_ONE + 0.5);
+}
+
+class MotionTilt {
+public:
+    MotionTilt() : _hasSample(false), _steady(true), _steadyCount(0), _settled(true), _lastUs(0), _x(128), _y(128) {
+        WiimoteAccelCalibration cal;
+        wiimoteAccelCalibrationDefault(cal);
+        setCalibration(cal);
+        reset();
+    }
+
+    // 換算用的係數在這裡算好，每個樣本只需乘法與位移
+    void setCalibration(const WiimoteAccelCalibration& cal) {
+        for (uint8_t i = 0; i < 3; i++) {
+            int32_t span = (int32_t)cal.gravity[i] - cal.zero[i];
+            if (span <= 0) {
+                span = WIIMOTE_ACCEL_GRAVITY_DEFAULT - WIIMOTE_ACCEL_ZERO_DEFAULT;
+            }
+            _zero[i] = cal.zero[i];
+            _scale[i] = MOTION_G_ONE / span;   // 10 位元讀數 1 格 = 1/span g
+        }
+    }
+
+    // 回報模式關閉或斷線: 回到中心，下一個樣本直接當作初始估計
+    void reset() {
+        _hasSample = false;
+        _steady = true;
+        _steadyCount = 0;
+        _settled = true;
+        for (uint8_t i = 0; i < 3; i++) {
+            _input[i] = 0;
+            _gravity[i] = 0;
+        }
+        _gravity[2] = MOTION_G_ONE;
+        _x = _y = 128;
+    }
+
+    /**
+     * 新的加速度樣本 (狀態封包中的 8 位元讀數)
+     * @return 輸出是否改變
+     */
+    bool input(uint8_t ax, uint8_t ay, uint8_t az, const MotionResponse& r, uint32_t nowUs) {
+        const uint8_t raw[3] = { ax, ay, az };
+        int64_t mag2 = 0;
+        for (uint8_t i = 0; i < 3; i++) {
+            int32_t g = ((int32_t)raw[i] * 4 - _zero[i]) * _scale[i];
+            if (g > MOTION_G_LIMIT) g = MOTION_G_LIMIT;
+            if (g < -MOTION_G_LIMIT) g = -MOTION_G_LIMIT;
+            _input[i] = g;
+            mag2 += (int64_t)g * g;
+        }
+        // |a|^2 與 1g^2 比較，不需要開根號
+        const int64_t one2 = (int64_t)MOTION_G_ONE * MOTION_G_ONE;
+        const int64_t tol2 = 2 * one2 / MOTION_STEADY_TOLERANCE;
+        if (mag2 > one2 - tol2 && mag2 < one2 + tol2) {
+            if (_steadyCount < MOTION_STEADY_SAMPLES) {
+                _steadyCount++;
+            }
+        } else {
+            _steadyCount = 0;
+        }
+        _steady = _steadyCount >= MOTION_STEADY_SAMPLES;
+        if (!_hasSample) {
+            _hasSample = true;
+            _lastUs = nowUs;
+            for (uint8_t i = 0; i < 3; i++) {
+                _gravity[i] = _input[i];
+            }
+            _settled = true;
+            return update(r);
+        }
+        advance(nowUs);
+        return update(r);
+    }
+
+    /**
+     * 推進時間 (每個 USB frame 呼叫)，讓停在同一個樣本時濾波也能收斂
+     * @return 輸出是否改變
+     */
+    bool tick(const MotionResponse& r, uint32_t nowUs) {
+        if (!active()) {
+            _lastUs = nowUs;
+            return false;
+        }
+        advance(nowUs);
+        return update(r);
+    }
+
+    bool active() const { return _hasSample && !_settled; }
+    bool steady() const { return _steady; }
+    uint8_t x() const { return _x; }
+    uint8_t y() const { return _y; }
+    // 濾波後的重力方向 (Q16)
+    int32_t gravity(uint8_t axis) const { return _gravity[axis]; }
+
+private:
+    void advance(uint32_t nowUs) {
+        uint32_t dt = nowUs - _lastUs;
+        _lastUs = nowUs;
+        if (dt > MOTION_MAX_DT_US) {
+            dt = MOTION_MAX_DT_US;
+        }
+        uint32_t tau = _steady ? MOTION_FAST_TAU_US : MOTION_SLOW_TAU_US;
+        // 一階低通: alpha = dt / (tau + dt)
+        int32_t alpha = (int32_t)((dt * MOTION_ALPHA_ONE + (tau + dt) / 2) / (tau + dt));
+        bool settled = true;
+        for (uint8_t i = 0; i < 3; i++) {
+            int32_t diff = _input[i] - _gravity[i];
+            int32_t step = (int32_t)(((int64_t)diff * alpha + (diff >= 0 ? MOTION_ALPHA_ONE / 2 : -MOTION_ALPHA_ONE / 2)) /
+                                     MOTION_ALPHA_ONE);
+            _gravity[i] += step;
+            diff -= step;
+            if (diff > MOTION_SETTLED || diff < -MOTION_SETTLED) {
+                settled = false;
+            }
+        }
+        _settled = settled;
+    }
+
+    // sin(傾斜角) -> Q15 搖桿幅度
+    static int32_t shape(int32_t v, const MotionResponse& r) {
+        int32_t mag = v < 0 ? -v : v;
+        if (mag <= r.deadzone) {
+            return 0;
+        }
+        int32_t out = mag >= r.fullScale
+            ? MOTION_Q15_ONE
+            : (int32_t)((int64_t)(mag - r.deadzone) * MOTION_Q15_ONE / (r.fullScale - r.deadzone));
+        return v < 0 ? -out : out;
+    }
+
+    // Q15 (-1 ~ 1) -> 0~255
+    static uint8_t axis(int32_t v) {
+        if (v >= 0) {
+            return (uint8_t)(128 + ((v * 127 + 16384) >> 15));
+        }
+        return (uint8_t)(128 - ((-v * 128 + 16384) >> 15));
+    }
+
+    bool update(const MotionResponse& r) {
+        int32_t vx = shape(r.signX * _gravity[r.axisX], r);
+        int32_t vy = shape(r.signY * _gravity[r.axisY], r);
+        uint8_t x = axis(vx);
+        uint8_t y = axis(-vy);   // 往上為正，NS 往上為 0
+        bool changed = x != _x || y != _y;
+        _x = x;
+        _y = y;
+        return changed;
+    }
+
+    int32_t _zero[3];
+    int32_t _scale[3];
+    int32_t _input[3];     // 最近一個樣本 (Q16)
+    int32_t _gravity[3];   // 濾波後的重力方向 (Q16)
+    bool _hasSample;
+    bool _steady;
+    uint8_t _steadyCount;
+    bool _settled;
+    uint32_t _lastUs;
+    uint8_t _x;
+    uint8_t _y;
+};
@@ -0,0 +1,288 @@
+// 檔案: NunchukStick.h
+// 作用: Nunchuk 類比搖桿的校正與死區處理
+//
+// 每個報告依序經過:
+//   1. 校正 + 軸向死區: 原始值 (0~255) 查表得到 -1~1 (Q15)，表在校正或設定改變時重建
+//   2. 徑向死區 / 反死區 / 外圈範圍: 依幅度查表 (線性內插) 得到輸出幅度
+//   3. 轉成 NS 搖桿的 0~255 (Y 軸反向)
+// 中心點在每次插上 Nunchuk 時由靜止的前幾個報告取得；上下限隨觀察到的範圍擴大。
+// 不依賴 Arduino，可在電腦上編譯。
+
+#pragma once
+#include <stdint.h>
+#include <stddef.h>
+#include <string.h>
+
+#define NUNCHUK_CENTER_SAMPLES    8     // 插上後用來估計中心的報告數 (靜止時 S1 約每 250ms 送一次關鍵幀)
+#define NUNCHUK_CENTER_SPREAD     4     // 這段期間的最大變化，超過代表玩家正在推搖桿
+#define NUNCHUK_CENTER_MAX_DRIFT  32    // 中心離 128 太遠時不採用
+#define NUNCHUK_DEFAULT_EXTENT    70    // 尚未觀察到完整範圍前的預設半徑 (原始值)
+#define NUNCHUK_MIN_EXTENT        20
+#define NUNCHUK_RADIAL_LUT_BITS   7     // 幅度查表的間隔: Q15 >> 7
+#define NUNCHUK_RADIAL_LUT_SIZE   ((46341 >> NUNCHUK_RADIAL_LUT_BITS) + 2)   // 幅度最大到 sqrt(2)
+#define NUNCHUK_Q15_ONE           32767
+
+struct NunchukCalibration {
+    uint8_t centerX;
+    uint8_t centerY;
+    uint8_t minX;
+    uint8_t maxX;
+    uint8_t minY;
+    uint8_t maxY;
+};
+
+// 單位皆為百分比 (0~100)
+struct NunchukSettings {
+    uint8_t axialDeadzone;    // 每一軸各自的死區 (避免只想推一個方向時另一軸漂移)
+    uint8_t radialDeadzone;   // 中心的圓形死區
+    uint8_t antiDeadzone;     // 離開死區時的最小輸出 (抵消遊戲本身的死區)
+    uint8_t outerRange;       // 推到此幅度即輸出最大值
+};
+
+inline void nunchukCalibrationDefault(NunchukCalibration& c) {
+    c.centerX = 128;
+    c.centerY = 128;
+    c.minX = 128 - NUNCHUK_DEFAULT_EXTENT;
+    c.maxX = 128 + NUNCHUK_DEFAULT_EXTENT;
+    c.minY = 128 - NUNCHUK_DEFAULT_EXTENT;
+    c.maxY = 128 + NUNCHUK_DEFAULT_EXTENT;
+}
+
+inline void nunchukSettingsDefault(NunchukSettings& s) {
+    s.axialDeadzone = 0;
+    s.radialDeadzone = 8;
+    s.antiDeadzone = 0;
+    s.outerRange = 95;
+}
+
+/**
+ * 修正不合理的校正值 / 設定 (從 NVS 讀入後呼叫)
+ */
+inline void nunchukSanitize(NunchukCalibration& c, NunchukSettings& s) {
+    if (c.centerX < 128 - NUNCHUK_CENTER_MAX_DRIFT || c.centerX > 128 + NUNCHUK_CENTER_MAX_DRIFT ||
+        c.centerY < 128 - NUNCHUK_CENTER_MAX_DRIFT || c.centerY > 128 + NUNCHUK_CENTER_MAX_DRIFT ||
+        c.centerX - c.minX < NUNCHUK_MIN_EXTENT || c.maxX - c.centerX < NUNCHUK_MIN_EXTENT ||
+        c.centerY - c.minY < NUNCHUK_MIN_EXTENT || c.maxY - c.centerY < NUNCHUK_MIN_EXTENT) {
+        nunchukCalibrationDefault(c);
+    }
+    if (s.axialDeadzone > 50) s.axialDeadzone = 50;
+    if (s.radialDeadzone > 50) s.radialDeadzone = 50;
+    if (s.antiDeadzone > 90) s.antiDeadzone = 90;
+    if (s.outerRange < 50 || s.outerRange > 100) s.outerRange = 95;
+    if (s.radialDeadzone >= s.outerRange) s.radialDeadzone = 0;
+}
+
+class NunchukStick {
+public:
+    NunchukStick() : _capturing(0), _dirty(false), _prevX(128), _prevY(128), _x(128), _y(128) {
+        nunchukCalibrationDefault(_cal);
+        nunchukSettingsDefault(_settings);
+        rebuild();
+    }
+
+    void begin(const NunchukCalibration& cal, const NunchukSettings& settings) {
+        _cal = cal;
+        _settings = settings;
+        nunchukSanitize(_cal, _settings);
+        rebuild();
+    }
+
+    void setSettings(const NunchukSettings& settings) {
+        _settings = settings;
+        nunchukSanitize(_cal, _settings);
+        rebuild();
+    }
+
+    // Nunchuk 剛插上: 接下來的報告用來重新估計中心
+    void onConnect() {
+        _capturing = 1;
+        _sumX = _sumY = 0;
+        _loX = _loY = 255;
+        _hiX = _hiY = 0;
+    }
+
+    // 清除觀察到的範圍並重新估計中心
+    void recalibrate() {
+        nunchukCalibrationDefault(_cal);
+        _dirty = true;
+        rebuild();
+        onConnect();
+    }
+
+    /**
+     * 處理一個報告的原始值 (每個報告一次)
+     */
+    void update(uint8_t rawX, uint8_t rawY) {
+        if (_capturing) {
+            captureCenter(rawX, rawY);
+        }
+        expandExtents(rawX, rawY);
+        _prevX = rawX;
+        _prevY = rawY;
+
+        int32_t nx = _lutX[rawX];
+        int32_t ny = _lutY[rawY];
+        int32_t r2 = nx * nx + ny * ny;
+        if (r2 == 0) {
+            _x = _y = 128;
+            return;
+        }
+        uint32_t r = isqrt((uint32_t)r2);
+        uint32_t index = r >> NUNCHUK_RADIAL_LUT_BITS;
+        if (index >= NUNCHUK_RADIAL_LUT_SIZE - 1) {
+            index = NUNCHUK_RADIAL_LUT_SIZE - 2;
+        }
+        // 相鄰兩格線性內插
+        uint32_t frac = r - (index << NUNCHUK_RADIAL_LUT_BITS);
+        int32_t lo = _radial[index];
+        int32_t hi = _radial[index + 1];
+        int32_t mag = lo + (int32_t)(((hi - lo) * (int32_t)frac) >> NUNCHUK_RADIAL_LUT_BITS);
+        _x = axis(nx * mag / (int32_t)r);
+        _y = axis(-(ny * mag / (int32_t)r));   // Nunchuk 往上為正，NS 往上為 0
+    }
+
+    // NS 搖桿輸出 (0~255)
+    uint8_t x() const { return _x; }
+    uint8_t y() const { return _y; }
+
+    bool capturing() const { return _capturing != 0; }
+    const NunchukCalibration& calibration() const { return _cal; }
+    const NunchukSettings& settings() const { return _settings; }
+
+    // 校正值在上次呼叫後是否改變 (需要儲存)
+    bool takeDirty() {
+        bool d = _dirty;
+        _dirty = false;
+        return d;
+    }
+
+private:
+    void captureCenter(uint8_t rawX, uint8_t rawY) {
+        _sumX += rawX;
+        _sumY += rawY;
+        if (rawX < _loX) _loX = rawX;
+        if (rawX > _hiX) _hiX = rawX;
+        if (rawY < _loY) _loY = rawY;
+        if (rawY > _hiY) _hiY = rawY;
+        if (_capturing++ < NUNCHUK_CENTER_SAMPLES) {
+            return;
+        }
+        _capturing = 0;
+        uint8_t cx = (uint8_t)((_sumX + NUNCHUK_CENTER_SAMPLES / 2) / NUNCHUK_CENTER_SAMPLES);
+        uint8_t cy = (uint8_t)((_sumY + NUNCHUK_CENTER_SAMPLES / 2) / NUNCHUK_CENTER_SAMPLES);
+        bool still = _hiX - _loX <= NUNCHUK_CENTER_SPREAD && _hiY - _loY <= NUNCHUK_CENTER_SPREAD;
+        bool plausible = cx >= 128 - NUNCHUK_CENTER_MAX_DRIFT && cx <= 128 + NUNCHUK_CENTER_MAX_DRIFT &&
+                         cy >= 128 - NUNCHUK_CENTER_MAX_DRIFT && cy <= 128 + NUNCHUK_CENTER_MAX_DRIFT;
+        if (!still || !plausible || (cx == _cal.centerX && cy == _cal.centerY)) {
+            return;   // 玩家在插上時推著搖桿: 沿用原本的中心
+        }
+        // 範圍至少保留 NUNCHUK_MIN_EXTENT
+        _cal.centerX = cx;
+        _cal.centerY = cy;
+        if (cx - _cal.minX < NUNCHUK_MIN_EXTENT) _cal.minX = cx - NUNCHUK_MIN_EXTENT;
+        if (_cal.maxX - cx < NUNCHUK_MIN_EXTENT) _cal.maxX = cx + NUNCHUK_MIN_EXTENT;
+        if (cy - _cal.minY < NUNCHUK_MIN_EXTENT) _cal.minY = cy - NUNCHUK_MIN_EXTENT;
+        if (_cal.maxY - cy < NUNCHUK_MIN_EXTENT) _cal.maxY = cy + NUNCHUK_MIN_EXTENT;
+        _dirty = true;
+        rebuild();
+    }
+
+    // 連續兩個報告都超出範圍才擴大 (取較保守的一個)，避免單一雜訊值永久撐大範圍
+    void expandExtents(uint8_t rawX, uint8_t rawY) {
+        bool changed = false;
+        uint8_t loX = rawX > _prevX ? rawX : _prevX;
+        uint8_t hiX = rawX < _prevX ? rawX : _prevX;
+        uint8_t loY = rawY > _prevY ? rawY : _prevY;
+        uint8_t hiY = rawY < _prevY ? rawY : _prevY;
+        if (loX < _cal.minX) { _cal.minX = loX; changed = true; }
+        if (hiX > _cal.maxX) { _cal.maxX = hiX; changed = true; }
+        if (loY < _cal.minY) { _cal.minY = loY; changed = true; }
+        if (hiY > _cal.maxY) { _cal.maxY = hiY; changed = true; }
+        if (changed) {
+            _dirty = true;
+            rebuildAxes();
+        }
+    }
+
+    void rebuild() {
+        rebuildAxes();
+        rebuildRadial();
+    }
+
+    // 原始值 -> 校正後的 -1~1 (Q15)，含軸向死區
+    static void buildAxis(int16_t* lut, uint8_t center, uint8_t lo, uint8_t hi, uint8_t deadzonePct) {
+        int32_t dz = (int32_t)deadzonePct * NUNCHUK_Q15_ONE / 100;
+        for (int32_t raw = 0; raw < 256; raw++) {
+            int32_t d = raw - center;
+            int32_t span = d >= 0 ? hi - center : center - lo;
+            int32_t n = span > 0 ? d * NUNCHUK_Q15_ONE / span : 0;
+            if (n > NUNCHUK_Q15_ONE) n = NUNCHUK_Q15_ONE;
+            if (n < -NUNCHUK_Q15_ONE) n = -NUNCHUK_Q15_ONE;
+            int32_t mag = n < 0 ? -n : n;
+            mag = mag <= dz ? 0 : (mag - dz) * NUNCHUK_Q15_ONE / (NUNCHUK_Q15_ONE - dz);
+            lut[raw] = (int16_t)(n < 0 ? -mag : mag);
+        }
+    }
+
+    void rebuildAxes() {
+        buildAxis(_lutX, _cal.centerX, _cal.minX, _cal.maxX, _settings.axialDeadzone);
+        buildAxis(_lutY, _cal.centerY, _cal.minY, _cal.maxY, _settings.axialDeadzone);
+    }
+
+    // 輸入幅度 -> 輸出幅度: 死區內為 0，之後由反死區線性升到外圈範圍時的 1
+    void rebuildRadial() {
+        int32_t dz = (int32_t)_settings.radialDeadzone * NUNCHUK_Q15_ONE / 100;
+        int32_t anti = (int32_t)_settings.antiDeadzone * NUNCHUK_Q15_ONE / 100;
+        int32_t outer = (int32_t)_settings.outerRange * NUNCHUK_Q15_ONE / 100;
+        for (int32_t i = 0; i < NUNCHUK_RADIAL_LUT_SIZE; i++) {
+            int32_t r = i << NUNCHUK_RADIAL_LUT_BITS;
+            int32_t out;
+            if (r <= dz) {
+                out = 0;
+            } else if (r >= outer) {
+                out = NUNCHUK_Q15_ONE;
+            } else {
+                out = anti + (int32_t)((int64_t)(NUNCHUK_Q15_ONE - anti) * (r - dz) / (outer - dz));
+            }
+            _radial[i] = (uint16_t)out;
+        }
+    }
+
+    static uint32_t isqrt(uint32_t v) {
+        uint32_t res = 0;
+        uint32_t bit = 1UL << 30;
+        while (bit > v) bit >>= 2;
+        while (bit) {
+            if (v >= res + bit) {
+                v -= res + bit;
+                res = (res >> 1) + bit;
+            } else {
+                res >>= 1;
+            }
+            bit >>= 2;
+        }
+        return res;
+    }
+
+    // Q15 (-1 ~ 1) -> 0~255
+    static uint8_t axis(int32_t v) {
+        if (v > NUNCHUK_Q15_ONE) v = NUNCHUK_Q15_ONE;
+        if (v < -NUNCHUK_Q15_ONE) v = -NUNCHUK_Q15_ONE;
+        if (v >= 0) {
+            return (uint8_t)(128 + ((v * 127 + 16384) >> 15));
+        }
+        return (uint8_t)(128 - ((-v * 128 + 16384) >> 15));
+    }
+
+    NunchukCalibration _cal;
+    NunchukSettings _settings;
+    int16_t _lutX[256];
+    int16_t _lutY[256];
+    uint16_t _radial[NUNCHUK_RADIAL_LUT_SIZE];
+    uint8_t _capturing;     // 0: 沒有在估計中心，否則為已收集的報告數 + 1
+    uint32_t _sumX, _sumY;
+    uint8_t _loX, _hiX, _loY, _hiY;
+    bool _dirty;
+    uint8_t _prevX, _prevY;
+    uint8_t _x, _y;
+};
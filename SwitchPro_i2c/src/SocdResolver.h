@@ -0,0 +1,73 @@
+// 檔案: SocdResolver.h
+// 作用: 相反方向同時按下 (SOCD: 左+右、上+下) 時要輸出哪一邊
+//
+// 在方向鍵查表之前處理 Wiimote 的方向位元，每一軸最多留下一個方向，
+// 所以十字鍵 (hat) 與搖桿 (含漸進輸出) 看到的是同一個結果。
+// 模式 (每個設定檔可選):
+//   NEUTRAL      兩邊都按時置中 (原本的行為)
+//   LAST         最後按下的優先；放開後回到仍按住的另一邊
+//   FIRST        先按下的優先，放開前忽略另一邊
+//   UP_PRIORITY  上下同時按時為上，左右同時按時置中 (依握法換算的玩家方向)
+// 每一軸以一個位元記錄最後按下的方向，每個封包固定的運算量。
+
+#pragma once
+#include <stdint.h>
+#include <stddef.h>
+#include "ButtonTranslation.h"
+
+#define SOCD_MODE_NEUTRAL      0
+#define SOCD_MODE_LAST         1
+#define SOCD_MODE_FIRST        2
+#define SOCD_MODE_UP_PRIORITY  3
+#define SOCD_MODE_COUNT        4
+
+class SocdResolver {
+public:
+    SocdResolver() : _held(0), _last(0) {}
+
+    /**
+     * 處理方向位元 (同一個狀態重複呼叫不會改變按下的順序)
+     * @param d 作用中設定檔的握法
+     * @return 每一軸最多只剩一個方向的按鈕遮罩 (其他按鈕不變)
+     */
+    uint16_t resolve(uint16_t buttons, const DirectionMapping& d, uint8_t mode) {
+        uint16_t held = buttons & BUTTON_DIRECTION_MASK;
+        uint16_t pressed = held & ~_held;
+        _held = held;
+        uint16_t x = axis(held, pressed, d.left | d.right, 0, mode);
+        uint16_t y = axis(held, pressed, d.up | d.down, d.up, mode);
+        return (uint16_t)((buttons & ~BUTTON_DIRECTION_MASK) | x | y);
+    }
+
+private:
+    /**
+     * 單軸
+     * @param priority UP_PRIORITY 模式下兩邊都按時的輸出 (0: 置中)
+     */
+    uint16_t axis(uint16_t held, uint16_t pressed, uint16_t axisMask, uint16_t priority, uint8_t mode) {
+        uint16_t h = held & axisMask;
+        uint16_t p = pressed & axisMask;
+        if (p) {
+            // 同一個封包兩邊一起按下就沒有先後 (兩邊都按時置中)
+            _last = (uint16_t)((_last & ~axisMask) | (p == axisMask ? 0 : p));
+        }
+        if (h != axisMask) {
+            return h;
+        }
+        uint16_t last = _last & axisMask;
+        switch (mode) {
+            case SOCD_MODE_LAST:
+                return last;
+            case SOCD_MODE_FIRST:
+                return last ? (uint16_t)(h ^ last) : 0;
+            case SOCD_MODE_UP_PRIORITY:
+                return priority;
+            case SOCD_MODE_NEUTRAL:
+            default:
+                return 0;
+        }
+    }
+
+    uint16_t _held;   // 上一次的方向位元
+    uint16_t _last;   // 每一軸最後按下的方向
+};
@@ -0,0 +1,65 @@
+// 檔案: SpscRing.h
+// 作用: 單一生產者 / 單一消費者的無鎖環形緩衝區
+//
+// 生產者 (UART 接收回呼) 只寫 _head，消費者 (輸入任務) 只寫 _tail，
+// 兩邊都不需要互斥鎖。N 必須是 2 的次方。
+
+#pragma once
+#include <stdint.h>
+#include <stddef.h>
+#include <atomic>
+
+template <size_t N>
+class SpscRing {
+    static_assert((N & (N - 1)) == 0, "SpscRing size must be a power of two");
+
+public:
+    SpscRing() : _head(0), _tail(0), _overruns(0) {}
+
+    /**
+     * 寫入資料 (僅限生產者呼叫)
+     * @return 實際寫入的位元組數；空間不足的部分會被丟棄並計入 overruns
+     */
+    size_t push(const uint8_t* data, size_t len) {
+        uint32_t head = _head.load(std::memory_order_relaxed);
+        uint32_t tail = _tail.load(std::memory_order_acquire);
+        size_t space = N - (size_t)(head - tail);
+        size_t n = len < space ? len : space;
+        for (size_t i = 0; i < n; i++) {
+            _buf[(head + i) & (N - 1)] = data[i];
+        }
+        _head.store(head + (uint32_t)n, std::memory_order_release);
+        if (n < len) {
+            _overruns.fetch_add((uint32_t)(len - n), std::memory_order_relaxed);
+        }
+        return n;
+    }
+
+    /**
+     * 讀出資料 (僅限消費者呼叫)
+     * @return 實際讀出的位元組數
+     */
+    size_t pop(uint8_t* out, size_t maxLen) {
+        uint32_t tail = _tail.load(std::memory_order_relaxed);
+        uint32_t head = _head.load(std::memory_order_acquire);
+        size_t avail = (size_t)(head - tail);
+        size_t n = maxLen < avail ? maxLen : avail;
+        for (size_t i = 0; i < n; i++) {
+            out[i] = _buf[(tail + i) & (N - 1)];
+        }
+        _tail.store(tail + (uint32_t)n, std::memory_order_release);
+        return n;
+    }
+
+    size_t size() const {
+        return (size_t)(_head.load(std::memory_order_acquire) - _tail.load(std::memory_order_acquire));
+    }
+
+    uint32_t overruns() const { return _overruns.load(std::memory_order_relaxed); }
+
+private:
+    uint8_t _buf[N];
+    std::atomic<uint32_t> _head;
+    std::atomic<uint32_t> _tail;
+    std::atomic<uint32_t> _overruns;
+};
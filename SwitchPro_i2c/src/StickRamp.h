@@ -0,0 +1,186 @@
+// 檔案: StickRamp.h
+// 作用: 方向鍵 -> 類比搖桿的漸進輸出 (加速/減速曲線、慢走鍵、圓形邊界)
+//
+// 按下方向鍵後搖桿幅度依曲線在 rampUp 時間內推到底，放開後在 rampDown 時間內回到中心；
+// 按住慢走鍵時幅度乘上固定比例。斜向以單位圓正規化 (0.707, 0.707)，不會跑到方形的角落。
+// 曲線在設定檔編譯時算成定點數查表，每個 USB frame 的計算量固定。
+// 時間由呼叫端傳入 (微秒)，可在電腦上重現。
+
+#pragma once
+#include <stdint.h>
+#include <stddef.h>
+
+#define STICK_RAMP_TABLE_BITS  8
+#define STICK_RAMP_TABLE_SIZE  (1 << STICK_RAMP_TABLE_BITS)
+#define STICK_RAMP_FULL        (1UL << 24)    // 加速進度 (Q24)，FULL = 推到底
+#define STICK_RAMP_RATE_SHIFT  8              // 速率比進度多的小數位數，2000ms 的速率才不會被截掉 5%
+#define STICK_RAMP_MAX_DT_US   100000         // 單次推進的上限，長時間沒有呼叫時不會一次跳到底
+#define STICK_Q15_ONE          32767
+
+// 曲線形狀
+#define STICK_CURVE_LINEAR    0
+#define STICK_CURVE_EASE_IN   1    // 起步慢 (t^2)，適合需要微調的遊戲
+#define STICK_CURVE_EASE_OUT  2    // 起步快 (1-(1-t)^2)
+#define STICK_CURVE_S         3    // 兩端慢 (smoothstep)
+#define STICK_CURVE_COUNT     4
+
+// 設定檔編譯後的搖桿反應參數
+struct StickResponse {
+    uint16_t curve[STICK_RAMP_TABLE_SIZE];   // 加速進度 -> 幅度 (Q15)
+    uint32_t upRate;       // 每微秒增加的進度 (Q24 << STICK_RAMP_RATE_SHIFT)，0: 立即推到底
+    uint32_t downRate;     // 每微秒減少的進度 (Q24 << STICK_RAMP_RATE_SHIFT)，0: 立即回中心
+    uint32_t walkMask;     // 慢走鍵的 Wiimote 位元 (wiimoteButtonSet 格式)，0: 沒有
+    uint16_t walkScale;    // 按住慢走鍵時的幅度比例 (Q15)
+};
+
+/**
+ * 產生搖桿反應參數
+ * @param walkPercent 慢走時的幅度 (1~100)
+ */
+inline void stickResponseBuild(StickResponse& r, uint16_t rampUpMs, uint16_t rampDownMs, uint8_t curve,
+                               uint32_t walkMask, uint8_t walkPercent) {
+    for (uint32_t i = 0; i < STICK_RAMP_TABLE_SIZE; i++) {
+        // t 為 Q15，最後一格為 1.0
+        uint32_t t = i * STICK_Q15_ONE / (STICK_RAMP_TABLE_SIZE - 1);
+        uint32_t inv = STICK_Q15_ONE - t;
+        uint32_t v;
+        switch (curve) {
+            case STICK_CURVE_EASE_IN:
+                v = t * t / STICK_Q15_ONE;
+                break;
+            case STICK_CURVE_EASE_OUT:
+                v = STICK_Q15_ONE - inv * inv / STICK_Q15_ONE;
+                break;
+            case STICK_CURVE_S:
+                // 3t^2 - 2t^3
+                v = (t * t / STICK_Q15_ONE) * (3 * STICK_Q15_ONE - 2 * t) / STICK_Q15_ONE;
+                break;
+            default:
+                v = t;
+                break;
+        }
+        r.curve[i] = (uint16_t)(v > STICK_Q15_ONE ? STICK_Q15_ONE : v);
+    }
+    const uint64_t full = (uint64_t)STICK_RAMP_FULL << STICK_RAMP_RATE_SHIFT;
+    r.upRate = rampUpMs ? (uint32_t)(full / ((uint32_t)rampUpMs * 1000)) : 0;
+    r.downRate = rampDownMs ? (uint32_t)(full / ((uint32_t)rampDownMs * 1000)) : 0;
+    r.walkMask = walkMask;
+    if (walkPercent == 0 || walkPercent > 100) {
+        walkPercent = 100;
+    }
+    r.walkScale = (uint16_t)((uint32_t)walkPercent * STICK_Q15_ONE / 100);
+}
+
+// 軸的 0/128/255 輸出轉成方向 -1/0/1
+inline int8_t stickDirection(uint8_t axis) {
+    return axis > 128 ? 1 : (axis < 128 ? -1 : 0);
+}
+
+class StickRamp {
+public:
+    StickRamp() : _dirX(0), _dirY(0), _pressed(false), _walk(false), _pos(0), _lastUs(0), _x(128), _y(128) {}
+
+    /**
+     * 新的方向鍵狀態 (每個封包一次)
+     * @param dirX, dirY -1/0/1 (Y 往上為 -1，與 NS 搖桿相同)
+     * @return 輸出是否改變
+     */
+    bool input(int8_t dirX, int8_t dirY, bool walk, const StickResponse& r, uint32_t nowUs) {
+        advance(r, nowUs);
+        _pressed = dirX != 0 || dirY != 0;
+        if (_pressed) {
+            // 放開後的減速沿用最後的方向
+            _dirX = dirX;
+            _dirY = dirY;
+        }
+        _walk = walk;
+        if (r.upRate == 0 && _pressed) {
+            _pos = STICK_RAMP_FULL;
+        }
+        if (r.downRate == 0 && !_pressed) {
+            _pos = 0;
+        }
+        return update(r);
+    }
+
+    /**
+     * 推進時間 (每個 USB frame 呼叫)
+     * @return 輸出是否改變
+     */
+    bool tick(const StickResponse& r, uint32_t nowUs) {
+        if (!active()) {
+            _lastUs = nowUs;
+            return false;
+        }
+        advance(r, nowUs);
+        return update(r);
+    }
+
+    // 是否仍在加速或減速中 (需要 tick)
+    bool active() const {
+        return _pressed ? _pos < STICK_RAMP_FULL : _pos > 0;
+    }
+
+    uint8_t x() const { return _x; }
+    uint8_t y() const { return _y; }
+
+private:
+    void advance(const StickResponse& r, uint32_t nowUs) {
+        uint32_t dt = nowUs - _lastUs;
+        _lastUs = nowUs;
+        if (dt > STICK_RAMP_MAX_DT_US) {
+            dt = STICK_RAMP_MAX_DT_US;
+        }
+        if (_pressed && _pos < STICK_RAMP_FULL) {
+            uint32_t step = r.upRate ? rampStep(dt, r.upRate) : STICK_RAMP_FULL;
+            _pos = (STICK_RAMP_FULL - _pos > step) ? _pos + step : STICK_RAMP_FULL;
+        } else if (!_pressed && _pos > 0) {
+            uint32_t step = r.downRate ? rampStep(dt, r.downRate) : STICK_RAMP_FULL;
+            _pos = _pos > step ? _pos - step : 0;
+        }
+    }
+
+    // dt * rate 最大約 2^39 (1ms 的速率乘上 STICK_RAMP_MAX_DT_US)，用 64 位元再截到 FULL
+    static uint32_t rampStep(uint32_t dt, uint32_t rate) {
+        uint64_t step = ((uint64_t)dt * rate) >> STICK_RAMP_RATE_SHIFT;
+        return step > STICK_RAMP_FULL ? STICK_RAMP_FULL : (uint32_t)step;
+    }
+
+    // 單一軸: Q15 (-1 ~ 1) -> 0~255，正向最大 255，負向最小 0
+    static uint8_t axis(int32_t v) {
+        if (v >= 0) {
+            return (uint8_t)(128 + ((v * 127 + 16384) >> 15));
+        }
+        return (uint8_t)(128 - ((-v * 128 + 16384) >> 15));
+    }
+
+    bool update(const StickResponse& r) {
+        // 圓形邊界: 斜向的單位向量為 (0.7071, 0.7071)
+        static const int32_t DIAGONAL = 23170;
+        int32_t unit = (_dirX != 0 && _dirY != 0) ? DIAGONAL : STICK_Q15_ONE;
+        uint32_t index = _pos >> (24 - STICK_RAMP_TABLE_BITS);
+        if (index >= STICK_RAMP_TABLE_SIZE) {
+            index = STICK_RAMP_TABLE_SIZE - 1;
+        }
+        int32_t mag = r.curve[index];
+        if (_walk && r.walkMask) {
+            mag = (mag * r.walkScale) >> 15;
+        }
+        int32_t v = (unit * mag) >> 15;
+        uint8_t x = axis(_dirX * v);
+        uint8_t y = axis(_dirY * v);
+        bool changed = x != _x || y != _y;
+        _x = x;
+        _y = y;
+        return changed;
+    }
+
+    int8_t _dirX;
+    int8_t _dirY;
+    bool _pressed;
+    bool _walk;
+    uint32_t _pos;       // 加速進度 (Q24)
+    uint32_t _lastUs;
+    uint8_t _x;
+    uint8_t _y;
+};
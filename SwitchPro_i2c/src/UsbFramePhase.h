@@ -0,0 +1,201 @@
+// 檔案: UsbFramePhase.h
+// 作用: 估計 USB frame 開始 (SOF) 在本地時鐘上的相位，讓報告在主機輪詢前一刻產生
+//
+// Full speed 的主機每 1ms 送一次 SOF，裝置的 frame number 暫存器 (11 位元) 隨之加一。
+// 每次取樣 (本地時間 t, frame number f) 代表 SOF(f) <= t < SOF(f) + 1ms，
+// 多個取樣的區間取交集就能把相位縮到幾十 µs 以內，不需要 SOF 中斷。
+// 取樣之間依最大時鐘誤差 (USB 規格 ±500 ppm 加上本地晶振) 放寬區間，交集為空時重新開始。
+// 主機的中斷端點輪詢排在 frame 的開頭，所以下一次 SOF 就是下一次 IN 輪詢的時間。
+//
+// UsbFrameTimer 決定單次計時器的下一次觸發: 報告 tick (相位任意，或在 SOF 前 lead µs)，
+// 另外每幾個 frame 在估計的 SOF 前後各取樣一次，維持區間的兩端。
+
+#pragma once
+#include <stdint.h>
+
+#define USB_FRAME_US            1000
+#define USB_FRAME_NUMBER_MASK   0x7FF     // 11 位元 frame number
+#define USB_FRAME_DRIFT_DIV     1500      // 每經過 1500µs 區間兩端各放寬 1µs (667 ppm)
+#define USB_FRAME_LOCK_US       64        // 區間寬度在此以內視為已鎖定，超過兩倍或重新同步才解除
+#define USB_FRAME_LOCK_SAMPLES  16        // 重新同步之後至少要連續這麼多個一致的取樣才鎖定 (主機暫停時 frame number 停住)
+#define USB_FRAME_REBASE_US     1000000   // 參考點每秒往前移，避免 32 位元運算溢位
+#define USB_FRAME_PROBE_FRAMES  8         // 每 8 個 frame 在估計的 SOF 前後各取樣一次
+#define USB_FRAME_PROBE_US      16        // 取樣點與估計 SOF 的距離
+
+class UsbFramePhase {
+public:
+    UsbFramePhase() : _resyncs(0) { reset(); }
+
+    void reset() {
+        _valid = false;
+        _locked = false;
+        _consistent = 0;
+        _refUs = 0;
+        _refFrame = 0;
+        _lastUs = 0;
+        _sampleUs = 0;
+        _lo = 0;
+        _hi = 0;
+    }
+
+    /**
+     * 加入一個取樣 (時間需遞增)
+     * @param t 讀取 frame number 時的本地時間 (µs)
+     * @param frame 讀到的 frame number (只用低 11 位元)
+     */
+    void sample(uint32_t t, uint16_t frame) {
+        frame &= USB_FRAME_NUMBER_MASK;
+        _sampleUs = t;
+        if (!_valid) {
+            _valid = true;
+            _refUs = t;
+            _refFrame = frame;
+            _lastUs = t;
+            _lo = -USB_FRAME_US;
+            _hi = 0;
+            _locked = false;
+            _consistent = 0;
+            return;
+        }
+        // 參考點之後的第幾個 frame: 以目前的相位推算，再以讀到的 11 位元 frame number 修正回繞
+        int32_t elapsed = (int32_t)(t - _refUs);
+        int32_t expected = floorDiv(elapsed - phase(), USB_FRAME_US);
+        int32_t delta = (int32_t)((frame - (uint32_t)(_refFrame + expected)) & USB_FRAME_NUMBER_MASK);
+        if (delta >= (USB_FRAME_NUMBER_MASK + 1) / 2) {
+            delta -= USB_FRAME_NUMBER_MASK + 1;
+        }
+        int32_t k = expected + delta;
+        int32_t u = elapsed - k * USB_FRAME_US;   // SOF(k) 相對參考點的相位上界
+
+        // 餘數留到下一次，取樣再密也不會多放寬
+        int32_t widen = (int32_t)((t - _lastUs) / USB_FRAME_DRIFT_DIV);
+        _lastUs += (uint32_t)widen * USB_FRAME_DRIFT_DIV;
+        int32_t lo = _lo - widen;
+        int32_t hi = _hi + widen;
+        if (u - USB_FRAME_US > lo) lo = u - USB_FRAME_US;
+        if (u < hi) hi = u;
+        if (lo > hi) {
+            // 與之前的取樣矛盾 (主機重新列舉、暫停或時鐘跳動): 只相信這個取樣
+            lo = u - USB_FRAME_US;
+            hi = u;
+            _resyncs++;
+            _locked = false;
+            _consistent = 0;
+        } else if (_consistent < USB_FRAME_LOCK_SAMPLES) {
+            _consistent++;
+        }
+        _lo = lo;
+        _hi = hi;
+        if (hi - lo <= USB_FRAME_LOCK_US && _consistent >= USB_FRAME_LOCK_SAMPLES) {
+            _locked = true;
+        } else if (hi - lo > 2 * USB_FRAME_LOCK_US) {
+            _locked = false;
+        }
+
+        if (elapsed >= USB_FRAME_REBASE_US) {
+            int32_t frames = elapsed / USB_FRAME_US;
+            _refUs += (uint32_t)frames * USB_FRAME_US;
+            _refFrame += (uint32_t)frames;
+            // 時鐘誤差累積的相位也併入參考 frame，讓 _lo/_hi 維持在一個 frame 內
+            int32_t wrap = floorDiv(phase(), USB_FRAME_US);
+            _lo -= wrap * USB_FRAME_US;
+            _hi -= wrap * USB_FRAME_US;
+            _refFrame -= (uint32_t)wrap;
+        }
+    }
+
+    bool valid() const { return _valid; }
+    bool locked() const { return _locked; }
+    uint32_t uncertaintyUs() const { return _valid ? (uint32_t)(_hi - _lo) : USB_FRAME_US; }
+    uint32_t resyncs() const { return _resyncs; }
+
+    // 最後一次取樣之前的最近一個 SOF (本地 µs)，與靜態的 nextSof() 搭配可以在別的任務中換算
+    uint32_t sofUs() const { return nextSof(_refUs + (uint32_t)phase(), _sampleUs) - USB_FRAME_US; }
+
+    // t 之後的第一個 SOF (本地 µs)
+    uint32_t nextSof(uint32_t t) const { return nextSof(_refUs + (uint32_t)phase(), t); }
+
+    static uint32_t nextSof(uint32_t sofUs, uint32_t t) {
+        int32_t n = (int32_t)(t - sofUs);
+        return sofUs + (uint32_t)((floorDiv(n, USB_FRAME_US) + 1) * USB_FRAME_US);
+    }
+
+private:
+    int32_t phase() const { return (_lo + _hi) / 2; }
+
+    static int32_t floorDiv(int32_t a, int32_t b) {
+        return a >= 0 ? a / b : -((-a + b - 1) / b);
+    }
+
+    bool _valid;
+    bool _locked;
+    uint8_t _consistent;  // 重新同步之後一致的取樣數 (到 USB_FRAME_LOCK_SAMPLES 為止)
+    uint32_t _refUs;      // 參考時間
+    uint32_t _refFrame;   // 參考時間所在的 frame (只有低 11 位元有意義)
+    uint32_t _lastUs;     // 已放寬到的時間
+    uint32_t _sampleUs;   // 最後一次取樣
+    int32_t _lo;          // SOF(_refFrame + k) = _refUs + k * 1ms + phase，phase 在 [_lo, _hi]
+    int32_t _hi;
+    uint32_t _resyncs;
+};
+
+class UsbFrameTimer {
+public:
+    UsbFrameTimer() { reset(0); }
+
+    void reset(uint32_t now) {
+        _tickUs = now + USB_FRAME_US;
+        _probeUs = 0;
+        _probes = 0;
+        _probeCount = 0;
+    }
+
+    /**
+     * 計時器觸發時呼叫 (先以同一個時間取樣 phase)
+     * @param now 目前時間 (µs)
+     * @param phase SOF 相位估計
+     * @param leadUs 大於 0 且相位已鎖定時，報告 tick 排在每個 SOF 之前 leadUs；否則每 1ms、相位任意
+     * @param tick 輸出: 這次觸發是否為報告 tick (取樣點不產生報告)
+     * @return 到下一次觸發的時間 (µs，至少 1)
+     */
+    uint32_t fire(uint32_t now, const UsbFramePhase& phase, uint32_t leadUs, bool& tick) {
+        tick = due(now, _tickUs);
+        if (tick) {
+            if (leadUs > 0 && phase.locked()) {
+                _tickUs = phase.nextSof(now + leadUs) - leadUs;
+                // 提早觸發時不要在同一個 frame 再觸發一次
+                if ((int32_t)(_tickUs - now) < USB_FRAME_US / 2) {
+                    _tickUs += USB_FRAME_US;
+                }
+            } else {
+                _tickUs += USB_FRAME_US;
+                if (due(now, _tickUs)) {
+                    _tickUs = now + USB_FRAME_US;
+                }
+            }
+        }
+        if (_probes > 0 && due(now, _probeUs)) {
+            _probes--;
+            _probeUs += 2 * USB_FRAME_PROBE_US;
+        }
+        if (tick && _probes == 0 && phase.valid() && ++_probeCount >= USB_FRAME_PROBE_FRAMES) {
+            _probeCount = 0;
+            _probes = 2;
+            _probeUs = phase.nextSof(now) - USB_FRAME_PROBE_US;
+        }
+        uint32_t next = _tickUs;
+        if (_probes > 0 && (int32_t)(_probeUs - next) < 0) {
+            next = _probeUs;
+        }
+        int32_t delay = (int32_t)(next - now);
+        return delay > 0 ? (uint32_t)delay : 1;
+    }
+
+private:
+    static bool due(uint32_t now, uint32_t at) { return (int32_t)(now - at) >= 0; }
+
+    uint32_t _tickUs;     // 下一個報告 tick
+    uint32_t _probeUs;    // 下一個取樣點
+    uint8_t _probes;      // 這一輪還剩幾個取樣點
+    uint8_t _probeCount;  // 距離上一輪取樣的 tick 數
+};
@@ -17,21 +17,109 @@
 
 #include <Arduino.h>
 #include "switch_ESP32.h"  // Switch 控制器函式庫
+#include "switch_ProController.h"  // 原廠 Pro 控制器協定 (USB_BACKEND_PRO_CONTROLLER)
 #include "WiimoteData.h"   // 我們的共享資料結構
+#include "WiimoteLink.h"   // S1 -> S3 訊框解析
+#include "UartLinkTransport.h"
+#include "LinkBaudNegotiator.h"
+#include "SpscRing.h"      // UART 接收回呼 -> 輸入任務
+#include "ClockSync.h"     // S1/S3 時鐘差估計
+#include "LatencyHistogram.h"
+#include "LinkCommand.h"   // S3 -> S1 命令 (震動、燈號、回報模式)
+#include "ButtonEdges.h"   // 快速點擊的中間狀態還原
+#include "ButtonTranslation.h"  // 按鈕映射查表
+#include "MappingProfile.h"     // 可在網頁編輯的映射設定檔
+#include "DoubleBuffer.h"
+#include "MacroEngine.h"      // 連發與巨集
+#include "NunchukStick.h"     // Nunchuk 搖桿校正與死區
+#include "MotionTilt.h"       // 體感傾斜 -> 搖桿
+#include "IrPointer.h"        // 紅外線指標 -> 搖桿
+#include "GestureDetector.h"  // 搖晃 / 揮動 -> 虛擬按鈕
+#include "ChordSwitch.h"      // HOME + 方向鍵切換設定檔與模式
+#include "SocdResolver.h"     // 相反方向同時按下的處理
+#include "UsbFramePhase.h"    // USB frame (SOF) 相位估計
+#include "WiimoteIr.h"
+#include "esp_timer.h"
+#include "esp_cpu.h"          // esp_cpu_get_cycle_count()
+#include "soc/usb_struct.h"   // USB OTG 暫存器 (frame number)
 #include <WiFi.h>
 #include <WebServer.h>
 #include <DNSServer.h>
+#include <Preferences.h>
+#include <atomic>
 
 // --- Serial2 設定 ---
 #define TX2_PIN 17
 #define RX2_PIN 18
 
+// Serial2 可接受的最高速率 (可在 platformio.ini 以 -DLINK_MAX_BAUD=... 覆寫)
+#ifndef LINK_MAX_BAUD
+#define LINK_MAX_BAUD 5000000
+#endif
+
+// --- Serial2 接收模式 ---
+#define INPUT_RX_POLLING 0   // 舊設計: 在 loop() 中於網頁伺服器之後輪詢
+#define INPUT_RX_EVENT   1   // UART 接收回呼 + 高優先權輸入任務，與網頁伺服器完全分離
+#ifndef INPUT_RX_MODE
+#define INPUT_RX_MODE INPUT_RX_EVENT
+#endif
+#define INPUT_TASK_PRIORITY  (configMAX_PRIORITIES - 2)
+#define INPUT_TASK_CORE      1      // 與 loop() 同核心，但優先權較高會直接搶占
+#define UART_RX_FIFO_FULL    16     // RX FIFO 到達此數量就觸發回呼
+#define UART_RX_TIMEOUT_SYM  1      // 或線路閒置 1 個字元時間就觸發回呼
+
+// --- USB 控制器類型 ---
+#define USB_BACKEND_HORIPAD         0   // HORIPAD 相容手把 (單向，沒有握手)
+#define USB_BACKEND_PRO_CONTROLLER  1   // 原廠 Pro 控制器: 握手、0x30 完整報告、玩家燈號、震動、IMU
+#ifndef USB_BACKEND
+#define USB_BACKEND USB_BACKEND_HORIPAD
+#endif
+// USB 手把數量: 1 = HORIPAD 相容 (Switch 只接受這種)；2..4 = 同一個 HID 介面上以 report ID 區分的多個手把 (PC)
+// 手把 0 走完整的映射流程，其餘手把的狀態由 S1 以 LINK_MSG_PAD_STATE 送來
+#ifndef USB_GAMEPADS
+#define USB_GAMEPADS 1
+#endif
+#if USB_GAMEPADS < 1 || USB_GAMEPADS > NSGAMEPAD_MAX_PADS
+#error "USB_GAMEPADS must be 1..NSGAMEPAD_MAX_PADS"
+#endif
+#if USB_GAMEPADS > 1 && USB_BACKEND == USB_BACKEND_PRO_CONTROLLER
+#error "USB_BACKEND_PRO_CONTROLLER supports a single pad"
+#endif
+
+// HORIPAD 閒置時重送報告的間隔 (ms，0: 只在變化時送出)
+#ifndef USB_KEEPALIVE_MS
+#define USB_KEEPALIVE_MS NSGAMEPAD_KEEPALIVE_MS
+#endif
+
+// --- USB 報告的產生時機 (可在網頁 /usb?schedule= 切換，比較兩者的「輪詢時資料年齡」) ---
+#define USB_SCHEDULE_ASAP  0   // 1ms 計時器的相位任意 (原本的行為)
+#define USB_SCHEDULE_SOF   1   // 1ms 計時器對齊主機的 USB frame，在輪詢前 USB_SOF_LEAD_US 產生報告
+#ifndef USB_SCHEDULE
+#define USB_SCHEDULE USB_SCHEDULE_ASAP
+#endif
+#define USB_SOF_LEAD_US       150   // 喚醒輸入任務 + 映射 + 交給端點所需的時間
+
 // --- WiFi 熱點設定 ---
 const char* ap_ssid = "WiimoteController";
 const char* ap_password = "12345678";
 
 // --- 建立 Switch Gamepad 物件 ---
+// 兩種類型的設定介面相同 (NSButtons 位元、hat、8 位元軸)，映射流程不需要知道是哪一種
+#if USB_BACKEND == USB_BACKEND_PRO_CONTROLLER
+ProControllerGamepad Gamepad;
+#elif USB_GAMEPADS == 1
 NSGamepad Gamepad;
+#else
+// 多個手把各自有 report ID，建構順序就是描述元中的順序
+NSGamepad Gamepad(1);
+NSGamepad Gamepad2(2);
+#if USB_GAMEPADS > 2
+NSGamepad Gamepad3(3);
+#endif
+#if USB_GAMEPADS > 3
+NSGamepad Gamepad4(4);
+#endif
+#endif
 
 // --- 建立網頁伺服器物件 ---
 WebServer server(80);
@@ -40,17 +128,312 @@ WebServer server(80);
 DNSServer dnsServer;
 const byte DNS_PORT = 53;
 
-// --- 方向鍵模式設定 ---
-bool directionalButtonMode = true;  // true: 方向鍵作為數位按鈕, false: 方向鍵作為左類比搖桿
+// --- S1 <-> S3 連線 (Serial2 上的訊框傳輸與解析) ---
+UartLinkTransport linkTransport(Serial2);
 
-// --- 按鈕映射配置表 ---
-struct ButtonMapping {
-    uint16_t wiimoteButton;
-    uint8_t nsButton;
+void sendLinkFrame(uint8_t type, const void* payload, uint8_t len) {
+    linkTransport.writeFrame(type, payload, len);
+}
+
+void setLinkBaud(uint32_t baud) {
+    linkTransport.setBaud(baud);
+    Serial.printf("Serial2 baud -> %lu\n", (unsigned long)baud);
+}
+
+LinkBaudNegotiator baudNegotiator(LINK_BAUD_RESPONDER, { sendLinkFrame, setLinkBaud });
+
+// --- 事件驅動接收 ---
+SpscRing<1024> uartRxRing;
+TaskHandle_t inputTaskHandle = NULL;
+volatile uint32_t uartErrorCount = 0;
+std::atomic<uint32_t> rxEventUs(0);   // 第一個未處理的接收回呼的時間 (0: 沒有)
+
+// 輸入延遲統計，兩種模式量的是同一件事: 接收回呼看到一批資料 -> 其中完整的訊框解析處理完成
+// 輪詢模式也註冊接收回呼，但回呼只記錄時間，資料留給 loop() 讀取
+struct InputTimingStats {
+    uint32_t count;
+    uint64_t sumUs;
+    uint32_t maxUs;
+};
+InputTimingStats inputTiming = {0, 0, 0};
+portMUX_TYPE inputTimingMux = portMUX_INITIALIZER_UNLOCKED;  // 網頁伺服器讀取時取得一致的快照
+
+void recordInputDelay(uint32_t delayUs) {
+    portENTER_CRITICAL(&inputTimingMux);
+    inputTiming.count++;
+    inputTiming.sumUs += delayUs;
+    if (delayUs > inputTiming.maxUs) {
+        inputTiming.maxUs = delayUs;
+    }
+    portEXIT_CRITICAL(&inputTimingMux);
+}
+
+// 按鈕轉換 (translateDirection + translateButtons) 的 CPU 週期數，確認查表在實機上的耗時
+struct TranslateCycleStats {
+    uint32_t count;
+    uint64_t sumCycles;
+    uint32_t minCycles;
+    uint32_t maxCycles;
+};
+TranslateCycleStats translateCycles = {0, 0, UINT32_MAX, 0};
+
+void recordTranslateCycles(uint32_t cycles) {
+    translateCycles.count++;
+    translateCycles.sumCycles += cycles;
+    if (cycles < translateCycles.minCycles) {
+        translateCycles.minCycles = cycles;
+    }
+    if (cycles > translateCycles.maxCycles) {
+        translateCycles.maxCycles = cycles;
+    }
+}
+
+// --- 端到端延遲量測 ---
+#define CLOCK_SYNC_INTERVAL_MS   500    // 時間同步請求間隔
+#define LATENCY_REPORT_MS        10000  // 序列埠延遲摘要間隔
+#define LATENCY_PENDING          16     // 報告還在 USB 佇列中的帶時間戳記狀態 (大於 NSGAMEPAD_QUEUE)
+
+ClockSync clockSync;
+uint32_t lastClockSyncMs = 0;
+
+// 各階段: S1 內部 (HCI 抵達 -> UART 送出)、連線 (S1 送出 -> S3 解析完成)、
+// S3 內部 (解析完成 -> USB 報告送出)、總計 (HCI 抵達 -> USB 報告送出)
+enum LatencyStage {
+    LATENCY_S1 = 0,
+    LATENCY_LINK,
+    LATENCY_S3,
+    LATENCY_TOTAL,
+    LATENCY_STAGE_COUNT
+};
+const char* const latencyStageNames[LATENCY_STAGE_COUNT] = { "s1", "link", "s3", "total" };
+LatencyHistogram latencyHist[LATENCY_STAGE_COUNT];
+
+// 帶時間戳記的狀態以 tag 跟著報告進入 USB 佇列，報告真正交給端點時才記錄延遲
+struct PendingLatency {
+    uint32_t tag;            // 0: 空
+    uint32_t reportTimeUs;   // S1 時鐘
+    uint32_t reportAgeUs;
+    uint32_t rxUs;           // 訊框解析完成時間 (S3)
 };
+PendingLatency pendingLatency[LATENCY_PENDING];
+uint32_t nextLatencyTag = 1;
+uint32_t reportTag = 0;      // 下一次 writeGamepadFrame() 的報告帶的 tag (0: 不記錄)
+#if USB_BACKEND == USB_BACKEND_PRO_CONTROLLER
+uint32_t unsentLatencyTag = 0;  // Pro 控制器尚未送出的最舊 tag
+#endif
+
+// --- USB frame 相位與輪詢時的資料年齡 ---
+// usbFramePhase / usbFrameTimer 只在計時器回呼中取樣 (輪詢模式則在 loop())，其他地方只讀發布的值
+UsbFramePhase usbFramePhase;
+UsbFrameTimer usbFrameTimer;
+volatile uint32_t usbSofUs = 0;
+volatile bool usbSofLocked = false;
+volatile uint32_t usbSofUncertaintyUs = USB_FRAME_US;
+volatile uint8_t usbSchedule = USB_SCHEDULE;
+volatile bool pollAgeResetPending = false;
+uint32_t reportDataUs = 0;        // 目前 USB 報告內容的產生時間
+uint32_t submittedReports = 0;
+// 報告內容產生 -> 主機輪詢 (下一個 SOF) 的時間，依產生時的模式分開統計
+const char* const usbScheduleNames[] = { "asap", "sof" };
+LatencyHistogram pollAgeHist[2];
+
+/**
+ * 記錄一筆帶時間戳記的狀態從 Wiimote 到 USB 的延遲
+ * @param submitUs USB 報告交給端點的時間 (S3)
+ */
+void recordLatency(const PendingLatency& state, uint32_t submitUs) {
+    latencyHist[LATENCY_S1].record(state.reportAgeUs);
+    latencyHist[LATENCY_S3].record(submitUs - state.rxUs);
+    if (!clockSync.valid()) {
+        return;  // 尚未同步時，跨晶片的階段沒有意義
+    }
+    uint32_t reportLocalUs = clockSync.toLocal(state.reportTimeUs);
+    int32_t linkUs = (int32_t)(state.rxUs - (reportLocalUs + state.reportAgeUs));
+    int32_t totalUs = (int32_t)(submitUs - reportLocalUs);
+    // 時鐘差估計誤差可能讓很短的連線延遲變成負值
+    latencyHist[LATENCY_LINK].record(linkUs > 0 ? (uint32_t)linkUs : 0);
+    latencyHist[LATENCY_TOTAL].record(totalUs > 0 ? (uint32_t)totalUs : 0);
+}
+
+/**
+ * 為一筆帶時間戳記的狀態配置 tag，讓延遲在報告送出時才記錄
+ * @param rxUs 訊框解析完成時間 (S3)
+ */
+uint32_t latencyTag(const WiimoteState& state, uint32_t rxUs) {
+    uint32_t tag = nextLatencyTag++;
+    if (nextLatencyTag == 0) {
+        nextLatencyTag = 1;
+    }
+    PendingLatency& pending = pendingLatency[tag % LATENCY_PENDING];
+    pending.tag = tag;
+    pending.reportTimeUs = state.reportTimeUs;
+    pending.reportAgeUs = state.reportAgeUs;
+    pending.rxUs = rxUs;
+    return tag;
+}
+
+/**
+ * 帶 tag 的報告已交給 USB 端點 (在輸入任務中呼叫)；等太久已被新 tag 覆蓋的不記錄
+ */
+void latencySubmitted(uint32_t tag) {
+    PendingLatency& pending = pendingLatency[tag % LATENCY_PENDING];
+    if (pending.tag != tag) {
+        return;
+    }
+    pending.tag = 0;
+    recordLatency(pending, (uint32_t)esp_timer_get_time());
+}
+
+#if USB_BACKEND == USB_BACKEND_PRO_CONTROLLER
+/**
+ * Pro 控制器的報告一律帶最新狀態: 之後送出的任何報告都包含尚未送出的 tag
+ * @param sent 是否送出了報告
+ */
+void latencyReportSent(bool sent) {
+    if (sent && unsentLatencyTag != 0) {
+        latencySubmitted(unsentLatencyTag);
+        unsentLatencyTag = 0;
+    }
+}
+#endif
+
+/**
+ * 定期送出時間同步請求 (速率協商期間暫停)
+ */
+void clockSyncTask() {
+    uint32_t nowMs = millis();
+    if (baudNegotiator.negotiating() || nowMs - lastClockSyncMs < CLOCK_SYNC_INTERVAL_MS) {
+        return;
+    }
+    lastClockSyncMs = nowMs;
+    LinkTimeSyncPayload req;
+    clockSync.makeRequest(req, (uint32_t)esp_timer_get_time());
+    sendLinkFrame(LINK_MSG_TIME_REQ, &req, sizeof(req));
+}
+
+void printLatencySummary() {
+    Serial.printf("Latency (us) offset=%ld rtt=%lu\n", (long)clockSync.offsetUs(), (unsigned long)clockSync.rttUs());
+    for (uint8_t i = 0; i < LATENCY_STAGE_COUNT; i++) {
+        const LatencyHistogram& h = latencyHist[i];
+        Serial.printf("  %-5s n=%lu min=%lu mean=%lu p99=%lu max=%lu\n", latencyStageNames[i],
+                      (unsigned long)h.count(), (unsigned long)h.min(), (unsigned long)h.mean(),
+                      (unsigned long)h.percentile(990), (unsigned long)h.max());
+    }
+    Serial.printf("USB poll age (us) schedule=%s locked=%d +/-%lu\n", usbScheduleNames[usbSchedule],
+                  usbSofLocked ? 1 : 0, (unsigned long)(usbSofUncertaintyUs / 2));
+    for (uint8_t i = 0; i < 2; i++) {
+        const LatencyHistogram& h = pollAgeHist[i];
+        Serial.printf("  %-5s n=%lu min=%lu mean=%lu p50=%lu p99=%lu max=%lu\n", usbScheduleNames[i],
+                      (unsigned long)h.count(), (unsigned long)h.min(), (unsigned long)h.mean(),
+                      (unsigned long)h.percentile(500), (unsigned long)h.percentile(990), (unsigned long)h.max());
+    }
+    if (translateCycles.count > 0) {
+        Serial.printf("Translate (cycles) n=%lu min=%lu avg=%lu max=%lu\n", (unsigned long)translateCycles.count,
+                      (unsigned long)translateCycles.minCycles,
+                      (unsigned long)(translateCycles.sumCycles / translateCycles.count),
+                      (unsigned long)translateCycles.maxCycles);
+    }
+}
+
+// --- 從 S1 收到的完整 Wiimote 狀態 ---
+WiimoteState wiimoteState;
+uint32_t stateDecodeErrors = 0;
+uint32_t appliedButtons = 0;   // 上一次送到 USB 的按鈕集合 (wiimoteButtonSet 格式)
+uint32_t edgeReplays = 0;      // 補送中間狀態的次數
+
+// --- S3 -> S1 命令通道 ---
+// 網頁伺服器只更新下列期望值，命令佇列只在輸入任務中存取
+#define REPORTING_RESUBMIT_MS 200   // 等待 S1 以狀態旗標回報新的回報模式
+
+volatile bool accelReporting = false;  // 只在動作映射需要時才開啟，節省藍牙頻寬與 S1 CPU
+volatile bool motionReporting = false; // 作用中的設定檔使用體感傾斜或 Wiimote 手勢 (切換設定檔時更新)
+volatile uint8_t irReporting = 0;      // 作用中的設定檔使用紅外線指標時為鏡頭靈敏度，0: 不使用
+volatile bool usbImuReporting = false;  // Switch 開啟了 Pro 控制器的 IMU (只在 USB_BACKEND_PRO_CONTROLLER)
+volatile uint8_t desiredLEDs = 0x01;
+volatile bool desiredRumble = false;
 
-// 可編輯的按鈕映射表
-const ButtonMapping buttonMappings[] = {
+uint8_t submittedLEDs = 0x01;          // S1 預設亮 LED1
+bool submittedRumble = false;
+uint32_t lastReportingSubmitMs = 0;
+uint8_t submittedIrSensitivity = 0;
+uint8_t lastCommandStatus = LINK_CMD_OK;
+
+/**
+ * 命令執行結果 (在輸入任務中呼叫)
+ */
+void onCommandResult(uint8_t cmd, uint8_t status) {
+    lastCommandStatus = status;
+    if (status == LINK_CMD_OK) {
+        return;
+    }
+    switch (cmd) {
+        case LINK_CMD_SET_LEDS:
+            submittedLEDs = 0xFF;  // 強制下次重送
+            break;
+        case LINK_CMD_SET_RUMBLE:
+            // Wiimote 未連線時不重試，直接回到關閉
+            desiredRumble = false;
+            submittedRumble = false;
+            break;
+        default:
+            break;
+    }
+}
+
+LinkCommandSender commandSender({ sendLinkFrame, onCommandResult });
+
+/**
+ * 比對期望值並送出命令 (速率協商期間暫停)
+ */
+void commandTask() {
+    if (baudNegotiator.negotiating()) {
+        return;
+    }
+    uint32_t nowMs = millis();
+
+    uint8_t leds = desiredLEDs;
+    if (leds != submittedLEDs && commandSender.submit(LINK_CMD_SET_LEDS, &leds, sizeof(leds))) {
+        submittedLEDs = leds;
+    }
+
+    bool rumble = desiredRumble;
+    if (rumble != submittedRumble) {
+        uint8_t on = rumble ? 1 : 0;
+        if (commandSender.submit(LINK_CMD_SET_RUMBLE, &on, sizeof(on))) {
+            submittedRumble = rumble;
+        }
+    }
+
+    // 回報模式以 S1 回報的旗標為準，S1 重新開機後也會自動恢復
+    // 作用中的設定檔使用體感時一定要開啟加速度計，使用紅外線指標時一定要開啟鏡頭
+    // (鏡頭初始化需要數個來回，旗標出現前每 REPORTING_RESUBMIT_MS 重送一次，S1 端重複的要求不會重新初始化)
+    bool connected = (wiimoteState.flags & WIIMOTE_FLAG_CONNECTED) != 0;
+    bool accelActive = (wiimoteState.flags & WIIMOTE_FLAG_ACCEL) != 0;
+    bool accelWanted = accelReporting || motionReporting || usbImuReporting;
+    bool irActive = (wiimoteState.flags & WIIMOTE_FLAG_IR) != 0;
+    uint8_t irSensitivity = irReporting;
+    bool irWanted = irSensitivity != 0;
+    bool mismatch = accelActive != accelWanted || irActive != irWanted ||
+                    (irWanted && irSensitivity != submittedIrSensitivity);
+    if (connected && mismatch &&
+        !commandSender.pending(LINK_CMD_SET_REPORTING) &&
+        nowMs - lastReportingSubmitMs >= REPORTING_RESUBMIT_MS) {
+        uint8_t args[2] = {
+            (uint8_t)((accelWanted ? LINK_REPORT_ACCEL : 0) | (irWanted ? LINK_REPORT_IR : 0)),
+            irWanted ? irSensitivity : (uint8_t)WIIMOTE_IR_SENSITIVITY_DEFAULT
+        };
+        if (commandSender.submit(LINK_CMD_SET_REPORTING, args, sizeof(args))) {
+            lastReportingSubmitMs = nowMs;
+            submittedIrSensitivity = args[1];
+        }
+    }
+
+    commandSender.task(nowMs);
+}
+
+// --- 按鈕映射配置表 ---
+// 內建映射表: 「Sideways」設定檔的預設值，開機時也直接使用它在編譯期產生的查表
+constexpr ButtonMapping buttonMappings[] = {
     // 主要按鈕映射
     {BUTTON_TWO,   NSButton_A},
     {BUTTON_ONE,   NSButton_B},
@@ -67,30 +450,370 @@ const ButtonMapping buttonMappings[] = {
     {BUTTON_C,     NSButton_Y}
 };
 
-// 方向鍵到數位按鈕的映射配置(已廢棄，保留供參考)
-const ButtonMapping directionalButtonMappings[] = {
-    {BUTTON_UP,    NSButton_Y},     
-    {BUTTON_DOWN,  NSButton_B},
-    {BUTTON_LEFT,  NSButton_X},
-    {BUTTON_RIGHT, NSButton_A}
+// 直握搭配 Nunchuk 的預設映射
+constexpr ButtonMapping nunchukButtonMappings[] = {
+    {BUTTON_A,     NSButton_A},
+    {BUTTON_B,     NSButton_B},
+    {BUTTON_ONE,   NSButton_X},
+    {BUTTON_TWO,   NSButton_Y},
+    {BUTTON_PLUS,  NSButton_Plus},
+    {BUTTON_MINUS, NSButton_Minus},
+    {BUTTON_HOME,  NSButton_Home},
+    {BUTTON_C,     NSButton_LeftTrigger},
+    {BUTTON_Z,     NSButton_LeftThrottle}
+};
+
+static_assert(directionMappingValid(MAPPING_HOLD_DIRECTIONS[MAPPING_HOLD_SIDEWAYS]) &&
+              directionMappingValid(MAPPING_HOLD_DIRECTIONS[MAPPING_HOLD_UPRIGHT]),
+              "direction buttons must be in the low nibble");
+static_assert(BUTTON_HAT_UP_LEFT == NSGAMEPAD_DPAD_UP_LEFT && BUTTON_HAT_CENTERED == NSGAMEPAD_DPAD_CENTERED,
+              "hat values must match switch_ESP32");
+static_assert(NSButton_Capture == MAPPING_NS_BUTTON_COUNT - 1, "NS button names must match switch_ESP32");
+
+// 載入設定檔之前使用的查表 (編譯期產生，放在快閃記憶體)
+constexpr CompiledProfile builtinProfile = {
+    { makeButtonTranslation(buttonMappings, MAPPING_HOLD_DIRECTIONS[MAPPING_HOLD_SIDEWAYS], DIRECTION_TARGET_DPAD),
+      makeButtonTranslation(buttonMappings, MAPPING_HOLD_DIRECTIONS[MAPPING_HOLD_SIDEWAYS], DIRECTION_TARGET_DPAD) },
+    0,
+    MAPPING_STICK_NONE,
+    { 0 },
+    DIRECTION_TARGET_DPAD,
+    SOCD_MODE_NEUTRAL,
+    { { 0 }, 0, 0, 0, STICK_Q15_ONE },  // 十字鍵模式不使用
+    MAPPING_STICK_NONE,
+    { 1, 0, 1, 1, 0, MOTION_G_ONE },    // 體感關閉時不使用
+    MAPPING_STICK_NONE,
+    WIIMOTE_IR_SENSITIVITY_DEFAULT,
+    { 1, 1, 0, WIIMOTE_IR_WIDTH / 2 * IR_POINTER_SUBPIXEL },  // 紅外線指標關閉時不使用
+    { 0 },                              // 不使用體感手勢
+    false,
+    { 0, 0 },
+    MAPPING_HOLD_DIRECTIONS[MAPPING_HOLD_SIDEWAYS]
+};
+
+// --- 映射設定檔 ---
+// profiles[] 只在網頁伺服器 (loop) 中存取；輸入任務只透過 compiledProfiles 讀取編譯好的查表
+#define PROFILE_SWAP_TIMEOUT_MS  50   // 等待輸入任務放下舊查表的上限 (輸入任務至少每 10ms 醒來一次)
+#define PROFILE_STORE_VERSION    7
+
+MappingProfile profiles[MAPPING_PROFILE_MAX];
+uint8_t activeProfileIndex = 0;
+DoubleBuffer<CompiledProfile> compiledProfiles(&builtinProfile);
+Preferences profileStore;
+
+const char* const directionTargetNames[DIRECTION_TARGET_COUNT] = { "方向鍵 (D-Pad)", "左類比搖桿", "右類比搖桿" };
+const char* const stickTargetNames[MAPPING_STICK_COUNT] = { "不使用", "左類比搖桿", "右類比搖桿" };
+const char* const holdNames[MAPPING_HOLD_COUNT] = { "橫握", "直握" };
+const char* const socdModeNames[SOCD_MODE_COUNT] = { "置中", "後按優先", "先按優先", "上優先" };
+
+void loadDefaultProfiles() {
+    const size_t count = sizeof(buttonMappings) / sizeof(buttonMappings[0]);
+    const size_t nunchukCount = sizeof(nunchukButtonMappings) / sizeof(nunchukButtonMappings[0]);
+    mappingProfileFromTable(profiles[0], "Sideways", buttonMappings, count,
+                            MAPPING_HOLD_SIDEWAYS, DIRECTION_TARGET_DPAD, MAPPING_STICK_NONE);
+    mappingProfileFromTable(profiles[1], "Sideways Stick", buttonMappings, count,
+                            MAPPING_HOLD_SIDEWAYS, DIRECTION_TARGET_LEFT_STICK, MAPPING_STICK_NONE);
+    profiles[1].rampUpMs = 120;
+    profiles[1].rampDownMs = 60;
+    profiles[1].rampCurve = STICK_CURVE_EASE_IN;
+    mappingProfileFromTable(profiles[2], "Nunchuk", nunchukButtonMappings, nunchukCount,
+                            MAPPING_HOLD_UPRIGHT, DIRECTION_TARGET_DPAD, MAPPING_STICK_LEFT);
+    mappingProfileFromTable(profiles[3], "Custom", buttonMappings, count,
+                            MAPPING_HOLD_SIDEWAYS, DIRECTION_TARGET_DPAD, MAPPING_STICK_NONE);
+    activeProfileIndex = 0;
+}
+
+void loadProfiles() {
+    loadDefaultProfiles();
+    if (profileStore.begin("mapping", true)) {
+        if (profileStore.getUChar("version", 0) == PROFILE_STORE_VERSION &&
+            profileStore.getBytesLength("profiles") == sizeof(profiles)) {
+            profileStore.getBytes("profiles", profiles, sizeof(profiles));
+            activeProfileIndex = profileStore.getUChar("active", 0);
+        }
+        profileStore.end();
+    }
+    for (uint8_t i = 0; i < MAPPING_PROFILE_MAX; i++) {
+        mappingProfileSanitize(profiles[i]);
+    }
+    if (activeProfileIndex >= MAPPING_PROFILE_MAX) {
+        activeProfileIndex = 0;
+    }
+}
+
+/**
+ * 將設定檔寫入 NVS
+ * 寫入快閃記憶體時 cache 會暫停，輸入會停頓數毫秒，所以只在使用者按下儲存時才寫
+ */
+void saveProfiles() {
+    if (!profileStore.begin("mapping", false)) {
+        return;
+    }
+    profileStore.putUChar("version", PROFILE_STORE_VERSION);
+    profileStore.putUChar("active", activeProfileIndex);
+    profileStore.putBytes("profiles", profiles, sizeof(profiles));
+    profileStore.end();
+}
+
+/**
+ * 編譯作用中的設定檔並切換給輸入任務
+ * 編譯在呼叫端 (網頁伺服器) 完成，輸入任務只會在下一個封包讀到新指標，不會被阻塞
+ * @return false: 輸入任務仍在使用上次換下的查表，逾時未切換
+ */
+bool activateProfile() {
+#if INPUT_RX_MODE == INPUT_RX_POLLING
+    // 輪詢模式的讀取端也在 loop() 中，呼叫到這裡時不可能持有舊指標；
+    // 不先標記的話，同一次 loop() 的第二次切換會在這裡等自己直到逾時
+    compiledProfiles.readerQuiescent();
+#endif
+    CompiledProfile* buf;
+    uint32_t startMs = millis();
+    while ((buf = compiledProfiles.beginWrite()) == NULL) {
+        if (millis() - startMs >= PROFILE_SWAP_TIMEOUT_MS) {
+            return false;
+        }
+        delay(1);
+    }
+    mappingProfileCompile(profiles[activeProfileIndex], *buf);
+    compiledProfiles.publish(buf);
+    motionReporting = buf->motionTarget != MAPPING_STICK_NONE || buf->wiimoteGestures;
+    irReporting = buf->irTarget != MAPPING_STICK_NONE ? buf->irSensitivity : 0;
+    Serial.printf("映射設定檔: %s\n", profiles[activeProfileIndex].name);
+    return true;
+}
+
+// --- 連發與巨集 ---
+// 巨集在觸發組合全部按下的瞬間開始，依序輸出各步驟，執行期間忽略玩家的按鈕與十字鍵
+constexpr MacroStep pairMacroSteps[] = {
+    // 「請同時按下 L+R」配對畫面: L+R 然後 A
+    { (1 << NSButton_LeftTrigger) | (1 << NSButton_RightTrigger), BUTTON_HAT_CENTERED, 100 },
+    { 0, BUTTON_HAT_CENTERED, 100 },
+    { 1 << NSButton_A, BUTTON_HAT_CENTERED, 100 },
 };
 
-// 注意：方向鍵到搖桿的映射現在使用8方向邏輯，不再需要映射表
-// 舊的 DirectionalMapping 結構已被新的8方向邏輯取代
+constexpr MacroDef macros[] = {
+    { BUTTON_PLUS | BUTTON_MINUS, pairMacroSteps, sizeof(pairMacroSteps) / sizeof(pairMacroSteps[0]) },
+};
+
+// 連發頻率選項 (Hz)
+const uint8_t turboRates[] = { 0, 5, 10, 15, 20, 30 };
+const char* const turboRateNames[] = { "關", "5", "10", "15", "20", "30" };
+const uint8_t turboRateCount = sizeof(turboRates) / sizeof(turboRates[0]);
+
+const char* const rampCurveNames[STICK_CURVE_COUNT] = { "線性", "慢起步", "快起步", "S 曲線" };
+const char* const motionInvertNames[] = { "不反向", "X 反向", "Y 反向", "X、Y 反向" };
+const char* const irSensitivityNames[] = { "1 (最低)", "2", "3", "4", "5 (最高)" };
+
+// --- 每個 USB frame 的推進 (搖桿漸進、連發、巨集) ---
+#define FRAME_TICK_US MACRO_TICK_US
 
-// 取得映射表大小
-const size_t buttonMappingsCount = sizeof(buttonMappings) / sizeof(buttonMappings[0]);
-const size_t directionalButtonMappingsCount = sizeof(directionalButtonMappings) / sizeof(directionalButtonMappings[0]);
-// 注意：directionalMappingsCount 已移除，現在使用8方向邏輯
+// 只在輸入任務中存取；計時器回呼只讀 frameTickNeeded
+MacroEngine macroEngine;
+StickRamp stickRamp;
+SocdResolver socdResolver;
+GamepadFrame mappedFrame = { 0, BUTTON_HAT_CENTERED, 128, 128, 128, 128 };  // 最近一次的映射結果
+uint32_t mappedButtons = 0;     // 最近一次映射的 Wiimote 按鈕 (wiimoteButtonSet 格式)
+esp_timer_handle_t frameTimer = NULL;
+volatile bool frameTickNeeded = false;
+uint32_t frameWriteFailures = 0;
+
+// --- Nunchuk 搖桿校正 ---
+// nunchukStick 只在輸入任務中更新；網頁的變更透過 pending 設定與旗標交給輸入任務套用
+#define NUNCHUK_STORE_VERSION  1
+#define NUNCHUK_SAVE_IDLE_MS   5000   // 校正改變後，搖桿與按鈕都靜止這麼久才自動寫入 NVS
+
+NunchukStick nunchukStick;
+Preferences nunchukStore;
+bool nunchukPresent = false;                        // 輸入任務: 上一個封包是否有 Nunchuk
+NunchukSettings pendingNunchukSettings;
+std::atomic<bool> nunchukSettingsPending(false);    // 網頁寫入 pending 後設為 true，輸入任務套用後清除
+volatile bool nunchukRecalRequested = false;
+volatile bool nunchukCalDirty = false;              // 校正值改變，尚未寫入
+volatile uint32_t nunchukActiveMs = 0;              // 最後一次搖桿離開中心或有按鈕按下
+
+// --- 體感 (加速度計傾斜) ---
+// 只在輸入任務中更新；校正值由 S1 讀取 Wiimote EEPROM 後送來，收到前使用典型值
+MotionTilt motionTilt;
+WiimoteAccelCalibration accelCalibration;
+bool accelCalibrationReceived = false;
+uint32_t motionSamples = 0;
+
+// --- 紅外線指標 ---
+// 只在輸入任務中更新；S1 在點座標改變時送來 LINK_MSG_IR
+IrPointer irPointer;
+WiimoteIrState irState;
+uint32_t irUpdates = 0;
+
+// --- 體感手勢 ---
+// 只在輸入任務中更新；[MAPPING_GESTURE_WIIMOTE] 使用 Wiimote 的校正值，[MAPPING_GESTURE_NUNCHUK] 使用典型值
+GestureDetector gestureDetectors[2];
+
+// --- 組合鍵切換 ---
+// chordSwitch 只在輸入任務中存取；觸發的動作經 chordActions 交給 loop() 套用 (設定檔只在 loop() 中編譯)
+#define CHORD_LED_MS        1500   // 切換後 LED 顯示確認燈號的時間
+#define CHORD_LED_DPAD      0x09   // 外側兩顆: 方向鍵模式
+#define CHORD_LED_STICK     0x06   // 內側兩顆: 搖桿模式
+
+ChordSwitch chordSwitch;
+SpscRing<8> chordActions;
+uint32_t chordCount = 0;
+bool chordLedShowing = false;          // loop(): 正在顯示確認燈號
+uint8_t chordLedPrevious = 0;          // 確認燈號結束後恢復的 LED
+uint8_t chordLedPattern = 0;
+uint32_t chordLedMs = 0;
+
+// --- 其他手把 (USB_GAMEPADS > 1) ---
+// 只在輸入任務中存取。映射使用作用中設定檔的按鈕、方向 (含相反方向處理) 與 Nunchuk 搖桿；
+// 連發、巨集、搖桿加速、體感、紅外線與組合鍵只作用在手把 0
+#if USB_GAMEPADS > 1
+struct ExtraPad {
+    NSGamepad* gamepad;
+    WiimoteState state;
+    SocdResolver socd;
+    NunchukStick stick;
+    bool nunchukPresent;
+    uint32_t appliedButtons;   // wiimoteButtonSet 格式
+    uint32_t updates;          // 收到的狀態封包
+};
+ExtraPad extraPads[USB_GAMEPADS - 1];
+#endif
+uint32_t padStatesDropped = 0;   // 手把編號超出 USB_GAMEPADS 的 LINK_MSG_PAD_STATE
+
+/**
+ * 從 NVS 讀取 Nunchuk 校正值與死區設定 (在輸入任務啟動前呼叫)
+ */
+void loadNunchukCalibration() {
+    NunchukCalibration cal;
+    NunchukSettings settings;
+    nunchukCalibrationDefault(cal);
+    nunchukSettingsDefault(settings);
+    if (nunchukStore.begin("nunchuk", true)) {
+        if (nunchukStore.getUChar("version", 0) == NUNCHUK_STORE_VERSION &&
+            nunchukStore.getBytesLength("cal") == sizeof(cal) &&
+            nunchukStore.getBytesLength("settings") == sizeof(settings)) {
+            nunchukStore.getBytes("cal", &cal, sizeof(cal));
+            nunchukStore.getBytes("settings", &settings, sizeof(settings));
+        }
+        nunchukStore.end();
+    }
+    nunchukStick.begin(cal, settings);
+    pendingNunchukSettings = nunchukStick.settings();
+}
+
+/**
+ * 將 Nunchuk 校正值與死區設定寫入 NVS (在網頁伺服器中呼叫)
+ * 校正值由輸入任務更新，這裡複製時可能剛好碰上擴大範圍；最差只是存下較小的範圍，之後會再學到
+ */
+void saveNunchukCalibration() {
+    NunchukCalibration cal = nunchukStick.calibration();
+    nunchukCalDirty = false;
+    if (!nunchukStore.begin("nunchuk", false)) {
+        return;
+    }
+    nunchukStore.putUChar("version", NUNCHUK_STORE_VERSION);
+    nunchukStore.putBytes("cal", &cal, sizeof(cal));
+    nunchukStore.putBytes("settings", &pendingNunchukSettings, sizeof(pendingNunchukSettings));
+    nunchukStore.end();
+    Serial.printf("Nunchuk 校正已儲存: 中心 (%u, %u) X %u~%u Y %u~%u\n", cal.centerX, cal.centerY,
+                  cal.minX, cal.maxX, cal.minY, cal.maxY);
+}
+
+/**
+ * 校正值改變後，等玩家停止操作才自動寫入 (寫入快閃記憶體時輸入會停頓數毫秒)
+ */
+void nunchukSaveTask() {
+    if (nunchukCalDirty && millis() - nunchukActiveMs >= NUNCHUK_SAVE_IDLE_MS) {
+        saveNunchukCalibration();
+    }
+}
+
+/**
+ * 套用組合鍵觸發的動作 (在 loop() 中呼叫，與網頁切換相同，不寫入快閃記憶體)
+ * 切換後以 LED 顯示確認: 設定檔 -> 第 N 顆，方向鍵模式 -> 外側兩顆，搖桿模式 -> 內側兩顆
+ */
+void chordTask() {
+    uint8_t action;
+    while (chordActions.pop(&action, 1) == 1) {
+        uint8_t leds;
+        switch (action) {
+            case CHORD_ACTION_PROFILE_NEXT:
+            case CHORD_ACTION_PROFILE_PREV:
+                activeProfileIndex = (uint8_t)((activeProfileIndex +
+                                                (action == CHORD_ACTION_PROFILE_NEXT ? 1 : MAPPING_PROFILE_MAX - 1)) %
+                                               MAPPING_PROFILE_MAX);
+                leds = (uint8_t)(1 << activeProfileIndex);
+                break;
+            case CHORD_ACTION_MODE_DPAD:
+                profiles[activeProfileIndex].dPadTarget = DIRECTION_TARGET_DPAD;
+                leds = CHORD_LED_DPAD;
+                break;
+            case CHORD_ACTION_MODE_STICK:
+                profiles[activeProfileIndex].dPadTarget = DIRECTION_TARGET_LEFT_STICK;
+                leds = CHORD_LED_STICK;
+                break;
+            default:
+                continue;
+        }
+        if (!activateProfile()) {
+            Serial.println("組合鍵切換逾時");
+            continue;
+        }
+        chordCount++;
+        if (!chordLedShowing) {
+            chordLedPrevious = desiredLEDs;
+            chordLedShowing = true;
+        }
+        chordLedPattern = leds;
+        chordLedMs = millis();
+        desiredLEDs = leds;
+    }
+    // 顯示期間網頁改了 LED 就不恢復
+    if (chordLedShowing && millis() - chordLedMs >= CHORD_LED_MS) {
+        chordLedShowing = false;
+        if (desiredLEDs == chordLedPattern) {
+            desiredLEDs = chordLedPrevious;
+        }
+    }
+}
 
 // 函式宣告
 bool captivePortal();
 bool isIp(String str);
 void handleRoot();
 void handleSetMode();
+void handleProfile();
+void handleProfiles();
+void handleNunchuk();
 void handleStatus();
+void handleWiimote();
+void handleUsb();
 void handleNotFound();
 void handleCaptivePortal();
+void onSerial2Receive();
+void onSerial2ReceiveError(hardwareSerial_error_t error);
+void inputTask(void* arg);
+void onFrameTimer(void* arg);
+void onUsbOutput();
+
+/**
+ * 產生設定檔編輯用的下拉選單
+ * @param allowNone 是否加入「無」選項 (值為 255)
+ * @param values 各選項的值；NULL 表示使用索引
+ */
+String profileSelect(const String& name, uint8_t value, const char* const* labels, uint8_t count, bool allowNone,
+                     const uint8_t* values = NULL) {
+    String html = "<select name=\"" + name + "\">";
+    if (allowNone) {
+        html += "<option value=\"255\"" + String(value == 0xFF ? " selected" : "") + ">無</option>";
+    }
+    for (uint8_t i = 0; i < count; i++) {
+        uint8_t v = values ? values[i] : i;
+        html += "<option value=\"" + String(v) + "\"" + String(value == v ? " selected" : "") + ">";
+        html += String(labels[i]) + "</option>";
+    }
+    html += "</select>";
+    return html;
+}
 
 /**
  * 處理根路徑請求 - 顯示設定頁面
@@ -118,17 +841,111 @@ void handleRoot() {
     html += "<div class=\"container\">";
     html += "<h1>🎮 Wiimote 控制器設定</h1>";
     
-    html += "<div class=\"status " + String(directionalButtonMode ? "dpad-mode" : "analog-mode") + "\">";
-    html += "<h2>目前模式: " + String(directionalButtonMode ? "方向鍵 (D-Pad)" : "左類比搖桿") + "</h2>";
-    html += "<p>" + String(directionalButtonMode ? 
-        "Wiimote 的方向鍵會對應到 Switch 的數位方向鍵" : 
-        "Wiimote 的方向鍵會對應到 Switch 的左類比搖桿") + "</p>";
+    const MappingProfile& profile = profiles[activeProfileIndex];
+    bool dPadMode = profile.dPadTarget == DIRECTION_TARGET_DPAD;
+    html += "<div class=\"status " + String(dPadMode ? "dpad-mode" : "analog-mode") + "\">";
+    html += "<h2>目前模式: " + String(directionTargetNames[profile.dPadTarget]) + "</h2>";
+    html += "<p>Wiimote 的方向鍵會對應到 Switch 的" + String(directionTargetNames[profile.dPadTarget]) + "</p>";
     html += "</div>";
     
     html += "<h3>變更控制模式:</h3>";
     html += "<button class=\"button\" onclick=\"setMode('dpad')\">設為方向鍵模式</button>";
     html += "<button class=\"button\" onclick=\"setMode('analog')\">設為類比搖桿模式</button>";
+
+    html += "<h3>映射設定檔:</h3><p>";
+    for (uint8_t i = 0; i < MAPPING_PROFILE_MAX; i++) {
+        html += "<button class=\"button\"" + String(i == activeProfileIndex ? " style=\"background-color:#28a745\"" : "");
+        html += " onclick=\"profile('select=" + String(i) + "')\">" + String(profiles[i].name) + "</button>";
+    }
+    html += "</p>";
+    html += "<form onsubmit=\"return editProfile(this)\">";
+    html += "<input type=\"hidden\" name=\"index\" value=\"" + String(activeProfileIndex) + "\">";
+    html += "<p>名稱: <input name=\"name\" maxlength=\"15\" value=\"" + String(profile.name) + "\"></p>";
+    html += "<table><tr><th>Wiimote</th><th>Switch</th><th>按住修飾鍵時</th><th>連發 (Hz)</th></tr>";
+    for (uint8_t i = 0; i < MAPPING_SLOT_COUNT; i++) {
+        html += "<tr><td>" + String(MAPPING_SLOTS[i].label) + "</td><td>";
+        html += profileSelect(String("map_") + MAPPING_SLOTS[i].key, profile.buttons[i],
+                              MAPPING_NS_BUTTON_NAMES, MAPPING_NS_BUTTON_COUNT, true);
+        html += "</td><td>";
+        html += profileSelect(String("shift_") + MAPPING_SLOTS[i].key, profile.shiftButtons[i],
+                              MAPPING_NS_BUTTON_NAMES, MAPPING_NS_BUTTON_COUNT, true);
+        html += "</td><td>";
+        html += profileSelect(String("turbo_") + MAPPING_SLOTS[i].key, profile.turboHz[i],
+                              turboRateNames, turboRateCount, false, turboRates);
+        html += "</td></tr>";
+    }
+    html += "</table>";
+    const char* slotLabels[MAPPING_SLOT_COUNT];
+    for (uint8_t i = 0; i < MAPPING_SLOT_COUNT; i++) {
+        slotLabels[i] = MAPPING_SLOTS[i].label;
+    }
+    html += "<p>修飾鍵: " + profileSelect("modifier", profile.modifierSlot, slotLabels, MAPPING_SLOT_COUNT, true) + "</p>";
+    html += "<p>握法: " + profileSelect("hold", profile.hold, holdNames, MAPPING_HOLD_COUNT, false) + "</p>";
+    html += "<p>方向鍵: " + profileSelect("dpad", profile.dPadTarget, directionTargetNames, DIRECTION_TARGET_COUNT, false) + "</p>";
+    html += "<p>相反方向同時按下: " + profileSelect("socd", profile.socdMode, socdModeNames, SOCD_MODE_COUNT, false) + "</p>";
+    html += "<p>Nunchuk 搖桿: " + profileSelect("stick", profile.stickTarget, stickTargetNames, MAPPING_STICK_COUNT, false) + "</p>";
+    html += "<p>方向鍵搖桿加速 (ms): <input type=\"number\" name=\"rampUp\" min=\"0\" max=\"" + String(MAPPING_RAMP_MAX_MS) + "\" value=\"" + String(profile.rampUpMs) + "\">";
+    html += " 回中心 (ms): <input type=\"number\" name=\"rampDown\" min=\"0\" max=\"" + String(MAPPING_RAMP_MAX_MS) + "\" value=\"" + String(profile.rampDownMs) + "\"></p>";
+    html += "<p>加速曲線: " + profileSelect("curve", profile.rampCurve, rampCurveNames, STICK_CURVE_COUNT, false) + "</p>";
+    html += "<p>慢走鍵: " + profileSelect("walk", profile.walkSlot, slotLabels, MAPPING_SLOT_COUNT, true);
+    html += " 幅度 (%): <input type=\"number\" name=\"walkPercent\" min=\"1\" max=\"100\" value=\"" + String(profile.walkPercent) + "\"></p>";
+    html += "<p>體感傾斜: " + profileSelect("motion", profile.motionTarget, stickTargetNames, MAPPING_STICK_COUNT, false);
+    html += " " + profileSelect("motionInvert", profile.motionInvert, motionInvertNames, 4, false) + "</p>";
+    html += "<p>滿刻度角度: <input type=\"number\" name=\"motionRange\" min=\"" + String(MOTION_RANGE_MIN_DEG) + "\" max=\"" + String(MOTION_RANGE_MAX_DEG) + "\" value=\"" + String(profile.motionRangeDeg) + "\">";
+    html += " 死區角度: <input type=\"number\" name=\"motionDeadzone\" min=\"0\" max=\"45\" value=\"" + String(profile.motionDeadzoneDeg) + "\"></p>";
+    html += "<p>紅外線指標: " + profileSelect("ir", profile.irTarget, stickTargetNames, MAPPING_STICK_COUNT, false);
+    html += " " + profileSelect("irInvert", profile.irInvert, motionInvertNames, 4, false);
+    html += " 靈敏度: <select name=\"irSensitivity\">";
+    for (uint8_t i = WIIMOTE_IR_SENSITIVITY_MIN; i <= WIIMOTE_IR_SENSITIVITY_MAX; i++) {
+        html += "<option value=\"" + String(i) + "\"" + String(i == profile.irSensitivity ? " selected" : "") + ">";
+        html += String(irSensitivityNames[i - 1]) + "</option>";
+    }
+    html += "</select></p>";
+    html += "<p>指標滿刻度 (%): <input type=\"number\" name=\"irRange\" min=\"" + String(IR_POINTER_RANGE_MIN) + "\" max=\"" + String(IR_POINTER_RANGE_MAX) + "\" value=\"" + String(profile.irRangePercent) + "\">";
+    html += " 死區 (%): <input type=\"number\" name=\"irDeadzone\" min=\"0\" max=\"50\" value=\"" + String(profile.irDeadzonePercent) + "\"></p>";
+    html += "<p>體感手勢:";
+    for (uint8_t i = 0; i < MAPPING_GESTURE_COUNT; i++) {
+        html += " " + String(MAPPING_GESTURES[i].label) + " ";
+        html += profileSelect(String("gesture_") + MAPPING_GESTURES[i].key, profile.gestureButtons[i],
+                              MAPPING_NS_BUTTON_NAMES, MAPPING_NS_BUTTON_COUNT, true);
+    }
+    html += "</p>";
+    html += "<p>搖晃門檻 (0.1g): <input type=\"number\" name=\"shake\" min=\"" + String(GESTURE_THRESHOLD_MIN) + "\" max=\"" + String(GESTURE_THRESHOLD_MAX) + "\" value=\"" + String(profile.shakeTenths) + "\">";
+    html += " 揮動門檻 (0.1g): <input type=\"number\" name=\"swing\" min=\"" + String(GESTURE_THRESHOLD_MIN) + "\" max=\"" + String(GESTURE_THRESHOLD_MAX) + "\" value=\"" + String(profile.swingTenths) + "\"></p>";
+    html += "<button class=\"button\" type=\"submit\">套用</button>";
+    html += "</form>";
+    html += "<button class=\"button\" onclick=\"profile('save=1')\">儲存到快閃記憶體</button>";
+    html += "<button class=\"button\" onclick=\"profile('reset=1')\">還原預設設定檔</button>";
     
+    const NunchukCalibration& cal = nunchukStick.calibration();
+    const NunchukSettings& nunchuk = pendingNunchukSettings;
+    html += "<h3>Nunchuk 搖桿:</h3>";
+    html += "<p>中心: (" + String(cal.centerX) + ", " + String(cal.centerY) + ")";
+    html += " X: " + String(cal.minX) + "~" + String(cal.maxX) + " Y: " + String(cal.minY) + "~" + String(cal.maxY);
+    html += String(nunchukCalDirty ? " (未儲存)" : "") + "</p>";
+    html += "<p><small>插上 Nunchuk 時請勿碰觸搖桿 (自動取中心)；轉幾圈搖桿即可學到完整範圍</small></p>";
+    html += "<form onsubmit=\"return editNunchuk(this)\">";
+    html += "<p>軸向死區 (%): <input type=\"number\" name=\"axial\" min=\"0\" max=\"50\" value=\"" + String(nunchuk.axialDeadzone) + "\">";
+    html += " 中心死區 (%): <input type=\"number\" name=\"radial\" min=\"0\" max=\"50\" value=\"" + String(nunchuk.radialDeadzone) + "\"></p>";
+    html += "<p>反死區 (%): <input type=\"number\" name=\"anti\" min=\"0\" max=\"90\" value=\"" + String(nunchuk.antiDeadzone) + "\">";
+    html += " 外圈範圍 (%): <input type=\"number\" name=\"outer\" min=\"50\" max=\"100\" value=\"" + String(nunchuk.outerRange) + "\"></p>";
+    html += "<button class=\"button\" type=\"submit\">套用</button>";
+    html += "</form>";
+    html += "<button class=\"button\" onclick=\"nunchuk('recal=1')\">重新校正</button>";
+    html += "<button class=\"button\" onclick=\"nunchuk('save=1')\">儲存校正</button>";
+
+    html += "<h3>Wiimote 輸出:</h3>";
+    html += "<p>加速度計回報: " + String(accelReporting ? "開啟" : "關閉") + "</p>";
+    html += "<button class=\"button\" onclick=\"wiimote('accel=" + String(accelReporting ? "0" : "1") + "')\">";
+    html += String(accelReporting ? "關閉加速度計" : "開啟加速度計") + "</button>";
+    html += "<button class=\"button\" onclick=\"wiimote('rumble=" + String(desiredRumble ? "0" : "1") + "')\">";
+    html += String(desiredRumble ? "停止震動" : "測試震動") + "</button>";
+    html += "<p>玩家燈號: ";
+    for (uint8_t i = 0; i < 4; i++) {
+        html += "<button class=\"button\" onclick=\"wiimote('leds=" + String(1 << i) + "')\">P" + String(i + 1) + "</button>";
+    }
+    html += "</p>";
+
     html += "<div class=\"info\">";
     html += "<h3>📖 模式說明:</h3>";
     html += "<p><strong>方向鍵模式:</strong> Wiimote 的上下左右按鈕會對應到 Switch 的數位方向鍵 (D-Pad)</p>";
@@ -151,6 +968,31 @@ void handleRoot() {
     html += ".then(data => { alert(data); location.reload(); })";
     html += ".catch(error => { alert('設定失敗: ' + error); });";
     html += "}";
+    html += "function profile(arg) {";
+    html += "fetch('/profile?' + arg)";
+    html += ".then(response => response.text())";
+    html += ".then(data => { if (data != 'OK') alert(data); location.reload(); })";
+    html += ".catch(error => { alert('設定失敗: ' + error); });";
+    html += "}";
+    html += "function editProfile(form) {";
+    html += "profile(new URLSearchParams(new FormData(form)).toString());";
+    html += "return false;";
+    html += "}";
+    html += "function nunchuk(arg) {";
+    html += "fetch('/nunchuk?' + arg)";
+    html += ".then(response => response.text())";
+    html += ".then(data => { if (data != 'OK') alert(data); location.reload(); })";
+    html += ".catch(error => { alert('設定失敗: ' + error); });";
+    html += "}";
+    html += "function editNunchuk(form) {";
+    html += "nunchuk(new URLSearchParams(new FormData(form)).toString());";
+    html += "return false;";
+    html += "}";
+    html += "function wiimote(arg) {";
+    html += "fetch('/wiimote?' + arg)";
+    html += ".then(() => location.reload())";
+    html += ".catch(error => { alert('設定失敗: ' + error); });";
+    html += "}";
     html += "</script>";
     html += "</body></html>";
     
@@ -163,30 +1005,490 @@ void handleRoot() {
 void handleSetMode() {
     if (server.hasArg("mode")) {
         String mode = server.arg("mode");
+        // 修改作用中設定檔的方向鍵輸出
+        uint8_t target;
         if (mode == "dpad") {
-            directionalButtonMode = true;
+            target = DIRECTION_TARGET_DPAD;
+        } else if (mode == "analog") {
+            target = DIRECTION_TARGET_LEFT_STICK;
+        } else {
+            server.send(400, "text/plain", "無效的模式參數");
+            return;
+        }
+        profiles[activeProfileIndex].dPadTarget = target;
+        if (!activateProfile()) {
+            server.send(503, "text/plain", "切換逾時，請再試一次");
+            return;
+        }
+        if (target == DIRECTION_TARGET_DPAD) {
             server.send(200, "text/plain", "已切換至方向鍵模式！");
             Serial.println("模式已切換: 方向鍵 (D-Pad)");
-        } else if (mode == "analog") {
-            directionalButtonMode = false;
+        } else {
             server.send(200, "text/plain", "已切換至類比搖桿模式！");
             Serial.println("模式已切換: 左類比搖桿");
-        } else {
-            server.send(400, "text/plain", "無效的模式參數");
         }
     } else {
         server.send(400, "text/plain", "缺少模式參數");
     }
 }
 
+// 讀取 0~255 的表單參數，負數或超出範圍視為 255 (無)
+uint8_t profileArg(const String& name, uint8_t fallback) {
+    if (!server.hasArg(name)) {
+        return fallback;
+    }
+    long v = server.arg(name).toInt();
+    return (v < 0 || v > 0xFF) ? 0xFF : (uint8_t)v;
+}
+
+// 讀取毫秒數的表單參數，超出範圍由 mappingProfileSanitize() 修正
+uint16_t profileArgMs(const String& name, uint16_t fallback) {
+    if (!server.hasArg(name)) {
+        return fallback;
+    }
+    long v = server.arg(name).toInt();
+    return v < 0 ? 0 : (v > 0xFFFF ? 0xFFFF : (uint16_t)v);
+}
+
+/**
+ * 處理映射設定檔請求:
+ *   /profile?select=i                切換作用中的設定檔
+ *   /profile?index=i&name=..&map_a=.. 編輯設定檔 (欄位見設定頁面的表單)
+ *   /profile?reset=1                 還原所有預設設定檔
+ *   /profile?save=1                  寫入快閃記憶體 (可與上述參數一起使用)
+ */
+void handleProfile() {
+    bool changed = false;
+    if (server.hasArg("reset")) {
+        loadDefaultProfiles();
+        changed = true;
+    }
+    if (server.hasArg("select")) {
+        long i = server.arg("select").toInt();
+        if (i < 0 || i >= MAPPING_PROFILE_MAX) {
+            server.send(400, "text/plain", "無效的設定檔編號");
+            return;
+        }
+        activeProfileIndex = (uint8_t)i;
+        changed = true;
+    }
+    if (server.hasArg("index")) {
+        long i = server.arg("index").toInt();
+        if (i < 0 || i >= MAPPING_PROFILE_MAX) {
+            server.send(400, "text/plain", "無效的設定檔編號");
+            return;
+        }
+        MappingProfile edited = profiles[i];
+        if (server.hasArg("name") && server.arg("name").length() > 0) {
+            mappingProfileSetName(edited, server.arg("name").c_str());
+        }
+        for (uint8_t s = 0; s < MAPPING_SLOT_COUNT; s++) {
+            edited.buttons[s] = profileArg(String("map_") + MAPPING_SLOTS[s].key, edited.buttons[s]);
+            edited.shiftButtons[s] = profileArg(String("shift_") + MAPPING_SLOTS[s].key, edited.shiftButtons[s]);
+            edited.turboHz[s] = profileArg(String("turbo_") + MAPPING_SLOTS[s].key, edited.turboHz[s]);
+        }
+        edited.modifierSlot = profileArg("modifier", edited.modifierSlot);
+        edited.hold = profileArg("hold", edited.hold);
+        edited.dPadTarget = profileArg("dpad", edited.dPadTarget);
+        edited.socdMode = profileArg("socd", edited.socdMode);
+        edited.stickTarget = profileArg("stick", edited.stickTarget);
+        edited.rampUpMs = profileArgMs("rampUp", edited.rampUpMs);
+        edited.rampDownMs = profileArgMs("rampDown", edited.rampDownMs);
+        edited.rampCurve = profileArg("curve", edited.rampCurve);
+        edited.walkSlot = profileArg("walk", edited.walkSlot);
+        edited.walkPercent = profileArg("walkPercent", edited.walkPercent);
+        edited.motionTarget = profileArg("motion", edited.motionTarget);
+        edited.motionInvert = profileArg("motionInvert", edited.motionInvert);
+        edited.motionRangeDeg = profileArg("motionRange", edited.motionRangeDeg);
+        edited.motionDeadzoneDeg = profileArg("motionDeadzone", edited.motionDeadzoneDeg);
+        edited.irTarget = profileArg("ir", edited.irTarget);
+        edited.irInvert = profileArg("irInvert", edited.irInvert);
+        edited.irSensitivity = profileArg("irSensitivity", edited.irSensitivity);
+        edited.irRangePercent = profileArg("irRange", edited.irRangePercent);
+        edited.irDeadzonePercent = profileArg("irDeadzone", edited.irDeadzonePercent);
+        for (uint8_t g = 0; g < MAPPING_GESTURE_COUNT; g++) {
+            edited.gestureButtons[g] = profileArg(String("gesture_") + MAPPING_GESTURES[g].key, edited.gestureButtons[g]);
+        }
+        edited.shakeTenths = profileArg("shake", edited.shakeTenths);
+        edited.swingTenths = profileArg("swing", edited.swingTenths);
+        mappingProfileSanitize(edited);
+        profiles[i] = edited;
+        changed = changed || i == activeProfileIndex;
+    }
+    if (!changed && !server.hasArg("save") && !server.hasArg("index")) {
+        server.send(400, "text/plain", "缺少參數");
+        return;
+    }
+    if (changed && !activateProfile()) {
+        server.send(503, "text/plain", "切換逾時，請再試一次");
+        return;
+    }
+    if (server.hasArg("save")) {
+        saveProfiles();
+    }
+    server.send(200, "text/plain", "OK");
+}
+
+/**
+ * 以 JSON 列出所有設定檔
+ */
+void handleProfiles() {
+    String json = "{\"active\":" + String(activeProfileIndex) + ",\"profiles\":[";
+    for (uint8_t i = 0; i < MAPPING_PROFILE_MAX; i++) {
+        const MappingProfile& p = profiles[i];
+        if (i > 0) {
+            json += ",";
+        }
+        json += "{\"name\":\"" + String(p.name) + "\",";
+        json += "\"buttons\":{";
+        for (uint8_t s = 0; s < MAPPING_SLOT_COUNT; s++) {
+            json += String(s ? "," : "") + "\"" + MAPPING_SLOTS[s].key + "\":" + String(p.buttons[s]);
+        }
+        json += "},\"shiftButtons\":{";
+        for (uint8_t s = 0; s < MAPPING_SLOT_COUNT; s++) {
+            json += String(s ? "," : "") + "\"" + MAPPING_SLOTS[s].key + "\":" + String(p.shiftButtons[s]);
+        }
+        json += "},\"turboHz\":{";
+        for (uint8_t s = 0; s < MAPPING_SLOT_COUNT; s++) {
+            json += String(s ? "," : "") + "\"" + MAPPING_SLOTS[s].key + "\":" + String(p.turboHz[s]);
+        }
+        json += "},";
+        json += "\"modifier\":" + String(p.modifierSlot) + ",";
+        json += "\"hold\":" + String(p.hold) + ",";
+        json += "\"dpad\":" + String(p.dPadTarget) + ",";
+        json += "\"socd\":" + String(p.socdMode) + ",";
+        json += "\"stick\":" + String(p.stickTarget) + ",";
+        json += "\"rampUpMs\":" + String(p.rampUpMs) + ",";
+        json += "\"rampDownMs\":" + String(p.rampDownMs) + ",";
+        json += "\"curve\":" + String(p.rampCurve) + ",";
+        json += "\"walk\":" + String(p.walkSlot) + ",";
+        json += "\"walkPercent\":" + String(p.walkPercent) + ",";
+        json += "\"motion\":" + String(p.motionTarget) + ",";
+        json += "\"motionInvert\":" + String(p.motionInvert) + ",";
+        json += "\"motionRangeDeg\":" + String(p.motionRangeDeg) + ",";
+        json += "\"motionDeadzoneDeg\":" + String(p.motionDeadzoneDeg) + ",";
+        json += "\"ir\":" + String(p.irTarget) + ",";
+        json += "\"irInvert\":" + String(p.irInvert) + ",";
+        json += "\"irSensitivity\":" + String(p.irSensitivity) + ",";
+        json += "\"irRangePercent\":" + String(p.irRangePercent) + ",";
+        json += "\"irDeadzonePercent\":" + String(p.irDeadzonePercent) + ",";
+        json += "\"gestures\":{";
+        for (uint8_t g = 0; g < MAPPING_GESTURE_COUNT; g++) {
+            json += String(g ? "," : "") + "\"" + MAPPING_GESTURES[g].key + "\":" + String(p.gestureButtons[g]);
+        }
+        json += "},";
+        json += "\"shakeTenths\":" + String(p.shakeTenths) + ",";
+        json += "\"swingTenths\":" + String(p.swingTenths) + "}";
+    }
+    json += "]}";
+    server.send(200, "application/json", json);
+}
+
+/**
+ * 處理 Nunchuk 搖桿設定請求:
+ *   /nunchuk?axial=..&radial=..&anti=..&outer=..  死區設定 (百分比)
+ *   /nunchuk?recal=1                               清除學到的範圍並重新取中心
+ *   /nunchuk?save=1                                立即寫入快閃記憶體 (可與上述參數一起使用)
+ */
+void handleNunchuk() {
+    bool handled = false;
+    if (server.hasArg("axial") || server.hasArg("radial") || server.hasArg("anti") || server.hasArg("outer")) {
+        // 輸入任務還沒套用上一次的設定時稍等，避免覆寫正在複製的內容
+        uint32_t startMs = millis();
+        while (nunchukSettingsPending.load()) {
+            if (millis() - startMs >= PROFILE_SWAP_TIMEOUT_MS) {
+                server.send(503, "text/plain", "套用逾時，請再試一次");
+                return;
+            }
+            delay(1);
+        }
+        NunchukSettings settings = pendingNunchukSettings;
+        settings.axialDeadzone = profileArg("axial", settings.axialDeadzone);
+        settings.radialDeadzone = profileArg("radial", settings.radialDeadzone);
+        settings.antiDeadzone = profileArg("anti", settings.antiDeadzone);
+        settings.outerRange = profileArg("outer", settings.outerRange);
+        NunchukCalibration cal = nunchukStick.calibration();
+        nunchukSanitize(cal, settings);
+        pendingNunchukSettings = settings;
+        nunchukSettingsPending.store(true);
+        nunchukCalDirty = true;
+        handled = true;
+    }
+    if (server.hasArg("recal")) {
+        nunchukRecalRequested = true;
+        handled = true;
+    }
+    if (server.hasArg("save")) {
+        saveNunchukCalibration();
+        handled = true;
+    }
+    if (handled) {
+        server.send(200, "text/plain", "OK");
+    } else {
+        server.send(400, "text/plain", "缺少參數");
+    }
+}
+
+/**
+ * 處理 Wiimote 輸出設定請求: /wiimote?accel=0|1&leds=0~15&rumble=0|1
+ * 命令由輸入任務送給 S1，這裡只更新期望值
+ */
+void handleWiimote() {
+    bool handled = false;
+    if (server.hasArg("accel")) {
+        accelReporting = server.arg("accel").toInt() != 0;
+        Serial.println(String("加速度計回報: ") + (accelReporting ? "開啟" : "關閉"));
+        handled = true;
+    }
+    if (server.hasArg("leds")) {
+        desiredLEDs = (uint8_t)(server.arg("leds").toInt() & 0x0F);
+        handled = true;
+    }
+    if (server.hasArg("rumble")) {
+        desiredRumble = server.arg("rumble").toInt() != 0;
+        handled = true;
+    }
+    if (handled) {
+        server.send(200, "text/plain", "OK");
+    } else {
+        server.send(400, "text/plain", "缺少參數");
+    }
+}
+
+/**
+ * 處理 USB 排程設定請求: /usb?schedule=0|1&reset=1
+ * schedule 0 = 計時器相位任意，1 = 對齊 USB SOF；reset 清除輪詢時資料年齡的統計
+ */
+void handleUsb() {
+    bool handled = false;
+    if (server.hasArg("schedule")) {
+        usbSchedule = server.arg("schedule").toInt() != 0 ? USB_SCHEDULE_SOF : USB_SCHEDULE_ASAP;
+        Serial.println(String("USB 報告排程: ") + usbScheduleNames[usbSchedule]);
+        handled = true;
+    }
+    if (server.hasArg("reset")) {
+        pollAgeResetPending = true;
+        handled = true;
+    }
+    if (handled) {
+        server.send(200, "text/plain", "OK");
+    } else {
+        server.send(400, "text/plain", "缺少參數");
+    }
+}
+
 /**
  * 處理狀態查詢請求
  */
 void handleStatus() {
     String json = "{";
-    json += "\"directionalButtonMode\":" + String(directionalButtonMode ? "true" : "false") + ",";
-    json += "\"mode\":\"" + String(directionalButtonMode ? "dpad" : "analog") + "\",";
-    json += "\"ip\":\"" + WiFi.softAPIP().toString() + "\"";
+    const MappingProfile& profile = profiles[activeProfileIndex];
+    static const char* const modeNames[DIRECTION_TARGET_COUNT] = { "dpad", "analog", "rightStick" };
+    json += "\"directionalButtonMode\":" + String(profile.dPadTarget == DIRECTION_TARGET_DPAD ? "true" : "false") + ",";
+    json += "\"mode\":\"" + String(modeNames[profile.dPadTarget]) + "\",";
+    json += "\"profile\":{\"active\":" + String(activeProfileIndex) + ",\"name\":\"" + String(profile.name) + "\",";
+    json += "\"swaps\":" + String(compiledProfiles.swaps()) + "},";
+    json += "\"chord\":{\"switches\":" + String(chordCount) + ",\"dropped\":" + String(chordActions.overruns()) + "},";
+#if USB_BACKEND == USB_BACKEND_PRO_CONTROLLER
+    const ProControllerStats& usb = Gamepad.stats();
+    json += "\"usb\":{\"backend\":\"pro\",";
+    json += "\"state\":" + String((int)Gamepad.state()) + ",";
+    json += "\"playerLights\":" + String(Gamepad.playerLights()) + ",";
+    json += "\"imu\":" + String(Gamepad.imuEnabled() ? "true" : "false") + ",";
+    json += "\"outputs\":" + String(usb.outputs) + ",";
+    json += "\"replies\":" + String(usb.replies) + ",";
+    json += "\"reports\":" + String(usb.fullReports) + ",";
+    json += "\"spiReads\":" + String(usb.spiReads) + ",";
+    json += "\"unknown\":" + String(usb.unknown) + ",";
+    json += "\"dropped\":" + String(usb.dropped) + ",";
+    json += "\"sendFailures\":" + String(Gamepad.sendFailures());
+    json += "},";
+#else
+    const NSGamepadStats& usb = Gamepad.stats();
+    json += "\"usb\":{\"backend\":\"horipad\",";
+    json += "\"submitted\":" + String(usb.submitted) + ",";
+    json += "\"keepalives\":" + String(usb.keepalives) + ",";
+    json += "\"queued\":" + String(usb.queued) + ",";
+    json += "\"coalesced\":" + String(usb.coalesced) + ",";
+    json += "\"dropped\":" + String(usb.dropped) + ",";
+    json += "\"failed\":" + String(usb.failed);
+#if USB_GAMEPADS > 1
+    json += ",\"extraPads\":[";
+    for (uint8_t i = 0; i < USB_GAMEPADS - 1; i++) {
+        const ExtraPad& pad = extraPads[i];
+        const NSGamepadStats& padUsb = pad.gamepad->stats();
+        json += String(i > 0 ? "," : "") + "{\"reportId\":" + String(pad.gamepad->reportId()) + ",";
+        json += "\"updates\":" + String(pad.updates) + ",";
+        json += "\"submitted\":" + String(padUsb.submitted) + ",";
+        json += "\"keepalives\":" + String(padUsb.keepalives) + ",";
+        json += "\"queued\":" + String(padUsb.queued) + ",";
+        json += "\"coalesced\":" + String(padUsb.coalesced) + ",";
+        json += "\"dropped\":" + String(padUsb.dropped) + "}";
+    }
+    json += "]";
+#endif
+    json += ",\"padStatesDropped\":" + String(padStatesDropped);
+    json += "},";
+#endif
+    json += "\"usbFrame\":{";
+    json += "\"schedule\":\"" + String(usbScheduleNames[usbSchedule]) + "\",";
+    json += "\"locked\":" + String(usbSofLocked ? "true" : "false") + ",";
+    json += "\"uncertaintyUs\":" + String(usbSofUncertaintyUs) + ",";
+    json += "\"resyncs\":" + String(usbFramePhase.resyncs());
+    for (uint8_t i = 0; i < 2; i++) {
+        const LatencyHistogram& h = pollAgeHist[i];
+        json += ",\"" + String(usbScheduleNames[i]) + "\":{";
+        json += "\"count\":" + String(h.count()) + ",";
+        json += "\"minUs\":" + String(h.min()) + ",";
+        json += "\"meanUs\":" + String(h.mean()) + ",";
+        json += "\"p50Us\":" + String(h.percentile(500)) + ",";
+        json += "\"p99Us\":" + String(h.percentile(990)) + ",";
+        json += "\"maxUs\":" + String(h.max());
+        json += "}";
+    }
+    json += "},";
+    json += "\"ip\":\"" + WiFi.softAPIP().toString() + "\",";
+
+    const LinkStats& link = linkTransport.rxStats();
+    json += "\"link\":{";
+    json += "\"framesOk\":" + String(link.framesOk) + ",";
+    json += "\"crcErrors\":" + String(link.crcErrors) + ",";
+    json += "\"lengthErrors\":" + String(link.lengthErrors) + ",";
+    json += "\"seqGaps\":" + String(link.seqGaps) + ",";
+    json += "\"droppedBytes\":" + String(link.droppedBytes) + ",";
+    json += "\"baud\":" + String(baudNegotiator.currentBaud()) + ",";
+    json += "\"baudFallbacks\":" + String(baudNegotiator.fallbackCount()) + ",";
+    json += "\"stateDecodeErrors\":" + String(stateDecodeErrors) + ",";
+    json += "\"edgeReplays\":" + String(edgeReplays);
+    json += "},";
+
+    json += "\"wiimote\":{";
+    json += "\"connected\":" + String((wiimoteState.flags & WIIMOTE_FLAG_CONNECTED) ? "true" : "false") + ",";
+    json += "\"nunchuk\":" + String((wiimoteState.flags & WIIMOTE_FLAG_NUNCHUK) ? "true" : "false") + ",";
+    json += "\"battery\":" + String(wiimoteState.battery) + ",";
+    json += "\"buttons\":" + String(wiimoteState.buttons) + ",";
+    json += "\"nunchukX\":" + String(wiimoteState.nunchukX) + ",";
+    json += "\"nunchukY\":" + String(wiimoteState.nunchukY) + ",";
+    const NunchukCalibration& cal = nunchukStick.calibration();
+    json += "\"nunchukStick\":{";
+    json += "\"x\":" + String(nunchukStick.x()) + ",";
+    json += "\"y\":" + String(nunchukStick.y()) + ",";
+    json += "\"center\":[" + String(cal.centerX) + "," + String(cal.centerY) + "],";
+    json += "\"rangeX\":[" + String(cal.minX) + "," + String(cal.maxX) + "],";
+    json += "\"rangeY\":[" + String(cal.minY) + "," + String(cal.maxY) + "],";
+    json += "\"calibrating\":" + String(nunchukStick.capturing() ? "true" : "false") + ",";
+    json += "\"unsaved\":" + String(nunchukCalDirty ? "true" : "false");
+    json += "},";
+    json += "\"accel\":[" + String(wiimoteState.accelX) + "," + String(wiimoteState.accelY) + "," + String(wiimoteState.accelZ) + "],";
+    json += "\"accelReporting\":" + String((wiimoteState.flags & WIIMOTE_FLAG_ACCEL) ? "true" : "false") + ",";
+    json += "\"accelRequested\":" + String(accelReporting ? "true" : "false") + ",";
+    json += "\"leds\":" + String(desiredLEDs) + ",";
+    json += "\"rumble\":" + String(desiredRumble ? "true" : "false");
+    json += "},";
+
+    json += "\"motion\":{";
+    json += "\"calibrated\":" + String(accelCalibrationReceived ? "true" : "false") + ",";
+    json += "\"zero\":[" + String(accelCalibration.zero[0]) + "," + String(accelCalibration.zero[1]) + "," + String(accelCalibration.zero[2]) + "],";
+    json += "\"gravity\":[" + String(accelCalibration.gravity[0]) + "," + String(accelCalibration.gravity[1]) + "," + String(accelCalibration.gravity[2]) + "],";
+    json += "\"samples\":" + String(motionSamples) + ",";
+    json += "\"steady\":" + String(motionTilt.steady() ? "true" : "false") + ",";
+    json += "\"x\":" + String(motionTilt.x()) + ",";
+    json += "\"y\":" + String(motionTilt.y());
+    json += "},";
+
+    json += "\"gestures\":[";
+    for (uint8_t i = 0; i < 2; i++) {
+        const GestureDetector& g = gestureDetectors[i];
+        json += String(i ? "," : "") + "{";
+        json += "\"source\":\"" + String(i == MAPPING_GESTURE_WIIMOTE ? "wiimote" : "nunchuk") + "\",";
+        json += "\"shake\":" + String((g.buttons() & GESTURE_SHAKE) ? "true" : "false") + ",";
+        json += "\"swing\":" + String((g.buttons() & GESTURE_SWING) ? "true" : "false") + ",";
+        json += "\"energy\":" + String(g.meanEnergy()) + ",";
+        json += "\"peak\":" + String(g.peak()) + ",";
+        json += "\"crossings\":" + String(g.crossingCount()) + ",";
+        json += "\"shakes\":" + String(g.shakeCount()) + ",";
+        json += "\"swings\":" + String(g.swingCount());
+        json += "}";
+    }
+    json += "],";
+
+    json += "\"ir\":{";
+    json += "\"ready\":" + String((wiimoteState.flags & WIIMOTE_FLAG_IR) ? "true" : "false") + ",";
+    json += "\"dots\":[";
+    for (uint8_t i = 0; i < WIIMOTE_IR_DOTS; i++) {
+        const WiimoteIrDot& d = irState.dots[i];
+        if (i > 0) {
+            json += ",";
+        }
+        if (d.x == WIIMOTE_IR_NO_DOT) {
+            json += "null";
+        } else {
+            json += "[" + String(d.x) + "," + String(d.y) + "," + String(d.size) + "]";
+        }
+    }
+    json += "],";
+    json += "\"updates\":" + String(irUpdates) + ",";
+    json += "\"tracking\":" + String(irPointer.tracking() ? "true" : "false") + ",";
+    json += "\"holding\":" + String(irPointer.holding() ? "true" : "false") + ",";
+    json += "\"point\":[" + String(irPointer.pointX() / IR_POINTER_SUBPIXEL) + "," + String(irPointer.pointY() / IR_POINTER_SUBPIXEL) + "],";
+    json += "\"x\":" + String(irPointer.x()) + ",";
+    json += "\"y\":" + String(irPointer.y());
+    json += "},";
+
+    const MacroStats& macro = macroEngine.stats();
+    json += "\"macro\":{";
+    json += "\"running\":" + String(macroEngine.macroRunning() ? "true" : "false") + ",";
+    json += "\"runs\":" + String(macro.macrosRun) + ",";
+    json += "\"frames\":" + String(macro.frames) + ",";
+    json += "\"lateFrames\":" + String(macro.lateFrames) + ",";
+    json += "\"maxLateUs\":" + String(macro.maxLateUs) + ",";
+    json += "\"writeFailures\":" + String(frameWriteFailures);
+    json += "},";
+
+    const LinkCommandStats& cmd = commandSender.stats();
+    json += "\"commands\":{";
+    json += "\"sent\":" + String(cmd.sent) + ",";
+    json += "\"acked\":" + String(cmd.acked) + ",";
+    json += "\"retries\":" + String(cmd.retries) + ",";
+    json += "\"failed\":" + String(cmd.failed) + ",";
+    json += "\"queued\":" + String(commandSender.queued()) + ",";
+    json += "\"lastStatus\":" + String(lastCommandStatus);
+    json += "},";
+
+    portENTER_CRITICAL(&inputTimingMux);
+    InputTimingStats input = inputTiming;
+    portEXIT_CRITICAL(&inputTimingMux);
+    json += "\"input\":{";
+    json += "\"mode\":\"" + String(INPUT_RX_MODE == INPUT_RX_EVENT ? "event" : "polling") + "\",";
+    json += "\"delaySamples\":" + String(input.count) + ",";
+    json += "\"delayAvgUs\":" + String(input.count ? (uint32_t)(input.sumUs / input.count) : 0) + ",";
+    json += "\"delayMaxUs\":" + String(input.maxUs) + ",";
+    json += "\"ringOverruns\":" + String(uartRxRing.overruns()) + ",";
+    json += "\"uartErrors\":" + String(uartErrorCount);
+    json += "},";
+
+    json += "\"translate\":{";
+    json += "\"count\":" + String(translateCycles.count) + ",";
+    json += "\"minCycles\":" + String(translateCycles.count ? translateCycles.minCycles : 0) + ",";
+    json += "\"avgCycles\":" + String(translateCycles.count ? (uint32_t)(translateCycles.sumCycles / translateCycles.count) : 0) + ",";
+    json += "\"maxCycles\":" + String(translateCycles.maxCycles);
+    json += "},";
+
+    json += "\"latency\":{";
+    json += "\"clockSynced\":" + String(clockSync.valid() ? "true" : "false") + ",";
+    json += "\"clockOffsetUs\":" + String(clockSync.offsetUs()) + ",";
+    json += "\"clockRttUs\":" + String(clockSync.rttUs());
+    for (uint8_t i = 0; i < LATENCY_STAGE_COUNT; i++) {
+        const LatencyHistogram& h = latencyHist[i];
+        json += ",\"" + String(latencyStageNames[i]) + "\":{";
+        json += "\"count\":" + String(h.count()) + ",";
+        json += "\"minUs\":" + String(h.min()) + ",";
+        json += "\"meanUs\":" + String(h.mean()) + ",";
+        json += "\"p99Us\":" + String(h.percentile(990)) + ",";
+        json += "\"maxUs\":" + String(h.max());
+        json += "}";
+    }
+    json += "}";
     json += "}";
     server.send(200, "application/json", json);
 }
@@ -248,115 +1550,40 @@ bool captivePortal() {
     return false;
 }
 
-/**
- * 處理方向鍵的 D-Pad 映射
- * @param buttons 按鈕狀態位元遮罩
- */
-void mapDirectionalButtonsToDPad(uint16_t buttons) {
-    // 根據按下的方向鍵組合設定 D-Pad
-    bool up = buttons & BUTTON_RIGHT;
-    bool down = buttons & BUTTON_LEFT;
-    bool left = buttons & BUTTON_UP;
-    bool right = buttons & BUTTON_DOWN;
-
-    // 使用 D-Pad 函式處理方向
-    Gamepad.dPad(up, down, left, right);
-}
-
-/**
- * 將 Wiimote 方向鍵映射到 NS 控制器的左搖桿
- * @param buttons 按鈕狀態位元遮罩
- */
-void mapDirectionalButtonsToAnalogStick(uint16_t buttons) {
-    // 預設搖桿在中心位置
-    uint8_t finalXAxis = 128;
-    uint8_t finalYAxis = 128;
-
-    // 檢查各個方向按鈕的狀態
-    bool up = buttons & BUTTON_RIGHT;
-    bool down = buttons & BUTTON_LEFT;
-    bool left = buttons & BUTTON_UP;
-    bool right = buttons & BUTTON_DOWN;
-
-    // 處理 8 方向映射
-    if (up && right) {
-        // 右上對角線 (Wiimote UP+RIGHT -> NS UP+RIGHT)
-        finalXAxis = 255;  // 右
-        finalYAxis = 0;    // 上
-    } else if (up && left) {
-        // 左上對角線 (Wiimote UP+LEFT -> NS UP+LEFT)
-        finalXAxis = 0;    // 左
-        finalYAxis = 0;    // 上
-    } else if (down && right) {
-        // 右下對角線 (Wiimote DOWN+RIGHT -> NS DOWN+RIGHT)
-        finalXAxis = 255;  // 右
-        finalYAxis = 255;  // 下
-    } else if (down && left) {
-        // 左下對角線 (Wiimote DOWN+LEFT -> NS DOWN+LEFT)
-        finalXAxis = 0;    // 左
-        finalYAxis = 255;  // 下
-    } else if (up) {
-        // 純上方向 (Wiimote UP -> NS UP)
-        finalXAxis = 128;  // 中心
-        finalYAxis = 0;    // 上
-    } else if (down) {
-        // 純下方向 (Wiimote DOWN -> NS DOWN)
-        finalXAxis = 128;  // 中心
-        finalYAxis = 255;  // 下
-    } else if (left) {
-        // 純左方向 (Wiimote LEFT -> NS LEFT)
-        finalXAxis = 0;    // 左
-        finalYAxis = 128;  // 中心
-    } else if (right) {
-        // 純右方向 (Wiimote RIGHT -> NS RIGHT)
-        finalXAxis = 255;  // 右
-        finalYAxis = 128;  // 中心
-    }
-    
-    // 處理相反方向同時按下的情況：維持中心點
-    if (up && down) {
-        finalYAxis = 128;  // Y軸回到中心
-    }
-    if (left && right) {
-        finalXAxis = 128;  // X軸回到中心
-    }
-
-    // 設定搖桿位置
-    Gamepad.leftXAxis(finalXAxis);
-    Gamepad.leftYAxis(finalYAxis);
-    Gamepad.rightXAxis(128); // 右搖桿保持中心
-    
-    // 除錯輸出（可選，用於測試）
-    if (buttons & (BUTTON_UP | BUTTON_DOWN | BUTTON_LEFT | BUTTON_RIGHT)) {
-        Serial.printf("8-Way Analog: U:%d D:%d L:%d R:%d -> X:%d Y:%d\n", 
-                     up, down, left, right, finalXAxis, finalYAxis);
-    }
-}
-
-/**
- * 將 Wiimote 按鈕映射到 NS 控制器按鈕
- * @param buttons 按鈕狀態位元遮罩
- */
-void mapWiimoteButtons(uint16_t buttons) {
-    // 清除所有按鈕
-    Gamepad.releaseAll();
-
-    // 根據映射表處理按鈕
-    for (size_t i = 0; i < buttonMappingsCount; i++) {
-        if (buttons & buttonMappings[i].wiimoteButton) {
-            Gamepad.press(buttonMappings[i].nsButton);
-        }
-    }
-
-    // 注意：移除了方向鍵的重複映射，方向鍵現在只透過 D-Pad 或搖桿處理
-}
-
 void setup() {
     // 開啟 USB 功能，這是模擬控制器的關鍵
     USB.begin(); 
     
     // 初始化 Gamepad
     Gamepad.begin();
+#if USB_BACKEND == USB_BACKEND_HORIPAD
+    Gamepad.keepalive(USB_KEEPALIVE_MS);
+    Gamepad.onSubmit(latencySubmitted);
+#endif
+#if USB_GAMEPADS > 1
+    NSGamepad* extraGamepads[] = {
+        &Gamepad2,
+#if USB_GAMEPADS > 2
+        &Gamepad3,
+#endif
+#if USB_GAMEPADS > 3
+        &Gamepad4,
+#endif
+    };
+    for (uint8_t i = 0; i < USB_GAMEPADS - 1; i++) {
+        ExtraPad& pad = extraPads[i];
+        pad.gamepad = extraGamepads[i];
+        pad.gamepad->begin();
+        pad.gamepad->keepalive(USB_KEEPALIVE_MS);
+        wiimoteStateReset(pad.state);
+        pad.nunchukPresent = false;
+        pad.appliedButtons = 0;
+        pad.updates = 0;
+    }
+#endif
+#if USB_BACKEND == USB_BACKEND_PRO_CONTROLLER && INPUT_RX_MODE == INPUT_RX_EVENT
+    Gamepad.onOutput(onUsbOutput);
+#endif
     
     // 初始化 Serial，用於除錯輸出 (可選，但建議保留)
     Serial.begin(115200);
@@ -364,6 +1591,42 @@ void setup() {
 
     // 初始化 Serial2，用於接收來自 S1 的資料
     Serial2.begin(115200, SERIAL_8N1, RX2_PIN, TX2_PIN);
+    baudNegotiator.begin(millis(), LINK_MAX_BAUD, linkTransport.rxStats());
+    wiimoteStateReset(wiimoteState);
+    wiimoteAccelCalibrationDefault(accelCalibration);
+    wiimoteIrReset(irState);
+    WiimoteAccelCalibration nunchukAccel;
+    wiimoteNunchukAccelCalibrationDefault(nunchukAccel);
+    gestureDetectors[MAPPING_GESTURE_NUNCHUK].setCalibration(nunchukAccel);
+    loadProfiles();
+    activateProfile();
+    loadNunchukCalibration();
+#if USB_GAMEPADS > 1
+    // 其他手把的 Nunchuk 不存校正值: 接上時擷取中心，範圍隨使用擴展
+    NunchukCalibration extraCal;
+    nunchukCalibrationDefault(extraCal);
+    for (uint8_t i = 0; i < USB_GAMEPADS - 1; i++) {
+        extraPads[i].stick.begin(extraCal, nunchukStick.settings());
+    }
+#endif
+    macroEngine.setMacros(macros, sizeof(macros) / sizeof(macros[0]));
+    Serial2.onReceiveError(onSerial2ReceiveError);
+#if INPUT_RX_MODE == INPUT_RX_EVENT
+    // 輸入任務先建立，接收回呼才有通知對象
+    xTaskCreatePinnedToCore(inputTask, "input", 4096, NULL, INPUT_TASK_PRIORITY, &inputTaskHandle, INPUT_TASK_CORE);
+#endif
+    // 兩種模式用同樣的接收回呼時機，輸入延遲統計才能互相比較
+    Serial2.setRxFIFOFull(UART_RX_FIFO_FULL);
+    Serial2.setRxTimeout(UART_RX_TIMEOUT_SYM);
+    Serial2.onReceive(onSerial2Receive);
+#if INPUT_RX_MODE == INPUT_RX_EVENT
+
+    esp_timer_create_args_t frameTimerArgs = {};
+    frameTimerArgs.callback = onFrameTimer;
+    frameTimerArgs.name = "frame";
+    esp_timer_create(&frameTimerArgs, &frameTimer);
+    esp_timer_start_once(frameTimer, FRAME_TICK_US);
+#endif
 
     // 設定 WiFi 熱點
     Serial.println("Setting up WiFi Access Point...");
@@ -383,7 +1646,12 @@ void setup() {
     // 設定網頁伺服器路由
     server.on("/", handleRoot);
     server.on("/setMode", handleSetMode);
+    server.on("/profile", handleProfile);
+    server.on("/profiles", handleProfiles);
+    server.on("/nunchuk", handleNunchuk);
     server.on("/status", handleStatus);
+    server.on("/wiimote", handleWiimote);
+    server.on("/usb", handleUsb);
     
     // 常見的強制門戶檢測端點
     server.on("/generate_204", handleCaptivePortal);         // Android
@@ -403,47 +1671,686 @@ void setup() {
     Serial.println("Ready. Connect to Switch and waiting for button data...");
 }
 
+/**
+ * 以目前的狀態更新 Nunchuk 搖桿 (每個狀態封包一次，在映射之前呼叫)
+ * 靜止時 S1 只送關鍵幀，所以不論這個封包是否帶有搖桿欄位都更新一次
+ */
+void updateNunchukStick(uint32_t buttons) {
+    if (nunchukSettingsPending.load()) {
+        nunchukStick.setSettings(pendingNunchukSettings);
+        nunchukSettingsPending.store(false);
+    }
+    if (nunchukRecalRequested) {
+        nunchukRecalRequested = false;
+        nunchukStick.recalibrate();
+    }
+    bool present = (wiimoteState.flags & WIIMOTE_FLAG_NUNCHUK) != 0;
+    if (present && !nunchukPresent) {
+        nunchukStick.onConnect();
+    }
+    nunchukPresent = present;
+    if (!present) {
+        return;
+    }
+    nunchukStick.update(wiimoteState.nunchukX, wiimoteState.nunchukY);
+    if (buttons != 0 || nunchukStick.x() != BUTTON_STICK_CENTER || nunchukStick.y() != BUTTON_STICK_CENTER) {
+        nunchukActiveMs = millis();
+    }
+    if (nunchukStick.takeDirty()) {
+        nunchukCalDirty = true;
+    }
+}
+
+/**
+ * 以狀態封包中的加速度更新體感濾波 (每個狀態封包一次，在映射之前呼叫)
+ */
+void updateMotionTilt(uint8_t fields) {
+    if (!(wiimoteState.flags & WIIMOTE_FLAG_ACCEL) || !(wiimoteState.flags & WIIMOTE_FLAG_CONNECTED)) {
+        motionTilt.reset();
+        return;
+    }
+    if (fields & STATE_FIELD_ACCEL) {
+        motionTilt.input(wiimoteState.accelX, wiimoteState.accelY, wiimoteState.accelZ,
+                         compiledProfiles.current()->motion, (uint32_t)esp_timer_get_time());
+        motionSamples++;
+    }
+}
+
+/**
+ * 以狀態封包中的加速度更新手勢偵測 (每個狀態封包一次，在映射之前呼叫)
+ * Wiimote 的加速度只在加速度計回報開啟時才有；Nunchuk 的加速度隨擴充資料一起送來
+ */
+void updateGestures(uint8_t fields) {
+    const CompiledProfile& profile = *compiledProfiles.current();
+    uint32_t nowUs = (uint32_t)esp_timer_get_time();
+    bool connected = (wiimoteState.flags & WIIMOTE_FLAG_CONNECTED) != 0;
+    GestureDetector& wiimote = gestureDetectors[MAPPING_GESTURE_WIIMOTE];
+    if (!connected || !(wiimoteState.flags & WIIMOTE_FLAG_ACCEL)) {
+        wiimote.reset();
+    } else if (fields & STATE_FIELD_ACCEL) {
+        wiimote.input(wiimoteState.accelX, wiimoteState.accelY, wiimoteState.accelZ, profile.gesture, nowUs);
+    }
+    GestureDetector& nunchuk = gestureDetectors[MAPPING_GESTURE_NUNCHUK];
+    if (!connected || !(wiimoteState.flags & WIIMOTE_FLAG_NUNCHUK)) {
+        nunchuk.reset();
+    } else if (fields & STATE_FIELD_NUNCHUK_ACCEL) {
+        nunchuk.input(wiimoteState.nunchukAccelX, wiimoteState.nunchukAccelY, wiimoteState.nunchukAccelZ,
+                      profile.gesture, nowUs);
+    }
+}
+
+/**
+ * 手勢按下時加上設定檔指定的 NS 按鈕
+ */
+void applyGestureButtons(GamepadFrame& frame, const CompiledProfile& profile) {
+    for (uint8_t i = 0; i < MAPPING_GESTURE_COUNT; i++) {
+        const MappingGesture& g = MAPPING_GESTURES[i];
+        if (gestureDetectors[g.source].buttons() & g.gesture) {
+            frame.buttons |= profile.gestureMasks[i];
+        }
+    }
+}
+
+/**
+ * 鏡頭關閉或斷線時清除紅外線指標 (每個狀態封包一次)
+ */
+void updateIrPointerState() {
+    if (!(wiimoteState.flags & WIIMOTE_FLAG_IR) || !(wiimoteState.flags & WIIMOTE_FLAG_CONNECTED)) {
+        wiimoteIrReset(irState);
+        irPointer.reset();
+    }
+}
+
+/**
+ * 紅外線指標輸出到設定檔指定的搖桿 (該搖桿已有方向鍵、Nunchuk 或體感輸出時讓給它們)
+ */
+void applyIrStick(GamepadFrame& frame, uint8_t target) {
+    if (target == MAPPING_STICK_LEFT &&
+        frame.leftX == BUTTON_STICK_CENTER && frame.leftY == BUTTON_STICK_CENTER) {
+        frame.leftX = irPointer.x();
+        frame.leftY = irPointer.y();
+    } else if (target == MAPPING_STICK_RIGHT &&
+               frame.rightX == BUTTON_STICK_CENTER && frame.rightY == BUTTON_STICK_CENTER) {
+        frame.rightX = irPointer.x();
+        frame.rightY = irPointer.y();
+    }
+}
+
+/**
+ * 體感傾斜輸出到設定檔指定的搖桿 (該搖桿已有方向鍵或 Nunchuk 輸出時讓給它們)
+ */
+void applyMotionStick(GamepadFrame& frame, uint8_t target) {
+    if (target == MAPPING_STICK_LEFT &&
+        frame.leftX == BUTTON_STICK_CENTER && frame.leftY == BUTTON_STICK_CENTER) {
+        frame.leftX = motionTilt.x();
+        frame.leftY = motionTilt.y();
+    } else if (target == MAPPING_STICK_RIGHT &&
+               frame.rightX == BUTTON_STICK_CENTER && frame.rightY == BUTTON_STICK_CENTER) {
+        frame.rightX = motionTilt.x();
+        frame.rightY = motionTilt.y();
+    }
+}
+
+/**
+ * Nunchuk 搖桿 (校正與死區處理後) 輸出到設定檔指定的搖桿
+ * 方向鍵也輸出到同一個搖桿時，按下方向鍵優先
+ */
+void applyNunchukStick(GamepadFrame& frame, uint8_t target, const NunchukStick& stick) {
+    uint8_t x = stick.x();
+    uint8_t y = stick.y();
+    if (target == MAPPING_STICK_LEFT &&
+        frame.leftX == BUTTON_STICK_CENTER && frame.leftY == BUTTON_STICK_CENTER) {
+        frame.leftX = x;
+        frame.leftY = y;
+    } else if (target == MAPPING_STICK_RIGHT &&
+               frame.rightX == BUTTON_STICK_CENTER && frame.rightY == BUTTON_STICK_CENTER) {
+        frame.rightX = x;
+        frame.rightY = y;
+    }
+}
+
+void applyNunchukStick(GamepadFrame& frame, uint8_t target) {
+    if (nunchukPresent) {
+        applyNunchukStick(frame, target, nunchukStick);
+    }
+}
+
+/**
+ * 由最近一次的映射結果組合出報告: 方向鍵輸出到搖桿時改用漸進輸出，再依序套用 Nunchuk 搖桿、體感與手勢按鈕
+ */
+GamepadFrame composeFrame(const CompiledProfile& profile) {
+    GamepadFrame frame = mappedFrame;
+    if (profile.dPadTarget == DIRECTION_TARGET_LEFT_STICK) {
+        frame.leftX = stickRamp.x();
+        frame.leftY = stickRamp.y();
+    } else if (profile.dPadTarget == DIRECTION_TARGET_RIGHT_STICK) {
+        frame.rightX = stickRamp.x();
+        frame.rightY = stickRamp.y();
+    }
+    if (profile.stickTarget != MAPPING_STICK_NONE) {
+        applyNunchukStick(frame, profile.stickTarget);
+    }
+    if (profile.motionTarget != MAPPING_STICK_NONE) {
+        applyMotionStick(frame, profile.motionTarget);
+    }
+    if (profile.irTarget != MAPPING_STICK_NONE) {
+        applyIrStick(frame, profile.irTarget);
+    }
+    applyGestureButtons(frame, profile);
+    return frame;
+}
+
+/**
+ * 將一個報告透過 USB 送出，報告帶著 reportTag
+ * @param force true: 立即送出；false: 同一毫秒內只送一次 (Pro 控制器)
+ *              HORIPAD 一律有變化就排隊，由 usbBackendTask() 依序送出，不會阻塞輸入任務
+ * @return Pro 控制器: 是否立即送出了報告；HORIPAD: false 表示佇列已滿、按鈕變化遺失
+ */
+bool writeGamepadFrame(const GamepadFrame& frame, bool force) {
+    Gamepad.buttons(frame.buttons);
+    Gamepad.dPad(frame.hat);
+    Gamepad.leftXAxis(frame.leftX);
+    Gamepad.leftYAxis(frame.leftY);
+    Gamepad.rightXAxis(frame.rightX);
+    Gamepad.rightYAxis(frame.rightY);
+    reportDataUs = (uint32_t)esp_timer_get_time();
+#if USB_BACKEND == USB_BACKEND_PRO_CONTROLLER
+    if (unsentLatencyTag == 0) {
+        unsentLatencyTag = reportTag;
+    }
+    bool sent = force ? Gamepad.write() : Gamepad.loop();
+    latencyReportSent(sent);
+    return sent;
+#else
+    return Gamepad.loop(reportTag);
+#endif
+}
+
+/**
+ * 將按鈕狀態映射並透過 USB 送出
+ * @param buttons 按鈕狀態 (wiimoteButtonSet 格式，含 Nunchuk 的 C/Z)
+ * @param force true: 立即送出 (按鈕有變化時)；false: 同一毫秒內只送一次
+ * @return 同 writeGamepadFrame()
+ */
+bool applyButtonState(uint32_t buttons, bool force = false) {
+    // 每個封包只讀一次作用中的查表；網頁切換設定檔時最晚在下一個封包生效
+    const CompiledProfile& profile = *compiledProfiles.current();
+    uint32_t nowUs = (uint32_t)esp_timer_get_time();
+
+    // 0. 組合鍵: HOME + 方向鍵不送給 Switch，動作交給 loop() 切換
+    buttons = chordSwitch.filter(buttons, profile.directions, nowUs);
+    uint8_t action = chordSwitch.takeAction();
+    if (action != CHORD_ACTION_NONE) {
+        chordActions.push(&action, 1);
+    }
+    const ButtonTranslation& table = compiledProfileLayer(profile, buttons);
+
+    // 1. 方向鍵: 先處理相反方向，再依設定檔查 D-Pad 或搖桿表 (其餘維持置中)
+    uint32_t directionButtons = socdResolver.resolve(buttons, profile.directions, profile.socdMode);
+    uint32_t translateStart = esp_cpu_get_cycle_count();
+    const DirectionOutput& direction = translateDirection(table, directionButtons);
+    mappedFrame.hat = direction.hat;
+    mappedFrame.leftX = direction.leftX;
+    mappedFrame.leftY = direction.leftY;
+    mappedFrame.rightX = direction.rightX;
+    mappedFrame.rightY = direction.rightY;
+
+    // 2. 其餘按鈕: 高低位元組與 Nunchuk C/Z 各查一次表
+    mappedFrame.buttons = translateButtons(table, buttons);
+    recordTranslateCycles(esp_cpu_get_cycle_count() - translateStart);
+    mappedButtons = buttons;
+
+    // 3. 方向鍵輸出到搖桿時，幅度依加速曲線漸進 (十字鍵模式下視為放開，讓狀態回到中心)
+    int8_t dirX = 0;
+    int8_t dirY = 0;
+    if (profile.dPadTarget == DIRECTION_TARGET_LEFT_STICK) {
+        dirX = stickDirection(direction.leftX);
+        dirY = stickDirection(direction.leftY);
+    } else if (profile.dPadTarget == DIRECTION_TARGET_RIGHT_STICK) {
+        dirX = stickDirection(direction.rightX);
+        dirY = stickDirection(direction.rightY);
+    }
+    stickRamp.input(dirX, dirY, (buttons & profile.stickResponse.walkMask) != 0, profile.stickResponse, nowUs);
+
+    // 4. 連發與巨集，之後的變化由 1ms 計時器推進
+    bool changed = macroEngine.input(buttons, composeFrame(profile), profile.turboHalfUs, nowUs);
+    frameTickNeeded = macroEngine.active() || stickRamp.active() || motionTilt.active() || irPointer.active() ||
+                      gestureDetectors[0].active() || gestureDetectors[1].active() || chordSwitch.active();
+
+    // 5. 將所有設定好的狀態透過 USB 發送給 Switch
+    return writeGamepadFrame(macroEngine.output(), force || changed);
+}
+
+/**
+ * 每個 USB frame (1ms) 的推進: 組合鍵逾時、搖桿加速/減速、體感濾波、連發與巨集 (在輸入任務中呼叫)
+ * 輸出有變化就立即送出，不受同一毫秒只送一次的限制
+ */
+void frameTick() {
+    if (!frameTickNeeded) {
+        return;
+    }
+    uint32_t nowUs = (uint32_t)esp_timer_get_time();
+    if (chordSwitch.tick(nowUs)) {
+        // 長按 HOME 逾時或補送的短按結束: 以同一組按鈕重新映射
+        applyButtonState(chordSwitch.buttons(), true);
+    }
+    const CompiledProfile& profile = *compiledProfiles.current();
+    bool changed = false;
+    bool inputChanged = stickRamp.tick(profile.stickResponse, nowUs);
+    inputChanged = motionTilt.tick(profile.motion, nowUs) || inputChanged;
+    inputChanged = irPointer.tick(profile.ir, nowUs) || inputChanged;
+    inputChanged = gestureDetectors[0].tick(nowUs) || inputChanged;
+    inputChanged = gestureDetectors[1].tick(nowUs) || inputChanged;
+    if (inputChanged) {
+        changed = macroEngine.input(mappedButtons, composeFrame(profile), profile.turboHalfUs, nowUs);
+    }
+    changed = macroEngine.tick(nowUs) || changed;
+    if (changed && !writeGamepadFrame(macroEngine.output(), true)) {
+        frameWriteFailures++;
+    }
+    frameTickNeeded = macroEngine.active() || stickRamp.active() || motionTilt.active() || irPointer.active() ||
+                      gestureDetectors[0].active() || gestureDetectors[1].active() || chordSwitch.active();
+}
+
+#if USB_GAMEPADS > 1
+/**
+ * 其他手把的映射並透過 USB 送出: 作用中設定檔的按鈕與方向 (搖桿輸出為全幅)，加上 Nunchuk 搖桿
+ * 與手把 0 共用端點，端點忙碌時由 NSGamepad 的佇列輪流送出
+ */
+bool applyExtraPad(ExtraPad& pad, uint32_t buttons) {
+    const CompiledProfile& profile = *compiledProfiles.current();
+    const ButtonTranslation& table = compiledProfileLayer(profile, buttons);
+    const DirectionOutput& direction =
+        translateDirection(table, pad.socd.resolve(buttons, profile.directions, profile.socdMode));
+    GamepadFrame frame = { translateButtons(table, buttons), direction.hat,
+                           direction.leftX, direction.leftY, direction.rightX, direction.rightY };
+    if (pad.nunchukPresent && profile.stickTarget != MAPPING_STICK_NONE) {
+        applyNunchukStick(frame, profile.stickTarget, pad.stick);
+    }
+    NSGamepad& gamepad = *pad.gamepad;
+    gamepad.buttons(frame.buttons);
+    gamepad.dPad(frame.hat);
+    gamepad.leftXAxis(frame.leftX);
+    gamepad.leftYAxis(frame.leftY);
+    gamepad.rightXAxis(frame.rightX);
+    gamepad.rightYAxis(frame.rightY);
+    return gamepad.loop();
+}
+
+/**
+ * 處理其他 Wiimote 的狀態 (LINK_MSG_PAD_STATE，手把編號 1..USB_GAMEPADS-1)
+ */
+void handlePadState(uint8_t index, const uint8_t* payload, uint8_t len) {
+    ExtraPad& pad = extraPads[index - 1];
+    uint8_t fields = 0;
+    if (!wiimoteStateDecode(payload, len, pad.state, &fields)) {
+        stateDecodeErrors++;
+        return;
+    }
+    pad.updates++;
+    bool present = (pad.state.flags & WIIMOTE_FLAG_NUNCHUK) != 0;
+    if (present && !pad.nunchukPresent) {
+        // 死區設定跟手把 0 相同；可能換了一支 Nunchuk，範圍與中心都重新估計
+        pad.stick.setSettings(nunchukStick.settings());
+        pad.stick.recalibrate();
+    }
+    pad.nunchukPresent = present;
+    if (present) {
+        pad.stick.update(pad.state.nunchukX, pad.state.nunchukY);
+    }
+    uint32_t buttons = wiimoteButtonSet(pad.state);
+    if (fields & STATE_FIELD_EDGES) {
+        for (uint8_t i = 0; i < pad.state.edgeCount && i < WIIMOTE_EDGE_MAX; i++) {
+            uint32_t replay = wiimoteEdgeState(pad.state, i);
+            if (replay != pad.appliedButtons) {
+                applyExtraPad(pad, replay);
+                pad.appliedButtons = replay;
+                edgeReplays++;
+            }
+        }
+    }
+    applyExtraPad(pad, buttons);
+    pad.appliedButtons = buttons;
+}
+#endif
+
+#if USB_BACKEND == USB_BACKEND_PRO_CONTROLLER
+uint8_t forwardedPlayerLights = 0;
+bool forwardedRumble = false;
+
+/**
+ * 把 Wiimote 加速度換算成 Pro 控制器的 IMU 讀數 (4096 = 1g，在映射之前呼叫)
+ * Wiimote 沒有陀螺儀，角速度一律為 0；軸向直接對應 (平放時 Z 朝上)
+ */
+void updateUsbImu(uint8_t fields) {
+    if (!(fields & STATE_FIELD_ACCEL) || !(wiimoteState.flags & WIIMOTE_FLAG_ACCEL)) {
+        return;
+    }
+    const uint8_t raw[3] = { wiimoteState.accelX, wiimoteState.accelY, wiimoteState.accelZ };
+    int16_t accel[3];
+    const int16_t gyro[3] = { 0, 0, 0 };
+    for (uint8_t i = 0; i < 3; i++) {
+        int32_t span = (int32_t)accelCalibration.gravity[i] - accelCalibration.zero[i];
+        if (span <= 0) {
+            span = WIIMOTE_ACCEL_GRAVITY_DEFAULT - WIIMOTE_ACCEL_ZERO_DEFAULT;
+        }
+        int32_t g = ((int32_t)(raw[i] << 2) - accelCalibration.zero[i]) * 4096 / span;
+        accel[i] = (int16_t)(g > 32767 ? 32767 : (g < -32768 ? -32768 : g));
+    }
+    Gamepad.imu(accel, gyro);
+}
+
+/**
+ * Switch 送來的命令 (TinyUSB 任務): 喚醒輸入任務立即回覆握手
+ */
+void onUsbOutput() {
+    xTaskNotifyGive(inputTaskHandle);
+}
+
+/**
+ * 回覆 Switch 的命令並維持 0x30 報告的週期；玩家燈號與震動轉給 Wiimote (在輸入任務中呼叫)
+ */
+void usbBackendTask() {
+    latencyReportSent(Gamepad.task((uint32_t)esp_timer_get_time()));
+    uint8_t lights = Gamepad.playerLights() & 0x0F;
+    if (lights != forwardedPlayerLights) {
+        forwardedPlayerLights = lights;
+        if (lights != 0) {
+            desiredLEDs = lights;
+        }
+    }
+    bool rumble = Gamepad.rumbleActive();
+    if (rumble != forwardedRumble) {
+        forwardedRumble = rumble;
+        desiredRumble = rumble;
+    }
+    usbImuReporting = Gamepad.imuEnabled();
+}
+
+bool usbBackendNeedsTick() {
+    return Gamepad.needsTick((uint32_t)esp_timer_get_time());
+}
+
+uint32_t usbReportsSubmitted() {
+    return Gamepad.stats().fullReports;
+}
+#else
+void updateUsbImu(uint8_t fields) {}
+void onUsbOutput() {}
+
+/**
+ * 送出排隊的報告，閒置時送 keep-alive (在輸入任務中呼叫)
+ * 所有手把的報告都只從這裡交給 USB 端點
+ */
+void usbBackendTask() {
+    Gamepad.task();
+}
+
+bool usbBackendNeedsTick() {
+    return Gamepad.pending();
+}
+
+uint32_t usbReportsSubmitted() {
+    const NSGamepadStats& stats = Gamepad.stats();
+    return stats.submitted - stats.keepalives;
+}
+#endif
+
+uint16_t usbFrameNumber() {
+    return (uint16_t)(USB0.dsts.soffn & USB_FRAME_NUMBER_MASK);
+}
+
+/**
+ * 取樣 USB frame number 更新 SOF 相位，並發布給其他任務
+ * @param nowUs 目前時間，需與讀 frame number 緊接著取得
+ */
+void usbFrameSample(uint32_t nowUs) {
+    usbFramePhase.sample(nowUs, usbFrameNumber());
+    usbSofUs = usbFramePhase.sofUs();
+    usbSofLocked = usbFramePhase.locked();
+    usbSofUncertaintyUs = usbFramePhase.uncertaintyUs();
+}
+
+/**
+ * 記錄新送出報告的輪詢時資料年齡 (在輸入任務中每次喚醒呼叫)
+ * 主機的中斷端點輪詢排在 frame 開頭: 交給端點的報告在下一個 SOF 被取走
+ */
+void usbFrameTask() {
+    uint32_t nowUs = (uint32_t)esp_timer_get_time();
+    if (pollAgeResetPending) {
+        pollAgeResetPending = false;
+        pollAgeHist[USB_SCHEDULE_ASAP].reset();
+        pollAgeHist[USB_SCHEDULE_SOF].reset();
+    }
+    uint32_t submitted = usbReportsSubmitted();
+    if (submitted != submittedReports) {
+        submittedReports = submitted;
+        if (usbSofLocked) {
+            pollAgeHist[usbSchedule].record(UsbFramePhase::nextSof(usbSofUs, nowUs) - reportDataUs);
+        }
+    }
+}
+
+/**
+ * esp_timer 回呼 (單次計時器，每次觸發重新設定)
+ * 只喚醒輸入任務，USB 報告一律由輸入任務送出，不會與封包處理同時存取 Gamepad
+ * 每次觸發都取樣 USB frame number；報告 tick 每 FRAME_TICK_US 一次，USB_SCHEDULE_SOF 且相位已鎖定時排在 SOF 之前 USB_SOF_LEAD_US
+ */
+void onFrameTimer(void* arg) {
+    uint32_t nowUs = (uint32_t)esp_timer_get_time();
+    usbFrameSample(nowUs);
+    bool tick;
+    uint32_t leadUs = usbSchedule == USB_SCHEDULE_SOF ? USB_SOF_LEAD_US : 0;
+    esp_timer_start_once(frameTimer, usbFrameTimer.fire(nowUs, usbFramePhase, leadUs, tick));
+    if (tick && (frameTickNeeded || usbBackendNeedsTick())) {
+        xTaskNotifyGive(inputTaskHandle);
+    }
+}
+
+/**
+ * 處理 Wiimote (手把 0) 的完整狀態: 更新搖桿、體感、紅外線與手勢後映射並送出
+ */
+void handleWiimoteState(const uint8_t* payload, uint8_t len) {
+    uint32_t rxUs = (uint32_t)esp_timer_get_time();
+    uint8_t fields = 0;
+    if (wiimoteStateDecode(payload, len, wiimoteState, &fields)) {
+        uint32_t buttons = wiimoteButtonSet(wiimoteState);
+        updateNunchukStick(buttons);
+        updateMotionTilt(fields);
+        updateIrPointerState();
+        updateGestures(fields);
+        updateUsbImu(fields);
+        if (fields & STATE_FIELD_EDGES) {
+            // 兩次送出之間有快速點擊: 依序補送中間狀態，讓每次點擊至少有一個按下的報告
+            for (uint8_t i = 0; i < wiimoteState.edgeCount && i < WIIMOTE_EDGE_MAX; i++) {
+                uint32_t replay = wiimoteEdgeState(wiimoteState, i);
+                if (replay != appliedButtons) {
+                    applyButtonState(replay, true);
+                    appliedButtons = replay;
+                    edgeReplays++;
+                }
+            }
+        }
+        // 按鈕變化必須各自成為一個報告，不能被同一毫秒的節流吃掉
+        // 延遲在這個報告交給 USB 端點時才記錄 (可能在 usbBackendTask() 排隊送出時)
+        if (fields & STATE_FIELD_TIMESTAMP) {
+            reportTag = latencyTag(wiimoteState, rxUs);
+        }
+        applyButtonState(buttons, buttons != appliedButtons);
+        reportTag = 0;
+        appliedButtons = buttons;
+    } else {
+        stateDecodeErrors++;
+    }
+}
+
+/**
+ * 處理一個 CRC 正確的訊框
+ */
+void handleLinkFrame(const LinkFrame& frame) {
+    if (baudNegotiator.handleFrame(frame, millis()) || commandSender.handleFrame(frame)) {
+        return;
+    }
+    switch (frame.type) {
+        case LINK_MSG_BUTTONS:
+            if (frame.len == sizeof(ButtonPacket)) {
+                ButtonPacket received_packet;
+                memcpy(&received_packet, frame.payload, sizeof(received_packet));
+                applyButtonState(received_packet.buttonState);
+            }
+            break;
+        case LINK_MSG_STATE:
+            handleWiimoteState(frame.payload, frame.len);
+            break;
+        case LINK_MSG_PAD_STATE:
+            // 第一個位元組是手把編號，其餘與 LINK_MSG_STATE 相同
+            if (frame.len < 1 || frame.payload[0] >= USB_GAMEPADS) {
+                padStatesDropped++;
+            } else if (frame.payload[0] == 0) {
+                handleWiimoteState(frame.payload + 1, frame.len - 1);
+            }
+#if USB_GAMEPADS > 1
+            else {
+                handlePadState(frame.payload[0], frame.payload + 1, frame.len - 1);
+            }
+#endif
+            break;
+        case LINK_MSG_ACCEL_CAL:
+            if (frame.len == sizeof(WiimoteAccelCalibration)) {
+                WiimoteAccelCalibration cal;
+                memcpy(&cal, frame.payload, sizeof(cal));
+                if (wiimoteAccelCalibrationValid(cal)) {
+                    if (memcmp(&cal, &accelCalibration, sizeof(cal)) != 0) {
+                        accelCalibration = cal;
+                        motionTilt.setCalibration(cal);
+                        gestureDetectors[MAPPING_GESTURE_WIIMOTE].setCalibration(cal);
+                    }
+                    accelCalibrationReceived = true;
+                }
+            }
+            break;
+        case LINK_MSG_IR:
+            // 點座標改變時才會送來: 更新指標後以上一次映射的按鈕重新組合報告
+            // 按鈕只由狀態封包套用，這裡不再經過組合鍵、相反方向與巨集觸發
+            if (frame.len == sizeof(WiimoteIrState) && (wiimoteState.flags & WIIMOTE_FLAG_IR)) {
+                memcpy(&irState, frame.payload, sizeof(irState));
+                irUpdates++;
+                const CompiledProfile& profile = *compiledProfiles.current();
+                uint32_t nowUs = (uint32_t)esp_timer_get_time();
+                if (irPointer.input(irState, profile.ir, nowUs) &&
+                    macroEngine.input(mappedButtons, composeFrame(profile), profile.turboHalfUs, nowUs)) {
+                    writeGamepadFrame(macroEngine.output(), true);
+                }
+                if (irPointer.active()) {
+                    frameTickNeeded = true;
+                }
+            }
+            break;
+        case LINK_MSG_TIME_RESP:
+            if (frame.len == sizeof(LinkTimeSyncPayload)) {
+                LinkTimeSyncPayload resp;
+                memcpy(&resp, frame.payload, sizeof(resp));
+                clockSync.onResponse(resp, (uint32_t)esp_timer_get_time());
+            }
+            break;
+        default:
+            // 未知的訊息類型，忽略
+            break;
+    }
+}
+
+/**
+ * UART 接收回呼 (在 UART 事件任務中執行)
+ * 只把資料搬進環形緩衝區並喚醒輸入任務，不做任何解析
+ */
+void onSerial2Receive() {
+#if INPUT_RX_MODE == INPUT_RX_EVENT
+    uint8_t buf[64];
+    size_t n;
+    while ((n = linkTransport.read(buf, sizeof(buf))) > 0) {
+        uartRxRing.push(buf, n);
+    }
+#endif
+    // 只保留還沒處理的第一次回呼；0 代表沒有，所以時間的最低位元固定為 1
+    // 資料先放好才設定時間，讀取端先取走時間再讀資料，這批資料一定在取走之後被讀到
+    uint32_t idle = 0;
+    rxEventUs.compare_exchange_strong(idle, (uint32_t)esp_timer_get_time() | 1);
+#if INPUT_RX_MODE == INPUT_RX_EVENT
+    xTaskNotifyGive(inputTaskHandle);
+#endif
+}
+
+/**
+ * 記錄一批資料的輸入延遲 (讀取資料之後呼叫)
+ * @param eventUs 讀取資料之前從 rxEventUs 取走的時間 (0: 沒有新的回呼)
+ * @param parsed 這批資料是否解析出完整的訊框；只有訊框的尾段時不記錄
+ */
+void recordInputBatch(uint32_t eventUs, bool parsed) {
+    if (eventUs != 0 && parsed) {
+        recordInputDelay((uint32_t)esp_timer_get_time() - eventUs);
+    }
+}
+
+void onSerial2ReceiveError(hardwareSerial_error_t error) {
+    // UART_BUFFER_FULL_ERROR / UART_FIFO_OVF_ERROR 代表驅動層已經丟資料
+    uartErrorCount++;
+}
+
+/**
+ * 高優先權輸入任務: 被接收回呼喚醒後立即解析訊框並送出 USB 報告
+ */
+void inputTask(void* arg) {
+    uint8_t buf[64];
+    for (;;) {
+        // 逾時喚醒是為了讓速率協商的計時器持續推進
+        ulTaskNotifyTake(pdTRUE, pdMS_TO_TICKS(10));
+
+        uint32_t eventUs = rxEventUs.exchange(0);
+        uint32_t framesBefore = linkTransport.rxStats().framesOk;
+        size_t n;
+        while ((n = uartRxRing.pop(buf, sizeof(buf))) > 0) {
+            linkTransport.feed(buf, n, handleLinkFrame);
+        }
+        recordInputBatch(eventUs, linkTransport.rxStats().framesOk != framesBefore);
+        compiledProfiles.readerQuiescent();
+        frameTick();
+        usbBackendTask();
+        usbFrameTask();
+        baudNegotiator.task(millis());
+        clockSyncTask();
+        commandTask();
+    }
+}
+
 void loop() {
     // 處理 DNS 請求（強制門戶功能）
     dnsServer.processNextRequest();
     
     // 處理網頁伺服器請求
     server.handleClient();
-    
-    // 檢查是否有來自 S1 的完整封包
-    if (Serial2.available() >= sizeof(ButtonPacket)) {
-        ButtonPacket received_packet;
-        Serial2.readBytes((char*)&received_packet, sizeof(received_packet));
-        uint16_t buttons = received_packet.buttonState;
-
-        // --- 開始映射 ---
-
-        // 1. 處理方向鍵映射 - 根據模式選擇
-        if (directionalButtonMode) {
-            // 方向鍵模式：使用 D-Pad
-            mapDirectionalButtonsToDPad(buttons);
-            // 保持搖桿在中心位置
-            Gamepad.leftXAxis(128);
-            Gamepad.leftYAxis(128);
-            Gamepad.rightXAxis(128);
-        } else {
-            // 類比搖桿模式：處理方向鍵到搖桿的映射
-            if (buttons & (BUTTON_UP | BUTTON_DOWN | BUTTON_LEFT | BUTTON_RIGHT)) {
-                mapDirectionalButtonsToAnalogStick(buttons);
-            } else {
-                // 如果沒有方向鍵被按下，重設搖桿到中心
-                Gamepad.leftXAxis(128);
-                Gamepad.leftYAxis(128);
-                Gamepad.rightXAxis(128);
-            }
-            // 清除 D-Pad
-            Gamepad.dPad(NSGAMEPAD_DPAD_CENTERED);
-        }
 
-        // 2. 處理按鈕映射
-        mapWiimoteButtons(buttons);
+#if INPUT_RX_MODE == INPUT_RX_POLLING
+    // 將 Serial2 收到的位元組交給訊框解析器，錯位或雜訊會在下一個訊框自動重新同步
+    uint32_t eventUs = rxEventUs.exchange(0);
+    uint32_t framesBefore = linkTransport.rxStats().framesOk;
+    linkTransport.poll(handleLinkFrame);
+    recordInputBatch(eventUs, linkTransport.rxStats().framesOk != framesBefore);
+    compiledProfiles.readerQuiescent();
+    frameTick();   // 輪詢模式沒有計時器，精度取決於 loop() 的週期
+    usbBackendTask();
+    usbFrameSample((uint32_t)esp_timer_get_time());
+    usbFrameTask();
+    baudNegotiator.task(millis());
+    clockSyncTask();
+    commandTask();
+#endif
+
+    nunchukSaveTask();
+    chordTask();
 
-        // 3. 將所有設定好的狀態透過 USB 發送給 Switch
-        Gamepad.loop();
+    static uint32_t lastLatencyReportMs = 0;
+    if (millis() - lastLatencyReportMs >= LATENCY_REPORT_MS) {
+        lastLatencyReportMs = millis();
+        printLatencySummary();
     }
-}
\ No newline at end of file
+}
@@ -24,6 +24,7 @@
 #include "freertos/task.h"
 #include "Arduino.h"
 #include "esp_bt.h"
+#include "esp_timer.h"
 #include <HardwareSerial.h>
 
 #include "time.h"
@@ -60,6 +61,7 @@ ESP32Wiimote::ESP32Wiimote(int NUNCHUK_STICK_THRESHOLD)
 {
     _nunStickThreshold = NUNCHUK_STICK_THRESHOLD;
     _filter = FILTER_NONE;
+    memset(_controllers, 0, sizeof(_controllers));
 }
 
 void ESP32Wiimote::notifyHostSendAvailable(void) {
@@ -101,13 +103,13 @@ void ESP32Wiimote::handleRxQueue(void) {
   if(uxQueueMessagesWaiting(rxQueue)){
     queuedata_t *queuedata = NULL;
     if(xQueueReceive(rxQueue, &queuedata, 0) == pdTRUE){
-      handleHciData(queuedata->data, queuedata->len);
+      handleHciData(queuedata->data, queuedata->len, queuedata->timestamp);
       free(queuedata);
     }
   }
 }
 
-esp_err_t ESP32Wiimote::sendQueueData(xQueueHandle queue, uint8_t *data, size_t len) {
+esp_err_t ESP32Wiimote::sendQueueData(xQueueHandle queue, uint8_t *data, size_t len, int64_t timestamp) {
     VERBOSE_PRINTLN("sendQueueData");
     if(!data || !len){
         VERBOSE_PRINTLN("no data");
@@ -119,6 +121,7 @@ esp_err_t ESP32Wiimote::sendQueueData(xQueueHandle queue, uint8_t *data, size_t
         return ESP_FAIL;
     }
     queuedata->len = len;
+    queuedata->timestamp = timestamp;
     memcpy(queuedata->data, data, len);
     UNVERBOSE_PRINT("RECV <= %s\n", format2Hex(queuedata->data, queuedata->len));
     if (xQueueSend(queue, &queuedata, portMAX_DELAY) != pdPASS) {
@@ -130,10 +133,12 @@ esp_err_t ESP32Wiimote::sendQueueData(xQueueHandle queue, uint8_t *data, size_t
 }
 
 void ESP32Wiimote::hciHostSendPacket(uint8_t *data, size_t len) {
-  sendQueueData(txQueue, data, len);
+  sendQueueData(txQueue, data, len, 0);
 }
 
 int ESP32Wiimote::notifyHostRecv(uint8_t *data, uint16_t len) {
+  // stamp as early as possible so latency measurements include the queueing below
+  int64_t recvTimeUs = esp_timer_get_time();
   VERBOSE_PRINT("notifyHostRecv:");
   for (int i = 0; i < len; i++)
   {
@@ -141,7 +146,7 @@ int ESP32Wiimote::notifyHostRecv(uint8_t *data, uint16_t len) {
   }
   VERBOSE_PRINTLN("");
 
-  if(ESP_OK == sendQueueData(rxQueue, data, len)){
+  if(ESP_OK == sendQueueData(rxQueue, data, len, recvTimeUs)){
     return ESP_OK;
   }else{
     return ESP_FAIL;
@@ -176,7 +181,7 @@ void ESP32Wiimote::task(void)
   handleRxQueue();
 }
 
-int ESP32Wiimote::available(void)
+int ESP32Wiimote::available(uint8_t number)
 {
     int offs = 0;
     int buttonIsChanged = false;
@@ -186,40 +191,63 @@ int ESP32Wiimote::available(void)
     uint8_t cBtn = 0;
     uint8_t zBtn = 0;
 
-    if (! TinyWiimoteAvailable())
+    if (number >= TW_MAX_WIIMOTES)
+        return 0;
+    if (! TinyWiimoteAvailable(number))
         return 0;
 
-    TinyWiimoteData rd = TinyWiimoteRead();
+    TinyWiimoteData rd = TinyWiimoteRead(number);
+    controller_t& c = _controllers[number];
 
     if (rd.len < 4) // 
         return 0;
     if (rd.data[0] != 0xA1) // no data input
         return 0;
+
+    c.reportTimeUs = rd.recvTimeUs;
+
+    // status report: (a1) 20 BB BB LF 00 00 VV
+    // keep the previous stick/accel values instead of clearing them
+    if (rd.data[1] == 0x20) {
+        if (rd.len >= 8)
+            c.batteryLevel = rd.data[7];
+        return 0;
+    }
+
+    // read responses (0x21) and output report acks (0x22) carry no stick/accel data either
+    if ((rd.data[1] == 0x21) || (rd.data[1] == 0x22))
+        return 0;
       
+    // keep the whole report for data that is decoded outside of this library (IR camera)
+    memcpy(c.rawReport, rd.data, rd.len);
+    c.rawReportLen = rd.len;
+
     // update old states
-    _oldButtonState  = _buttonState;
-    _oldAccelState   = _accelState;
-    _oldNunchukState = _nunchukState;
+    c.oldButtonState  = c.buttonState;
+    c.oldAccelState   = c.accelState;
+    c.oldNunchukState = c.nunchukState;
 
     if ((rd.data[1] >= 0x30) && (rd.data[1] <= 0x37)) // data report with button data
         offs = 2;
 
     if (offs) // update button state
-        _buttonState = (ButtonState)((rd.data[offs + 0] << 8) | rd.data[offs + 1]);
+        c.buttonState = (ButtonState)((rd.data[offs + 0] << 8) | rd.data[offs + 1]);
 
     // get accelerometer offset
     switch (rd.data[1])
     {
     case 0x31: offs = 4; break; // Core Buttons and Accelerometer
+    case 0x33: offs = 4; break; // Core Buttons and Accelerometer with 12 IR bytes
     case 0x35: offs = 4; break; // Core Buttons and Accelerometer with 16 Extension Bytes
+    case 0x37: offs = 4; break; // Core Buttons and Accelerometer with 10 IR bytes and 6 Extension Bytes
     default:   offs = 0;
     }
 
     if (offs) // update accelerometer
     {
-        _accelState.xAxis  = rd.data[offs + 0];
-        _accelState.yAxis  = rd.data[offs + 1];
-        _accelState.zAxis  = rd.data[offs + 2];
+        c.accelState.xAxis  = rd.data[offs + 0];
+        c.accelState.yAxis  = rd.data[offs + 1];
+        c.accelState.zAxis  = rd.data[offs + 2];
 
         // check accel change
         if (_filter & FILTER_ACCEL) {
@@ -231,9 +259,9 @@ int ESP32Wiimote::available(void)
     }
     else
     {
-        _accelState.xAxis  = 0;
-        _accelState.yAxis  = 0;
-        _accelState.zAxis  = 0;
+        c.accelState.xAxis  = 0;
+        c.accelState.yAxis  = 0;
+        c.accelState.zAxis  = 0;
     }
 
     // get extension offset
@@ -241,16 +269,18 @@ int ESP32Wiimote::available(void)
     {
     case 0x32: offs = 4; break; // Core Buttons with 8 Extension bytes
     case 0x35: offs = 7; break; // Core Buttons and Accelerometer with 16 Extension Bytes
+    case 0x36: offs = 14; break; // Core Buttons with 10 IR bytes and 9 Extension Bytes
+    case 0x37: offs = 17; break; // Core Buttons and Accelerometer with 10 IR bytes and 6 Extension Bytes
     default:   offs = 0;
     }
 
     if (offs) // update nunchuk state
     {
-        _nunchukState.xStick = rd.data[offs + 0];
-        _nunchukState.yStick = rd.data[offs + 1];
-        _nunchukState.xAxis  = rd.data[offs + 2];
-        _nunchukState.yAxis  = rd.data[offs + 3];
-        _nunchukState.zAxis  = rd.data[offs + 4];
+        c.nunchukState.xStick = rd.data[offs + 0];
+        c.nunchukState.yStick = rd.data[offs + 1];
+        c.nunchukState.xAxis  = rd.data[offs + 2];
+        c.nunchukState.yAxis  = rd.data[offs + 3];
+        c.nunchukState.zAxis  = rd.data[offs + 4];
 
         // update nunchuk buttons
         cBtn = ((rd.data[offs + 5] & 0x02) >> 1) ^ 0x01;
@@ -258,33 +288,33 @@ int ESP32Wiimote::available(void)
     }
     else
     {
-        _nunchukState.xStick = 0;
-        _nunchukState.yStick = 0;
-        _nunchukState.xAxis  = 0;
-        _nunchukState.yAxis  = 0;
-        _nunchukState.zAxis  = 0;
+        c.nunchukState.xStick = 0;
+        c.nunchukState.yStick = 0;
+        c.nunchukState.xAxis  = 0;
+        c.nunchukState.yAxis  = 0;
+        c.nunchukState.zAxis  = 0;
     }
     
 
     // add nunchuk buttons
     if (cBtn)
-        _buttonState = (ButtonState)((int)_buttonState | BUTTON_C);
+        c.buttonState = (ButtonState)((int)c.buttonState | BUTTON_C);
     if (zBtn)
-        _buttonState = (ButtonState)((int)_buttonState | BUTTON_Z);
+        c.buttonState = (ButtonState)((int)c.buttonState | BUTTON_Z);
 
     // check button change
     if (_filter & FILTER_BUTTON) {
         ; // ignore
     }
-    else if (_buttonState != _oldButtonState) {
+    else if (c.buttonState != c.oldButtonState) {
         buttonIsChanged = true;
     }
 
     // check nunchuk stick change
     if (offs)
     {
-        int nunXStickDelta = (int)(_nunchukState.xStick) - _oldNunchukState.xStick;
-        int nunYStickDelta = (int)(_nunchukState.yStick) - _oldNunchukState.yStick;
+        int nunXStickDelta = (int)(c.nunchukState.xStick) - c.oldNunchukState.xStick;
+        int nunYStickDelta = (int)(c.nunchukState.yStick) - c.oldNunchukState.yStick;
         int nunStickDelta = (nunXStickDelta*nunXStickDelta + nunYStickDelta*nunYStickDelta);
         if (_filter & FILTER_NUNCHUK_STICK) {
             ; // ignore
@@ -321,19 +351,107 @@ int ESP32Wiimote::available(void)
         );
 }
 
-ButtonState ESP32Wiimote::getButtonState(void)
+ButtonState ESP32Wiimote::getButtonState(uint8_t number)
+{
+  return _controllers[number % TW_MAX_WIIMOTES].buttonState;
+}
+
+AccelState ESP32Wiimote::getAccelState(uint8_t number)
+{
+    return _controllers[number % TW_MAX_WIIMOTES].accelState;
+}
+
+NunchukState ESP32Wiimote::getNunchukState(uint8_t number)
+{
+  return _controllers[number % TW_MAX_WIIMOTES].nunchukState;
+}
+
+uint8_t ESP32Wiimote::getBatteryLevel(uint8_t number)
+{
+  return _controllers[number % TW_MAX_WIIMOTES].batteryLevel;
+}
+
+int64_t ESP32Wiimote::getReportTime(uint8_t number)
+{
+  return _controllers[number % TW_MAX_WIIMOTES].reportTimeUs;
+}
+
+bool ESP32Wiimote::isConnected(uint8_t number)
+{
+  return TinyWiimoteConnected(number);
+}
+
+bool ESP32Wiimote::isNunchukConnected(uint8_t number)
+{
+  return TinyWiimoteNunchukConnected(number);
+}
+
+// Decodes the 10-bit zero-g and 1g values from the EEPROM calibration block:
+// X0 Y0 Z0 [--XXYYZZ] XG YG ZG [--XXYYZZ] ...
+bool ESP32Wiimote::getAccelCalibration(AccelCalibration& cal, uint8_t number)
+{
+  uint8_t raw[TW_ACCEL_CAL_SIZE];
+  if (!TinyWiimoteGetAccelCalibration(raw, number))
+    return false;
+  for (int i = 0; i < 3; i++) {
+    int shift = 4 - 2 * i;
+    cal.zero[i]    = (uint16_t)((raw[i]     << 2) | ((raw[3] >> shift) & 0x03));
+    cal.gravity[i] = (uint16_t)((raw[4 + i] << 2) | ((raw[7] >> shift) & 0x03));
+  }
+  return true;
+}
+
+void ESP32Wiimote::setPlayerLEDs(uint8_t leds, uint8_t number)
+{
+  TinyWiimoteSetPlayerLEDs(leds, number);
+}
+
+bool ESP32Wiimote::setRumble(bool on, uint8_t number)
+{
+  return TinyWiimoteSetRumble(on, number);
+}
+
+void ESP32Wiimote::setMaxControllers(uint8_t count)
+{
+  TinyWiimoteSetMaxWiimotes(count);
+}
+
+uint8_t ESP32Wiimote::connectedCount(void)
+{
+  return TinyWiimoteConnectedCount();
+}
+
+// Switches between core-only and accelerometer reporting at runtime
+// (overrides a previous addFilter(ACTION_IGNORE, FILTER_ACCEL))
+void ESP32Wiimote::setAccelerometer(bool enable)
+{
+  if (enable)
+    _filter &= ~FILTER_ACCEL;
+  else
+    _filter |= FILTER_ACCEL;
+  TinyWiimoteReqAccelerometer(enable);
+}
+
+bool ESP32Wiimote::isAccelerometerEnabled(void)
+{
+  return TinyWiimoteAccelerometerEnabled();
+}
+
+void ESP32Wiimote::setIrCamera(bool enable, uint8_t sensitivity)
 {
-  return _buttonState;
+  TinyWiimoteReqIrCamera(enable, sensitivity);
 }
 
-AccelState ESP32Wiimote::getAccelState(void)
+bool ESP32Wiimote::isIrCameraReady(uint8_t number)
 {
-    return _accelState;
+  return TinyWiimoteIrCameraReady(number);
 }
 
-NunchukState ESP32Wiimote::getNunchukState(void)
+const uint8_t* ESP32Wiimote::getRawReport(size_t& len, uint8_t number)
 {
-  return _nunchukState;
+  const controller_t& c = _controllers[number % TW_MAX_WIIMOTES];
+  len = c.rawReportLen;
+  return c.rawReport;
 }
 
 void ESP32Wiimote::addFilter(int action, int filter) {
@@ -24,6 +24,11 @@ typedef struct {
     uint8_t zAxis;
 } AccelState;
 
+typedef struct {
+    uint16_t zero[3];    // 10-bit readings at 0g (X, Y, Z)
+    uint16_t gravity[3]; // 10-bit readings with +1g on that axis
+} AccelCalibration;
+
 typedef enum {
     BUTTON_Z          = 0x00020000, // nunchuk
     BUTTON_C          = 0x00010000, // nunchuk
@@ -73,27 +78,53 @@ public:
 
   void init(void);
   void task(void);
-  int available(void);
-  ButtonState getButtonState(void);
-  AccelState getAccelState(void);
-  NunchukState getNunchukState(void);
+  // number selects the Wiimote (0..TW_MAX_WIIMOTES-1, player = number + 1)
+  int available(uint8_t number = 0);
+  ButtonState getButtonState(uint8_t number = 0);
+  AccelState getAccelState(uint8_t number = 0);
+  NunchukState getNunchukState(uint8_t number = 0);
+  uint8_t getBatteryLevel(uint8_t number = 0);
+  int64_t getReportTime(uint8_t number = 0);
+  bool isConnected(uint8_t number = 0);
+  bool isNunchukConnected(uint8_t number = 0);
+  bool getAccelCalibration(AccelCalibration& cal, uint8_t number = 0);
+  const uint8_t* getRawReport(size_t& len, uint8_t number = 0); // last data report, starting with 0xA1 (IR dots are decoded by the caller)
+  void setPlayerLEDs(uint8_t leds, uint8_t number = 0);
+  bool setRumble(bool on, uint8_t number = 0);
+  void setMaxControllers(uint8_t count); // 1..TW_MAX_WIIMOTES, keeps scanning until that many are connected
+  uint8_t connectedCount(void);
+  void setAccelerometer(bool enable);
+  bool isAccelerometerEnabled(void);
+  void setIrCamera(bool enable, uint8_t sensitivity = TW_IR_SENSITIVITY_DEFAULT);
+  bool isIrCameraReady(uint8_t number = 0);
   void addFilter(int action, int filter);
 
 private:
 
   typedef struct {
           size_t len;
+          int64_t timestamp;
           uint8_t data[];
   } queuedata_t;
 
-  ButtonState _buttonState;
-  ButtonState _oldButtonState;
+  typedef struct {
+    ButtonState buttonState;
+    ButtonState oldButtonState;
+
+    AccelState accelState;
+    AccelState oldAccelState;
+
+    NunchukState nunchukState;
+    NunchukState oldNunchukState;
+
+    uint8_t batteryLevel;
+    int64_t reportTimeUs;
 
-  AccelState _accelState;
-  AccelState _oldAccelState;
+    uint8_t rawReport[RECIEVED_DATA_MAX_LEN];
+    size_t rawReportLen;
+  } controller_t;
 
-  NunchukState _nunchukState;
-  NunchukState _oldNunchukState;
+  controller_t _controllers[TW_MAX_WIIMOTES];
 
   int _nunStickThreshold;
 
@@ -107,7 +138,7 @@ private:
   static void createQueue(void);
   static void handleTxQueue(void);
   static void handleRxQueue(void);
-  static esp_err_t sendQueueData(xQueueHandle queue, uint8_t *data, size_t len);
+  static esp_err_t sendQueueData(xQueueHandle queue, uint8_t *data, size_t len, int64_t timestamp);
   static void notifyHostSendAvailable(void);
   static int notifyHostRecv(uint8_t *data, uint16_t len);
   static void hciHostSendPacket(uint8_t *data, size_t len);
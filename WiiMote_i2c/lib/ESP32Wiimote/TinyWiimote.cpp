@@ -18,7 +18,9 @@
 #include <string.h>
 #include <stdbool.h>
 #include <stdio.h>
+#ifdef ARDUINO
 #include <HardwareSerial.h> // for Arduino
+#endif
 
 #include "time.h"
 #include "sys/time.h"
@@ -35,8 +37,12 @@
 #define VERBOSE_PRINTLN(...) do {} while(0)
 #endif
 
+#ifdef ARDUINO
 #define UNVERBOSE_PRINT(...) Serial.printf(__VA_ARGS__)
 //#define UNVERBOSE_PRINT(...) do {} while(0)
+#else
+#define UNVERBOSE_PRINT(...) do {} while(0) // host builds (tools/hcireplay)
+#endif
 
 #define HCI_H4_CMD_PREAMBLE_SIZE           (4)
 #define HCI_H4_ACL_PREAMBLE_SIZE           (5)
@@ -99,6 +105,7 @@ enum {
 #define HCI_OCF_INQUIRY                      0x0001
 #define HCI_OCF_INQUIRY_CANCEL               0x0002
 #define HCI_OCF_CREATE_CONNECTION            0x0005
+#define HCI_OCF_DISCONNECT                   0x0006
 #define HCI_OCF_REMOTE_NAME_REQUEST          0x0019
 
 // HCI Command opcodes(OGF + OCF)
@@ -111,6 +118,7 @@ enum {
 #define HCI_OPCODE_INQUIRY_CANCEL                 (HCI_OCF_INQUIRY_CANCEL | (HCI_OGF_LINK_CONTROL << 10))
 #define HCI_OPCODE_CREATE_CONNECTION              (HCI_OCF_CREATE_CONNECTION | (HCI_OGF_LINK_CONTROL << 10))
 #define HCI_OPCODE_REMOTE_NAME_REQUEST            (HCI_OCF_REMOTE_NAME_REQUEST | (HCI_OGF_LINK_CONTROL << 10))
+#define HCI_OPCODE_DISCONNECT                     (HCI_OCF_DISCONNECT | (HCI_OGF_LINK_CONTROL << 10))
 
 #define HCIC_PARAM_SIZE_WRITE_LOCAL_NAME (248)
 #define HCIC_PARAM_SIZE_WRITE_CLASS_OF_DEVICE (3)
@@ -119,11 +127,127 @@ enum {
 #define HCIC_PARAM_SIZE_REMOTE_NAME_REQUEST (10)
 #define HCIC_PARAM_SIZE_WRITE_INQUIRY_CANCEL (0)
 #define HCIC_PARAM_SIZE_WRITE_INQUIRY (5)
+#define HCIC_PARAM_SIZE_DISCONNECT (3)
 
 static bool deviceInited = false;
-static bool wiimoteConnected = false;
-static bool nunchukConnected = false;
 static bool useAccelerometer = true;
+static bool useIrCamera = false;
+static uint8_t irSensitivity = TW_IR_SENSITIVITY_DEFAULT;
+static uint8_t maxWiimotes = 1;     // connections accepted; inquiry continues while fewer are connected
+static bool inquiryActive = false;
+#define IR_INIT_IDLE (0xFF)
+#define PENDING_WRITE_MAX (8)
+#define RECIEVED_DATA_MAX_NUM     (5)
+
+struct recv_data_rb {
+  uint8_t wp;
+  uint8_t rp;
+  uint8_t cnt;
+};
+
+/**
+ * Per-connection state, one slot per Wiimote (the slot index is the controller number).
+ * A slot is looked up by its HCI connection handle; the address and the player LEDs stay
+ * after a disconnect so a Wiimote that comes back gets the same number and LEDs.
+ */
+struct wiimote_t {
+  bool inUse;                   // ACL link up
+  bool connected;               // HID reports are arriving
+  uint16_t handle;              // HCI connection handle
+  bd_addr_t bdAddr;
+  bool hasAddr;                 // bdAddr belongs to the last Wiimote in this slot
+  bool nunchukConnected;
+  bool rumbleOn;
+  uint8_t playerLEDs;
+  uint8_t accelCalibration[TW_ACCEL_CAL_SIZE]; // raw EEPROM bytes 0x0016..0x001F
+  bool accelCalibrationValid;
+  uint8_t irCameraMode;         // mode the camera has been set up for
+  uint8_t irInitStep;           // index into irInitSteps while setting up
+  uint8_t irInitMode;
+  uint8_t irInitRetries;
+  uint8_t pendingWriteOwner[PENDING_WRITE_MAX]; // writes waiting for their acknowledgement
+  uint8_t pendingWriteRp;
+  uint8_t pendingWriteCount;
+  uint8_t extensionState;       // handleExtensionControllerReports()
+  recv_data_rb receivedDataRb;
+  TinyWiimoteData receivedData[RECIEVED_DATA_MAX_NUM];
+};
+static wiimote_t wiimotes[TW_MAX_WIIMOTES];
+
+static wiimote_t* findWiimote(uint16_t handle) {
+  for (uint8_t i = 0; i < TW_MAX_WIIMOTES; i++) {
+    if (wiimotes[i].inUse && (wiimotes[i].handle == handle))
+      return &wiimotes[i];
+  }
+  return NULL;
+}
+
+static bool wiimoteAddrInUse(const bd_addr_t& bdAddr) {
+  for (uint8_t i = 0; i < TW_MAX_WIIMOTES; i++) {
+    if (wiimotes[i].inUse && (memcmp(wiimotes[i].bdAddr.addr, bdAddr.addr, BD_ADDR_LEN) == 0))
+      return true;
+  }
+  return false;
+}
+
+static uint8_t wiimoteNumber(const wiimote_t& w) {
+  return (uint8_t)(&w - wiimotes);
+}
+
+static uint8_t wiimotesInUse(void) {
+  uint8_t n = 0;
+  for (uint8_t i = 0; i < TW_MAX_WIIMOTES; i++) {
+    if (wiimotes[i].inUse)
+      n++;
+  }
+  return n;
+}
+
+// Forgets everything about the connection; the address and LEDs are kept for the next one
+static void clearWiimoteConnection(wiimote_t& w) {
+  w.inUse = false;
+  w.connected = false;
+  w.nunchukConnected = false;
+  w.rumbleOn = false;
+  w.accelCalibrationValid = false;
+  w.irCameraMode = TW_IR_MODE_OFF;
+  w.irInitStep = IR_INIT_IDLE;
+  w.irInitRetries = 0;
+  w.pendingWriteCount = 0;
+  w.extensionState = 0;
+}
+
+// Takes the slot this address used last, otherwise the lowest slot nobody used yet,
+// otherwise the lowest free slot. NULL when maxWiimotes are connected.
+static wiimote_t* allocWiimote(uint16_t handle, const bd_addr_t& bdAddr) {
+  if (wiimotesInUse() >= maxWiimotes)
+    return NULL;
+  wiimote_t* fresh = NULL;
+  wiimote_t* any = NULL;
+  for (uint8_t i = 0; i < maxWiimotes; i++) {
+    wiimote_t& w = wiimotes[i];
+    if (w.inUse)
+      continue;
+    if (w.hasAddr && (memcmp(w.bdAddr.addr, bdAddr.addr, BD_ADDR_LEN) == 0)) {
+      fresh = any = &w;
+      break;
+    }
+    if (!w.hasAddr && (fresh == NULL))
+      fresh = &w;
+    if (any == NULL)
+      any = &w;
+  }
+  wiimote_t* w = (fresh != NULL) ? fresh : any;
+  if (w == NULL)
+    return NULL;
+  clearWiimoteConnection(*w);
+  w->inUse = true;
+  w->handle = handle;
+  w->bdAddr = bdAddr;
+  w->hasAddr = true;
+  memset(&w->receivedDataRb, 0, sizeof(w->receivedDataRb)); // drop reports of the last connection
+  return w;
+}
 
 /**
  * Command Maker
@@ -228,6 +352,17 @@ static uint16_t make_cmd_create_connection(uint8_t *buf, struct bd_addr_t bdAddr
     return HCI_H4_CMD_PREAMBLE_SIZE + HCIC_PARAM_SIZE_CREATE_CONNECTION;
 }
 
+static uint16_t make_cmd_disconnect(uint8_t *buf, uint16_t ch, uint8_t reason)
+{
+    UINT8_TO_STREAM (buf, H4_TYPE_COMMAND);
+    UINT16_TO_STREAM (buf, HCI_OPCODE_DISCONNECT);
+    UINT8_TO_STREAM (buf, HCIC_PARAM_SIZE_DISCONNECT);
+
+    UINT16_TO_STREAM (buf, ch);     // Connection Handle
+    UINT8_TO_STREAM (buf, reason);  // Reason
+    return HCI_H4_CMD_PREAMBLE_SIZE + HCIC_PARAM_SIZE_DISCONNECT;
+}
+
 #define L2CAP_HEADER_LEN (4) //Length + Channel ID
 
 static uint16_t make_l2cap_packet(uint8_t *buf, uint16_t channelID, uint8_t *data, uint16_t len) {
@@ -325,6 +460,13 @@ static int l2capAddConnection(struct l2cap_connection_t connection) {
   l2capConnectionList[l2capConnectionSize++] = connection;
   return l2capConnectionSize;
 }
+static void l2capRemoveConnection(uint16_t ch) {
+  int idx = l2capFindConnection(ch);
+  if(idx == -1){
+    return;
+  }
+  l2capConnectionList[idx] = l2capConnectionList[--l2capConnectionSize];
+}
 static void l2capClearConnection(void) {
   l2capConnectionSize = 0;
 }
@@ -335,10 +477,29 @@ static void resetDevice(void) {
   UNVERBOSE_PRINT("resetDevice\n");
   connected_device_clear();
   l2capClearConnection();
+  inquiryActive = false;
   uint16_t len = make_cmd_reset(tmpQueueData);
   sendHciPacket(tmpQueueData, len);
 }
 
+static void startInquiry(void) {
+  connected_device_clear();
+  uint16_t len = make_cmd_inquiry(tmpQueueData, 0x9E8B33, 0x05/*0x30*/, 0x00);
+  sendHciPacket(tmpQueueData, len);
+  inquiryActive = true;
+  VERBOSE_PRINTLN("queued inquiry");
+}
+
+// A connection ended or failed: reset the controller when no Wiimote is left (as with a
+// single Wiimote), otherwise keep the others and look for more
+static void restartDiscovery(void) {
+  if (wiimotesInUse() == 0) {
+    resetDevice();
+  } else if ((wiimotesInUse() < maxWiimotes) && !inquiryActive) {
+    startInquiry();
+  }
+}
+
 /**
  * HCI Event Handler
  */
@@ -394,10 +555,7 @@ static void handleCommandCompleteEvent(uint8_t len, uint8_t* data) {
         if(data[3] == 0x00){ // OK
           VERBOSE_PRINTLN("write_scan_enable succeeded");
 
-          connected_device_clear();
-          uint16_t len = make_cmd_inquiry(tmpQueueData, 0x9E8B33, 0x05/*0x30*/, 0x00);
-          sendHciPacket(tmpQueueData, len);
-          VERBOSE_PRINTLN("queued inquiry");
+          startInquiry();
         }else{
           VERBOSE_PRINTLN("write_scan_enable failed.");
         }
@@ -451,7 +609,8 @@ static void handleCommandStatusEvent(uint8_t len, uint8_t* data) {
 static void handleInquiryCompleteEvent(uint8_t len, uint8_t* data) {
     uint8_t status = data[0];
     VERBOSE_PRINT("inquiry_complete status=%02X", status);
-    resetDevice();
+    inquiryActive = false;
+    restartDiscovery();
 }
 
 static void handleInquiryResultEvent(uint8_t len, uint8_t* data) {
@@ -508,10 +667,11 @@ static void handleRemoteNameRequestCompleteEvent(uint8_t len, uint8_t* data) {
     VERBOSE_PRINT("  REMOTE_NAME = %s", name);
 
     int idx = findConnectedDevice(bdAddr);
-    if(0<=idx && strcmp("Nintendo RVL-CNT-01", name)==0){
-        {
+    if(0<=idx && strcmp("Nintendo RVL-CNT-01", name)==0 && wiimotesInUse() < maxWiimotes && !wiimoteAddrInUse(bdAddr)){
+        if(inquiryActive){
             uint16_t len = make_cmd_inquiry_cancel(tmpQueueData);
             sendHciPacket(tmpQueueData, len);
+            inquiryActive = false;
             VERBOSE_PRINTLN("queued inquiry_cancel");
         }
 
@@ -567,6 +727,18 @@ static void handleConnectionCompleteEvent(uint8_t len, uint8_t* data) {
     VERBOSE_PRINT("  Link_Type          = %02X", lt);
     VERBOSE_PRINT("  Encryption_Enabled = %02X", ee);
 
+    if(status != 0x00){
+      restartDiscovery();
+      return;
+    }
+    wiimote_t* w = allocWiimote(ch, bdAddr);
+    if(w == NULL){ // all slots taken (two Wiimotes answered the same inquiry)
+      uint16_t len = make_cmd_disconnect(tmpQueueData, ch, 0x13); // remote user terminated connection
+      sendHciPacket(tmpQueueData, len);
+      VERBOSE_PRINTLN("queued disconnect");
+      return;
+    }
+    UNVERBOSE_PRINT("Wiimote %d connecting (handle 0x%03X)\n", wiimoteNumber(*w), ch);
     l2capConnect(ch, 0x0013, 0x0045);
 }
 
@@ -580,10 +752,13 @@ static void handleDisconnectionCompleteEvent(uint8_t len, uint8_t* data) {
     VERBOSE_PRINT("Connection_Handle  = 0x%04X  ", ch);
     VERBOSE_PRINT("Reason             = %02X", reason);
 
-    UNVERBOSE_PRINT("Wiimote lost\n");
-    wiimoteConnected = false;
-    nunchukConnected = false;
-    resetDevice();
+    l2capRemoveConnection(ch);
+    wiimote_t* w = findWiimote(ch);
+    if(w != NULL){
+      UNVERBOSE_PRINT("Wiimote %d lost\n", wiimoteNumber(*w));
+      clearWiimoteConnection(*w);
+    }
+    restartDiscovery();
 }
 
 void handleHciEvent(uint8_t event_code, uint8_t len, uint8_t* data) {
@@ -755,7 +930,14 @@ static void handleL2capConfigurationRequest(uint16_t ch, uint8_t* data) {
   }
 }
 
-static void setPlayerLEDs(uint16_t ch, uint8_t leds) {
+// The rumble motor is controlled by bit0 of the first byte of every output
+// report, so every report must carry the current rumble state.
+static uint8_t rumbleBit(const wiimote_t& w) {
+  return w.rumbleOn ? 0x01 : 0x00;
+}
+
+static void setPlayerLEDs(const wiimote_t& w, uint8_t leds) {
+  uint16_t ch = w.handle;
   int idx = l2capFindConnection(ch);
   struct l2cap_connection_t connection = l2capConnectionList[idx];
 
@@ -769,13 +951,35 @@ static void setPlayerLEDs(uint16_t ch, uint8_t leds) {
   // Information Payload
   payload[posi++] = 0xA2;  // Output report
   payload[posi++] = 0x11;  // Function:Player LEDs
-  payload[posi++] = (uint8_t)(leds << 4); // LL:controls the four LEDs
+  payload[posi++] = (uint8_t)(leds << 4) | rumbleBit(w); // LL:controls the four LEDs
   uint16_t dataLen = posi;
   uint16_t len = make_acl_l2cap_packet(tmpQueueData, ch, pbf, bf, channelID, payload, dataLen);
   sendHciPacket(tmpQueueData, len);
   VERBOSE_PRINT("queued acl_l2cap_single_packet(Set LEDs)");
 }
 
+static void setRumble(const wiimote_t& w) {
+  uint16_t ch = w.handle;
+  int idx = l2capFindConnection(ch);
+  struct l2cap_connection_t connection = l2capConnectionList[idx];
+
+  uint8_t  pbf = 0b10; // Packet Boundary Flag
+  uint8_t  bf = 0b00; // Broadcast Flag
+  uint16_t channelID           = connection.remoteCID;
+
+  // create information payload of 'Basic information frame'
+  // wiimote report: (a2) 10 RR
+  uint8_t  posi = 0;
+  // Information Payload
+  payload[posi++] = 0xA2;  // Output report
+  payload[posi++] = 0x10;  // Function:Rumble
+  payload[posi++] = rumbleBit(w); // RR
+  uint16_t dataLen = posi;
+  uint16_t len = make_acl_l2cap_packet(tmpQueueData, ch, pbf, bf, channelID, payload, dataLen);
+  sendHciPacket(tmpQueueData, len);
+  VERBOSE_PRINT("queued acl_l2cap_single_packet(Rumble)");
+}
+
 enum address_space_t {
   EEPROM_MEMORY,
   CONTROL_REGISTER
@@ -793,7 +997,35 @@ static uint8_t getAddrSpace(int as)
 #define OFFSET_EEP_DATA (7)
 #define SIZE_EEP_DATA (16)
 
-static void writingEEPROM(uint16_t ch, int as, uint32_t offset, const uint8_t* eepData, uint8_t eepLen) {
+// Every write is acknowledged in order with (a1) 22 BB BB 16 EE. Remember who issued
+// each write so the extension detection and the IR camera setup can overlap.
+enum write_owner_t {
+  WRITE_OWNER_NONE,
+  WRITE_OWNER_EXTENSION,
+  WRITE_OWNER_IR_CAMERA
+};
+
+static void pushWriteOwner(wiimote_t& w, uint8_t owner) {
+  if (w.pendingWriteCount == PENDING_WRITE_MAX) { // should not happen; forget the oldest
+    w.pendingWriteRp = (w.pendingWriteRp + 1) % PENDING_WRITE_MAX;
+    w.pendingWriteCount--;
+  }
+  w.pendingWriteOwner[(w.pendingWriteRp + w.pendingWriteCount) % PENDING_WRITE_MAX] = owner;
+  w.pendingWriteCount++;
+}
+
+// Returns the owner of the write acknowledged by this report, WRITE_OWNER_NONE otherwise
+static uint8_t takeWriteAck(wiimote_t& w, uint8_t* data, uint16_t len) {
+  if ((len < 6) || (data[1] != 0x22) || (data[4] != 0x16) || (w.pendingWriteCount == 0))
+    return WRITE_OWNER_NONE;
+  uint8_t owner = w.pendingWriteOwner[w.pendingWriteRp];
+  w.pendingWriteRp = (w.pendingWriteRp + 1) % PENDING_WRITE_MAX;
+  w.pendingWriteCount--;
+  return owner;
+}
+
+static void writingEEPROM(wiimote_t& w, int as, uint32_t offset, const uint8_t* eepData, uint8_t eepLen, uint8_t owner) {
+  uint16_t ch = w.handle;
   int idx = l2capFindConnection(ch);
   struct l2cap_connection_t connection = l2capConnectionList[idx];
 
@@ -807,7 +1039,7 @@ static void writingEEPROM(uint16_t ch, int as, uint32_t offset, const uint8_t* e
   // Information Payload
   payload[posi++] = 0xA2;  // Output report
   payload[posi++] = 0x16;  // Function:Write Memory and Registers
-  payload[posi++] = getAddrSpace((int)as);  // MM Address space: 0x00=EEPROM, 0x04=ControlRegister
+  payload[posi++] = getAddrSpace((int)as) | rumbleBit(w);  // MM Address space: 0x00=EEPROM, 0x04=ControlRegister
   payload[posi++] = (uint8_t)((offset >> 16) & 0xFF); //FF
   payload[posi++] = (uint8_t)((offset >>  8) & 0xFF); //FF
   payload[posi++] = (uint8_t)((offset      ) & 0xFF); //FF
@@ -816,6 +1048,7 @@ static void writingEEPROM(uint16_t ch, int as, uint32_t offset, const uint8_t* e
   posi += SIZE_EEP_DATA;
 
   memcpy(payload+OFFSET_EEP_DATA, eepData, eepLen);
+  pushWriteOwner(w, owner);
 
   uint16_t dataLen = posi;
   uint16_t len = make_acl_l2cap_packet(tmpQueueData, ch, pbf, bf, channelID, payload, dataLen);
@@ -823,7 +1056,8 @@ static void writingEEPROM(uint16_t ch, int as, uint32_t offset, const uint8_t* e
   VERBOSE_PRINTLN("queued writingEEPROM");
 }
 
-static void readingEEPROM(uint16_t ch, int as, uint32_t offset, uint16_t size) {
+static void readingEEPROM(const wiimote_t& w, int as, uint32_t offset, uint16_t size) {
+  uint16_t ch = w.handle;
   int idx = l2capFindConnection(ch);
   struct l2cap_connection_t connection = l2capConnectionList[idx];
 
@@ -837,7 +1071,7 @@ static void readingEEPROM(uint16_t ch, int as, uint32_t offset, uint16_t size) {
   // Information Payload
   payload[posi++] = 0xA2;  // Output report
   payload[posi++] = 0x17;  // Function:Read Memory and Registers
-  payload[posi++] = getAddrSpace((int)as);  // MM Address space: 0x00=EEPROM, 0x04=ControlRegister
+  payload[posi++] = getAddrSpace((int)as) | rumbleBit(w);  // MM Address space: 0x00=EEPROM, 0x04=ControlRegister
   payload[posi++] = (uint8_t)((offset >> 16) & 0xFF); // FF
   payload[posi++] = (uint8_t)((offset >>  8) & 0xFF); // FF
   payload[posi++] = (uint8_t)((offset      ) & 0xFF); // FF
@@ -850,7 +1084,8 @@ static void readingEEPROM(uint16_t ch, int as, uint32_t offset, uint16_t size) {
   VERBOSE_PRINTLN("queued readingEEPROM");
 }
 
-static void setDataReportingMode(uint16_t ch, uint8_t mode, bool continuous) {
+static void setDataReportingMode(const wiimote_t& w, uint8_t mode, bool continuous) {
+  uint16_t ch = w.handle;
   UNVERBOSE_PRINT("setDataReportingMode 0x%02X (ch:%d)\n", (int)mode, (int)ch);
   int idx = l2capFindConnection(ch);
   struct l2cap_connection_t connection = l2capConnectionList[idx];
@@ -858,7 +1093,7 @@ static void setDataReportingMode(uint16_t ch, uint8_t mode, bool continuous) {
   uint8_t  pbf = 0b10; // Packet Boundary Flag
   uint8_t  bf = 0b00; // Broadcast Flag
   uint16_t channelID           = connection.remoteCID;
-  uint8_t  contReportIsDesired = continuous ? 0x04 : 0x00; // 0x00, 0x04
+  uint8_t  contReportIsDesired = (continuous ? 0x04 : 0x00) | rumbleBit(w); // 0x00, 0x04
 
   // create information payload of 'Basic information frame'
   // report: (a2) 12 TT MM
@@ -875,6 +1110,200 @@ static void setDataReportingMode(uint16_t ch, uint8_t mode, bool continuous) {
   VERBOSE_PRINTLN("queued setDataReportingMode");
 }
 
+// Picks the data reporting mode from the accelerometer/IR requests and extension state
+static uint8_t selectReportingMode(const wiimote_t& w) {
+  if (useIrCamera)
+    return w.nunchukConnected
+      ? (useAccelerometer
+        ? 0x37  // Core Buttons and Accelerometer with 10 IR bytes and 6 Extension Bytes: 37 BB BB AA AA AA II*10 EE*6
+        : 0x36) // Core Buttons with 10 IR bytes and 9 Extension Bytes: 36 BB BB II*10 EE*9
+      : 0x33;   // Core Buttons and Accelerometer with 12 IR bytes: 33 BB BB AA AA AA II*12
+  if (w.nunchukConnected)
+    return useAccelerometer
+      ? 0x35  // Core Buttons and Accelerometer with 16 Extension bytes: 35 BB BB AA AA AA EE EE ...
+      : 0x32; // Core Buttons with 8 Extension bytes : 32 BB BB EE EE EE EE EE EE EE EE
+  return useAccelerometer
+    ? 0x31  // Core Buttons and Accelerometer: 31 BB BB AA AA AA
+    : 0x30; // Core Buttons : 30 BB BB
+}
+
+/**
+ * IR camera
+ */
+// 0x33 carries the extended format (3 bytes per dot, with size), 0x36/0x37 the basic one
+static uint8_t irModeForReportingMode(uint8_t mode) {
+  return (mode == 0x33) ? TW_IR_MODE_EXTENDED : TW_IR_MODE_BASIC;
+}
+
+// Sensitivity blocks written to 0xB00000 (9 bytes) and 0xB0001A (2 bytes), Wii levels 1..5
+static const uint8_t irSensitivityBlock1[TW_IR_SENSITIVITY_MAX][9] = {
+  { 0x02, 0x00, 0x00, 0x71, 0x01, 0x00, 0x64, 0x00, 0xFE },
+  { 0x02, 0x00, 0x00, 0x71, 0x01, 0x00, 0x96, 0x00, 0xB4 },
+  { 0x02, 0x00, 0x00, 0x71, 0x01, 0x00, 0xAA, 0x00, 0x64 },
+  { 0x02, 0x00, 0x00, 0x71, 0x01, 0x00, 0xC8, 0x00, 0x36 },
+  { 0x07, 0x00, 0x00, 0x71, 0x01, 0x00, 0x72, 0x00, 0x20 },
+};
+static const uint8_t irSensitivityBlock2[TW_IR_SENSITIVITY_MAX][2] = {
+  { 0xFD, 0x05 },
+  { 0xB3, 0x04 },
+  { 0x63, 0x03 },
+  { 0x35, 0x03 },
+  { 0x1F, 0x03 },
+};
+
+enum ir_init_data_t {
+  IR_DATA_ENABLE,  // 0x13 / 0x1A: enable
+  IR_DATA_START,   // 0xB00030: 0x08
+  IR_DATA_BLOCK1,
+  IR_DATA_BLOCK2,
+  IR_DATA_MODE     // 0xB00033: camera mode
+};
+
+struct ir_init_step_t {
+  uint8_t report;   // output report; the step completes on its (a1) 22 BB BB RR 00 acknowledgement
+  uint32_t address; // register for 0x16 writes
+  uint8_t data;     // ir_init_data_t
+};
+
+// Initialization sequence from the camera documentation, one step per acknowledgement
+static const ir_init_step_t irInitSteps[] = {
+  { 0x13, 0,        IR_DATA_ENABLE }, // pixel clock
+  { 0x1A, 0,        IR_DATA_ENABLE }, // camera
+  { 0x16, 0xB00030, IR_DATA_START  },
+  { 0x16, 0xB00000, IR_DATA_BLOCK1 },
+  { 0x16, 0xB0001A, IR_DATA_BLOCK2 },
+  { 0x16, 0xB00033, IR_DATA_MODE   },
+  { 0x16, 0xB00030, IR_DATA_START  },
+};
+#define IR_INIT_STEPS (sizeof(irInitSteps) / sizeof(irInitSteps[0]))
+#define IR_INIT_MAX_RETRIES (3)
+
+// (a2) 13 EE / (a2) 1A EE : bit2 enables, bit1 requests an acknowledgement
+static void setIrCameraEnable(const wiimote_t& w, uint8_t report, bool enable) {
+  uint16_t ch = w.handle;
+  int idx = l2capFindConnection(ch);
+  struct l2cap_connection_t connection = l2capConnectionList[idx];
+
+  uint8_t  pbf = 0b10; // Packet Boundary Flag
+  uint8_t  bf = 0b00; // Broadcast Flag
+  uint16_t channelID           = connection.remoteCID;
+
+  uint8_t  posi = 0;
+  // Information Payload
+  payload[posi++] = 0xA2;  // Output report
+  payload[posi++] = report; // Function:IR Camera Enable (0x13) / IR Camera Enable 2 (0x1A)
+  payload[posi++] = (enable ? 0x06 : 0x00) | rumbleBit(w);
+
+  uint16_t dataLen = posi;
+  uint16_t len = make_acl_l2cap_packet(tmpQueueData, ch, pbf, bf, channelID, payload, dataLen);
+  sendHciPacket(tmpQueueData, len);
+  VERBOSE_PRINT("queued acl_l2cap_single_packet(IR camera 0x%02X)", report);
+}
+
+static void sendIrInitStep(wiimote_t& w) {
+  const ir_init_step_t& step = irInitSteps[w.irInitStep];
+  const uint8_t start = 0x08;
+  uint8_t level = irSensitivity - 1;
+  switch (step.data) {
+    case IR_DATA_ENABLE:
+      setIrCameraEnable(w, step.report, true);
+      break;
+    case IR_DATA_START:
+      writingEEPROM(w, CONTROL_REGISTER, step.address, &start, 1, WRITE_OWNER_IR_CAMERA);
+      break;
+    case IR_DATA_BLOCK1:
+      writingEEPROM(w, CONTROL_REGISTER, step.address, irSensitivityBlock1[level], 9, WRITE_OWNER_IR_CAMERA);
+      break;
+    case IR_DATA_BLOCK2:
+      writingEEPROM(w, CONTROL_REGISTER, step.address, irSensitivityBlock2[level], 2, WRITE_OWNER_IR_CAMERA);
+      break;
+    case IR_DATA_MODE:
+      writingEEPROM(w, CONTROL_REGISTER, step.address, &w.irInitMode, 1, WRITE_OWNER_IR_CAMERA);
+      break;
+  }
+}
+
+static void startIrCamera(wiimote_t& w, uint8_t mode) {
+  UNVERBOSE_PRINT("IR camera setup: mode %d, sensitivity %d\n", mode, irSensitivity);
+  w.irCameraMode = TW_IR_MODE_OFF;
+  w.irInitMode = mode;
+  w.irInitStep = 0;
+  sendIrInitStep(w);
+}
+
+static void stopIrCamera(wiimote_t& w) {
+  w.irInitStep = IR_INIT_IDLE;
+  w.irCameraMode = TW_IR_MODE_OFF;
+  setIrCameraEnable(w, 0x13, false);
+  setIrCameraEnable(w, 0x1A, false);
+}
+
+// Sets the reporting mode, setting up the camera first when its mode has to change
+static void applyReportingMode(wiimote_t& w) {
+  uint8_t mode = selectReportingMode(w);
+  if (useIrCamera && (w.irCameraMode != irModeForReportingMode(mode))) {
+    if (w.irInitStep == IR_INIT_IDLE) {
+      w.irInitRetries = 0;
+      startIrCamera(w, irModeForReportingMode(mode));
+    }
+    return; // the reporting mode is set when the setup completes
+  }
+  if (!useIrCamera && ((w.irCameraMode != TW_IR_MODE_OFF) || (w.irInitStep != IR_INIT_IDLE)))
+    stopIrCamera(w);
+  setDataReportingMode(w, mode, false);
+}
+
+static void handleIrCameraReports(wiimote_t& w, uint8_t* data, uint16_t len) {
+  if (w.irInitStep == IR_INIT_IDLE)
+    return;
+  // data report(Acknowledge output report): (a1) 22 BB BB RR EE
+  if ((len < 6) || (data[1] != 0x22) || (data[4] != irInitSteps[w.irInitStep].report))
+    return;
+  if (data[5] != 0x00) {
+    UNVERBOSE_PRINT("IR camera setup failed at step %d: %02X\n", w.irInitStep, data[5]);
+    w.irInitStep = IR_INIT_IDLE;
+    if (w.irInitRetries++ < IR_INIT_MAX_RETRIES)
+      startIrCamera(w, w.irInitMode);
+    return;
+  }
+  w.irInitStep++;
+  if (w.irInitStep < IR_INIT_STEPS) {
+    sendIrInitStep(w);
+    return;
+  }
+  w.irInitStep = IR_INIT_IDLE;
+  w.irCameraMode = w.irInitMode;
+  UNVERBOSE_PRINT("IR camera ready\n");
+  // the extension may have changed the wanted mode while the camera was being set up
+  applyReportingMode(w);
+}
+
+#define ACCEL_CAL_ADDRESS (0x0016)
+
+// Read response for the accelerometer calibration block:
+// (a1) 21 BB BB SE 00 16 X0 Y0 Z0 LL XG YG ZG LL VV CK
+// The checksum is the sum of the first 9 bytes plus 0x55.
+static void handleAccelCalibrationReport(wiimote_t& w, uint8_t* data, uint16_t len) {
+  if((data[1] != 0x21) || (len < 7 + TW_ACCEL_CAL_SIZE))
+    return;
+  if((data[5] != (ACCEL_CAL_ADDRESS >> 8)) || (data[6] != (ACCEL_CAL_ADDRESS & 0xFF)))
+    return;
+  if(data[4] & 0x0F){ // error flags (e.g. read from write-only memory)
+    UNVERBOSE_PRINT("Accelerometer calibration read failed: %02X\n", data[4]);
+    return;
+  }
+  uint8_t sum = 0x55;
+  for(int i = 0; i < TW_ACCEL_CAL_SIZE - 1; i++)
+    sum += data[7 + i];
+  if(sum != data[7 + TW_ACCEL_CAL_SIZE - 1]){
+    UNVERBOSE_PRINT("Accelerometer calibration checksum mismatch\n");
+    return;
+  }
+  memcpy(w.accelCalibration, data + 7, TW_ACCEL_CAL_SIZE);
+  w.accelCalibrationValid = true;
+  UNVERBOSE_PRINT("Accelerometer calibration: %s\n", format2Hex(w.accelCalibration, TW_ACCEL_CAL_SIZE));
+}
+
 enum {
     REPORT_STATE_INIT = 0,
     REPORT_STATE_WAIT_ACK_OUT_REPORT,
@@ -882,8 +1311,8 @@ enum {
     REPORT_STATE_WAIT_READ_RESPONSE,
 };
 
-static void handleExtensionControllerReports(uint16_t ch, uint16_t channelID, uint8_t* data, uint16_t len) {
-  static int controllerReportState = REPORT_STATE_INIT;
+static void handleExtensionControllerReports(wiimote_t& w, uint16_t channelID, uint8_t* data, uint16_t len) {
+  uint8_t& controllerReportState = w.extensionState;
 
   switch(controllerReportState){
   case REPORT_STATE_INIT:
@@ -893,16 +1322,12 @@ static void handleExtensionControllerReports(uint16_t ch, uint16_t channelID, ui
     if(data[1] == 0x20){
       if(data[4] & 0x02){ // extension controller is connected
         UNVERBOSE_PRINT("Extension controller connected\n");
-        writingEEPROM(ch, CONTROL_REGISTER, 0xA400F0, (const uint8_t[]){0x55}, 1);
+        writingEEPROM(w, CONTROL_REGISTER, 0xA400F0, (const uint8_t[]){0x55}, 1, WRITE_OWNER_EXTENSION);
         controllerReportState = REPORT_STATE_WAIT_ACK_OUT_REPORT;
       }else{ // extension controller is NOT connected
           UNVERBOSE_PRINT("Extension controller NOT connected\n");
-          nunchukConnected = false;
-          if (useAccelerometer)
-            setDataReportingMode(ch, 0x31, false); // Core Buttons and Accelerometer: 31 BB BB AA AA AA
-          else
-            setDataReportingMode(ch, 0x30, false); // Core Buttons : 30 BB BB
-        // [note] Core Buttons and Accelerometer with 12 IR bytes: 33 BB BB AA AA AA II II II II II II II II II II II II 
+          w.nunchukConnected = false;
+          applyReportingMode(w);
       }
     }
     break;
@@ -913,7 +1338,7 @@ static void handleExtensionControllerReports(uint16_t ch, uint16_t channelID, ui
     // (a1) 22 BB BB 16 04 : NG
     if((data[1] == 0x22) && (data[4] == 0x16)){
       if(data[5] == 0x00){
-        writingEEPROM(ch, CONTROL_REGISTER, 0xA400FB, (const uint8_t[]){0x00}, 1);
+        writingEEPROM(w, CONTROL_REGISTER, 0xA400FB, (const uint8_t[]){0x00}, 1, WRITE_OWNER_EXTENSION);
         controllerReportState = REPORT_STATE_WAIT_READ_COTRLLER_TYPE;
       }else{
         controllerReportState = REPORT_STATE_INIT;
@@ -924,7 +1349,7 @@ static void handleExtensionControllerReports(uint16_t ch, uint16_t channelID, ui
     VERBOSE_PRINT("REPORT_STATE_WAIT_READ_COTRLLER_TYPE\n");
     if((data[1] == 0x22) && (data[4] == 0x16)){
       if(data[5] == 0x00){
-        readingEEPROM(ch, CONTROL_REGISTER, 0xA400FA, 6); // read controller type
+        readingEEPROM(w, CONTROL_REGISTER, 0xA400FA, 6); // read controller type
         controllerReportState = REPORT_STATE_WAIT_READ_RESPONSE;
       }else{
         controllerReportState = REPORT_STATE_INIT;
@@ -939,11 +1364,8 @@ static void handleExtensionControllerReports(uint16_t ch, uint16_t channelID, ui
       if(memcmp(data+5, (const uint8_t[]){0x00, 0xFA}, 2) == 0){
         if(memcmp(data+7, (const uint8_t[]){0x00, 0x00, 0xA4, 0x20, 0x00, 0x00}, 6) == 0){ // Nunchuk
           UNVERBOSE_PRINT("Nunchuk detected\n");
-          nunchukConnected = true;
-          if (useAccelerometer)
-            setDataReportingMode(ch, 0x35, false); // Core Buttons and Accelerometer with 16 Extension bytes: 35 BB BB AA AA AA EE EE ...
-          else
-            setDataReportingMode(ch, 0x32, false); // Core Buttons with 8 Extension bytes : 32 BB BB EE EE EE EE EE EE EE EE
+          w.nunchukConnected = true;
+          applyReportingMode(w);
         }
         controllerReportState = REPORT_STATE_INIT;
       }
@@ -954,33 +1376,27 @@ static void handleExtensionControllerReports(uint16_t ch, uint16_t channelID, ui
 
 
 /**
- * Received Data
+ * Received Data (one ring per Wiimote)
  */
-struct recv_data_rb {
-  uint8_t wp;
-  uint8_t rp;
-  uint8_t cnt;
-};
-static recv_data_rb receivedDataRb;
-#define RECIEVED_DATA_MAX_NUM     (5)
-static TinyWiimoteData receivedData[RECIEVED_DATA_MAX_NUM];
+static int64_t currentRecvTimeUs = 0; // receive time of the HCI packet being handled
 
-void putWiimoteReceivedData(uint8_t number, uint8_t* data, uint8_t len) {
-  if(receivedDataRb.cnt < RECIEVED_DATA_MAX_NUM) {
-    TinyWiimoteData *target = &(receivedData[receivedDataRb.wp]);
+static void putWiimoteReceivedData(wiimote_t& w, uint8_t* data, uint8_t len) {
+  recv_data_rb& rb = w.receivedDataRb;
+  if(rb.cnt < RECIEVED_DATA_MAX_NUM) {
+    TinyWiimoteData *target = &(w.receivedData[rb.wp]);
     memcpy(target->data, data, len);
-    target->number = number;
+    target->number = wiimoteNumber(w);
     target->len = len;
-    receivedDataRb.wp = (receivedDataRb.wp + 1) % RECIEVED_DATA_MAX_NUM;
-    receivedDataRb.cnt++;
+    target->recvTimeUs = currentRecvTimeUs;
+    rb.wp = (rb.wp + 1) % RECIEVED_DATA_MAX_NUM;
+    rb.cnt++;
   }
   VERBOSE_PRINTLN("");
 }
 
-static void handleReport(uint8_t* data, uint16_t len) {
+static void handleReport(wiimote_t& w, uint8_t* data, uint16_t len) {
   VERBOSE_PRINT("REPORT len=%d data=%s", len, format2Hex(data, len));
-  uint8_t idx = 0; //only supports one wiimote
-  putWiimoteReceivedData(idx, data, len);
+  putWiimoteReceivedData(w, data, len);
 }
 
 static void handleL2capData(uint16_t ch, uint16_t channelID, uint8_t* data, uint16_t len) {
@@ -1000,17 +1416,33 @@ static void handleL2capData(uint16_t ch, uint16_t channelID, uint8_t* data, uint
       VERBOSE_PRINTLN("L2CAP CONFIGURATION RESPONSE");
       handleL2capConfigurationResponse(ch, data);
       break;
-    case BTCODE_HID:
-      if(!wiimoteConnected){
-        setPlayerLEDs(ch, 0b0001);
-        UNVERBOSE_PRINT("Wiimote detected\n");
-        wiimoteConnected = true;
-        if (useAccelerometer)
-          setDataReportingMode(ch, 0x31, false); // Core Buttons and Accelerometer: 31 BB BB AA AA AA
+    case BTCODE_HID: {
+      wiimote_t* w = findWiimote(ch);
+      if(w == NULL){ // refused connection, disconnect pending
+        break;
+      }
+      if(!w->connected){
+        setPlayerLEDs(*w, w->playerLEDs);
+        UNVERBOSE_PRINT("Wiimote %d detected\n", wiimoteNumber(*w));
+        w->connected = true;
+        if (useAccelerometer || useIrCamera)
+          applyReportingMode(*w);
+        readingEEPROM(*w, EEPROM_MEMORY, ACCEL_CAL_ADDRESS, TW_ACCEL_CAL_SIZE);
+        // look for the next player while there are free slots
+        if ((wiimotesInUse() < maxWiimotes) && !inquiryActive)
+          startInquiry();
       }
-      handleExtensionControllerReports(ch, channelID, data, len);
-      handleReport(data, len);
+      handleAccelCalibrationReport(*w, data, len);
+      {
+        uint8_t writeAck = takeWriteAck(*w, data, len);
+        if (writeAck != WRITE_OWNER_IR_CAMERA)
+          handleExtensionControllerReports(*w, channelID, data, len);
+        if (writeAck != WRITE_OWNER_EXTENSION)
+          handleIrCameraReports(*w, data, len);
+      }
+      handleReport(*w, data, len);
       break;
+    }
     default:
       // handleL2capData no impl
       VERBOSE_PRINT("  L2CAP len=%d data=%s\n", len, format2Hex(data, len));
@@ -1021,11 +1453,11 @@ static void handleL2capData(uint16_t ch, uint16_t channelID, uint8_t* data, uint
 
 void handleAclData(uint8_t* data, size_t len) {
     VERBOSE_PRINT("handleAclData\n");
-    if(!wiimoteConnected){
-      VERBOSE_PRINT("len=%d data=%s\n", len, format2Hex(data, len));
-    }
 
     uint16_t ch    = ((data[1] & 0x0F) << 8) | data[0]; // Connection Handle
+    if(findWiimote(ch) == NULL){
+      VERBOSE_PRINT("len=%d data=%s\n", len, format2Hex(data, len));
+    }
     uint8_t  pbf =  (data[1] & 0x30) >> 4; // Packet Boundary Flag
     uint8_t  bf =  (data[1] & 0xC0) >> 6; // Broadcast Flag
     uint16_t aclLen              =  (data[3] << 8) | data[2];
@@ -1043,7 +1475,8 @@ void handleAclData(uint8_t* data, size_t len) {
     handleL2capData(ch, channelID, data + 8, l2capLen);
 }
 
-void handleHciData(uint8_t* data, size_t len) {
+void handleHciData(uint8_t* data, size_t len, int64_t recvTimeUs) {
+    currentRecvTimeUs = recvTimeUs;
     switch(data[0]){
     case H4_TYPE_EVENT:
       handleHciEvent(data[1], data[2], data+3);
@@ -1066,29 +1499,133 @@ bool TinyWiimoteDeviceIsInited(void) {
   return deviceInited;
 }
 
-int TinyWiimoteAvailable() {
-  return receivedDataRb.cnt;
+void TinyWiimoteSetMaxWiimotes(uint8_t num) {
+    if (num < 1)
+      num = 1;
+    if (num > TW_MAX_WIIMOTES)
+      num = TW_MAX_WIIMOTES;
+    bool more = (num > maxWiimotes);
+    maxWiimotes = num;
+    if (more && (wiimotesInUse() > 0) && !inquiryActive)
+      startInquiry();
 }
 
-TinyWiimoteData TinyWiimoteRead() {
+uint8_t TinyWiimoteMaxWiimotes(void) {
+    return maxWiimotes;
+}
+
+uint8_t TinyWiimoteConnectedCount(void) {
+    uint8_t n = 0;
+    for (uint8_t i = 0; i < TW_MAX_WIIMOTES; i++) {
+      if (wiimotes[i].connected)
+        n++;
+    }
+    return n;
+}
+
+int TinyWiimoteAvailable(uint8_t number) {
+  if (number >= TW_MAX_WIIMOTES)
+    return 0;
+  return wiimotes[number].receivedDataRb.cnt;
+}
+
+TinyWiimoteData TinyWiimoteRead(uint8_t number) {
   TinyWiimoteData target;
-  target.number = 0;
+  target.number = number;
   target.len = 0;
-  if(receivedDataRb.cnt > 0) {
-    target = receivedData[receivedDataRb.rp];
-    receivedDataRb.rp = (receivedDataRb.rp + 1) % RECIEVED_DATA_MAX_NUM;
-    receivedDataRb.cnt--;
+  target.recvTimeUs = 0;
+  if (number >= TW_MAX_WIIMOTES)
+    return target;
+  wiimote_t& w = wiimotes[number];
+  if(w.receivedDataRb.cnt > 0) {
+    target = w.receivedData[w.receivedDataRb.rp];
+    w.receivedDataRb.rp = (w.receivedDataRb.rp + 1) % RECIEVED_DATA_MAX_NUM;
+    w.receivedDataRb.cnt--;
   }
   return target;
 }
 
 void TinyWiimoteInit(TwHciInterface hciInterface) {
-    receivedDataRb.cnt = 0;
-    receivedDataRb.wp = 0;
-    receivedDataRb.rp = 0;
+    memset(wiimotes, 0, sizeof(wiimotes));
+    for (uint8_t i = 0; i < TW_MAX_WIIMOTES; i++) {
+      clearWiimoteConnection(wiimotes[i]);
+      wiimotes[i].playerLEDs = (uint8_t)(1 << i); // player 1..4
+    }
+    inquiryActive = false;
     _hciInterface = hciInterface;
 }
 
 void TinyWiimoteReqAccelerometer(bool use) {
+    bool changed = (useAccelerometer != use);
     useAccelerometer = use;
+    if (!changed)
+      return;
+    for (uint8_t i = 0; i < TW_MAX_WIIMOTES; i++) {
+      if (wiimotes[i].connected)
+        applyReportingMode(wiimotes[i]);
+    }
+}
+
+bool TinyWiimoteAccelerometerEnabled(void) {
+    return useAccelerometer;
+}
+
+void TinyWiimoteSetPlayerLEDs(uint8_t leds, uint8_t number) {
+    if (number >= TW_MAX_WIIMOTES)
+      return;
+    wiimote_t& w = wiimotes[number];
+    w.playerLEDs = leds & 0x0F;
+    if (w.connected)
+      setPlayerLEDs(w, w.playerLEDs);
+}
+
+bool TinyWiimoteSetRumble(bool on, uint8_t number) {
+    if ((number >= TW_MAX_WIIMOTES) || !wiimotes[number].connected)
+      return false;
+    wiimote_t& w = wiimotes[number];
+    w.rumbleOn = on;
+    setRumble(w);
+    return true;
+}
+
+bool TinyWiimoteConnected(uint8_t number) {
+    return (number < TW_MAX_WIIMOTES) && wiimotes[number].connected;
+}
+
+bool TinyWiimoteNunchukConnected(uint8_t number) {
+    return (number < TW_MAX_WIIMOTES) && wiimotes[number].nunchukConnected;
+}
+
+void TinyWiimoteReqIrCamera(bool use, uint8_t sensitivity) {
+    if (sensitivity < 1)
+      sensitivity = 1;
+    if (sensitivity > TW_IR_SENSITIVITY_MAX)
+      sensitivity = TW_IR_SENSITIVITY_MAX;
+    bool changed = (useIrCamera != use) || (use && (irSensitivity != sensitivity));
+    bool rewrite = use && (irSensitivity != sensitivity); // rewrite the sensitivity blocks
+    useIrCamera = use;
+    irSensitivity = sensitivity;
+    if (!changed)
+      return;
+    for (uint8_t i = 0; i < TW_MAX_WIIMOTES; i++) {
+      wiimote_t& w = wiimotes[i];
+      if (rewrite)
+        w.irCameraMode = TW_IR_MODE_OFF;
+      if (w.connected)
+        applyReportingMode(w);
+    }
+}
+
+bool TinyWiimoteIrCameraReady(uint8_t number) {
+    if (number >= TW_MAX_WIIMOTES)
+      return false;
+    const wiimote_t& w = wiimotes[number];
+    return useIrCamera && (w.irCameraMode != TW_IR_MODE_OFF) && (w.irInitStep == IR_INIT_IDLE);
+}
+
+bool TinyWiimoteGetAccelCalibration(uint8_t* out, uint8_t number) {
+    if ((number >= TW_MAX_WIIMOTES) || !wiimotes[number].accelCalibrationValid)
+      return false;
+    memcpy(out, wiimotes[number].accelCalibration, TW_ACCEL_CAL_SIZE);
+    return true;
 }
@@ -16,10 +16,12 @@
 #define _TINY_WIIMOTE_H_
 
 #define RECIEVED_DATA_MAX_LEN     (50)
+#define TW_MAX_WIIMOTES           (4)  // simultaneous connections, one per player LED
 struct TinyWiimoteData {
-  uint8_t number;
+  uint8_t number;                     // connection slot 0..TW_MAX_WIIMOTES-1
   uint8_t data[RECIEVED_DATA_MAX_LEN];
   uint8_t len;
+  int64_t recvTimeUs; // esp_timer time the HCI packet reached the host
 };
 //#define TWII_OFFSET_BTNS1 (2)
 //#define TWII_OFFSET_BTNS2 (3)
@@ -30,15 +32,43 @@ typedef struct tinywii_device_callback {
 } TwHciInterface;
 
 void TinyWiimoteInit(TwHciInterface hciInterface);
-int TinyWiimoteAvailable(void);
-TinyWiimoteData TinyWiimoteRead(void);
+// Reports are queued per connection; number selects the slot (player = number + 1)
+int TinyWiimoteAvailable(uint8_t number = 0);
+TinyWiimoteData TinyWiimoteRead(uint8_t number = 0);
+
+// Connections to accept (1..TW_MAX_WIIMOTES, default 1). While fewer are connected the
+// inquiry keeps running, which costs radio time on the connected links.
+void TinyWiimoteSetMaxWiimotes(uint8_t num);
+uint8_t TinyWiimoteMaxWiimotes(void);
+uint8_t TinyWiimoteConnectedCount(void);
 
 void TinyWiimoteResetDevice(void);
 bool TinyWiimoteDeviceIsInited(void);
 
-void TinyWiimoteReqAccelerometer(bool use);
+void TinyWiimoteReqAccelerometer(bool use); // re-applies the reporting mode on every connection
+bool TinyWiimoteAccelerometerEnabled(void);
+// bit0..3 = LED1..4, kept across reconnects (default: LED number+1)
+void TinyWiimoteSetPlayerLEDs(uint8_t leds, uint8_t number = 0);
+bool TinyWiimoteSetRumble(bool on, uint8_t number = 0); // false if that Wiimote is not connected
+bool TinyWiimoteConnected(uint8_t number = 0);
+bool TinyWiimoteNunchukConnected(uint8_t number = 0);
+
+#define TW_IR_MODE_OFF            (0)
+#define TW_IR_MODE_BASIC          (1)  // 10 bytes for 4 dots (reports 0x36/0x37)
+#define TW_IR_MODE_EXTENDED       (3)  // 12 bytes for 4 dots with size (report 0x33)
+#define TW_IR_SENSITIVITY_MAX     (5)
+#define TW_IR_SENSITIVITY_DEFAULT (3)
+// Sets up the IR camera (sensitivity 1..5) and switches to reports 0x33/0x36/0x37.
+// The camera mode follows the extension: extended without one, basic with a nunchuk.
+void TinyWiimoteReqIrCamera(bool use, uint8_t sensitivity);
+bool TinyWiimoteIrCameraReady(uint8_t number = 0); // setup finished and IR data is being reported
+
+#define TW_ACCEL_CAL_SIZE (10)
+// Copies the accelerometer calibration block read from EEPROM 0x0016 after connecting.
+// Returns false until a block with a valid checksum has been received.
+bool TinyWiimoteGetAccelCalibration(uint8_t* out, uint8_t number = 0);
 
-void handleHciData(uint8_t* data, size_t len);
+void handleHciData(uint8_t* data, size_t len, int64_t recvTimeUs);
 
 char* format2Hex(uint8_t* data, uint16_t len);
 
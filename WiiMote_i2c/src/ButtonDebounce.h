@@ -0,0 +1,159 @@
+// 檔案: ButtonDebounce.h
+// 作用: 按鈕去彈跳 / 雜訊濾除 (S1 讀到 Wiimote 回報之後、記錄按鈕邊緣之前)
+//
+// 所有按鈕 (wiimoteButtonSet 的 24 位元，最多 32 個) 一起以位元運算處理:
+// 每個按鈕一個 4 位元的倒數計數器，存成 4 個位元平面 (垂直計數器)，
+// 一次減一對所有按鈕同時進行，耗時與按鈕數量無關。
+//
+// 每個按鈕可分別設定:
+//   - 按下 / 放開各自的視窗 (0 ~ DEBOUNCE_WINDOW_MAX 個 tick)
+//   - 模式:
+//       立即 (eager)  第一個邊緣立即輸出 (不增加延遲)，之後視窗內的變化都忽略；
+//                     視窗結束時原始狀態與輸出不同就再輸出一次 (視窗內真的放開也不會遺失)
+//       延遲 (defer)  原始狀態連續維持整個視窗才輸出，短於視窗的雜訊脈衝完全濾掉
+// 視窗為 0 的按鈕不做任何處理。時間由呼叫端傳入 (微秒)，可在電腦上重現。
+
+#pragma once
+#include <stdint.h>
+#include <stddef.h>
+
+#define DEBOUNCE_TICK_US      1000   // 計數器的單位
+#define DEBOUNCE_PLANES       4
+#define DEBOUNCE_WINDOW_MAX   ((1 << DEBOUNCE_PLANES) - 1)   // 15 ms
+
+class ButtonDebouncer {
+public:
+    ButtonDebouncer() {
+        for (uint8_t k = 0; k < DEBOUNCE_PLANES; k++) {
+            _pressPlanes[k] = 0;
+            _releasePlanes[k] = 0;
+        }
+        _eager = 0;
+        reset(0, 0);
+    }
+
+    /**
+     * 設定按鈕的視窗 (毫秒，超過 DEBOUNCE_WINDOW_MAX 以上限計)
+     * @param mask 套用的按鈕 (wiimoteButtonSet 格式)
+     * @param eager true: 立即模式；false: 延遲模式
+     */
+    void configure(uint32_t mask, uint8_t pressMs, uint8_t releaseMs, bool eager) {
+        uint8_t press = ticksFor(pressMs);
+        uint8_t release = ticksFor(releaseMs);
+        for (uint8_t k = 0; k < DEBOUNCE_PLANES; k++) {
+            _pressPlanes[k] = (_pressPlanes[k] & ~mask) | ((press >> k) & 1 ? mask : 0);
+            _releasePlanes[k] = (_releasePlanes[k] & ~mask) | ((release >> k) & 1 ? mask : 0);
+        }
+        _eager = eager ? (_eager | mask) : (_eager & ~mask);
+    }
+
+    // 斷線或重新設定後: 輸出直接等於目前的原始狀態，計數器歸零
+    void reset(uint32_t buttons, uint32_t nowUs) {
+        _raw = buttons;
+        _stable = buttons;
+        for (uint8_t k = 0; k < DEBOUNCE_PLANES; k++) {
+            _count[k] = 0;
+        }
+        _tickUs = nowUs;
+        _rawEdges = 0;
+        _outEdges = 0;
+    }
+
+    /**
+     * 新的原始按鈕狀態 (每個 Wiimote 回報，或每次 loop() 以同一個狀態推進時間)
+     * @return 去彈跳後的按鈕
+     */
+    uint32_t update(uint32_t raw, uint32_t nowUs) {
+        // 1. 推進經過的 tick: 立即模式的鎖定與延遲模式中「與輸出不同」的按鈕倒數
+        uint32_t elapsed = (nowUs - _tickUs) / DEBOUNCE_TICK_US;
+        if (elapsed > DEBOUNCE_WINDOW_MAX) {
+            elapsed = DEBOUNCE_WINDOW_MAX;
+            _tickUs = nowUs;
+        } else {
+            _tickUs += elapsed * DEBOUNCE_TICK_US;
+        }
+        uint32_t counting = _eager | (_raw ^ _stable);
+        for (uint32_t i = 0; i < elapsed; i++) {
+            uint32_t mask = counting & nonzero();
+            if (mask == 0) {
+                break;
+            }
+            decrement(mask);
+        }
+
+        // 2. 延遲模式: 倒數到 0 時原始狀態仍不同就輸出
+        uint32_t idle = ~nonzero();
+        uint32_t flips = ~_eager & idle & (_raw ^ _stable);
+
+        // 3. 新的原始狀態
+        _rawEdges += (uint32_t)__builtin_popcount(raw ^ _raw);
+        _raw = raw;
+        uint32_t diff = raw ^ (_stable ^ flips);
+        // 視窗為 0 的延遲模式按鈕直接通過；立即模式在不鎖定時立即輸出
+        flips |= diff & idle & (_eager | ~windowMask(_stable ^ flips));
+        _stable ^= flips;
+        _outEdges += (uint32_t)__builtin_popcount(flips);
+
+        // 4. 重新載入計數器: 立即模式在輸出改變時開始鎖定；
+        //    延遲模式在原始狀態與輸出相同、或剛輸出 (下一個方向重新計時) 時回到整個視窗
+        uint32_t load = (_eager & flips) | (~_eager & (flips | ~(raw ^ _stable)));
+        uint32_t rising = _stable;   // 載入按鈕的下一個方向: 目前按下 -> 放開的視窗 (立即模式剛按下則是按下的鎖定)
+        for (uint8_t k = 0; k < DEBOUNCE_PLANES; k++) {
+            uint32_t eagerWindow = (rising & _pressPlanes[k]) | (~rising & _releasePlanes[k]);
+            uint32_t deferWindow = (rising & _releasePlanes[k]) | (~rising & _pressPlanes[k]);
+            uint32_t window = (_eager & eagerWindow) | (~_eager & deferWindow);
+            _count[k] = (_count[k] & ~load) | (load & window);
+        }
+        return _stable;
+    }
+
+    uint32_t buttons() const { return _stable; }
+    // 還有計數器在倒數 (呼叫端需要繼續以同一個狀態推進時間)
+    bool pending() const { return (nonzero() & (_eager | (_raw ^ _stable))) != 0; }
+    // 統計: 原始狀態與輸出的邊緣數 (差值就是濾掉的彈跳)
+    uint32_t rawEdges() const { return _rawEdges; }
+    uint32_t outputEdges() const { return _outEdges; }
+
+private:
+    static uint8_t ticksFor(uint8_t ms) {
+        uint32_t ticks = (uint32_t)ms * 1000 / DEBOUNCE_TICK_US;
+        return (uint8_t)(ticks > DEBOUNCE_WINDOW_MAX ? DEBOUNCE_WINDOW_MAX : ticks);
+    }
+
+    uint32_t nonzero() const {
+        uint32_t any = 0;
+        for (uint8_t k = 0; k < DEBOUNCE_PLANES; k++) {
+            any |= _count[k];
+        }
+        return any;
+    }
+
+    // 依目前輸出，下一個方向的延遲視窗是否不為 0
+    uint32_t windowMask(uint32_t stable) const {
+        uint32_t any = 0;
+        for (uint8_t k = 0; k < DEBOUNCE_PLANES; k++) {
+            any |= (stable & _releasePlanes[k]) | (~stable & _pressPlanes[k]);
+        }
+        return any;
+    }
+
+    // mask 中的計數器同時減一 (借位在位元平面之間傳遞)
+    void decrement(uint32_t mask) {
+        uint32_t borrow = mask;
+        for (uint8_t k = 0; k < DEBOUNCE_PLANES; k++) {
+            uint32_t bit = _count[k];
+            _count[k] = bit ^ borrow;
+            borrow &= ~bit;
+        }
+    }
+
+    uint32_t _count[DEBOUNCE_PLANES];          // 位元平面: bit i of _count[k] = 按鈕 i 計數器的第 k 位
+    uint32_t _pressPlanes[DEBOUNCE_PLANES];    // 按下的視窗
+    uint32_t _releasePlanes[DEBOUNCE_PLANES];  // 放開的視窗
+    uint32_t _eager;                           // 立即模式的按鈕
+    uint32_t _raw;                             // 上一次的原始狀態
+    uint32_t _stable;                          // 輸出
+    uint32_t _tickUs;
+    uint32_t _rawEdges;
+    uint32_t _outEdges;
+};
@@ -0,0 +1,58 @@
+// 檔案: SendScheduler.h
+// 作用: 決定 S1 何時把按鈕狀態送往 S3 (固定頻率 / 變化即送 / 混合)
+//
+// 不依賴 Arduino，時間由呼叫端以微秒傳入，方便在電腦上模擬。
+
+#pragma once
+#include <stdint.h>
+
+enum SendPolicy : uint8_t {
+    SEND_POLICY_FIXED_RATE = 0,  // 每 intervalUs 發送一次 (舊行為)
+    SEND_POLICY_ON_CHANGE,       // 狀態改變立即發送，閒置時只送心跳
+    SEND_POLICY_HYBRID,          // 狀態改變立即發送，另外維持 intervalUs 的固定刷新
+};
+
+class SendScheduler {
+public:
+    /**
+     * @param policy 發送策略
+     * @param intervalUs 固定頻率模式與混合模式的刷新間隔
+     * @param minSpacingUs 兩次發送之間的最小間隔，避免連續變化塞滿 UART
+     * @param heartbeatUs 變化即送模式下，閒置時的心跳間隔
+     */
+    SendScheduler(SendPolicy policy, uint32_t intervalUs, uint32_t minSpacingUs, uint32_t heartbeatUs)
+        : _policy(policy), _intervalUs(intervalUs), _minSpacingUs(minSpacingUs),
+          _heartbeatUs(heartbeatUs), _lastSendUs(0), _pending(true) {}
+
+    void setPolicy(SendPolicy policy) { _policy = policy; }
+    SendPolicy policy() const { return _policy; }
+
+    // 有新的狀態等待送出
+    void markChanged() { _pending = true; }
+
+    bool shouldSend(uint32_t nowUs) const {
+        uint32_t since = nowUs - _lastSendUs;
+        switch (_policy) {
+            case SEND_POLICY_ON_CHANGE:
+                return (_pending && since >= _minSpacingUs) || since >= _heartbeatUs;
+            case SEND_POLICY_HYBRID:
+                return (_pending && since >= _minSpacingUs) || since >= _intervalUs;
+            case SEND_POLICY_FIXED_RATE:
+            default:
+                return since >= _intervalUs;
+        }
+    }
+
+    void onSent(uint32_t nowUs) {
+        _lastSendUs = nowUs;
+        _pending = false;
+    }
+
+private:
+    SendPolicy _policy;
+    uint32_t _intervalUs;
+    uint32_t _minSpacingUs;
+    uint32_t _heartbeatUs;
+    uint32_t _lastSendUs;
+    bool _pending;
+};
@@ -1,25 +1,169 @@
 /*
- * ESP32-S1: Wiimote Button Sender (Continuous Polling Mode)
+ * ESP32-S1: Wiimote Button Sender
  * 
- * 持續讀取 Wiimote 狀態，並以固定頻率發送，以確保控制器響應流暢。
+ * 持續讀取 Wiimote 狀態 (最多 WIIMOTE_COUNT 支)，依照 SEND_POLICY 發送給 S3:
+ * - SEND_POLICY_FIXED_RATE: 固定 20ms 發送 (舊行為)
+ * - SEND_POLICY_ON_CHANGE : 狀態改變立即發送，閒置時送心跳
+ * - SEND_POLICY_HYBRID    : 狀態改變立即發送，並維持 20ms 的固定刷新
  */
 #include <Arduino.h>
 #include "ESP32Wiimote.h"
-#include "WiimoteData.h" // 確保你使用的是精簡版的 WiimoteData.h
+
+// WiimoteData.h 的 BUTTON_* 巨集會遮蔽 ESP32Wiimote 的同名列舉，先把 Nunchuk 按鈕位元取出來
+static const uint32_t NUNCHUK_BUTTON_C = BUTTON_C;
+static const uint32_t NUNCHUK_BUTTON_Z = BUTTON_Z;
+
+#include "WiimoteData.h" // S1/S3 共用的資料結構 (common/WiimoteLink)
+#include "WiimoteIr.h"   // 紅外線鏡頭點座標解碼
+#include "WiimoteLink.h" // S1 -> S3 訊框格式 (同步標記 + 序號 + CRC)
+#include "UartLinkTransport.h" // 以 Serial2 傳送訊框
+#include "SendScheduler.h"
+#include "ButtonEdges.h"    // 兩次送出之間的按鈕邊緣
+#include "ButtonDebounce.h" // 按鈕去彈跳
+#include "LinkBaudNegotiator.h"
+#include "LinkCommand.h"     // S3 -> S1 命令 (震動、燈號、回報模式)
+#include "esp_timer.h"
 
 // 定義 Serial2 使用的 GPIO
 #define TX2_PIN 17
 #define RX2_PIN 18
 
+// Serial2 可協商的最高速率 (可在 platformio.ini 以 -DLINK_MAX_BAUD=... 覆寫)
+#ifndef LINK_MAX_BAUD
+#define LINK_MAX_BAUD 5000000
+#endif
+
+// 定義發送策略 (可在 platformio.ini 以 -DSEND_POLICY=... 覆寫)
+#ifndef SEND_POLICY
+#define SEND_POLICY SEND_POLICY_ON_CHANGE
+#endif
+
 // 定義發送頻率
 // 50Hz (20ms) 是一個很好的遊戲控制器更新率
 #define SEND_INTERVAL_MS 20
 
+// 變化即送時兩個封包的最小間隔，與閒置時的心跳間隔
+#define SEND_MIN_SPACING_US 1000
+#define SEND_HEARTBEAT_MS 250
+
+// 每隔這麼久送一次全部欄位，S3 遺失訊框後也能恢復完整狀態
+#define STATE_KEYFRAME_MS 250
+
+// 按鈕去彈跳 (可在 platformio.ini 覆寫): 接點老化的 Wiimote 按一下會出現數次快速的按下 / 放開
+#define DEBOUNCE_MODE_OFF    0
+#define DEBOUNCE_MODE_EAGER  1   // 第一個邊緣立即送出，之後的彈跳忽略 (不增加延遲)
+#define DEBOUNCE_MODE_DEFER  2   // 維持整個視窗才送出，連單一的雜訊脈衝也濾掉
+#ifndef DEBOUNCE_MODE
+#define DEBOUNCE_MODE DEBOUNCE_MODE_EAGER
+#endif
+#ifndef DEBOUNCE_PRESS_MS
+#define DEBOUNCE_PRESS_MS 5      // 按下後的視窗
+#endif
+#ifndef DEBOUNCE_RELEASE_MS
+#define DEBOUNCE_RELEASE_MS 10   // 放開後的視窗 (放開時的彈跳通常比較久)
+#endif
+
+// 同時連線的 Wiimote 數 (可在 platformio.ini 以 -DWIIMOTE_COUNT=... 覆寫)
+// 玩家 1 走 LINK_MSG_STATE，其餘玩家以 LINK_MSG_PAD_STATE 帶手把編號送出，S3 對應到 USB_GAMEPADS 的其他手把
+// 還有空位時藍牙會持續查詢 (inquiry)，佔用已連線手把的無線電時間，所以預設只接一支
+#ifndef WIIMOTE_COUNT
+#define WIIMOTE_COUNT 1
+#endif
+#if WIIMOTE_COUNT < 1 || WIIMOTE_COUNT > TW_MAX_WIIMOTES
+#error "WIIMOTE_COUNT must be 1..TW_MAX_WIIMOTES"
+#endif
+
 ESP32Wiimote wiimote;
-unsigned long lastSendTime = 0;
 
-// 用一個變數來儲存最新的按鈕狀態
-uint16_t currentButtonState = 0;
+// 每支 Wiimote 各自的狀態、去彈跳與發送排程 (編號 = 玩家燈號 - 1)
+struct WiimotePlayer {
+    // 最新的 Wiimote 狀態，以及上一次送出的狀態 (用來只送有變化的欄位)
+    WiimoteState currentState;
+    WiimoteState sentState;
+    unsigned long lastKeyframeTime;
+    ButtonEdgeTracker buttonEdges;
+    ButtonDebouncer buttonDebouncer;
+    bool accelCalSent;           // 目前連線的加速度計校正值是否已送出 (只有玩家 1)
+    WiimoteIrState currentIr;    // 紅外線點座標獨立成 LINK_MSG_IR 送出 (只有玩家 1)
+    WiimoteIrState sentIr;
+    SendScheduler sendScheduler;
+
+    WiimotePlayer()
+        : lastKeyframeTime(0), accelCalSent(false),
+          sendScheduler(SEND_POLICY, SEND_INTERVAL_MS * 1000UL, SEND_MIN_SPACING_US, SEND_HEARTBEAT_MS * 1000UL) {}
+};
+WiimotePlayer players[WIIMOTE_COUNT];
+uint8_t debounceMode = DEBOUNCE_MODE;
+
+// S1 <-> S3 連線 (訊框編碼、序號與 S3 -> S1 方向的解析都在傳輸層內)
+UartLinkTransport linkTransport(Serial2);
+
+/**
+ * 將 payload 包裝成訊框送給 S3
+ */
+void sendLinkFrame(uint8_t type, const void* payload, uint8_t len) {
+    linkTransport.writeFrame(type, payload, len);
+}
+
+void setLinkBaud(uint32_t baud) {
+    linkTransport.setBaud(baud);
+    Serial.printf("Serial2 baud -> %lu\n", (unsigned long)baud);
+}
+
+LinkBaudNegotiator baudNegotiator(LINK_BAUD_INITIATOR, { sendLinkFrame, setLinkBaud });
+
+/**
+ * 執行 S3 送來的命令
+ * @return LinkCommandStatus
+ */
+uint8_t executeLinkCommand(uint8_t cmd, const uint8_t* args, uint8_t len) {
+    if (len < 1) {
+        return LINK_CMD_BAD_ARGS;
+    }
+    switch (cmd) {
+        case LINK_CMD_SET_LEDS:
+            // 未連線時也接受，連線後套用 (命令只針對玩家 1，其他玩家維持預設燈號)
+            wiimote.setPlayerLEDs(args[0]);
+            return LINK_CMD_OK;
+        case LINK_CMD_SET_RUMBLE:
+            return wiimote.setRumble(args[0] != 0) ? LINK_CMD_OK : LINK_CMD_NOT_CONNECTED;
+        case LINK_CMD_SET_REPORTING:
+            wiimote.setAccelerometer((args[0] & LINK_REPORT_ACCEL) != 0);
+            wiimote.setIrCamera((args[0] & LINK_REPORT_IR) != 0,
+                                len >= 2 ? args[1] : WIIMOTE_IR_SENSITIVITY_DEFAULT);
+            return LINK_CMD_OK;
+        default:
+            return LINK_CMD_UNKNOWN;
+    }
+}
+
+LinkCommandReceiver commandReceiver(sendLinkFrame, executeLinkCommand);
+
+/**
+ * 設定所有玩家、所有按鈕的去彈跳模式
+ */
+void setDebounceMode(uint8_t mode) {
+    debounceMode = mode;
+    for (uint8_t i = 0; i < WIIMOTE_COUNT; i++) {
+        WiimotePlayer& player = players[i];
+        if (mode == DEBOUNCE_MODE_OFF) {
+            player.buttonDebouncer.configure(0xFFFFFFFF, 0, 0, true);
+        } else {
+            player.buttonDebouncer.configure(0xFFFFFFFF, DEBOUNCE_PRESS_MS, DEBOUNCE_RELEASE_MS,
+                                             mode == DEBOUNCE_MODE_EAGER);
+        }
+        player.buttonDebouncer.reset(wiimoteButtonSet(player.currentState), micros());
+    }
+}
+
+/**
+ * 所有玩家改用同一種發送策略
+ */
+void setSendPolicy(SendPolicy policy) {
+    for (uint8_t i = 0; i < WIIMOTE_COUNT; i++) {
+        players[i].sendScheduler.setPolicy(policy);
+    }
+}
 
 void setup() {
     Serial.begin(115200);
@@ -27,30 +171,257 @@ void setup() {
     Serial2.begin(115200, SERIAL_8N1, RX2_PIN, TX2_PIN);
     wiimote.init();
     wiimote.addFilter(ACTION_IGNORE, FILTER_ACCEL);
-    Serial.println("Sender Ready. Waiting for Wiimote connection...");
+    wiimote.setMaxControllers(WIIMOTE_COUNT);
+    baudNegotiator.begin(millis(), LINK_MAX_BAUD, linkTransport.rxStats());
+    for (uint8_t i = 0; i < WIIMOTE_COUNT; i++) {
+        wiimoteStateReset(players[i].currentState);
+        wiimoteStateReset(players[i].sentState);
+        wiimoteIrReset(players[i].currentIr);
+        wiimoteIrReset(players[i].sentIr);
+    }
+    setDebounceMode(DEBOUNCE_MODE);
+    Serial.printf("Sender Ready. Waiting for %d Wiimote connection(s)...\n", WIIMOTE_COUNT);
 }
 
-void loop() {
-    // 總是要檢查 Wiimote 的任務
-    wiimote.task();
+/**
+ * 透過除錯序列埠在執行期切換發送策略與去彈跳模式
+ * 'f': 固定頻率, 'c': 變化即送, 'h': 混合, 'd': 去彈跳 (立即 -> 延遲 -> 關閉)
+ */
+void handleDebugCommand() {
+    if (Serial.available() <= 0) {
+        return;
+    }
+    switch (Serial.read()) {
+        case 'f':
+            setSendPolicy(SEND_POLICY_FIXED_RATE);
+            Serial.println("Send policy: fixed-rate");
+            break;
+        case 'c':
+            setSendPolicy(SEND_POLICY_ON_CHANGE);
+            Serial.println("Send policy: on-change");
+            break;
+        case 'h':
+            setSendPolicy(SEND_POLICY_HYBRID);
+            Serial.println("Send policy: hybrid");
+            break;
+        case 'd': {
+            static const char* const names[] = { "off", "eager", "defer" };
+            for (uint8_t i = 0; i < WIIMOTE_COUNT; i++) {
+                Serial.printf("Debounce P%d: %lu raw edges, %lu passed\n", i + 1,
+                              (unsigned long)players[i].buttonDebouncer.rawEdges(),
+                              (unsigned long)players[i].buttonDebouncer.outputEdges());
+            }
+            setDebounceMode((uint8_t)((debounceMode + 1) % 3));
+            Serial.printf("Debounce mode: %s\n", names[debounceMode]);
+            break;
+        }
+        default:
+            break;
+    }
+}
 
-    // 如果 Wiimote 狀態有更新，就更新我們儲存的狀態變數
-    if (wiimote.available() > 0) {
-        currentButtonState = wiimote.getButtonState();
+/**
+ * 從 ESP32Wiimote 收集一支 Wiimote 目前所有已解碼的狀態
+ * @param number Wiimote 編號 (0 = 玩家 1)
+ */
+void readWiimoteState(uint8_t number, WiimoteState& state) {
+    uint32_t buttons = wiimote.getButtonState(number);
+    state.buttons = (uint16_t)buttons;
+    state.extButtons = ((buttons & NUNCHUK_BUTTON_C) ? EXT_BUTTON_C : 0) |
+                       ((buttons & NUNCHUK_BUTTON_Z) ? EXT_BUTTON_Z : 0);
+
+    NunchukState nunchuk = wiimote.getNunchukState(number);
+    state.nunchukX = nunchuk.xStick;
+    state.nunchukY = nunchuk.yStick;
+    state.nunchukAccelX = nunchuk.xAxis;
+    state.nunchukAccelY = nunchuk.yAxis;
+    state.nunchukAccelZ = nunchuk.zAxis;
+
+    AccelState accel = wiimote.getAccelState(number);
+    state.accelX = accel.xAxis;
+    state.accelY = accel.yAxis;
+    state.accelZ = accel.zAxis;
+
+    state.battery = wiimote.getBatteryLevel(number);
+    state.flags = (wiimote.isConnected(number) ? WIIMOTE_FLAG_CONNECTED : 0) |
+                  (wiimote.isNunchukConnected(number) ? WIIMOTE_FLAG_NUNCHUK : 0) |
+                  (wiimote.isAccelerometerEnabled() ? WIIMOTE_FLAG_ACCEL : 0) |
+                  (wiimote.isIrCameraReady(number) ? WIIMOTE_FLAG_IR : 0);
+}
+
+/**
+ * 從最近一個回報解出紅外線點座標 (鏡頭未開啟時清空)
+ */
+void readWiimoteIr(WiimoteIrState& ir) {
+    if (!wiimote.isIrCameraReady()) {
+        wiimoteIrReset(ir);
+        return;
+    }
+    size_t len;
+    const uint8_t* report = wiimote.getRawReport(len);
+    // 狀態回報等不含紅外線資料的回報維持上一次的點
+    wiimoteIrDecode(report, len, ir);
+}
+
+/**
+ * 將玩家 1 的 Wiimote EEPROM 加速度計校正值送給 S3 (尚未讀到時不送)
+ */
+void sendAccelCalibration() {
+    AccelCalibration cal;
+    if (!wiimote.getAccelCalibration(cal)) {
+        players[0].accelCalSent = false;   // 斷線後重新連線要再送一次
+        return;
+    }
+    WiimoteAccelCalibration payload;
+    for (uint8_t i = 0; i < 3; i++) {
+        payload.zero[i] = cal.zero[i];
+        payload.gravity[i] = cal.gravity[i];
+    }
+    sendLinkFrame(LINK_MSG_ACCEL_CAL, &payload, sizeof(payload));
+    players[0].accelCalSent = true;
+}
+
+/**
+ * 處理 S3 送來的訊框
+ */
+void handleLinkFrame(const LinkFrame& frame) {
+    uint32_t rxUs = (uint32_t)esp_timer_get_time();
+    if (baudNegotiator.handleFrame(frame, millis()) || commandReceiver.handleFrame(frame)) {
+        return;
+    }
+    switch (frame.type) {
+        case LINK_MSG_TIME_REQ:
+            // 時鐘同步: 填入收到與送出的時間後原樣送回
+            if (frame.len == sizeof(LinkTimeSyncPayload)) {
+                LinkTimeSyncPayload sync;
+                memcpy(&sync, frame.payload, sizeof(sync));
+                sync.t1 = rxUs;
+                sync.t2 = (uint32_t)esp_timer_get_time();
+                sendLinkFrame(LINK_MSG_TIME_RESP, &sync, sizeof(sync));
+            }
+            break;
+        default:
+            break;
     }
+}
 
-    // 使用 millis() 來控制發送頻率，這比 delay() 更好
-    if (millis() - lastSendTime >= SEND_INTERVAL_MS) {
-        lastSendTime = millis();
+/**
+ * 把一支 Wiimote 目前的狀態交給排程，必要時送給 S3
+ * 玩家 1 送 LINK_MSG_STATE (加上紅外線與校正值)，其他玩家送 LINK_MSG_PAD_STATE
+ * @param number Wiimote 編號 (0 = 玩家 1)
+ * @param force true: 不等排程立即送出 (中間狀態記錄已滿)
+ */
+void sendPlayerState(uint8_t number, bool force) {
+    WiimotePlayer& player = players[number];
+    if (wiimoteStateDiff(player.currentState, player.sentState) != 0) {
+        // 記錄造成這次變化的 HCI 回報時間，供 S3 計算端到端延遲
+        player.currentState.reportTimeUs = (uint32_t)wiimote.getReportTime(number);
+        player.sendScheduler.markChanged();
+    }
+    bool irChanged = memcmp(&player.currentIr, &player.sentIr, sizeof(player.currentIr)) != 0;
+    if (irChanged) {
+        player.sendScheduler.markChanged();
+    }
 
-        // 建立封包，內容為我們儲存的最新狀態
-        ButtonPacket packet_to_send;
-        packet_to_send.buttonState = currentButtonState;
+    // 連線後讀到校正值就立即送出，不必等下一個關鍵幀
+    if (number == 0 && !player.accelCalSent) {
+        sendAccelCalibration();
+    }
+
+    // 使用 micros() 由 SendScheduler 決定是否發送，這比 delay() 更好
+    uint32_t now = micros();
+    if (!player.sendScheduler.shouldSend(now) && !force) {
+        return;
+    }
+    player.sendScheduler.onSent(now);
 
-        // 不管狀態有沒有變，都發送一次
-        Serial2.write((uint8_t*)&packet_to_send, sizeof(packet_to_send));
-        
-        // (可選) 在本地監控視窗除錯，確認它在連續發送
-        // Serial.printf("Sent state: 0x%04X\n", currentButtonState);
+    // 只送有變化的欄位，定期補送完整狀態
+    uint8_t fields = wiimoteStateDiff(player.currentState, player.sentState);
+    if (fields != 0) {
+        // 只有帶著新變化的封包才附上時間戳，心跳封包不列入延遲統計
+        uint32_t age = (uint32_t)esp_timer_get_time() - player.currentState.reportTimeUs;
+        player.currentState.reportAgeUs = age > 0xFFFF ? 0xFFFF : (uint16_t)age;
+        fields |= STATE_FIELD_TIMESTAMP;
+    }
+    if (player.buttonEdges.needsReplay()) {
+        // 按鈕在這段期間內變化超過一次，附上中間狀態讓 S3 依序補送
+        player.buttonEdges.store(player.currentState);
+        fields |= STATE_FIELD_EDGES | STATE_FIELD_BUTTONS;
+    }
+    player.buttonEdges.clear();
+    bool keyframe = millis() - player.lastKeyframeTime >= STATE_KEYFRAME_MS;
+    if (keyframe) {
+        player.lastKeyframeTime = millis();
+        fields |= STATE_FIELD_ALL;
     }
-}
\ No newline at end of file
+    player.sentState = player.currentState;
+
+    // 包裝成訊框，S3 可偵測錯誤並重新同步
+    if (number > 0) {
+        uint8_t payload[1 + WIIMOTE_STATE_MAX_SIZE];
+        payload[0] = number;
+        size_t payloadLen = 1 + wiimoteStateEncode(payload + 1, player.currentState, fields);
+        sendLinkFrame(LINK_MSG_PAD_STATE, payload, payloadLen);
+        return;
+    }
+    uint8_t payload[WIIMOTE_STATE_MAX_SIZE];
+    size_t payloadLen = wiimoteStateEncode(payload, player.currentState, fields);
+    sendLinkFrame(LINK_MSG_STATE, payload, payloadLen);
+
+    // 紅外線點座標有變化時送出，鏡頭開啟時也隨關鍵幀重送
+    if (irChanged || (keyframe && (player.currentState.flags & WIIMOTE_FLAG_IR))) {
+        sendLinkFrame(LINK_MSG_IR, &player.currentIr, sizeof(player.currentIr));
+        player.sentIr = player.currentIr;
+    }
+
+    // 校正值隨關鍵幀重送，S3 重新開機或遺失訊框後也能收到
+    if (keyframe) {
+        sendAccelCalibration();
+    }
+
+    // (可選) 在本地監控視窗除錯，確認它在連續發送
+    // Serial.printf("Sent state: 0x%04X fields: 0x%02X\n", player.currentState.buttons, fields);
+}
+
+/**
+ * 處理一支 Wiimote 已收到的回報，必要時把狀態送給 S3
+ * @param number Wiimote 編號 (0 = 玩家 1)
+ */
+void updatePlayer(uint8_t number) {
+    WiimotePlayer& player = players[number];
+
+    // 如果 Wiimote 狀態有更新，就更新我們儲存的狀態變數
+    // (電量與連線旗標不會讓 available() 回報變化，因此每次都重新收集)
+    // 把已收到的回報逐一處理，每個回報都累積按鈕邊緣，快速點擊才不會在兩次送出之間遺失
+    // 邊緣記錄的是去彈跳後的狀態，接點彈跳不會變成補送的點擊；沒有新回報時也推進去彈跳的計時
+    do {
+        wiimote.available(number);
+        readWiimoteState(number, player.currentState);
+        if (number == 0) {
+            readWiimoteIr(player.currentIr);
+        }
+        uint32_t buttons = player.buttonDebouncer.update(wiimoteButtonSet(player.currentState), micros());
+        player.currentState.buttons = (uint16_t)buttons;
+        player.currentState.extButtons = (uint8_t)(buttons >> 16);
+        player.buttonEdges.update(buttons);
+        if (player.buttonEdges.full()) {
+            // 再變化一次就會覆蓋中間狀態: 不等排程也不等剩下的回報處理完，先把已記錄的送出
+            sendPlayerState(number, true);
+        }
+    } while (TinyWiimoteAvailable(number) > 0);
+    sendPlayerState(number, false);
+}
+
+void loop() {
+    // 總是要檢查 Wiimote 的任務
+    wiimote.task();
+    handleDebugCommand();
+
+    // 處理 S3 的回覆並推進速率協商
+    linkTransport.poll(handleLinkFrame);
+    baudNegotiator.task(millis());
+
+    for (uint8_t i = 0; i < WIIMOTE_COUNT; i++) {
+        updatePlayer(i);
+    }
+}
@@ -0,0 +1,70 @@
+// 檔案: ButtonEdges.h
+// 作用: 記錄兩次送出之間出現過的按鈕狀態，讓 S3 依序補送，快速點擊不會遺失
+//
+// 按鈕集合以 24 位元表示: bit0 ~ bit15 = buttons，bit16 ~ bit23 = extButtons。
+//
+// 例: 20ms 內按下又放開 A，取樣到的前後狀態都是「未按」，
+// 但 S1 記錄了 [A 按下, 未按]；封包帶上中間狀態 [A 按下]，
+// S3 先送一個 A 按下的報告，再送最終狀態。
+//
+// 不依賴 Arduino，可在電腦上測試。
+
+#pragma once
+#include <stdint.h>
+#include "WiimoteData.h"
+
+static_assert(BUTTON_C == ((uint32_t)EXT_BUTTON_C << 16) && BUTTON_Z == ((uint32_t)EXT_BUTTON_Z << 16),
+              "Nunchuk buttons must match wiimoteButtonSet");
+
+inline uint32_t wiimoteButtonSet(const WiimoteState& state) {
+    return ((uint32_t)state.extButtons << 16) | state.buttons;
+}
+
+inline uint32_t wiimoteEdgeState(const WiimoteState& state, uint8_t index) {
+    const uint8_t* e = state.edgeStates[index];
+    return ((uint32_t)e[2] << 16) | ((uint32_t)e[1] << 8) | e[0];
+}
+
+/**
+ * S1: 每處理一個 Wiimote 回報就呼叫 update()，送出時以 store() 寫入狀態並 clear()
+ */
+class ButtonEdgeTracker {
+public:
+    ButtonEdgeTracker() : _last(0), _count(0) {}
+
+    void update(uint32_t buttons) {
+        if (buttons == _last) {
+            return;
+        }
+        _last = buttons;
+        if (_count < WIIMOTE_EDGE_MAX + 1) {
+            _history[_count++] = buttons;
+        } else {
+            // 呼叫端應在 full() 時立即送出；若仍來不及，只保留最新的狀態
+            _history[WIIMOTE_EDGE_MAX] = buttons;
+        }
+    }
+
+    // 變化超過一次，只靠最終狀態無法表達
+    bool needsReplay() const { return _count > 1; }
+
+    // 再變化一次就無法完整記錄，應立即送出
+    bool full() const { return _count == WIIMOTE_EDGE_MAX + 1; }
+
+    // 寫入最終狀態之前的中間狀態
+    void store(WiimoteState& state) const {
+        state.edgeCount = _count > 0 ? _count - 1 : 0;
+        for (uint8_t i = 0; i < state.edgeCount; i++) {
+            state.edgeStates[i][0] = (uint8_t)_history[i];
+            state.edgeStates[i][1] = (uint8_t)(_history[i] >> 8);
+            state.edgeStates[i][2] = (uint8_t)(_history[i] >> 16);
+        }
+    }
+
+    void clear() { _count = 0; }
+
+private:
+    uint32_t _last;
+    uint32_t _history[WIIMOTE_EDGE_MAX + 1];  // 依序記錄，最後一個就是目前狀態
+    uint8_t _count;
+};
@@ -0,0 +1,306 @@
+// 檔案: LinkBaudNegotiator.cpp
+// 作用: UART 速率協商狀態機實作
+
+#include "LinkBaudNegotiator.h"
+#include <string.h>
+
+// 可協商的速率，由低到高；索引 0 為開機時的基本速率
+static const uint32_t LINK_BAUD_RATES[] = {
+    115200, 230400, 460800, 921600, 1500000, 2000000, 3000000, 5000000
+};
+#define LINK_BAUD_RATE_COUNT (sizeof(LINK_BAUD_RATES) / sizeof(LINK_BAUD_RATES[0]))
+
+// PROBE 的填充資料，包含交替位元與長串 0/1，用來檢驗取樣邊界
+static const uint8_t LINK_PROBE_PATTERN[24] = {
+    0x55, 0xAA, 0x55, 0xAA, 0x00, 0xFF, 0x00, 0xFF,
+    0x0F, 0xF0, 0x33, 0xCC, 0x00, 0x00, 0xFF, 0xFF,
+    0x01, 0x80, 0xFE, 0x7F, 0xA5, 0x5A, 0x96, 0x69
+};
+
+// 以 (int32_t) 差值比較，millis() 溢位時仍正確
+static inline bool timeReached(uint32_t nowMs, uint32_t targetMs) {
+    return (int32_t)(nowMs - targetMs) >= 0;
+}
+
+static inline uint32_t readBaud(const LinkFrame& frame) {
+    uint32_t baud = 0;
+    if (frame.len >= sizeof(baud)) {
+        memcpy(&baud, frame.payload, sizeof(baud));
+    }
+    return baud;
+}
+
+LinkBaudNegotiator::LinkBaudNegotiator(LinkBaudRole role, LinkBaudInterface io)
+    : _role(role), _io(io), _state(STATE_IDLE),
+      _active(0), _current(0), _pending(0), _maxIndex(0), _fallbacks(0), _proposeFailures(0),
+      _deadlineMs(0), _nextActionMs(0), _lastRxMs(0), _lastStatusMs(0),
+      _probesSeen(0), _probeErrorBase(0),
+      _haveBaseline(false), _baseFramesOk(0), _baseErrors(0), _baseLocalErrors(0),
+      _rxStats(NULL) {}
+
+void LinkBaudNegotiator::begin(uint32_t nowMs, uint32_t maxBaud, const LinkStats& rxStats) {
+    _rxStats = &rxStats;
+    _state = STATE_IDLE;
+    _active = _current = _pending = 0;
+    _maxIndex = 0;
+    for (uint8_t i = 0; i < LINK_BAUD_RATE_COUNT; i++) {
+        if (LINK_BAUD_RATES[i] <= maxBaud) {
+            _maxIndex = i;
+        }
+    }
+    _fallbacks = 0;
+    _proposeFailures = 0;
+    _haveBaseline = false;
+    _lastRxMs = nowMs;
+    _lastStatusMs = nowMs;
+    _nextActionMs = nowMs + LINK_BAUD_RETRY_DELAY_MS;
+}
+
+uint32_t LinkBaudNegotiator::currentBaud() const {
+    return LINK_BAUD_RATES[_active];
+}
+
+uint32_t LinkBaudNegotiator::errorCount(const LinkStats& stats) {
+    return stats.crcErrors + stats.lengthErrors + stats.seqGaps;
+}
+
+int LinkBaudNegotiator::indexOf(uint32_t baud) {
+    for (uint8_t i = 0; i < LINK_BAUD_RATE_COUNT; i++) {
+        if (LINK_BAUD_RATES[i] == baud) {
+            return i;
+        }
+    }
+    return -1;
+}
+
+void LinkBaudNegotiator::sendBaud(uint8_t type, uint32_t baud) {
+    _io.send_frame(type, &baud, sizeof(baud));
+}
+
+void LinkBaudNegotiator::switchTo(uint8_t index) {
+    if (index == _active) {
+        return;
+    }
+    _active = index;
+    _io.set_baud(LINK_BAUD_RATES[index]);
+}
+
+void LinkBaudNegotiator::propose(uint8_t index, uint32_t nowMs) {
+    _pending = index;
+    _state = STATE_PROPOSING;
+    _deadlineMs = nowMs + LINK_BAUD_PROPOSE_TIMEOUT_MS;
+    sendBaud(LINK_MSG_BAUD_PROPOSE, LINK_BAUD_RATES[index]);
+}
+
+/**
+ * 放棄目前速率，退回 index 並禁止再嘗試失敗的速率
+ */
+void LinkBaudNegotiator::fallBack(uint8_t index, uint32_t nowMs) {
+    if (_active > 0 && _maxIndex >= _active) {
+        _maxIndex = _active - 1;
+    }
+    switchTo(index);
+    _current = index;
+    _state = STATE_IDLE;
+    _fallbacks++;
+    _haveBaseline = false;
+    _lastRxMs = nowMs;
+    _nextActionMs = nowMs + LINK_BAUD_RETRY_DELAY_MS;
+}
+
+bool LinkBaudNegotiator::handleFrame(const LinkFrame& frame, uint32_t nowMs) {
+    _lastRxMs = nowMs;
+
+    switch (frame.type) {
+        case LINK_MSG_BAUD_PROPOSE: {
+            if (_role != LINK_BAUD_RESPONDER) {
+                return true;
+            }
+            uint32_t baud = readBaud(frame);
+            int index = indexOf(baud);
+            if (index < 0 || index > _maxIndex) {
+                sendBaud(LINK_MSG_BAUD_REJECT, baud);
+                return true;
+            }
+            // ACCEPT 以舊速率送出，set_baud 會先等它送完
+            sendBaud(LINK_MSG_BAUD_ACCEPT, baud);
+            switchTo((uint8_t)index);
+            _pending = (uint8_t)index;
+            _probesSeen = 0;
+            _state = STATE_WAIT_PROBE;
+            _deadlineMs = nowMs + LINK_BAUD_WAIT_PROBE_TIMEOUT_MS;
+            return true;
+        }
+
+        case LINK_MSG_BAUD_PROBE: {
+            if (_role != LINK_BAUD_RESPONDER) {
+                return true;
+            }
+            uint32_t baud = readBaud(frame);
+            if (_state == STATE_IDLE && baud == LINK_BAUD_RATES[_current]) {
+                // 先前的 CONFIRM 遺失，S1 還在送 PROBE
+                sendBaud(LINK_MSG_BAUD_CONFIRM, baud);
+                return true;
+            }
+            if (_state != STATE_WAIT_PROBE || baud != LINK_BAUD_RATES[_pending]) {
+                return true;
+            }
+            if (_probesSeen == 0) {
+                _probeErrorBase = errorCount(*_rxStats);
+            }
+            _probesSeen++;
+            if (_probesSeen >= LINK_BAUD_PROBES_REQUIRED) {
+                if (errorCount(*_rxStats) == _probeErrorBase) {
+                    _current = _pending;
+                    _state = STATE_IDLE;
+                    sendBaud(LINK_MSG_BAUD_CONFIRM, baud);
+                } else {
+                    // 期間有錯誤，重新計數；若一直無法通過，逾時後退回
+                    _probesSeen = 0;
+                }
+            }
+            return true;
+        }
+
+        case LINK_MSG_BAUD_ACCEPT:
+            if (_role == LINK_BAUD_INITIATOR && _state == STATE_PROPOSING &&
+                readBaud(frame) == LINK_BAUD_RATES[_pending]) {
+                switchTo(_pending);
+                _state = STATE_PROBING;
+                _deadlineMs = nowMs + LINK_BAUD_PROBE_TIMEOUT_MS;
+                _nextActionMs = nowMs;
+            }
+            return true;
+
+        case LINK_MSG_BAUD_REJECT:
+            if (_role == LINK_BAUD_INITIATOR && _state == STATE_PROPOSING) {
+                // 對方不支援此速率，不再往上嘗試
+                if (_pending > _current) {
+                    _maxIndex = _current;
+                }
+                _state = STATE_IDLE;
+            }
+            return true;
+
+        case LINK_MSG_BAUD_CONFIRM:
+            if (_role == LINK_BAUD_INITIATOR && _state == STATE_PROBING &&
+                readBaud(frame) == LINK_BAUD_RATES[_pending]) {
+                _current = _pending;
+                _state = STATE_IDLE;
+                _proposeFailures = 0;
+                _haveBaseline = false;
+                _nextActionMs = nowMs + LINK_BAUD_STEP_DELAY_MS;
+            }
+            return true;
+
+        case LINK_MSG_LINK_STATUS:
+            if (_role == LINK_BAUD_INITIATOR && frame.len == sizeof(LinkStatusPayload)) {
+                LinkStatusPayload status;
+                memcpy(&status, frame.payload, sizeof(status));
+                evaluateErrors(status, nowMs);
+            }
+            return true;
+
+        default:
+            return false;
+    }
+}
+
+/**
+ * 以 S3 回報的統計加上本端的接收錯誤計算錯誤率，超過門檻就降一級
+ */
+void LinkBaudNegotiator::evaluateErrors(const LinkStatusPayload& status, uint32_t nowMs) {
+    uint32_t localErrors = errorCount(*_rxStats);
+    if (_state != STATE_IDLE || status.baud != LINK_BAUD_RATES[_active] || !_haveBaseline) {
+        _baseFramesOk = status.framesOk;
+        _baseErrors = status.errors;
+        _baseLocalErrors = localErrors;
+        _haveBaseline = (_state == STATE_IDLE && status.baud == LINK_BAUD_RATES[_active]);
+        return;
+    }
+
+    uint32_t frames = status.framesOk - _baseFramesOk;
+    uint32_t errors = (status.errors - _baseErrors) + (localErrors - _baseLocalErrors);
+    _baseFramesOk = status.framesOk;
+    _baseErrors = status.errors;
+    _baseLocalErrors = localErrors;
+
+    if (_current > 0 && errors >= 2 && errors * 1000 > frames * LINK_BAUD_MAX_ERROR_PERMILLE) {
+        _maxIndex = _current - 1;
+        _fallbacks++;
+        _haveBaseline = false;
+        propose(_current - 1, nowMs);
+    }
+}
+
+void LinkBaudNegotiator::task(uint32_t nowMs) {
+    // 長時間收不到對方的訊框: 雙方各自退回基本速率，一定能重新會合
+    if (_active != 0 && timeReached(nowMs, _lastRxMs + LINK_SILENCE_TIMEOUT_MS)) {
+        fallBack(0, nowMs);
+        return;
+    }
+
+    if (_role == LINK_BAUD_INITIATOR) {
+        taskInitiator(nowMs);
+    } else {
+        taskResponder(nowMs);
+    }
+}
+
+void LinkBaudNegotiator::taskInitiator(uint32_t nowMs) {
+    switch (_state) {
+        case STATE_IDLE:
+            if (_current < _maxIndex && timeReached(nowMs, _nextActionMs)) {
+                propose(_current + 1, nowMs);
+            }
+            break;
+
+        case STATE_PROPOSING:
+            if (timeReached(nowMs, _deadlineMs)) {
+                // 沒收到 ACCEPT: S3 若已切換會在 WAIT_PROBE 逾時後自行退回
+                _state = STATE_IDLE;
+                _nextActionMs = nowMs + LINK_BAUD_RETRY_DELAY_MS;
+                if (++_proposeFailures >= 3 && _pending > _current) {
+                    _maxIndex = _current;
+                }
+            }
+            break;
+
+        case STATE_PROBING:
+            if (timeReached(nowMs, _deadlineMs)) {
+                fallBack(_pending > _current ? _current : 0, nowMs);
+            } else if (timeReached(nowMs, _nextActionMs)) {
+                uint8_t probe[sizeof(uint32_t) + sizeof(LINK_PROBE_PATTERN)];
+                uint32_t baud = LINK_BAUD_RATES[_pending];
+                memcpy(probe, &baud, sizeof(baud));
+                memcpy(probe + sizeof(baud), LINK_PROBE_PATTERN, sizeof(LINK_PROBE_PATTERN));
+                _io.send_frame(LINK_MSG_BAUD_PROBE, probe, sizeof(probe));
+                _nextActionMs = nowMs + LINK_BAUD_PROBE_INTERVAL_MS;
+            }
+            break;
+
+        default:
+            break;
+    }
+}
+
+void LinkBaudNegotiator::taskResponder(uint32_t nowMs) {
+    if (_state == STATE_WAIT_PROBE) {
+        if (timeReached(nowMs, _deadlineMs)) {
+            // 新速率沒有通過驗證，退回上一個可用速率
+            switchTo(_current);
+            _state = STATE_IDLE;
+            _fallbacks++;
+        }
+        return;
+    }
+
+    if (timeReached(nowMs, _lastStatusMs + LINK_STATUS_INTERVAL_MS)) {
+        _lastStatusMs = nowMs;
+        LinkStatusPayload status;
+        status.baud = LINK_BAUD_RATES[_active];
+        status.framesOk = _rxStats->framesOk;
+        status.errors = errorCount(*_rxStats);
+        _io.send_frame(LINK_MSG_LINK_STATUS, &status, sizeof(status));
+    }
+}
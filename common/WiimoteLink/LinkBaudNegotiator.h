@@ -0,0 +1,110 @@
+// 檔案: LinkBaudNegotiator.h
+// 作用: S1/S3 之間的 UART 速率協商與連線品質降速
+//
+// 流程 (S1 為發起端 initiator，S3 為回應端 responder):
+//   1. 雙方從 115200 開始
+//   2. S1 送出 BAUD_PROPOSE(rate)，S3 回覆 BAUD_ACCEPT 後切換速率
+//   3. S1 收到 ACCEPT 後切換，並持續送出 BAUD_PROBE
+//   4. S3 連續收到 LINK_BAUD_PROBES_REQUIRED 個 PROBE 且期間沒有任何錯誤，回覆 BAUD_CONFIRM
+//   5. S1 收到 CONFIRM 後，確認此速率可用並嘗試下一級；逾時則雙方各自退回上一個可用速率
+//
+// 運作中 S3 每 LINK_STATUS_INTERVAL_MS 回報一次接收統計 (同時作為心跳)，
+// S1 發現錯誤率超過門檻就降一級；任一方長時間收不到對方的訊框則直接退回 115200。
+//
+// 不依賴 Arduino，實際的送出與切換速率由 LinkBaudInterface 提供。
+
+#pragma once
+#include <stdint.h>
+#include "WiimoteLink.h"
+
+#define LINK_BAUD_PROPOSE_TIMEOUT_MS   100
+#define LINK_BAUD_PROBE_INTERVAL_MS    5
+#define LINK_BAUD_PROBE_TIMEOUT_MS     200
+#define LINK_BAUD_WAIT_PROBE_TIMEOUT_MS 300   // 必須大於 PROBE_TIMEOUT，確保 S3 比 S1 晚放棄
+#define LINK_BAUD_RETRY_DELAY_MS       500
+#define LINK_BAUD_STEP_DELAY_MS        50
+#define LINK_BAUD_PROBES_REQUIRED      8
+#define LINK_BAUD_MAX_ERROR_PERMILLE   20    // 錯誤率超過 2% 就降速
+#define LINK_STATUS_INTERVAL_MS        100
+#define LINK_SILENCE_TIMEOUT_MS        1000
+
+enum LinkBaudRole : uint8_t {
+    LINK_BAUD_INITIATOR,
+    LINK_BAUD_RESPONDER,
+};
+
+typedef struct link_baud_interface {
+    void (*send_frame)(uint8_t type, const void* payload, uint8_t len);
+    void (*set_baud)(uint32_t baud);  // 實作需先等待 TX 送完 (flush) 再切換
+} LinkBaudInterface;
+
+// LINK_MSG_LINK_STATUS 的內容: 回應端的接收統計
+struct __attribute__((packed)) LinkStatusPayload {
+    uint32_t baud;
+    uint32_t framesOk;
+    uint32_t errors;   // crcErrors + lengthErrors + seqGaps
+};
+
+class LinkBaudNegotiator {
+public:
+    LinkBaudNegotiator(LinkBaudRole role, LinkBaudInterface io);
+
+    // 以基本速率 (115200) 開始，maxBaud 為此端能接受的最高速率，rxStats 為本端解析器的統計
+    void begin(uint32_t nowMs, uint32_t maxBaud, const LinkStats& rxStats);
+
+    // 處理一個收到的訊框；回傳 true 代表是協商用訊框，呼叫端不需再處理
+    bool handleFrame(const LinkFrame& frame, uint32_t nowMs);
+
+    // 在 loop() 中呼叫
+    void task(uint32_t nowMs);
+
+    uint32_t currentBaud() const;
+    uint8_t fallbackCount() const { return _fallbacks; }
+    bool negotiating() const { return _state != STATE_IDLE; }
+
+private:
+    enum State : uint8_t {
+        STATE_IDLE,
+        STATE_PROPOSING,    // initiator: 等待 ACCEPT
+        STATE_PROBING,      // initiator: 已切換，送 PROBE 等待 CONFIRM
+        STATE_WAIT_PROBE,   // responder: 已切換，等待 PROBE
+    };
+
+    void propose(uint8_t index, uint32_t nowMs);
+    void sendBaud(uint8_t type, uint32_t baud);
+    void switchTo(uint8_t index);
+    void fallBack(uint8_t index, uint32_t nowMs);
+    void taskInitiator(uint32_t nowMs);
+    void taskResponder(uint32_t nowMs);
+    void evaluateErrors(const LinkStatusPayload& status, uint32_t nowMs);
+    static uint32_t errorCount(const LinkStats& stats);
+    static int indexOf(uint32_t baud);
+
+    LinkBaudRole _role;
+    LinkBaudInterface _io;
+    State _state;
+
+    uint8_t _active;      // UART 目前實際設定的速率
+    uint8_t _current;     // 目前確認可用的速率
+    uint8_t _pending;     // 協商中的速率
+    uint8_t _maxIndex;    // 允許嘗試的最高速率 (失敗後會下修)
+    uint8_t _fallbacks;
+    uint8_t _proposeFailures;
+
+    uint32_t _deadlineMs;
+    uint32_t _nextActionMs;
+    uint32_t _lastRxMs;
+    uint32_t _lastStatusMs;
+
+    // responder: PROBE 計數
+    uint8_t _probesSeen;
+    uint32_t _probeErrorBase;
+
+    // initiator: 上一次錯誤評估的基準
+    bool _haveBaseline;
+    uint32_t _baseFramesOk;
+    uint32_t _baseErrors;
+    uint32_t _baseLocalErrors;
+
+    const LinkStats* _rxStats;
+};
@@ -0,0 +1,171 @@
+// 檔案: LinkCommand.cpp
+// 作用: 命令通道的送出端與接收端實作
+
+#include "LinkCommand.h"
+#include <string.h>
+
+LinkCommandSender::LinkCommandSender(LinkCommandInterface io)
+    : _io(io), _count(0), _nextSeq(0) {
+    memset(&_stats, 0, sizeof(_stats));
+}
+
+bool LinkCommandSender::submit(uint8_t cmd, const void* args, uint8_t len) {
+    if (len > LINK_CMD_MAX_ARGS) {
+        return false;
+    }
+
+    // 尚未送出的同種命令直接以新參數取代
+    for (uint8_t i = 0; i < _count; i++) {
+        Entry& e = _queue[i];
+        if (e.cmd == cmd && !e.sent) {
+            memcpy(e.args, args, len);
+            e.len = len;
+            return true;
+        }
+    }
+
+    if (_count == LINK_CMD_QUEUE_SIZE) {
+        return false;
+    }
+    Entry& e = _queue[_count++];
+    e.cmd = cmd;
+    e.cmdSeq = 0;
+    e.len = len;
+    e.retries = 0;
+    e.sent = false;
+    e.sentMs = 0;
+    memcpy(e.args, args, len);
+    return true;
+}
+
+bool LinkCommandSender::handleFrame(const LinkFrame& frame) {
+    if (frame.type != LINK_MSG_CMD_ACK) {
+        return false;
+    }
+    if (frame.len < sizeof(LinkCommandAck)) {
+        return true;
+    }
+    LinkCommandAck ack;
+    memcpy(&ack, frame.payload, sizeof(ack));
+    for (uint8_t i = 0; i < _count; i++) {
+        const Entry& e = _queue[i];
+        if (e.sent && e.cmdSeq == ack.cmdSeq && e.cmd == ack.cmd) {
+            remove(i);
+            _stats.acked++;
+            if (_io.on_result) {
+                _io.on_result(ack.cmd, ack.status);
+            }
+            break;
+        }
+    }
+    // 找不到代表是重送後的重複確認，忽略
+    return true;
+}
+
+void LinkCommandSender::task(uint32_t nowMs) {
+    // 逾時重送或放棄
+    uint8_t i = 0;
+    while (i < _count) {
+        Entry& e = _queue[i];
+        if (e.sent && (uint32_t)(nowMs - e.sentMs) >= LINK_CMD_RETRY_MS) {
+            if (e.retries >= LINK_CMD_MAX_RETRIES) {
+                uint8_t cmd = e.cmd;
+                remove(i);
+                _stats.failed++;
+                if (_io.on_result) {
+                    _io.on_result(cmd, LINK_CMD_TIMEOUT);
+                }
+                continue;
+            }
+            e.retries++;
+            e.sentMs = nowMs;
+            _stats.retries++;
+            transmit(e);
+        }
+        i++;
+    }
+
+    // 視窗有空間時依序送出新命令
+    uint8_t window = inFlight();
+    for (i = 0; i < _count && window < LINK_CMD_WINDOW; i++) {
+        Entry& e = _queue[i];
+        if (e.sent || cmdInFlight(e.cmd, i)) {
+            continue;
+        }
+        e.cmdSeq = _nextSeq++;
+        e.sent = true;
+        e.sentMs = nowMs;
+        _stats.sent++;
+        transmit(e);
+        window++;
+    }
+}
+
+void LinkCommandSender::reset() {
+    _count = 0;
+}
+
+bool LinkCommandSender::pending(uint8_t cmd) const {
+    for (uint8_t i = 0; i < _count; i++) {
+        if (_queue[i].cmd == cmd) {
+            return true;
+        }
+    }
+    return false;
+}
+
+uint8_t LinkCommandSender::inFlight() const {
+    uint8_t n = 0;
+    for (uint8_t i = 0; i < _count; i++) {
+        if (_queue[i].sent) {
+            n++;
+        }
+    }
+    return n;
+}
+
+void LinkCommandSender::transmit(Entry& entry) {
+    uint8_t payload[sizeof(LinkCommandHeader) + LINK_CMD_MAX_ARGS];
+    payload[0] = entry.cmdSeq;
+    payload[1] = entry.cmd;
+    memcpy(payload + sizeof(LinkCommandHeader), entry.args, entry.len);
+    _io.send_frame(LINK_MSG_CMD, payload, (uint8_t)(sizeof(LinkCommandHeader) + entry.len));
+}
+
+void LinkCommandSender::remove(uint8_t index) {
+    for (uint8_t i = index; i + 1 < _count; i++) {
+        _queue[i] = _queue[i + 1];
+    }
+    _count--;
+}
+
+// 同種命令一次只送一個，避免較舊命令的重送在較新的命令之後才被執行
+bool LinkCommandSender::cmdInFlight(uint8_t cmd, uint8_t before) const {
+    for (uint8_t i = 0; i < before; i++) {
+        if (_queue[i].sent && _queue[i].cmd == cmd) {
+            return true;
+        }
+    }
+    return false;
+}
+
+LinkCommandReceiver::LinkCommandReceiver(void (*sendFrame)(uint8_t type, const void* payload, uint8_t len),
+                                         LinkCommandHandler handler)
+    : _sendFrame(sendFrame), _handler(handler), _executed(0) {}
+
+bool LinkCommandReceiver::handleFrame(const LinkFrame& frame) {
+    if (frame.type != LINK_MSG_CMD) {
+        return false;
+    }
+    if (frame.len < sizeof(LinkCommandHeader)) {
+        return true;
+    }
+    LinkCommandAck ack;
+    ack.cmdSeq = frame.payload[0];
+    ack.cmd = frame.payload[1];
+    ack.status = _handler(ack.cmd, frame.payload + sizeof(LinkCommandHeader),
+                          (uint8_t)(frame.len - sizeof(LinkCommandHeader)));
+    _executed++;
+    _sendFrame(LINK_MSG_CMD_ACK, &ack, sizeof(ack));
+    return true;
+}
@@ -0,0 +1,139 @@
+// 檔案: LinkCommand.h
+// 作用: S3 -> S1 方向的命令通道 (震動、玩家燈號、回報模式)
+//
+// S3 以 LINK_MSG_CMD 送出命令，每個命令帶有自己的命令序號 cmdSeq；
+// S1 執行後以 LINK_MSG_CMD_ACK 回覆同一個 cmdSeq 與執行結果。
+//   - 同時未確認的命令最多 LINK_CMD_WINDOW 個，其餘在佇列中等待
+//   - 逾時未收到確認就重送，超過 LINK_CMD_MAX_RETRIES 次則回報失敗
+//   - 同一種命令一次只會有一個在途中，尚未送出的同種命令會直接被新的參數取代
+//
+// 所有命令都是「設定狀態」語意 (冪等)，因此 S1 收到重送的命令時直接再執行一次即可，
+// 不需要記錄已執行過的序號。
+//
+// 不依賴 Arduino，實際的送出由 LinkCommandInterface 提供。
+
+#pragma once
+#include <stdint.h>
+#include "WiimoteLink.h"
+
+#define LINK_CMD_WINDOW        4     // 同時未確認的命令上限
+#define LINK_CMD_QUEUE_SIZE    8     // 含在途中的命令
+#define LINK_CMD_MAX_ARGS      8
+#define LINK_CMD_RETRY_MS      50
+#define LINK_CMD_MAX_RETRIES   5
+
+// 命令代碼
+enum LinkCommandId : uint8_t {
+    LINK_CMD_SET_LEDS      = 0x01,  // args: uint8_t leds (bit0 ~ bit3 = LED1 ~ LED4)
+    LINK_CMD_SET_RUMBLE    = 0x02,  // args: uint8_t on
+    LINK_CMD_SET_REPORTING = 0x03,  // args: uint8_t features (LINK_REPORT_*) [, uint8_t 紅外線靈敏度 1~5]
+};
+
+// LINK_CMD_SET_REPORTING 的功能位元，S1 依此與擴充控制器狀態選擇 Wiimote 的回報模式
+#define LINK_REPORT_ACCEL      0x01
+#define LINK_REPORT_IR         0x02   // 開啟紅外線鏡頭 (0x33，接 Nunchuk 時 0x36 / 0x37)
+
+// 執行結果
+enum LinkCommandStatus : uint8_t {
+    LINK_CMD_OK            = 0x00,
+    LINK_CMD_NOT_CONNECTED = 0x01,  // Wiimote 未連線
+    LINK_CMD_BAD_ARGS      = 0x02,
+    LINK_CMD_UNKNOWN       = 0x03,  // S1 不認得的命令
+    LINK_CMD_TIMEOUT       = 0xFF,  // 只在 S3 本地使用: 重送次數用完
+};
+
+struct __attribute__((packed)) LinkCommandHeader {
+    uint8_t cmdSeq;
+    uint8_t cmd;
+    // 接著是參數
+};
+
+struct __attribute__((packed)) LinkCommandAck {
+    uint8_t cmdSeq;
+    uint8_t cmd;
+    uint8_t status;   // LinkCommandStatus
+};
+
+typedef struct link_command_interface {
+    void (*send_frame)(uint8_t type, const void* payload, uint8_t len);
+    void (*on_result)(uint8_t cmd, uint8_t status);  // 可為 NULL
+} LinkCommandInterface;
+
+struct LinkCommandStats {
+    uint32_t sent;      // 首次送出
+    uint32_t acked;
+    uint32_t retries;
+    uint32_t failed;    // 重送次數用完
+};
+
+/**
+ * 命令送出端 (S3)
+ */
+class LinkCommandSender {
+public:
+    LinkCommandSender(LinkCommandInterface io);
+
+    /**
+     * 將命令排入佇列
+     * @return 佇列已滿或參數過長時回傳 false
+     */
+    bool submit(uint8_t cmd, const void* args, uint8_t len);
+
+    // 處理一個收到的訊框；回傳 true 代表是命令確認，呼叫端不需再處理
+    bool handleFrame(const LinkFrame& frame);
+
+    // 在輸入任務中呼叫: 送出新命令與逾時重送
+    void task(uint32_t nowMs);
+
+    // 丟棄所有命令 (不回報結果)
+    void reset();
+
+    // 該命令是否還在佇列或在途中
+    bool pending(uint8_t cmd) const;
+    uint8_t inFlight() const;
+    uint8_t queued() const { return _count; }
+    const LinkCommandStats& stats() const { return _stats; }
+
+private:
+    struct Entry {
+        uint8_t cmd;
+        uint8_t cmdSeq;
+        uint8_t len;
+        uint8_t retries;
+        bool sent;
+        uint32_t sentMs;
+        uint8_t args[LINK_CMD_MAX_ARGS];
+    };
+
+    void transmit(Entry& entry);
+    void remove(uint8_t index);
+    bool cmdInFlight(uint8_t cmd, uint8_t before) const;
+
+    LinkCommandInterface _io;
+    Entry _queue[LINK_CMD_QUEUE_SIZE];  // 依提交順序排列
+    uint8_t _count;
+    uint8_t _nextSeq;
+    LinkCommandStats _stats;
+};
+
+/**
+ * 命令接收端 (S1)
+ * handler 執行命令並回傳 LinkCommandStatus
+ */
+typedef uint8_t (*LinkCommandHandler)(uint8_t cmd, const uint8_t* args, uint8_t len);
+
+class LinkCommandReceiver {
+public:
+    LinkCommandReceiver(void (*sendFrame)(uint8_t type, const void* payload, uint8_t len),
+                        LinkCommandHandler handler);
+
+    // 回傳 true 代表是命令訊框 (已執行並回覆確認)
+    bool handleFrame(const LinkFrame& frame);
+
+    uint32_t executed() const { return _executed; }
+
+private:
+    void (*_sendFrame)(uint8_t type, const void* payload, uint8_t len);
+    LinkCommandHandler _handler;
+    uint32_t _executed;
+};
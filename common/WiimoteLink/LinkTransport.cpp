@@ -0,0 +1,19 @@
+// 檔案: LinkTransport.cpp
+// 作用: 傳輸層共用的訊框送出
+
+#include "LinkTransport.h"
+
+bool LinkTransport::writeFrame(uint8_t type, const void* payload, uint8_t len) {
+    size_t frameLen = linkEncodeFrame(_txFrame, type, _txSeq++, payload, len);
+    if (frameLen == 0) {
+        return false;
+    }
+    size_t written = write(_txFrame, frameLen);
+    _txStats.frames++;
+    _txStats.bytes += written;
+    if (written != frameLen) {
+        _txStats.shortWrites++;
+        return false;
+    }
+    return true;
+}
@@ -0,0 +1,63 @@
+// 檔案: LinkTransport.h
+// 作用: S1/S3 連線的傳輸層介面 (送出訊框 / 解析收到的訊框 / 統計)
+//
+// 韌體使用 UartLinkTransport (Serial2)；在電腦上可換成 pty 或 Unix socket
+// (見 tools/linksim)，整條 S1 -> S3 流程 (藍牙與 USB 除外) 都能在 Linux 上執行。
+//
+// 實作只需提供位元組層級的 write / read，訊框編碼、序號與解析由基底類別處理。
+
+#pragma once
+#include <stdint.h>
+#include <stddef.h>
+#include "WiimoteLink.h"
+
+// 送出方向的計數器 (接收方向沿用 LinkStats)
+struct LinkTxStats {
+    uint32_t frames;
+    uint32_t bytes;
+    uint32_t shortWrites;   // 底層只寫入部分位元組 (訊框已損毀，接收端會重新同步)
+};
+
+class LinkTransport {
+public:
+    LinkTransport() : _txSeq(0), _txStats() {}
+    virtual ~LinkTransport() {}
+
+    // --- 底層位元組傳輸 ---
+    virtual size_t write(const uint8_t* data, size_t len) = 0;
+    // 非阻塞: 回傳目前可讀的位元組數 (最多 maxLen)，沒有資料時回傳 0
+    virtual size_t read(uint8_t* out, size_t maxLen) = 0;
+    // 切換速率；實作需先等待已寫入的資料送完。不支援速率的傳輸可忽略
+    virtual void setBaud(uint32_t baud) { (void)baud; }
+
+    /**
+     * 將 payload 包裝成訊框送出
+     * @return 是否完整寫入
+     */
+    bool writeFrame(uint8_t type, const void* payload, uint8_t len);
+
+    // 讀出所有可讀的位元組並解析，每個完整訊框呼叫一次 onFrame(const LinkFrame&)
+    template <typename Handler>
+    void poll(Handler onFrame) {
+        uint8_t buf[64];
+        size_t n;
+        while ((n = read(buf, sizeof(buf))) > 0) {
+            _parser.feed(buf, n, onFrame);
+        }
+    }
+
+    // 由其他路徑取得的位元組 (例如 S3 的接收環形緩衝區) 直接交給解析器
+    template <typename Handler>
+    void feed(const uint8_t* data, size_t len, Handler onFrame) {
+        _parser.feed(data, len, onFrame);
+    }
+
+    const LinkStats& rxStats() const { return _parser.stats(); }
+    const LinkTxStats& txStats() const { return _txStats; }
+
+private:
+    LinkFrameParser _parser;
+    uint8_t _txSeq;
+    uint8_t _txFrame[LINK_MAX_FRAME_SIZE];
+    LinkTxStats _txStats;
+};
@@ -0,0 +1,30 @@
+// 檔案: UartLinkTransport.h
+// 作用: 以 ESP32 HardwareSerial (Serial2) 實作的連線傳輸層
+//
+// UART 的腳位、接收回呼等設定仍由各自的 setup() 負責，這裡只包裝讀寫與速率切換。
+
+#pragma once
+#include <Arduino.h>
+#include "LinkTransport.h"
+
+class UartLinkTransport : public LinkTransport {
+public:
+    explicit UartLinkTransport(HardwareSerial& serial) : _serial(serial) {}
+
+    size_t write(const uint8_t* data, size_t len) override {
+        return _serial.write(data, len);
+    }
+
+    size_t read(uint8_t* out, size_t maxLen) override {
+        return _serial.read(out, maxLen);
+    }
+
+    // 先等待 TX FIFO 送完，避免尾端位元組以新速率送出
+    void setBaud(uint32_t baud) override {
+        _serial.flush();
+        _serial.updateBaudRate(baud);
+    }
+
+private:
+    HardwareSerial& _serial;
+};
@@ -0,0 +1,133 @@
+// 檔案: WiimoteData.cpp
+// 作用: 完整狀態封包的編碼與解碼
+
+#include "WiimoteData.h"
+#include <string.h>
+
+struct StateFieldLayout {
+    uint8_t offset;
+    uint8_t size;
+};
+
+// 依欄位位元順序排列 (bit0, bit1, ...)
+static const StateFieldLayout STATE_FIELD_LAYOUT[] = {
+    { offsetof(WiimoteState, buttons),       3 },  // buttons + extButtons
+    { offsetof(WiimoteState, nunchukX),      2 },
+    { offsetof(WiimoteState, accelX),        3 },
+    { offsetof(WiimoteState, nunchukAccelX), 3 },
+    { offsetof(WiimoteState, battery),       1 },
+    { offsetof(WiimoteState, flags),         1 },
+    { offsetof(WiimoteState, reportTimeUs),  6 },  // reportTimeUs + reportAgeUs
+    { offsetof(WiimoteState, edgeCount),     1 },  // edgeCount，之後接著 edgeCount 個 edgeStates
+};
+#define STATE_FIELD_COUNT (sizeof(STATE_FIELD_LAYOUT) / sizeof(STATE_FIELD_LAYOUT[0]))
+#define EDGE_STATE_SIZE   sizeof(WiimoteState::edgeStates[0])
+// 可變長度的 edgeStates 接在最後一個欄位之後
+static_assert(STATE_FIELD_EDGES == 1 << (STATE_FIELD_COUNT - 1), "STATE_FIELD_EDGES must be the last field");
+
+void wiimoteStateReset(WiimoteState& state) {
+    memset(&state, 0, sizeof(state));
+    state.nunchukX = state.nunchukY = 0x80;
+}
+
+uint8_t wiimoteStateDiff(const WiimoteState& a, const WiimoteState& b) {
+    const uint8_t* pa = (const uint8_t*)&a;
+    const uint8_t* pb = (const uint8_t*)&b;
+    uint8_t fields = 0;
+    for (uint8_t i = 0; i < STATE_FIELD_COUNT; i++) {
+        const StateFieldLayout& f = STATE_FIELD_LAYOUT[i];
+        if (((1 << i) & STATE_FIELD_ALL) && memcmp(pa + f.offset, pb + f.offset, f.size) != 0) {
+            fields |= (uint8_t)(1 << i);
+        }
+    }
+    return fields;
+}
+
+size_t wiimoteStateEncode(uint8_t* out, const WiimoteState& state, uint8_t fields) {
+    const uint8_t* src = (const uint8_t*)&state;
+    size_t pos = 0;
+    out[pos++] = WIIMOTE_STATE_VERSION;
+    out[pos++] = fields & STATE_FIELD_KNOWN;
+    for (uint8_t i = 0; i < STATE_FIELD_COUNT; i++) {
+        if (fields & (1 << i)) {
+            const StateFieldLayout& f = STATE_FIELD_LAYOUT[i];
+            memcpy(out + pos, src + f.offset, f.size);
+            pos += f.size;
+        }
+    }
+    if (fields & STATE_FIELD_EDGES) {
+        // 只送實際使用的中間狀態
+        uint8_t count = state.edgeCount < WIIMOTE_EDGE_MAX ? state.edgeCount : WIIMOTE_EDGE_MAX;
+        out[pos - 1] = count;
+        memcpy(out + pos, state.edgeStates, count * EDGE_STATE_SIZE);
+        pos += count * EDGE_STATE_SIZE;
+    }
+    return pos;
+}
+
+bool wiimoteStateDecode(const uint8_t* in, size_t len, WiimoteState& state, uint8_t* fieldsOut) {
+    if (len < WIIMOTE_STATE_HEADER_SIZE || in[0] != WIIMOTE_STATE_VERSION) {
+        return false;
+    }
+    uint8_t fields = in[1] & STATE_FIELD_KNOWN;
+
+    // 先確認長度，避免只套用一半的欄位
+    size_t need = WIIMOTE_STATE_HEADER_SIZE;
+    for (uint8_t i = 0; i < STATE_FIELD_COUNT; i++) {
+        if (fields & (1 << i)) {
+            need += STATE_FIELD_LAYOUT[i].size;
+        }
+    }
+    if (len < need) {
+        return false;
+    }
+    uint8_t edgeCount = 0;
+    if (fields & STATE_FIELD_EDGES) {
+        // edgeCount 之後的中間狀態數量由封包決定，超過 WIIMOTE_EDGE_MAX 的部分捨棄
+        edgeCount = in[need - 1];
+        if (len < need + edgeCount * EDGE_STATE_SIZE) {
+            return false;
+        }
+    }
+
+    uint8_t* dst = (uint8_t*)&state;
+    size_t pos = WIIMOTE_STATE_HEADER_SIZE;
+    for (uint8_t i = 0; i < STATE_FIELD_COUNT; i++) {
+        if (fields & (1 << i)) {
+            const StateFieldLayout& f = STATE_FIELD_LAYOUT[i];
+            memcpy(dst + f.offset, in + pos, f.size);
+            pos += f.size;
+        }
+    }
+    if (fields & STATE_FIELD_EDGES) {
+        state.edgeCount = edgeCount < WIIMOTE_EDGE_MAX ? edgeCount : WIIMOTE_EDGE_MAX;
+        memcpy(state.edgeStates, in + pos, state.edgeCount * EDGE_STATE_SIZE);
+    }
+    if (fieldsOut) {
+        *fieldsOut = fields;
+    }
+    return true;
+}
+
+void wiimoteAccelCalibrationDefault(WiimoteAccelCalibration& cal) {
+    for (uint8_t i = 0; i < 3; i++) {
+        cal.zero[i] = WIIMOTE_ACCEL_ZERO_DEFAULT;
+        cal.gravity[i] = WIIMOTE_ACCEL_GRAVITY_DEFAULT;
+    }
+}
+
+void wiimoteNunchukAccelCalibrationDefault(WiimoteAccelCalibration& cal) {
+    for (uint8_t i = 0; i < 3; i++) {
+        cal.zero[i] = WIIMOTE_NUNCHUK_ACCEL_ZERO_DEFAULT;
+        cal.gravity[i] = WIIMOTE_NUNCHUK_ACCEL_GRAVITY_DEFAULT;
+    }
+}
+
+bool wiimoteAccelCalibrationValid(const WiimoteAccelCalibration& cal) {
+    for (uint8_t i = 0; i < 3; i++) {
+        if (cal.gravity[i] <= cal.zero[i] || cal.gravity[i] > 0x3FF) {
+            return false;
+        }
+    }
+    return true;
+}
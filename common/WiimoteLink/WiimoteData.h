@@ -0,0 +1,138 @@
+// 檔案: WiimoteData.h
+// 作用: 定義 S1 和 S3 之間通訊用的共享資料結構 (S1/S3 共用同一份)
+
+#pragma once
+#include <stdint.h>
+#include <stddef.h>
+
+// --- 按鈕位元定義 (從 ESP32Wiimote 函式庫複製) ---
+#define BUTTON_A        0x0800//0x0008
+#define BUTTON_B        0x0400//0x0004
+#define BUTTON_C        0x10000UL  // Nunchuk，只在 wiimoteButtonSet() 的 24 位元中 (extButtons 的 EXT_BUTTON_C)
+#define BUTTON_Z        0x20000UL  // Nunchuk，只在 wiimoteButtonSet() 的 24 位元中 (extButtons 的 EXT_BUTTON_Z)
+#define BUTTON_ONE      0x0200
+#define BUTTON_TWO      0x0100
+#define BUTTON_MINUS    0x1000
+#define BUTTON_PLUS     0x0010 //0x1000
+#define BUTTON_HOME     0x8000 //0x0080
+#define BUTTON_LEFT     0x0001//ok
+#define BUTTON_RIGHT    0x0002//ok
+#define BUTTON_UP       0x0008
+#define BUTTON_DOWN     0x0004
+
+// 定義精簡版的通訊封包結構 (LINK_MSG_BUTTONS，保留給舊版 S1 韌體)
+// __attribute__((packed)) 確保編譯器不會增加額外的填充位元組
+struct __attribute__((packed)) ButtonPacket {
+    // 只包含一個成員：16位元的按鈕狀態
+    // 來自 wiimote.getButtonState()
+    uint16_t buttonState;
+};
+
+// ---------------------------------------------------------------------------
+// 完整狀態封包 (LINK_MSG_STATE)
+//
+// payload = [version][fields][欄位資料...]
+//   fields 是存在遮罩，欄位依位元順序緊密排列，只送出有變化的欄位。
+//   新欄位只能加在更高的位元，舊版解碼器讀完已知欄位就停止，因此可向前相容。
+// ---------------------------------------------------------------------------
+#define WIIMOTE_STATE_VERSION   1
+
+// Nunchuk 按鈕 (extButtons)
+#define EXT_BUTTON_C            0x01
+#define EXT_BUTTON_Z            0x02
+
+// 狀態旗標 (flags)
+#define WIIMOTE_FLAG_CONNECTED  0x01
+#define WIIMOTE_FLAG_NUNCHUK    0x02
+#define WIIMOTE_FLAG_ACCEL      0x04  // 加速度計回報已開啟
+#define WIIMOTE_FLAG_IR         0x08  // 紅外線鏡頭已完成初始化並在回報中
+
+// 欄位存在遮罩
+enum WiimoteStateField : uint8_t {
+    STATE_FIELD_BUTTONS       = 0x01,  // buttons + extButtons (3 bytes)
+    STATE_FIELD_NUNCHUK_STICK = 0x02,  // 2 bytes
+    STATE_FIELD_ACCEL         = 0x04,  // 3 bytes
+    STATE_FIELD_NUNCHUK_ACCEL = 0x08,  // 3 bytes
+    STATE_FIELD_BATTERY       = 0x10,  // 1 byte
+    STATE_FIELD_FLAGS         = 0x20,  // 1 byte
+    STATE_FIELD_ALL           = 0x3F,  // 所有狀態欄位 (完整狀態)
+    STATE_FIELD_TIMESTAMP     = 0x40,  // reportTimeUs + reportAgeUs (6 bytes)，不參與變化比較
+    STATE_FIELD_EDGES         = 0x80,  // edgeCount + edgeCount 個 edgeStates (1 ~ 13 bytes)，不參與變化比較
+    STATE_FIELD_KNOWN         = 0xFF,
+};
+
+// 一個狀態封包最多攜帶的中間按鈕狀態數
+#define WIIMOTE_EDGE_MAX        4
+
+// 欄位的記憶體排列與線上格式相同，編解碼只需依表格複製 (edgeStates 只送 edgeCount 個)
+struct __attribute__((packed)) WiimoteState {
+    uint16_t buttons;        // 與 ButtonPacket.buttonState 相同
+    uint8_t extButtons;      // EXT_BUTTON_*
+    uint8_t nunchukX;
+    uint8_t nunchukY;
+    uint8_t accelX;
+    uint8_t accelY;
+    uint8_t accelZ;
+    uint8_t nunchukAccelX;
+    uint8_t nunchukAccelY;
+    uint8_t nunchukAccelZ;
+    uint8_t battery;         // 狀態回報中的電量 (0x00 ~ 0xFF)
+    uint8_t flags;           // WIIMOTE_FLAG_*
+
+    // 延遲量測: 產生此狀態的 HCI 回報抵達 S1 的時間 (S1 esp_timer 低 32 位元)，
+    // 以及它在 S1 停留到送出為止的時間
+    uint32_t reportTimeUs;
+    uint16_t reportAgeUs;
+
+    // 自上次送出以來、最終狀態之前依序出現過的按鈕狀態 (見 ButtonEdges.h)。
+    // 只有在兩次送出之間按鈕變化超過一次時才會送出，S3 依序補送，
+    // 快速點擊不會因取樣間隔而遺失
+    uint8_t edgeCount;
+    uint8_t edgeStates[WIIMOTE_EDGE_MAX][3];  // buttons (little-endian) + extButtons
+};
+
+#define WIIMOTE_STATE_HEADER_SIZE  2
+#define WIIMOTE_STATE_MAX_SIZE     (WIIMOTE_STATE_HEADER_SIZE + sizeof(WiimoteState))
+
+void wiimoteStateReset(WiimoteState& state);
+
+// 回傳 a 與 b 不同的狀態欄位遮罩 (不含 STATE_FIELD_TIMESTAMP / STATE_FIELD_EDGES)
+uint8_t wiimoteStateDiff(const WiimoteState& a, const WiimoteState& b);
+
+/**
+ * 編碼指定欄位
+ * @param out 至少 WIIMOTE_STATE_MAX_SIZE 位元組
+ * @return payload 長度
+ */
+size_t wiimoteStateEncode(uint8_t* out, const WiimoteState& state, uint8_t fields);
+
+/**
+ * 解碼並套用到 state (未出現的欄位維持原值)
+ * @param fieldsOut 可為 NULL，回傳實際更新的欄位
+ * @return 版本不符或長度錯誤時回傳 false，state 不會被修改
+ */
+bool wiimoteStateDecode(const uint8_t* in, size_t len, WiimoteState& state, uint8_t* fieldsOut);
+
+// ---------------------------------------------------------------------------
+// 加速度計校正值 (LINK_MSG_ACCEL_CAL)
+// S1 連線後從 Wiimote EEPROM 讀出 (10 位元讀數)，讀到之後隨每個關鍵幀一起送出，
+// S3 重新開機或遺失訊框都能再收到。狀態封包中的 accelX/Y/Z 是讀數的高 8 位元。
+// ---------------------------------------------------------------------------
+#define WIIMOTE_ACCEL_ZERO_DEFAULT     512   // 尚未收到校正值時使用的典型值
+#define WIIMOTE_ACCEL_GRAVITY_DEFAULT  616
+
+struct __attribute__((packed)) WiimoteAccelCalibration {
+    uint16_t zero[3];      // 0g 時的讀數 (X, Y, Z)
+    uint16_t gravity[3];   // 該軸朝上承受 1g 時的讀數
+};
+
+void wiimoteAccelCalibrationDefault(WiimoteAccelCalibration& cal);
+
+// Nunchuk 的加速度計校正值沒有讀取，一律使用典型值 (nunchukAccelX/Y/Z 同樣是 10 位元讀數的高 8 位元)
+#define WIIMOTE_NUNCHUK_ACCEL_ZERO_DEFAULT     512
+#define WIIMOTE_NUNCHUK_ACCEL_GRAVITY_DEFAULT  716
+
+void wiimoteNunchukAccelCalibrationDefault(WiimoteAccelCalibration& cal);
+
+// 各軸的 1g 讀數必須大於 0g 讀數，否則視為無效
+bool wiimoteAccelCalibrationValid(const WiimoteAccelCalibration& cal);
@@ -0,0 +1,112 @@
+// 檔案: WiimoteIr.cpp
+// 作用: 紅外線點座標解碼 (查表)
+
+#include "WiimoteIr.h"
+#include <string.h>
+
+enum IrFormat : uint8_t {
+    IR_FORMAT_BASIC = 0,
+    IR_FORMAT_EXTENDED,
+};
+
+struct IrReportLayout {
+    uint8_t reportId;
+    uint8_t offset;      // 紅外線資料在回報中的位置 (含 0xA1)
+    uint8_t format;      // IrFormat
+};
+
+static const IrReportLayout IR_REPORT_LAYOUT[] = {
+    { 0x33, 7, IR_FORMAT_EXTENDED },
+    { 0x36, 4, IR_FORMAT_BASIC },
+    { 0x37, 7, IR_FORMAT_BASIC },
+};
+#define IR_REPORT_LAYOUT_COUNT (sizeof(IR_REPORT_LAYOUT) / sizeof(IR_REPORT_LAYOUT[0]))
+
+// 每個點的位元組位置: X 與 Y 的低 8 位元各一個 byte，高 2 位元放在 hi 的 xShift / yShift
+struct IrDotLayout {
+    uint8_t xLo;
+    uint8_t yLo;
+    uint8_t hi;
+    uint8_t xShift;
+    uint8_t yShift;
+};
+
+struct IrFormatLayout {
+    uint8_t length;      // 紅外線資料長度
+    uint8_t mode;        // WIIMOTE_IR_MODE_*
+    bool hasSize;        // hi 的低 4 位元為亮點大小
+    IrDotLayout dots[WIIMOTE_IR_DOTS];
+};
+
+static const IrFormatLayout IR_FORMAT_LAYOUT[] = {
+    // 基本格式: X1 Y1 [Y1:2 X1:2 Y2:2 X2:2] X2 Y2 | X3 Y3 [...] X4 Y4
+    { 10, WIIMOTE_IR_MODE_BASIC, false,
+      { { 0, 1, 2, 4, 6 }, { 3, 4, 2, 0, 2 }, { 5, 6, 7, 4, 6 }, { 8, 9, 7, 0, 2 } } },
+    // 擴充格式: X Y [Y:2 X:2 S:4]，每點 3 bytes
+    { 12, WIIMOTE_IR_MODE_EXTENDED, true,
+      { { 0, 1, 2, 4, 6 }, { 3, 4, 5, 4, 6 }, { 6, 7, 8, 4, 6 }, { 9, 10, 11, 4, 6 } } },
+};
+
+static const IrReportLayout* findReportLayout(uint8_t reportId) {
+    for (uint8_t i = 0; i < IR_REPORT_LAYOUT_COUNT; i++) {
+        if (IR_REPORT_LAYOUT[i].reportId == reportId) {
+            return &IR_REPORT_LAYOUT[i];
+        }
+    }
+    return NULL;
+}
+
+void wiimoteIrReset(WiimoteIrState& ir) {
+    for (uint8_t i = 0; i < WIIMOTE_IR_DOTS; i++) {
+        ir.dots[i].x = WIIMOTE_IR_NO_DOT;
+        ir.dots[i].y = WIIMOTE_IR_NO_DOT;
+        ir.dots[i].size = WIIMOTE_IR_SIZE_NONE;
+    }
+}
+
+uint8_t wiimoteIrCount(const WiimoteIrState& ir) {
+    uint8_t count = 0;
+    for (uint8_t i = 0; i < WIIMOTE_IR_DOTS; i++) {
+        if (ir.dots[i].x != WIIMOTE_IR_NO_DOT) {
+            count++;
+        }
+    }
+    return count;
+}
+
+uint8_t wiimoteIrModeForReport(uint8_t reportId) {
+    const IrReportLayout* layout = findReportLayout(reportId);
+    return layout ? IR_FORMAT_LAYOUT[layout->format].mode : 0;
+}
+
+bool wiimoteIrDecode(const uint8_t* report, size_t len, WiimoteIrState& ir) {
+    if (len < 2 || report[0] != 0xA1) {
+        return false;
+    }
+    const IrReportLayout* layout = findReportLayout(report[1]);
+    if (layout == NULL) {
+        return false;
+    }
+    const IrFormatLayout& format = IR_FORMAT_LAYOUT[layout->format];
+    if (len < (size_t)layout->offset + format.length) {
+        return false;
+    }
+    const uint8_t* data = report + layout->offset;
+    for (uint8_t i = 0; i < WIIMOTE_IR_DOTS; i++) {
+        const IrDotLayout& d = format.dots[i];
+        uint8_t hi = data[d.hi];
+        uint16_t x = (uint16_t)(data[d.xLo] | (((hi >> d.xShift) & 0x03) << 8));
+        uint16_t y = (uint16_t)(data[d.yLo] | (((hi >> d.yShift) & 0x03) << 8));
+        // 沒有點時鏡頭回報全部為 0xFF
+        if (y >= WIIMOTE_IR_HEIGHT) {
+            ir.dots[i].x = WIIMOTE_IR_NO_DOT;
+            ir.dots[i].y = WIIMOTE_IR_NO_DOT;
+            ir.dots[i].size = WIIMOTE_IR_SIZE_NONE;
+            continue;
+        }
+        ir.dots[i].x = x;
+        ir.dots[i].y = y;
+        ir.dots[i].size = format.hasSize ? (uint8_t)(hi & 0x0F) : WIIMOTE_IR_SIZE_NONE;
+    }
+    return true;
+}
@@ -0,0 +1,56 @@
+// 檔案: WiimoteIr.h
+// 作用: Wiimote 紅外線鏡頭的點座標解碼，以及 S1 -> S3 的紅外線訊息 (LINK_MSG_IR)
+//
+// 支援的回報模式 (開頭的 0xA1 為 HID 輸入標頭):
+//   (a1) 33 BB BB AA AA AA II*12          擴充格式，每點 3 bytes，含亮點大小
+//   (a1) 36 BB BB II*10 EE*9              基本格式，每兩點 5 bytes
+//   (a1) 37 BB BB AA AA AA II*10 EE*6     基本格式
+// 回報配置與位元位置都以查表決定，解碼不做動態配置。
+
+#pragma once
+#include <stdint.h>
+#include <stddef.h>
+
+#define WIIMOTE_IR_DOTS        4
+#define WIIMOTE_IR_WIDTH       1024
+#define WIIMOTE_IR_HEIGHT      768
+#define WIIMOTE_IR_NO_DOT      0xFFFF    // x 為此值表示沒有看到這個點
+#define WIIMOTE_IR_SIZE_NONE   0         // 基本格式沒有亮點大小
+
+// 鏡頭模式 (寫入暫存器 0xB00033)
+#define WIIMOTE_IR_MODE_BASIC     1
+#define WIIMOTE_IR_MODE_EXTENDED  3
+
+// 鏡頭靈敏度 (1 最低 ~ 5 最高)，對應 Wii 設定中的紅外線感應度
+#define WIIMOTE_IR_SENSITIVITY_MIN      1
+#define WIIMOTE_IR_SENSITIVITY_MAX      5
+#define WIIMOTE_IR_SENSITIVITY_DEFAULT  3
+
+struct __attribute__((packed)) WiimoteIrDot {
+    uint16_t x;      // 0 ~ 1023，WIIMOTE_IR_NO_DOT = 沒有點
+    uint16_t y;      // 0 ~ 767
+    uint8_t size;    // 0 ~ 15 (擴充格式)，基本格式為 WIIMOTE_IR_SIZE_NONE
+};
+
+// LINK_MSG_IR 的 payload: 鏡頭回報的 4 個點，依鏡頭給的順序
+struct __attribute__((packed)) WiimoteIrState {
+    WiimoteIrDot dots[WIIMOTE_IR_DOTS];
+};
+
+void wiimoteIrReset(WiimoteIrState& ir);
+
+// 回傳看到的點數
+uint8_t wiimoteIrCount(const WiimoteIrState& ir);
+
+/**
+ * 回報模式使用的鏡頭模式
+ * @return WIIMOTE_IR_MODE_*，不含紅外線資料的回報模式回傳 0
+ */
+uint8_t wiimoteIrModeForReport(uint8_t reportId);
+
+/**
+ * 從 Wiimote 輸入回報解出 4 個點
+ * @param report 以 0xA1 開頭的輸入回報 (與 TinyWiimoteData.data 相同)
+ * @return 回報不含紅外線資料或長度不足時回傳 false，ir 不會被修改
+ */
+bool wiimoteIrDecode(const uint8_t* report, size_t len, WiimoteIrState& ir);
@@ -0,0 +1,137 @@
+// 檔案: WiimoteLink.cpp
+// 作用: WiimoteLink 訊框編碼與解析實作
+
+#include "WiimoteLink.h"
+#include <string.h>
+
+// CRC-16/CCITT-FALSE (poly 0x1021)，使用 16 項的半位元組查表，兼顧速度與 Flash 大小
+static const uint16_t CRC16_NIBBLE_TABLE[16] = {
+    0x0000, 0x1021, 0x2042, 0x3063, 0x4084, 0x50A5, 0x60C6, 0x70E7,
+    0x8108, 0x9129, 0xA14A, 0xB16B, 0xC18C, 0xD1AD, 0xE1CE, 0xF1EF
+};
+
+uint16_t linkCrc16(const uint8_t* data, size_t len, uint16_t crc) {
+    for (size_t i = 0; i < len; i++) {
+        crc = (uint16_t)(crc << 4) ^ CRC16_NIBBLE_TABLE[((crc >> 12) ^ (data[i] >> 4)) & 0x0F];
+        crc = (uint16_t)(crc << 4) ^ CRC16_NIBBLE_TABLE[((crc >> 12) ^ (data[i] & 0x0F)) & 0x0F];
+    }
+    return crc;
+}
+
+size_t linkEncodeFrame(uint8_t* out, uint8_t type, uint8_t seq, const void* payload, uint8_t len) {
+    if (len > LINK_MAX_PAYLOAD) {
+        return 0;
+    }
+    out[0] = LINK_SYNC0;
+    out[1] = LINK_SYNC1;
+    out[2] = type;
+    out[3] = seq;
+    out[4] = len;
+    if (len > 0) {
+        memcpy(out + LINK_HEADER_SIZE, payload, len);
+    }
+    uint16_t crc = linkCrc16(out + 2, LINK_HEADER_SIZE - 2 + len);
+    out[LINK_HEADER_SIZE + len + 0] = (uint8_t)(crc & 0xFF);
+    out[LINK_HEADER_SIZE + len + 1] = (uint8_t)(crc >> 8);
+    return LINK_HEADER_SIZE + len + LINK_CRC_SIZE;
+}
+
+void LinkFrameParser::reset() {
+    _len = 0;
+    _haveSeq = false;
+    _lastSeq = 0;
+    memset(&_frame, 0, sizeof(_frame));
+    resetStats();
+}
+
+void LinkFrameParser::resetStats() {
+    memset(&_stats, 0, sizeof(_stats));
+}
+
+/**
+ * 加入一個位元組到緩衝區
+ * @return 緩衝區是否有新資料需要掃描
+ */
+bool LinkFrameParser::append(uint8_t b) {
+    if (_len == 0 && b != LINK_SYNC0) {
+        // 尚未找到同步標記，直接丟棄
+        _stats.droppedBytes++;
+        return false;
+    }
+    _buf[_len++] = b;
+    return true;
+}
+
+/**
+ * 從緩衝區開頭移除 n 個位元組，並丟棄後面不是同步標記開頭的雜訊
+ */
+void LinkFrameParser::consume(size_t n) {
+    if (n > _len) {
+        n = _len;
+    }
+    size_t skip = n;
+    while (skip < _len && _buf[skip] != LINK_SYNC0) {
+        skip++;
+        _stats.droppedBytes++;
+    }
+    _len -= skip;
+    if (_len > 0) {
+        memmove(_buf, _buf + skip, _len);
+    }
+}
+
+/**
+ * 檢查緩衝區開頭是否為完整且正確的訊框
+ * 錯誤時從下一個位元組重新尋找同步標記，因此已緩衝的位元組中若有真正的訊框也不會遺失
+ * @return true 代表 _frame 已填好
+ */
+bool LinkFrameParser::scan() {
+    for (;;) {
+        if (_len < 2) {
+            return false;
+        }
+        if (_buf[1] != LINK_SYNC1) {
+            _stats.droppedBytes++;
+            consume(1);
+            continue;
+        }
+        if (_len < LINK_HEADER_SIZE) {
+            return false;
+        }
+
+        uint8_t payloadLen = _buf[4];
+        if (payloadLen > LINK_MAX_PAYLOAD) {
+            _stats.lengthErrors++;
+            _stats.droppedBytes++;
+            consume(1);
+            continue;
+        }
+
+        size_t frameSize = LINK_HEADER_SIZE + payloadLen + LINK_CRC_SIZE;
+        if (_len < frameSize) {
+            return false;
+        }
+
+        uint16_t crc = linkCrc16(_buf + 2, LINK_HEADER_SIZE - 2 + payloadLen);
+        uint16_t rxCrc = (uint16_t)_buf[frameSize - 2] | ((uint16_t)_buf[frameSize - 1] << 8);
+        if (crc != rxCrc) {
+            _stats.crcErrors++;
+            _stats.droppedBytes++;
+            consume(1);
+            continue;
+        }
+
+        _frame.type = _buf[2];
+        _frame.seq = _buf[3];
+        _frame.len = payloadLen;
+        _frame.payload = _buf + LINK_HEADER_SIZE;
+
+        if (_haveSeq && _frame.seq != (uint8_t)(_lastSeq + 1)) {
+            _stats.seqGaps += (uint8_t)(_frame.seq - _lastSeq - 1);
+        }
+        _lastSeq = _frame.seq;
+        _haveSeq = true;
+        _stats.framesOk++;
+        return true;
+    }
+}
@@ -0,0 +1,125 @@
+// 檔案: WiimoteLink.h
+// 作用: S1 -> S3 Serial2 連線的訊框格式、CRC 與串流解析器 (兩端共用)
+//
+// 訊框格式 (little-endian):
+//   +------+------+------+-----+-----+-------------+--------+
+//   | 0xA5 | 0x5A | type | seq | len | payload ... | CRC16  |
+//   +------+------+------+-----+-----+-------------+--------+
+//   CRC16 = CRC-16/CCITT-FALSE，涵蓋 type ~ payload
+//
+// 解析器不做動態配置；任何位元組遺失或多出，最多在下一個訊框就能重新同步。
+
+#pragma once
+#include <stdint.h>
+#include <stddef.h>
+
+#define LINK_SYNC0            0xA5
+#define LINK_SYNC1            0x5A
+#define LINK_HEADER_SIZE      5    // sync0 sync1 type seq len
+#define LINK_CRC_SIZE         2
+#define LINK_MAX_PAYLOAD      64
+#define LINK_MAX_FRAME_SIZE   (LINK_HEADER_SIZE + LINK_MAX_PAYLOAD + LINK_CRC_SIZE)
+
+// --- 訊息類型 ---
+enum LinkMessageType : uint8_t {
+    LINK_MSG_BUTTONS = 0x01,   // payload: ButtonPacket (舊版 S1)
+    LINK_MSG_STATE   = 0x02,   // payload: 完整狀態，見 WiimoteData.h
+    LINK_MSG_ACCEL_CAL = 0x03, // payload: WiimoteAccelCalibration
+    LINK_MSG_IR      = 0x04,   // payload: WiimoteIrState (WiimoteIr.h)，點座標改變時與每個關鍵幀送出
+    LINK_MSG_PAD_STATE = 0x05, // payload: uint8_t 手把編號 + LINK_MSG_STATE 的 payload (多個 Wiimote 時)
+
+    // 速率協商 (見 LinkBaudNegotiator.h)，payload 開頭為 uint32_t baud
+    LINK_MSG_BAUD_PROPOSE = 0x10,  // S1 -> S3
+    LINK_MSG_BAUD_ACCEPT  = 0x11,  // S3 -> S1
+    LINK_MSG_BAUD_REJECT  = 0x12,  // S3 -> S1
+    LINK_MSG_BAUD_PROBE   = 0x13,  // S1 -> S3，以新速率送出
+    LINK_MSG_BAUD_CONFIRM = 0x14,  // S3 -> S1，以新速率送出
+    LINK_MSG_LINK_STATUS  = 0x15,  // S3 -> S1，payload: LinkStatusPayload
+
+    // 時鐘同步 (NTP 式四時間戳)，payload: LinkTimeSyncPayload
+    LINK_MSG_TIME_REQ     = 0x20,  // S3 -> S1，只填 t0
+    LINK_MSG_TIME_RESP    = 0x21,  // S1 -> S3
+
+    // 命令通道 (見 LinkCommand.h)
+    LINK_MSG_CMD          = 0x30,  // S3 -> S1，payload: LinkCommandHeader + 參數
+    LINK_MSG_CMD_ACK      = 0x31,  // S1 -> S3，payload: LinkCommandAck
+};
+
+// 時鐘同步: t0 = S3 送出請求, t1 = S1 收到請求, t2 = S1 送出回覆 (皆為各自 esp_timer 的低 32 位元, µs)
+// S3 在 t3 收到回覆後: offset = ((t1 - t0) + (t2 - t3)) / 2，rtt = (t3 - t0) - (t2 - t1)
+struct __attribute__((packed)) LinkTimeSyncPayload {
+    uint32_t t0;
+    uint32_t t1;
+    uint32_t t2;
+};
+
+// 解析完成的訊框；payload 只在回呼期間有效
+struct LinkFrame {
+    uint8_t type;
+    uint8_t seq;
+    uint8_t len;
+    const uint8_t* payload;
+};
+
+// 連線品質計數器
+struct LinkStats {
+    uint32_t framesOk;       // CRC 正確的訊框數
+    uint32_t crcErrors;      // CRC 錯誤
+    uint32_t lengthErrors;   // len 欄位超出上限
+    uint32_t seqGaps;        // 依序號推算遺失的訊框數
+    uint32_t droppedBytes;   // 重新同步時丟棄的位元組
+};
+
+uint16_t linkCrc16(const uint8_t* data, size_t len, uint16_t crc = 0xFFFF);
+
+/**
+ * 將一個訊框編碼到 out
+ * @param out 輸出緩衝區，至少 LINK_MAX_FRAME_SIZE 位元組
+ * @return 訊框總長度；payload 過長時回傳 0
+ */
+size_t linkEncodeFrame(uint8_t* out, uint8_t type, uint8_t seq, const void* payload, uint8_t len);
+
+/**
+ * 逐位元組的訊框解析器 (狀態保存在固定大小的緩衝區)
+ *
+ * 用法:
+ *   parser.feed(byte, onFrame);   // onFrame(const LinkFrame&)
+ */
+class LinkFrameParser {
+public:
+    LinkFrameParser() { reset(); }
+
+    void reset();
+    void resetStats();
+    const LinkStats& stats() const { return _stats; }
+
+    template <typename Handler>
+    void feed(uint8_t b, Handler onFrame) {
+        if (!append(b)) {
+            return;
+        }
+        while (scan()) {
+            onFrame(_frame);
+            consume(LINK_HEADER_SIZE + _frame.len + LINK_CRC_SIZE);
+        }
+    }
+
+    template <typename Handler>
+    void feed(const uint8_t* data, size_t len, Handler onFrame) {
+        for (size_t i = 0; i < len; i++) {
+            feed(data[i], onFrame);
+        }
+    }
+
+private:
+    bool append(uint8_t b);
+    bool scan();
+    void consume(size_t n);
+
+    uint8_t _buf[LINK_MAX_FRAME_SIZE];
+    size_t _len;
+    LinkFrame _frame;
+    LinkStats _stats;
+    uint8_t _lastSeq;
+    bool _haveSeq;
+};
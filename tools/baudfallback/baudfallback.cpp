@@ -0,0 +1,275 @@
+// 檔案: baudfallback.cpp
+// 作用: 經由 pty 執行 S1/S3 的 LinkBaudNegotiator，檢查速率協商往上升級、注入錯誤後退回上一個可用速率
+//
+// S1 (initiator) 與 S3 (responder) 各用 pty 的一端，位元組經過核心的 pty 傳遞，時鐘則是假的 (每步 1ms)，
+// 所以結果不受機器負載影響。pty 本身沒有鮑率，SimUart 記錄每一端目前設定的速率:
+// 兩端速率不同時寫出的位元組變成雜訊 (接收端只會看到錯誤)，另外可指定在某些速率上以固定機率翻轉位元。
+// S1 每 4ms 送一個狀態封包，S3 照常每 LINK_STATUS_INTERVAL_MS 回報接收統計，和韌體的流量相同。
+//
+// 情境:
+//   clean           沒有錯誤，應一路協商到 LINK_MAX_BAUD
+//   errors at 3M+   3000000 以上的速率錯誤很多，PROBE 無法通過，應停在 2000000 且不再嘗試 3000000
+//   errors at 5M    先協商到 5000000，之後 5000000 開始出錯，S1 應依錯誤率降回上一個速率 3000000
+//
+// 編譯 (在專案根目錄):
+//   g++ -std=c++17 -O2 -Icommon/WiimoteLink -Itools/linksim -Itools/common tools/baudfallback/baudfallback.cpp
+//       common/WiimoteLink/LinkBaudNegotiator.cpp common/WiimoteLink/LinkTransport.cpp
+//       common/WiimoteLink/WiimoteLink.cpp -o baudfallback
+//
+// 用法:
+//   ./baudfallback
+//   ./baudfallback --seed 7
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+
+#include <vector>
+
+#include "WiimoteLink.h"
+#include "LinkTransport.h"
+#include "LinkBaudNegotiator.h"
+#include "PosixLinkTransport.h"   // tools/linksim
+#include "ToolCheck.h"   // tools/common
+
+#define SIM_MAX_BAUD        5000000   // 與韌體的 LINK_MAX_BAUD 相同
+#define SIM_STATE_MS        4         // S1 送出狀態封包的間隔
+#define SIM_STATE_SIZE      12
+#define SIM_SETTLE_MS       5000      // 等待協商結束的時間
+#define SIM_HOLD_MS         3000      // 結束後再觀察的時間，確認不會再嘗試失敗的速率
+
+static uint32_t rngState = 1;
+
+static uint32_t rnd() {
+    rngState ^= rngState << 13;
+    rngState ^= rngState >> 17;
+    rngState ^= rngState << 5;
+    return rngState;
+}
+
+// ---------------------------------------------------------------------------
+// 帶有速率的 pty 端點
+// ---------------------------------------------------------------------------
+class SimUart : public LinkTransport {
+public:
+    explicit SimUart(int fd) : _pty(fd), _baud(115200), _peer(NULL), _errorMinBaud(0), _errorPpm(0) {}
+
+    void connect(SimUart* peer) { _peer = peer; }
+
+    // 速率 >= minBaud 時每個位元組以 ppm 的機率翻轉一個位元
+    void injectErrors(uint32_t minBaud, uint32_t ppm) {
+        _errorMinBaud = minBaud;
+        _errorPpm = ppm;
+    }
+
+    size_t write(const uint8_t* data, size_t len) override {
+        uint8_t buf[LINK_MAX_FRAME_SIZE];
+        size_t n = len < sizeof(buf) ? len : sizeof(buf);
+        memcpy(buf, data, n);
+        bool mismatch = _peer && _peer->_baud != _baud;
+        bool noisy = _errorPpm != 0 && _baud >= _errorMinBaud;
+        for (size_t i = 0; i < n; i++) {
+            if (mismatch) {
+                // 取樣時間不對，收到的是雜訊
+                buf[i] = (uint8_t)rnd();
+            } else if (noisy && rnd() % 1000000 < _errorPpm) {
+                buf[i] ^= (uint8_t)(1 << (rnd() % 8));
+            }
+        }
+        return _pty.write(buf, n);
+    }
+
+    size_t read(uint8_t* out, size_t maxLen) override { return _pty.read(out, maxLen); }
+
+    void setBaud(uint32_t baud) override {
+        _baud = baud;
+        history.push_back(baud);
+    }
+
+    uint32_t baud() const { return _baud; }
+
+    std::vector<uint32_t> history;   // 每次切換的速率
+
+private:
+    PosixLinkTransport _pty;
+    uint32_t _baud;
+    SimUart* _peer;
+    uint32_t _errorMinBaud;
+    uint32_t _errorPpm;
+};
+
+static SimUart* s1Uart = NULL;
+static SimUart* s3Uart = NULL;
+
+static void s1Send(uint8_t type, const void* payload, uint8_t len) { s1Uart->writeFrame(type, payload, len); }
+static void s1SetBaud(uint32_t baud) { s1Uart->setBaud(baud); }
+static void s3Send(uint8_t type, const void* payload, uint8_t len) { s3Uart->writeFrame(type, payload, len); }
+static void s3SetBaud(uint32_t baud) { s3Uart->setBaud(baud); }
+
+// 一對以 pty 連接的 S1/S3
+struct Link {
+    SimUart* s1;
+    SimUart* s3;
+    LinkBaudNegotiator s1Baud;
+    LinkBaudNegotiator s3Baud;
+    uint32_t nowMs;
+
+    Link() : s1(NULL), s3(NULL),
+             s1Baud(LINK_BAUD_INITIATOR, { s1Send, s1SetBaud }),
+             s3Baud(LINK_BAUD_RESPONDER, { s3Send, s3SetBaud }),
+             nowMs(1000) {}
+
+    ~Link() {
+        delete s1;
+        delete s3;
+        s1Uart = s3Uart = NULL;
+    }
+
+    bool open() {
+        char name[64];
+        int master = linkOpenPty(name, sizeof(name));
+        int slave = master >= 0 ? linkOpenTty(name) : -1;
+        if (slave < 0) {
+            return false;
+        }
+        s1 = s1Uart = new SimUart(master);
+        s3 = s3Uart = new SimUart(slave);
+        s1->connect(s3);
+        s3->connect(s1);
+        s1Baud.begin(nowMs, SIM_MAX_BAUD, s1->rxStats());
+        s3Baud.begin(nowMs, SIM_MAX_BAUD, s3->rxStats());
+        return true;
+    }
+
+    // 依照兩邊 loop() 的順序前進 ms 毫秒
+    void run(uint32_t ms) {
+        uint8_t state[SIM_STATE_SIZE];
+        memset(state, 0x5A, sizeof(state));
+        for (uint32_t i = 0; i < ms; i++) {
+            nowMs++;
+            s1->poll([this](const LinkFrame& frame) { s1Baud.handleFrame(frame, nowMs); });
+            s1Baud.task(nowMs);
+            if (nowMs % SIM_STATE_MS == 0) {
+                state[0] = (uint8_t)nowMs;
+                s1->writeFrame(LINK_MSG_STATE, state, sizeof(state));
+            }
+            s3->poll([this](const LinkFrame& frame) { s3Baud.handleFrame(frame, nowMs); });
+            s3Baud.task(nowMs);
+        }
+    }
+
+    bool settledAt(uint32_t baud) const {
+        return !s1Baud.negotiating() && !s3Baud.negotiating() &&
+               s1Baud.currentBaud() == baud && s3Baud.currentBaud() == baud &&
+               s1->baud() == baud && s3->baud() == baud;
+    }
+};
+
+static uint32_t countBaud(const std::vector<uint32_t>& history, uint32_t baud) {
+    uint32_t count = 0;
+    for (size_t i = 0; i < history.size(); i++) {
+        if (history[i] == baud) {
+            count++;
+        }
+    }
+    return count;
+}
+
+static void printHistory(const char* name, const std::vector<uint32_t>& history) {
+    printf("    %s:", name);
+    for (size_t i = 0; i < history.size(); i++) {
+        printf(" %u", history[i]);
+    }
+    printf("\n");
+}
+
+static bool testClean() {
+    printf("clean\n");
+    Link link;
+    if (!link.open()) {
+        return false;
+    }
+    link.run(SIM_SETTLE_MS);
+    printHistory("S1", link.s1->history);
+    char detail[96];
+    snprintf(detail, sizeof(detail), "(S1 %u, S3 %u)", link.s1Baud.currentBaud(), link.s3Baud.currentBaud());
+    check(link.settledAt(SIM_MAX_BAUD), "clean: both sides reach LINK_MAX_BAUD", detail);
+    check(link.s1Baud.fallbackCount() == 0 && link.s3Baud.fallbackCount() == 0, "clean: no fallbacks");
+    check(link.s1->rxStats().crcErrors == 0 && link.s3->rxStats().crcErrors == 0, "clean: no CRC errors");
+    return true;
+}
+
+static bool testProbeFailure() {
+    printf("errors at 3M+\n");
+    Link link;
+    if (!link.open()) {
+        return false;
+    }
+    // 每個位元組 5% 的錯誤率，8 個 PROBE 幾乎不可能連續通過
+    link.s1->injectErrors(3000000, 50000);
+    link.s3->injectErrors(3000000, 50000);
+    link.run(SIM_SETTLE_MS);
+    printHistory("S1", link.s1->history);
+    printHistory("S3", link.s3->history);
+    char detail[96];
+    snprintf(detail, sizeof(detail), "(S1 %u, S3 %u)", link.s1Baud.currentBaud(), link.s3Baud.currentBaud());
+    check(link.settledAt(2000000), "errors at 3M+: both sides fall back to 2000000", detail);
+    check(link.s1Baud.fallbackCount() > 0 && link.s3Baud.fallbackCount() > 0, "errors at 3M+: fallback counted");
+    uint32_t tries = countBaud(link.s1->history, 3000000);
+    link.run(SIM_HOLD_MS);
+    snprintf(detail, sizeof(detail), "(%u -> %u)", tries, countBaud(link.s1->history, 3000000));
+    check(tries == 1 && countBaud(link.s1->history, 3000000) == 1, "errors at 3M+: 3000000 not retried", detail);
+    check(countBaud(link.s1->history, 5000000) == 0, "errors at 3M+: never goes past the failed rate");
+    check(link.settledAt(2000000), "errors at 3M+: still at 2000000 after hold");
+    return true;
+}
+
+static bool testRuntimeErrors() {
+    printf("errors at 5M\n");
+    Link link;
+    if (!link.open()) {
+        return false;
+    }
+    link.run(SIM_SETTLE_MS);
+    check(link.settledAt(SIM_MAX_BAUD), "errors at 5M: negotiated up before errors");
+    // 每個位元組 1% 的錯誤率: 狀態封包約 15% 損毀，超過 LINK_BAUD_MAX_ERROR_PERMILLE
+    link.s1->injectErrors(5000000, 10000);
+    link.s3->injectErrors(5000000, 10000);
+    link.run(SIM_SETTLE_MS);
+    printHistory("S1", link.s1->history);
+    printHistory("S3", link.s3->history);
+    char detail[96];
+    snprintf(detail, sizeof(detail), "(S1 %u, S3 %u)", link.s1Baud.currentBaud(), link.s3Baud.currentBaud());
+    check(link.settledAt(3000000), "errors at 5M: falls back to the previous rate 3000000", detail);
+    check(link.s1Baud.fallbackCount() > 0, "errors at 5M: fallback counted");
+    uint32_t tries = countBaud(link.s1->history, 5000000);
+    uint32_t base = countBaud(link.s1->history, 115200);
+    link.run(SIM_HOLD_MS);
+    check(countBaud(link.s1->history, 5000000) == tries, "errors at 5M: 5000000 not retried");
+    check(countBaud(link.s1->history, 115200) == base, "errors at 5M: no silence fallback to 115200");
+    check(link.settledAt(3000000), "errors at 5M: still at 3000000 after hold");
+    return true;
+}
+
+int main(int argc, char** argv) {
+    uint32_t seed = 1;
+    for (int i = 1; i < argc; i++) {
+        if (strcmp(argv[i], "--seed") == 0 && i + 1 < argc) {
+            seed = (uint32_t)atoi(argv[++i]);
+        } else {
+            fprintf(stderr, "usage: %s [--seed N]\n", argv[0]);
+            return 2;
+        }
+    }
+    if (seed == 0) {
+        fprintf(stderr, "seed must be != 0\n");
+        return 2;
+    }
+    rngState = seed;
+
+    if (!testClean() || !testProbeFailure() || !testRuntimeErrors()) {
+        fprintf(stderr, "cannot open pty\n");
+        return 2;
+    }
+    return checkSummary();
+}
@@ -0,0 +1,275 @@
+// 檔案: clocksync.cpp
+// 作用: 檢查 S3 的時鐘差估計 (SwitchPro_i2c/src/ClockSync.h) 與延遲直方圖 (LatencyHistogram.h)
+//
+// ClockSync: 以已知的 S1 時鐘差與單趟延遲產生 TIME_REQ / TIME_RESP 交換 (t1/t2 依照 S1 的 handleLinkFrame 填入)，確認:
+//   - 延遲對稱時估計值等於真正的時鐘差，正負都一樣，S1 或 S3 的 32 位元時鐘回繞也不影響
+//   - 延遲不對稱或有抖動時，誤差不超過採用樣本的 rtt / 2，且採用的是最近 CLOCK_SYNC_WINDOW 組中 rtt 最小的一組
+//   - rtt 為負的回覆 (時間戳錯亂) 被忽略
+// LatencyHistogram: 與排序後的精確值比較，count / min / mean / max 完全相同，
+// 百分位不小於精確值、不超過精確值的 1/4 個 2 的冪次 (約 19%)，也不超過最大值。
+//
+// 編譯 (在專案根目錄):
+//   g++ -std=c++17 -O2 -Icommon/WiimoteLink -ISwitchPro_i2c/src -Itools/common tools/clocksync/clocksync.cpp
+//       -o clocksync
+//
+// 用法:
+//   ./clocksync
+//   ./clocksync --seed 7 --exchanges 20000
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+
+#include <algorithm>
+#include <vector>
+
+#include "WiimoteLink.h"
+#include "ClockSync.h"          // SwitchPro_i2c/src
+#include "LatencyHistogram.h"   // SwitchPro_i2c/src
+#include "ToolCheck.h"   // tools/common
+
+#define SYNC_EXCHANGES      5000
+#define SYNC_INTERVAL_US    500000   // 與 S3 的 CLOCK_SYNC_INTERVAL_MS 相同
+#define S1_TURNAROUND_US    40       // S1 收到請求到送出回覆的時間
+
+static uint32_t rngState = 1;
+
+static uint32_t rnd() {
+    rngState ^= rngState << 13;
+    rngState ^= rngState >> 17;
+    rngState ^= rngState << 5;
+    return rngState;
+}
+
+static uint32_t rndRange(uint32_t lo, uint32_t hi) {
+    return lo + rnd() % (hi - lo + 1);
+}
+
+/**
+ * 一次時間同步交換
+ * @param s3Us 送出請求時 S3 的時間
+ * @param offsetUs 真正的時鐘差 (S1 時間 - S3 時間)
+ * @param upUs S3 -> S1 的單趟延遲
+ * @param downUs S1 -> S3 的單趟延遲
+ */
+static void exchange(ClockSync& sync, uint32_t s3Us, int32_t offsetUs, uint32_t upUs, uint32_t downUs) {
+    LinkTimeSyncPayload p;
+    sync.makeRequest(p, s3Us);
+    // S1 的 handleLinkFrame: t1 為收到的時間，t2 為送出回覆的時間
+    p.t1 = s3Us + upUs + (uint32_t)offsetUs;
+    p.t2 = p.t1 + S1_TURNAROUND_US;
+    uint32_t t3 = s3Us + upUs + S1_TURNAROUND_US + downUs;
+    sync.onResponse(p, t3);
+}
+
+static void testSymmetric(const char* label, uint32_t startUs, int32_t offsetUs) {
+    ClockSync sync;
+    uint32_t s3Us = startUs;
+    bool exact = true;
+    for (int i = 0; i < 40; i++) {
+        uint32_t delay = rndRange(200, 3000);
+        exchange(sync, s3Us, offsetUs, delay, delay);
+        exact = exact && sync.valid() && sync.offsetUs() == offsetUs;
+        s3Us += SYNC_INTERVAL_US;
+    }
+    char detail[64];
+    snprintf(detail, sizeof(detail), "(estimate %d, true %d)", sync.offsetUs(), offsetUs);
+    check(exact, label, detail);
+}
+
+static void testAsymmetric(uint32_t exchanges) {
+    printf("asymmetric, jittered delays\n");
+    ClockSync sync;
+    const int32_t offsetUs = -123456789;
+    uint32_t s3Us = 0xFFFFFFFFUL - 100 * SYNC_INTERVAL_US;   // 途中 S3 的時鐘回繞
+    std::vector<uint32_t> rtts;
+    uint32_t worstErrorUs = 0;
+    uint32_t boundViolations = 0;
+    uint32_t notBest = 0;
+    for (uint32_t i = 0; i < exchanges; i++) {
+        // 大部分交換只有幾百 µs；偶爾一邊卡在忙碌的 loop() 或長訊框後面
+        uint32_t up = rndRange(150, 900);
+        uint32_t down = rndRange(150, 900);
+        if (rnd() % 8 == 0) {
+            up += rndRange(1000, 20000);
+        }
+        if (rnd() % 8 == 0) {
+            down += rndRange(1000, 20000);
+        }
+        exchange(sync, s3Us, offsetUs, up, down);
+        rtts.push_back(up + down);
+        s3Us += SYNC_INTERVAL_US;
+
+        // 採用的樣本必須是最近 CLOCK_SYNC_WINDOW 組中 rtt 最小的
+        size_t from = rtts.size() > CLOCK_SYNC_WINDOW ? rtts.size() - CLOCK_SYNC_WINDOW : 0;
+        uint32_t best = *std::min_element(rtts.begin() + from, rtts.end());
+        if (sync.rttUs() != best) {
+            notBest++;
+        }
+        uint32_t error = (uint32_t)abs(sync.offsetUs() - offsetUs);
+        if (error > worstErrorUs) {
+            worstErrorUs = error;
+        }
+        // 單趟延遲不對稱造成的誤差最多是 rtt / 2 (整數除法再多 1µs)
+        if (error > sync.rttUs() / 2 + 1) {
+            boundViolations++;
+        }
+    }
+    printf("  %u exchanges, worst error %u us\n", exchanges, worstErrorUs);
+    char detail[64];
+    snprintf(detail, sizeof(detail), "(%u exchanges)", notBest);
+    check(notBest == 0, "asymmetric: uses the minimum-rtt sample of the window", detail);
+    snprintf(detail, sizeof(detail), "(%u exchanges)", boundViolations);
+    check(boundViolations == 0, "asymmetric: error within rtt / 2", detail);
+    // 視窗內幾乎一定有一組兩邊都沒有卡住的樣本: 誤差只來自 150~900µs 的不對稱
+    snprintf(detail, sizeof(detail), "(%u us)", worstErrorUs);
+    check(worstErrorUs <= 10000, "asymmetric: a stalled direction never dominates the estimate", detail);
+
+    // toLocal: S1 時間換算回 S3 時間
+    uint32_t s1Stamp = s3Us + (uint32_t)offsetUs;
+    uint32_t local = sync.toLocal(s1Stamp);
+    snprintf(detail, sizeof(detail), "(%d us off)", (int32_t)(local - s3Us));
+    check((uint32_t)abs((int32_t)(local - s3Us)) <= sync.rttUs() / 2 + 1, "asymmetric: toLocal within rtt / 2", detail);
+}
+
+static void testWindow() {
+    printf("window\n");
+    ClockSync sync;
+    uint32_t s3Us = 1000000;
+    check(!sync.valid() && sync.offsetUs() == 0, "window: invalid before the first response");
+    // 一組很好的樣本，之後 CLOCK_SYNC_WINDOW - 1 組較差的仍選它
+    exchange(sync, s3Us, 5000, 100, 100);
+    for (int i = 0; i < CLOCK_SYNC_WINDOW - 1; i++) {
+        s3Us += SYNC_INTERVAL_US;
+        exchange(sync, s3Us, 5000, 2000, 500);
+    }
+    check(sync.rttUs() == 200 && sync.offsetUs() == 5000, "window: keeps the best sample while in the window");
+    // 再一組: 最好的樣本離開視窗
+    s3Us += SYNC_INTERVAL_US;
+    exchange(sync, s3Us, 5000, 2000, 500);
+    char detail[64];
+    snprintf(detail, sizeof(detail), "(rtt %u, offset %d)", sync.rttUs(), sync.offsetUs());
+    check(sync.rttUs() == 2500 && sync.offsetUs() == 5000 + 750, "window: drops the best sample after it ages out",
+          detail);
+
+    // rtt 為負 (t2 - t1 大於整段時間): 忽略，不影響目前的估計
+    LinkTimeSyncPayload p;
+    sync.makeRequest(p, s3Us);
+    p.t1 = s3Us + 5000;
+    p.t2 = p.t1 + 100000;
+    sync.onResponse(p, s3Us + 1000);
+    check(sync.rttUs() == 2500 && sync.offsetUs() == 5750, "window: negative rtt is ignored");
+}
+
+/**
+ * 直方圖與精確值比較
+ * @param label 分布名稱
+ * @param samples 延遲樣本 (µs)
+ */
+static void checkHistogram(const char* label, const std::vector<uint32_t>& samples) {
+    LatencyHistogram h;
+    uint64_t sum = 0;
+    for (size_t i = 0; i < samples.size(); i++) {
+        h.record(samples[i]);
+        sum += samples[i];
+    }
+    std::vector<uint32_t> sorted(samples);
+    std::sort(sorted.begin(), sorted.end());
+
+    char name[96];
+    snprintf(name, sizeof(name), "%s: count/min/mean/max exact", label);
+    check(h.count() == sorted.size() && h.min() == sorted.front() && h.max() == sorted.back() &&
+          h.mean() == (uint32_t)(sum / sorted.size()), name);
+
+    static const uint16_t permilles[] = { 1, 500, 900, 990, 999, 1000 };
+    bool ok = true;
+    char detail[96] = "";
+    for (size_t i = 0; i < sizeof(permilles) / sizeof(permilles[0]); i++) {
+        uint16_t p = permilles[i];
+        size_t index = ((uint64_t)sorted.size() * p + 999) / 1000;
+        uint32_t exact = sorted[index > 0 ? index - 1 : 0];
+        uint32_t got = h.percentile(p);
+        // 桶寬是下界的 1/4 (值小於 4 時每個值一個桶)
+        uint32_t limit = exact < 4 ? exact : exact + exact / 4;
+        if (got < exact || got > limit || got > h.max()) {
+            if (ok) {
+                snprintf(detail, sizeof(detail), "(p%u: %u, exact %u)", p, got, exact);
+            }
+            ok = false;
+        }
+    }
+    snprintf(name, sizeof(name), "%s: percentiles within one bucket above exact", label);
+    check(ok, name, detail);
+}
+
+static void testHistogram() {
+    printf("histogram\n");
+    std::vector<uint32_t> v;
+    for (int i = 0; i < 20000; i++) {
+        v.push_back(rndRange(0, 20000));
+    }
+    checkHistogram("uniform 0-20ms", v);
+
+    // 大多數很快，長尾到 200ms
+    v.clear();
+    for (int i = 0; i < 20000; i++) {
+        uint32_t us = rndRange(800, 3000);
+        if (rnd() % 100 == 0) {
+            us += rndRange(10000, 200000);
+        }
+        v.push_back(us);
+    }
+    checkHistogram("long tail", v);
+
+    v.clear();
+    for (int i = 0; i < 1000; i++) {
+        v.push_back(rndRange(0, 7));
+    }
+    checkHistogram("small values", v);
+
+    // 每個 2 的冪次與其前後的值
+    v.clear();
+    for (uint32_t b = 2; b < 24; b++) {
+        v.push_back((1UL << b) - 1);
+        v.push_back(1UL << b);
+        v.push_back((1UL << b) + 1);
+    }
+    checkHistogram("bucket edges", v);
+
+    LatencyHistogram h;
+    h.record(40000000);   // 超過最後一個桶子的範圍
+    h.record(1000);
+    check(h.percentile(1000) == 40000000 && h.max() == 40000000, "overflow bucket: p100 clipped to the real max");
+    check(LatencyHistogram().percentile(990) == 0 && LatencyHistogram().min() == 0, "empty: all zero");
+}
+
+int main(int argc, char** argv) {
+    uint32_t seed = 1;
+    uint32_t exchanges = SYNC_EXCHANGES;
+    for (int i = 1; i < argc; i++) {
+        if (strcmp(argv[i], "--seed") == 0 && i + 1 < argc) {
+            seed = (uint32_t)atoi(argv[++i]);
+        } else if (strcmp(argv[i], "--exchanges") == 0 && i + 1 < argc) {
+            exchanges = (uint32_t)atoi(argv[++i]);
+        } else {
+            fprintf(stderr, "usage: %s [--seed N] [--exchanges N]\n", argv[0]);
+            return 2;
+        }
+    }
+    if (seed == 0 || exchanges == 0) {
+        fprintf(stderr, "seed and exchanges must be > 0\n");
+        return 2;
+    }
+    rngState = seed;
+
+    printf("symmetric delays\n");
+    testSymmetric("symmetric: positive offset exact", 1000, 2500000);
+    testSymmetric("symmetric: negative offset exact", 1000, -73000000);
+    testSymmetric("symmetric: S3 clock wraps", 0xFFFFFFFFUL - 5 * SYNC_INTERVAL_US, 900000);
+    testSymmetric("symmetric: S1 clock wraps", 1000, (int32_t)(0xFFFFFFFFUL - 3 * SYNC_INTERVAL_US));
+    testAsymmetric(exchanges);
+    testWindow();
+    testHistogram();
+
+    return checkSummary();
+}
@@ -0,0 +1,365 @@
+// 檔案: cmdchannel.cpp
+// 作用: 以假時鐘與會遺失訊框的連線檢查 S3 -> S1 命令通道 (common/WiimoteLink/LinkCommand.h)
+//
+// LinkCommandSender (S3) 與 LinkCommandReceiver (S1) 之間是兩條先進先出的佇列 (UART 不會讓訊框亂序)，
+// 每個訊框有傳輸延遲，並可依機率遺失。每 1ms 呼叫一次 task()，檢查:
+//   - 沒有遺失時每個命令送出一次、確認一次，結果回報 OK
+//   - 未確認的命令任何時刻都不超過 LINK_CMD_WINDOW 個，同一種命令一次只有一個在途中
+//   - 尚未送出的同種命令只保留最新的參數，S1 不會執行被取代的參數，也不會在新參數之後執行舊參數
+//   - 逾時每 LINK_CMD_RETRY_MS 以相同的序號重送，連線中斷時送出 1 + LINK_CMD_MAX_RETRIES 次後回報 LINK_CMD_TIMEOUT
+//   - 遺失 30% 訊框時，最後一個成功的命令就是 S1 的最終狀態，sent == acked + failed
+//
+// 編譯 (在專案根目錄):
+//   g++ -std=c++17 -O2 -Icommon/WiimoteLink -Itools/common tools/cmdchannel/cmdchannel.cpp
+//       common/WiimoteLink/LinkCommand.cpp -o cmdchannel
+//
+// 用法:
+//   ./cmdchannel
+//   ./cmdchannel --seed 7 --loss 40
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+
+#include <deque>
+#include <vector>
+
+#include "WiimoteLink.h"
+#include "LinkCommand.h"
+#include "ToolCheck.h"   // tools/common
+
+#define SIM_LINK_DELAY_MS   2     // 單趟延遲
+#define SIM_LINK_JITTER_MS  6
+#define SIM_LOSS_PERCENT    30
+#define SIM_KIND_COUNT      8     // 視窗測試用的命令種類 (0x10 ~ 0x17，S1 一律回覆 OK)
+
+static uint32_t rngState = 1;
+
+static uint32_t rnd() {
+    rngState ^= rngState << 13;
+    rngState ^= rngState >> 17;
+    rngState ^= rngState << 5;
+    return rngState;
+}
+
+// 一個在線路上的訊框
+struct WireFrame {
+    uint32_t arriveMs;
+    uint8_t type;
+    uint8_t len;
+    uint8_t payload[LINK_MAX_PAYLOAD];
+};
+
+// 一個方向的線路: 先進先出，延遲不會讓後送的訊框先到
+struct Wire {
+    std::deque<WireFrame> frames;
+    uint32_t lossPercent;
+    uint32_t lastArriveMs;
+
+    void send(uint32_t nowMs, uint8_t type, const void* payload, uint8_t len) {
+        if (lossPercent && rnd() % 100 < lossPercent) {
+            return;
+        }
+        WireFrame f;
+        f.arriveMs = nowMs + SIM_LINK_DELAY_MS + rnd() % (SIM_LINK_JITTER_MS + 1);
+        if ((int32_t)(f.arriveMs - lastArriveMs) < 0) {
+            f.arriveMs = lastArriveMs;
+        }
+        lastArriveMs = f.arriveMs;
+        f.type = type;
+        f.len = len;
+        memcpy(f.payload, payload, len);
+        frames.push_back(f);
+    }
+};
+
+// S1 執行過的一個命令
+struct Executed {
+    uint32_t atMs;
+    uint8_t cmdSeq;
+    uint8_t cmd;
+    uint8_t arg;
+};
+
+// S3 送出的一個命令訊框
+struct Transmission {
+    uint32_t atMs;
+    uint8_t cmdSeq;
+    uint8_t cmd;
+    uint8_t arg;
+};
+
+// S3 收到的結果
+struct Result {
+    uint32_t atMs;
+    uint8_t cmd;
+    uint8_t status;
+};
+
+static uint32_t simNowMs = 0;
+// 每種命令目前在途中的序號 (-1: 沒有)，送出另一個序號時代表同種命令同時有兩個在途中
+static int outstandingSeq[256];
+static bool sameKindInFlight = false;
+static Wire toS1;
+static Wire toS3;
+static std::vector<Executed> executed;
+static std::vector<Transmission> transmissions;
+static std::vector<Result> results;
+
+static void s3Send(uint8_t type, const void* payload, uint8_t len) {
+    const uint8_t* p = (const uint8_t*)payload;
+    if (type == LINK_MSG_CMD) {
+        transmissions.push_back({ simNowMs, p[0], p[1], len > 2 ? p[2] : (uint8_t)0 });
+        if (outstandingSeq[p[1]] >= 0 && outstandingSeq[p[1]] != p[0]) {
+            sameKindInFlight = true;
+        }
+        outstandingSeq[p[1]] = p[0];
+    }
+    toS1.send(simNowMs, type, payload, len);
+}
+
+static void s3Result(uint8_t cmd, uint8_t status) {
+    results.push_back({ simNowMs, cmd, status });
+    outstandingSeq[cmd] = -1;
+}
+
+static void s1Send(uint8_t type, const void* payload, uint8_t len) {
+    toS3.send(simNowMs, type, payload, len);
+}
+
+static uint8_t lastSeqSeen = 0;
+
+static uint8_t s1Execute(uint8_t cmd, const uint8_t* args, uint8_t len) {
+    executed.push_back({ simNowMs, lastSeqSeen, cmd, len > 0 ? args[0] : (uint8_t)0 });
+    return len > 0 ? LINK_CMD_OK : LINK_CMD_BAD_ARGS;
+}
+
+struct Rig {
+    LinkCommandSender sender;
+    LinkCommandReceiver receiver;
+    uint8_t maxInFlight;
+
+    Rig(uint32_t lossPercent)
+        : sender({ s3Send, s3Result }), receiver(s1Send, s1Execute), maxInFlight(0) {
+        simNowMs = 1000;
+        toS1.frames.clear();
+        toS3.frames.clear();
+        toS1.lossPercent = toS3.lossPercent = lossPercent;
+        toS1.lastArriveMs = toS3.lastArriveMs = simNowMs;
+        executed.clear();
+        transmissions.clear();
+        results.clear();
+        memset(outstandingSeq, -1, sizeof(outstandingSeq));
+        sameKindInFlight = false;
+    }
+
+    void submit(uint8_t cmd, uint8_t arg) {
+        sender.submit(cmd, &arg, 1);
+    }
+
+    // 前進 ms 毫秒 (S1 的 loop() 與 S3 的輸入任務都每 1ms 一次)
+    void run(uint32_t ms) {
+        for (uint32_t i = 0; i < ms; i++) {
+            simNowMs++;
+            while (!toS1.frames.empty() && (int32_t)(simNowMs - toS1.frames.front().arriveMs) >= 0) {
+                WireFrame f = toS1.frames.front();
+                toS1.frames.pop_front();
+                LinkFrame frame = { f.type, 0, f.len, f.payload };
+                lastSeqSeen = f.payload[0];
+                receiver.handleFrame(frame);
+            }
+            while (!toS3.frames.empty() && (int32_t)(simNowMs - toS3.frames.front().arriveMs) >= 0) {
+                WireFrame f = toS3.frames.front();
+                toS3.frames.pop_front();
+                LinkFrame frame = { f.type, 0, f.len, f.payload };
+                sender.handleFrame(frame);
+            }
+            sender.task(simNowMs);
+            if (sender.inFlight() > maxInFlight) {
+                maxInFlight = sender.inFlight();
+            }
+        }
+    }
+};
+
+static uint32_t countExecuted(uint8_t cmd) {
+    uint32_t n = 0;
+    for (size_t i = 0; i < executed.size(); i++) {
+        if (executed[i].cmd == cmd) {
+            n++;
+        }
+    }
+    return n;
+}
+
+static void testLossless() {
+    printf("lossless\n");
+    Rig rig(0);
+    rig.submit(LINK_CMD_SET_LEDS, 0x05);
+    rig.submit(LINK_CMD_SET_RUMBLE, 1);
+    rig.submit(LINK_CMD_SET_REPORTING, LINK_REPORT_ACCEL);
+    rig.run(200);
+    const LinkCommandStats& s = rig.sender.stats();
+    check(s.sent == 3 && s.acked == 3 && s.retries == 0 && s.failed == 0, "lossless: three sent, three acked");
+    bool ok = results.size() == 3;
+    for (size_t i = 0; ok && i < results.size(); i++) {
+        ok = results[i].status == LINK_CMD_OK;
+    }
+    check(ok, "lossless: each result reported OK once");
+    check(executed.size() == 3 && rig.sender.queued() == 0, "lossless: S1 executed each once, queue empty");
+}
+
+static void testWindow() {
+    printf("window\n");
+    Rig rig(0);
+    for (uint8_t k = 0; k < SIM_KIND_COUNT; k++) {
+        rig.submit((uint8_t)(0x10 + k), k);
+    }
+    rig.sender.task(simNowMs);
+    char detail[48];
+    snprintf(detail, sizeof(detail), "(%u in flight)", rig.sender.inFlight());
+    check(rig.sender.inFlight() == LINK_CMD_WINDOW, "window: fills the window immediately", detail);
+    rig.run(200);
+    snprintf(detail, sizeof(detail), "(max %u)", rig.maxInFlight);
+    check(rig.maxInFlight <= LINK_CMD_WINDOW, "window: never more than LINK_CMD_WINDOW in flight", detail);
+    bool inOrder = executed.size() == SIM_KIND_COUNT;
+    for (size_t i = 0; inOrder && i < executed.size(); i++) {
+        inOrder = executed[i].cmd == 0x10 + i;
+    }
+    check(inOrder, "window: S1 executes in submission order");
+    check(rig.sender.stats().acked == SIM_KIND_COUNT && rig.sender.queued() == 0, "window: all acked");
+}
+
+static void testCoalesce() {
+    printf("coalesce\n");
+    Rig rig(0);
+    // 尚未送出的三個同種命令: 只送最後一個
+    rig.submit(LINK_CMD_SET_LEDS, 1);
+    rig.submit(LINK_CMD_SET_LEDS, 2);
+    rig.submit(LINK_CMD_SET_LEDS, 3);
+    check(rig.sender.queued() == 1, "coalesce: unsent commands of a kind share one entry");
+    rig.run(1);
+    // 在途中時再送兩個: 第二個取代第一個，等確認後才送出
+    rig.submit(LINK_CMD_SET_LEDS, 4);
+    rig.submit(LINK_CMD_SET_LEDS, 5);
+    check(rig.sender.queued() == 2 && rig.sender.inFlight() == 1, "coalesce: one in flight, one waiting");
+    rig.run(200);
+    bool ok = executed.size() == 2 && executed[0].arg == 3 && executed[1].arg == 5;
+    char detail[64];
+    snprintf(detail, sizeof(detail), "(%zu executed, last %u)", executed.size(),
+             executed.empty() ? 0 : executed.back().arg);
+    check(ok, "coalesce: S1 executes 3 then 5, never 1, 2 or 4", detail);
+    check(!sameKindInFlight, "coalesce: never two LEDS commands in flight");
+}
+
+static void testDeadLink() {
+    printf("dead link\n");
+    Rig rig(100);
+    uint32_t start = simNowMs;
+    rig.submit(LINK_CMD_SET_RUMBLE, 1);
+    rig.run(1000);
+    bool spacing = transmissions.size() == 1 + LINK_CMD_MAX_RETRIES;
+    for (size_t i = 1; spacing && i < transmissions.size(); i++) {
+        spacing = transmissions[i].atMs - transmissions[i - 1].atMs == LINK_CMD_RETRY_MS &&
+                  transmissions[i].cmdSeq == transmissions[0].cmdSeq;
+    }
+    char detail[64];
+    snprintf(detail, sizeof(detail), "(%zu transmissions)", transmissions.size());
+    check(spacing, "dead link: 1 + LINK_CMD_MAX_RETRIES transmissions, same seq, LINK_CMD_RETRY_MS apart", detail);
+    uint32_t expectMs = start + 1 + (LINK_CMD_MAX_RETRIES + 1) * LINK_CMD_RETRY_MS;
+    snprintf(detail, sizeof(detail), "(at +%u ms, expected +%u)", results.empty() ? 0 : results[0].atMs - start,
+             expectMs - start);
+    check(results.size() == 1 && results[0].status == LINK_CMD_TIMEOUT && results[0].atMs == expectMs,
+          "dead link: LINK_CMD_TIMEOUT after the last retry", detail);
+    const LinkCommandStats& s = rig.sender.stats();
+    check(s.failed == 1 && s.retries == LINK_CMD_MAX_RETRIES && rig.sender.queued() == 0,
+          "dead link: counted as failed, queue empty");
+}
+
+static void testLossy(uint32_t lossPercent) {
+    printf("lossy link (%u%% each way)\n", lossPercent);
+    Rig rig(lossPercent);
+    uint8_t lastSubmitted[3] = { 0, 0, 0 };
+    static const uint8_t kinds[3] = { LINK_CMD_SET_LEDS, LINK_CMD_SET_RUMBLE, LINK_CMD_SET_REPORTING };
+    for (int round = 0; round < 2000; round++) {
+        uint32_t k = rnd() % 3;
+        uint8_t arg = (uint8_t)(1 + rnd() % 200);
+        if (rig.sender.submit(kinds[k], &arg, 1)) {
+            lastSubmitted[k] = arg;
+        }
+        rig.run(1 + rnd() % 40);
+    }
+    rig.run(2000);
+
+    const LinkCommandStats& s = rig.sender.stats();
+    printf("  sent %u acked %u retries %u failed %u, S1 executed %zu\n", s.sent, s.acked, s.retries, s.failed,
+           executed.size());
+    char detail[64];
+    snprintf(detail, sizeof(detail), "(sent %u, acked %u, failed %u)", s.sent, s.acked, s.failed);
+    check(s.sent == s.acked + s.failed && rig.sender.queued() == 0, "lossy: every command acked or failed", detail);
+    snprintf(detail, sizeof(detail), "(max %u)", rig.maxInFlight);
+    check(rig.maxInFlight <= LINK_CMD_WINDOW, "lossy: window respected", detail);
+    check(!sameKindInFlight, "lossy: never two of a kind in flight");
+    check(s.retries > 0, "lossy: retries happened");
+
+    // 每種命令: S1 執行的序號不會倒退 (舊參數不會在新參數之後生效)，
+    // 最後一個命令若已確認，S1 的狀態就是最後提交的參數
+    bool monotonic = true;
+    bool finalState = true;
+    for (uint32_t k = 0; k < 3; k++) {
+        int lastSeq = -1;
+        uint8_t state = 0;
+        for (size_t i = 0; i < executed.size(); i++) {
+            if (executed[i].cmd != kinds[k]) {
+                continue;
+            }
+            int seq = executed[i].cmdSeq;
+            // 8 位元序號: 與上一個的差距在 128 以內才算前進
+            if (lastSeq >= 0 && seq != lastSeq && (uint8_t)(seq - lastSeq) >= 128) {
+                monotonic = false;
+            }
+            lastSeq = seq;
+            state = executed[i].arg;
+        }
+        uint8_t lastStatus = 0;
+        for (size_t i = 0; i < results.size(); i++) {
+            if (results[i].cmd == kinds[k]) {
+                lastStatus = results[i].status;
+            }
+        }
+        if (lastStatus == LINK_CMD_OK && state != lastSubmitted[k]) {
+            finalState = false;
+        }
+    }
+    check(monotonic, "lossy: S1 never executes an older command after a newer one");
+    check(finalState, "lossy: S1 ends at the last submitted value of each acked kind");
+    check(countExecuted(LINK_CMD_SET_LEDS) > 0 && countExecuted(LINK_CMD_SET_RUMBLE) > 0, "lossy: all kinds executed");
+}
+
+int main(int argc, char** argv) {
+    uint32_t seed = 1;
+    uint32_t lossPercent = SIM_LOSS_PERCENT;
+    for (int i = 1; i < argc; i++) {
+        if (strcmp(argv[i], "--seed") == 0 && i + 1 < argc) {
+            seed = (uint32_t)atoi(argv[++i]);
+        } else if (strcmp(argv[i], "--loss") == 0 && i + 1 < argc) {
+            lossPercent = (uint32_t)atoi(argv[++i]);
+        } else {
+            fprintf(stderr, "usage: %s [--seed N] [--loss PERCENT]\n", argv[0]);
+            return 2;
+        }
+    }
+    if (seed == 0 || lossPercent == 0 || lossPercent >= 100) {
+        fprintf(stderr, "seed must be != 0, loss 1..99\n");
+        return 2;
+    }
+    rngState = seed;
+
+    testLossless();
+    testWindow();
+    testCoalesce();
+    testDeadLink();
+    testLossy(lossPercent);
+
+    return checkSummary();
+}
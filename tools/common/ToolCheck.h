@@ -0,0 +1,43 @@
+// 檔案: ToolCheck.h
+// 作用: tools/ 下各個主機端檢查工具共用的檢查計數與計時
+//
+// 每個工具以 check() 記錄一項檢查，最後 return checkSummary(); 印出 "PASS (N checks)" 並傳回結束碼。
+// nowNs() 量的是執行工具的這台電腦；工具只印主機上的耗時，不換算成 ESP32 的時間，
+// 實機的耗時要在韌體中量測 (例如 S3 /status 的 translate 週期數)。
+//
+// 編譯時加上 -Itools/common (C++17)。
+
+#pragma once
+#include <stdint.h>
+#include <stdio.h>
+#include <time.h>
+
+inline int checkCount = 0;
+inline int checkFailures = 0;
+
+/**
+ * 記錄一項檢查並印出結果
+ * @param detail 附在結果後的量測值 (可省略)
+ */
+inline void check(bool ok, const char* name, const char* detail = "") {
+    checkCount++;
+    if (!ok) {
+        checkFailures++;
+        printf("  FAIL %s %s\n", name, detail);
+    } else {
+        printf("  ok   %s%s%s\n", name, detail[0] != '\0' ? " " : "", detail);
+    }
+}
+
+// 印出 "PASS (N checks)" 或 "FAIL (N checks)"，傳回 main() 的結束碼
+inline int checkSummary() {
+    printf("%s (%d checks)\n", checkFailures == 0 ? "PASS" : "FAIL", checkCount);
+    return checkFailures == 0 ? 0 : 1;
+}
+
+// 單調時鐘 (ns)，只用來量測主機上的耗時
+inline uint64_t nowNs() {
+    struct timespec ts;
+    clock_gettime(CLOCK_MONOTONIC, &ts);
+    return (uint64_t)ts.tv_sec * 1000000000ULL + ts.tv_nsec;
+}
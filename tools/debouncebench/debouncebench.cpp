@@ -0,0 +1,249 @@
+// 檔案: debouncebench.cpp
+// 作用: 在 Linux 上檢查按鈕去彈跳 (WiiMote_i2c/src/ButtonDebounce.h) 的正確性並量測每次 update 的耗時
+//
+// 以合成的接點彈跳 (按下 / 放開時數毫秒的快速切換、單一雜訊脈衝、24 個按鈕同時彈跳、隨機的連續點擊)
+// 驅動與韌體相同的程式碼，確認:
+//   - 立即模式第一個邊緣沒有延遲，彈跳只輸出一次
+//   - 延遲模式濾掉短於視窗的脈衝，維持整個視窗後才輸出
+//   - 每個按鈕的按下 / 放開視窗與模式互不影響
+// 再量測主機上每次 update 的耗時 (含推進數個 tick)。實機的耗時要在 S1 上量測。
+//
+// 編譯 (在專案根目錄):
+//   g++ -std=c++17 -O2 -Icommon/WiimoteLink -IWiiMote_i2c/src -Itools/common
+//       tools/debouncebench/debouncebench.cpp -o debouncebench
+//
+// 用法:
+//   ./debouncebench                           預設 200 Hz 回報
+//   ./debouncebench --rate 100 --iterations 2000000
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+
+#include "WiimoteData.h"
+#include "ButtonDebounce.h"    // WiiMote_i2c/src
+#include "ToolCheck.h"         // tools/common
+
+#define BENCH_RATE_HZ          200
+#define BENCH_ITERATIONS       1000000
+#define SAMPLE_US              250       // 測試時呼叫 update 的間隔 (S1 的 loop() 比回報快得多)
+#define PRESS_MS               5
+#define RELEASE_MS             10
+#define ALL_BUTTONS            0x00FFFFFFUL   // wiimoteButtonSet 的 24 位元
+
+// 以 SAMPLE_US 的間隔驅動去彈跳，記錄輸出的邊緣與第一個邊緣的時間
+struct Rig {
+    ButtonDebouncer d;
+    uint32_t t;
+    uint32_t out;
+    uint32_t edges;         // 監看的按鈕輸出改變次數
+    uint32_t mask;          // 監看的按鈕
+    uint32_t lastEdgeUs;
+
+    explicit Rig(uint32_t watch) : t(1000000), out(0), edges(0), mask(watch), lastEdgeUs(0) { d.reset(0, t); }
+
+    void sample(uint32_t raw) {
+        uint32_t o = d.update(raw, t);
+        if ((o ^ out) & mask) {
+            edges += (uint32_t)__builtin_popcount((o ^ out) & mask);
+            lastEdgeUs = t;
+        }
+        out = o;
+        t += SAMPLE_US;
+    }
+
+    // 維持同一個原始狀態 us 微秒
+    void hold(uint32_t raw, uint32_t us) {
+        for (uint32_t e = 0; e < us; e += SAMPLE_US) {
+            sample(raw);
+        }
+    }
+
+    // 在 raw 與 other 之間每個樣本切換一次，持續 us 微秒，最後停在 other
+    void chatter(uint32_t raw, uint32_t other, uint32_t us) {
+        bool on = false;
+        for (uint32_t e = 0; e < us; e += SAMPLE_US) {
+            sample(on ? raw : other);
+            on = !on;
+        }
+        sample(other);
+    }
+};
+
+static void testEager() {
+    printf("eager\n");
+    Rig r(BUTTON_A);
+    r.d.configure(ALL_BUTTONS, PRESS_MS, RELEASE_MS, true);
+    r.hold(0, 20000);
+    uint32_t pressUs = r.t;
+    r.sample(BUTTON_A);
+    check(r.out == BUTTON_A && r.lastEdgeUs == pressUs, "first edge has no latency");
+    r.chatter(0, BUTTON_A, 3000);
+    r.hold(BUTTON_A, 50000);
+    check(r.edges == 1, "press chatter is one edge");
+    uint32_t releaseUs = r.t;
+    r.sample(0);
+    check(r.out == 0 && r.lastEdgeUs == releaseUs, "release has no latency");
+    r.chatter(BUTTON_A, 0, 8000);
+    r.hold(0, 50000);
+    check(r.edges == 2, "release chatter is one edge");
+
+    // 視窗內真的放開: 鎖定結束時補上
+    r.sample(BUTTON_A);
+    uint32_t tapUs = r.lastEdgeUs;
+    r.hold(BUTTON_A, 2000);
+    r.hold(0, 30000);
+    char detail[64];
+    snprintf(detail, sizeof(detail), "(held %u us)", r.lastEdgeUs - tapUs);
+    check(r.edges == 4 && r.out == 0 && r.lastEdgeUs - tapUs >= (PRESS_MS - 1) * 1000 &&
+              r.lastEdgeUs - tapUs <= (PRESS_MS + 1) * 1000,
+          "short tap is kept and released at lockout end", detail);
+
+    // 鎖定結束後的按下不延遲 (快速連打)
+    r.hold(0, RELEASE_MS * 1000 + 2000);
+    uint32_t againUs = r.t;
+    r.sample(BUTTON_A);
+    check(r.lastEdgeUs == againUs && r.edges == 5, "repress after window is immediate");
+}
+
+static void testDefer() {
+    printf("defer\n");
+    Rig r(BUTTON_B);
+    r.d.configure(ALL_BUTTONS, PRESS_MS, RELEASE_MS, false);
+    r.hold(0, 20000);
+    r.hold(BUTTON_B, 3000);     // 短於按下的視窗
+    r.hold(0, 20000);
+    check(r.edges == 0, "pulse shorter than window is dropped");
+    r.chatter(0, BUTTON_B, 4000);
+    uint32_t settledUs = r.t;
+    r.hold(BUTTON_B, 30000);
+    char detail[64];
+    snprintf(detail, sizeof(detail), "(latency %u us)", r.lastEdgeUs - settledUs);
+    check(r.edges == 1 && r.lastEdgeUs - settledUs >= (PRESS_MS - 1) * 1000 &&
+              r.lastEdgeUs - settledUs <= (PRESS_MS + 1) * 1000,
+          "press is output one window after chatter settles", detail);
+    r.hold(0, 6000);            // 短於放開的視窗
+    r.hold(BUTTON_B, 30000);
+    check(r.edges == 1 && r.out == BUTTON_B, "dropout shorter than release window is dropped");
+    r.hold(0, 30000);
+    check(r.edges == 2 && r.out == 0, "release after window");
+}
+
+static void testPerButton() {
+    printf("per-button\n");
+    Rig r(BUTTON_A | BUTTON_B | BUTTON_ONE);
+    r.d.configure(BUTTON_A, 0, RELEASE_MS, true);    // 只在放開時鎖定
+    r.d.configure(BUTTON_B, PRESS_MS, 2, false);     // 按下要穩定 5ms，放開 2ms
+    r.d.configure(BUTTON_ONE, 0, 0, false);          // 不處理
+    r.hold(0, 20000);
+    r.sample(BUTTON_A | BUTTON_B | BUTTON_ONE);
+    check((r.out & (BUTTON_A | BUTTON_ONE)) == (BUTTON_A | BUTTON_ONE) && !(r.out & BUTTON_B),
+          "eager and pass-through buttons are immediate, deferred waits");
+    r.hold(BUTTON_A | BUTTON_B | BUTTON_ONE, 10000);
+    check(r.out == (BUTTON_A | BUTTON_B | BUTTON_ONE), "deferred button follows after its window");
+    // A 沒有按下鎖定: 按下時的彈跳直接通過
+    uint32_t before = r.edges;
+    r.chatter(BUTTON_B | BUTTON_ONE, BUTTON_A | BUTTON_B | BUTTON_ONE, 1000);
+    r.hold(BUTTON_A | BUTTON_B | BUTTON_ONE, 20000);
+    check(r.edges - before > 1, "zero press window passes press-side chatter");
+    r.d.configure(BUTTON_A, 3, RELEASE_MS, true);
+    before = r.edges;
+    r.hold(BUTTON_B | BUTTON_ONE, 20000);
+    r.chatter(BUTTON_B | BUTTON_ONE, BUTTON_A | BUTTON_B | BUTTON_ONE, 2000);
+    r.hold(BUTTON_A | BUTTON_B | BUTTON_ONE, 20000);
+    check(r.edges - before == 2, "reconfigured window applies on the next edge");
+    before = r.edges;
+    r.hold(BUTTON_A | BUTTON_ONE, 3000);
+    check(!(r.out & BUTTON_B) && r.edges - before == 1, "asymmetric release window");
+}
+
+static void testAllButtons() {
+    printf("all buttons\n");
+    Rig r(ALL_BUTTONS);
+    r.d.configure(ALL_BUTTONS, PRESS_MS, RELEASE_MS, true);
+    r.hold(0, 20000);
+    r.chatter(0, ALL_BUTTONS, 4000);
+    r.hold(ALL_BUTTONS, 20000);
+    r.chatter(ALL_BUTTONS, 0, 8000);
+    r.hold(0, 20000);
+    check(r.edges == 2 * 24, "24 buttons chattering together give one edge each");
+}
+
+// 隨機的連續點擊: 每次按下 / 放開都有短於視窗的彈跳，輸出必須剛好是每次點擊一個按下與一個放開
+static void testRandom(bool eager) {
+    printf("random %s\n", eager ? "eager" : "defer");
+    Rig r(ALL_BUTTONS);
+    r.d.configure(ALL_BUTTONS, PRESS_MS, RELEASE_MS, eager);
+    srand(7);
+    uint32_t clicks = 0;
+    uint32_t raw = 0;
+    r.hold(0, 20000);
+    for (int i = 0; i < 2000; i++) {
+        uint32_t bit = 1UL << (rand() % 24);
+        raw |= bit;
+        r.chatter(raw & ~bit, raw, (uint32_t)(rand() % (PRESS_MS - 1)) * 1000);
+        r.hold(raw, (uint32_t)(RELEASE_MS + 2 + rand() % 30) * 1000);
+        raw &= ~bit;
+        r.chatter(raw | bit, raw, (uint32_t)(rand() % (RELEASE_MS - 1)) * 1000);
+        r.hold(raw, (uint32_t)(RELEASE_MS + 2 + rand() % 30) * 1000);
+        clicks++;
+    }
+    char detail[64];
+    snprintf(detail, sizeof(detail), "(%u edges for %u clicks, %u raw)", r.edges, clicks, r.d.rawEdges());
+    check(r.edges == 2 * clicks && r.d.outputEdges() == r.edges, "one press and one release per click", detail);
+}
+
+static double benchmark(uint32_t iterations, uint32_t rateHz) {
+    ButtonDebouncer d;
+    d.configure(ALL_BUTTONS, PRESS_MS, RELEASE_MS, true);
+    d.configure(BUTTON_A | BUTTON_B, PRESS_MS, RELEASE_MS, false);
+    uint32_t periodUs = 1000000 / rateHz;
+    uint32_t t = 0;
+    uint32_t raw = 0;
+    uint32_t sink = 0;
+    srand(11);
+    uint64_t start = nowNs();
+    for (uint32_t i = 0; i < iterations; i++) {
+        if ((i & 7) == 0) {
+            raw ^= 1UL << (rand() % 24);
+        }
+        sink ^= d.update(raw, t);
+        t += periodUs;
+    }
+    uint64_t elapsed = nowNs() - start;
+    if (sink == 0xDEADBEEF) {
+        printf(" ");
+    }
+    return (double)elapsed / iterations;
+}
+
+int main(int argc, char** argv) {
+    uint32_t rateHz = BENCH_RATE_HZ;
+    uint32_t iterations = BENCH_ITERATIONS;
+    for (int i = 1; i < argc; i++) {
+        if (strcmp(argv[i], "--rate") == 0 && i + 1 < argc) {
+            rateHz = (uint32_t)atoi(argv[++i]);
+        } else if (strcmp(argv[i], "--iterations") == 0 && i + 1 < argc) {
+            iterations = (uint32_t)atoi(argv[++i]);
+        } else {
+            fprintf(stderr, "usage: %s [--rate HZ] [--iterations N]\n", argv[0]);
+            return 2;
+        }
+    }
+    if (rateHz == 0 || iterations == 0) {
+        fprintf(stderr, "rate and iterations must be > 0\n");
+        return 2;
+    }
+
+    testEager();
+    testDefer();
+    testPerButton();
+    testAllButtons();
+    testRandom(true);
+    testRandom(false);
+
+    double ns = benchmark(iterations, rateHz);
+    printf("update: %.1f ns/report on host at %u Hz\n", ns, rateHz);
+    printf("state: %zu bytes\n", sizeof(ButtonDebouncer));
+    return checkSummary();
+}
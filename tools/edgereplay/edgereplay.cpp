@@ -0,0 +1,333 @@
+// 檔案: edgereplay.cpp
+// 作用: 以假時鐘檢查 S1 的按鈕邊緣記錄 (common/WiimoteLink/ButtonEdges.h) 與 S3 的補送，確認快速連打每一下都送到 USB
+//
+// 以 5ms 按下 / 5ms 放開的連打產生 Wiimote 回報，依照 WiiMote_i2c/src/main.cpp 的 updatePlayer():
+//   - 每次 loop 把已排隊的回報逐一交給 ButtonEdgeTracker，記錄已滿就立即送出
+//   - 之後由 SendScheduler 決定是否送出
+// 再以 wiimoteStateEncode / wiimoteStateDecode 傳給模擬的 S3，依照 SwitchPro_i2c/src/main.cpp 的
+// handleWiimoteState() 先補送中間狀態再送最終狀態，記錄每個 USB 報告的按鈕。
+// USB 報告的按鈕序列必須與 S1 看到的按鈕序列完全相同 (每一下按下與放開都在，順序不變)，
+// 包括 loop 停頓時一次排隊超過 WIIMOTE_EDGE_MAX 個變化、以及 Nunchuk C/Z (第 16、17 位元) 的連打。
+// 邊緣欄位只帶 edgeCount 個中間狀態，解碼與編碼時 edgeCount 都不超過 WIIMOTE_EDGE_MAX。
+// 最後以舊的寫法 (全部處理完才檢查 full()) 跑同一組輸入，確認這個測試確實抓得到遺失的點擊。
+// 所有時間都是模擬的，結果每次都相同。
+//
+// 編譯 (在專案根目錄):
+//   g++ -std=c++17 -O2 -Icommon/WiimoteLink -IWiiMote_i2c/src
+//       -Itools/common tools/edgereplay/edgereplay.cpp common/WiimoteLink/WiimoteData.cpp -o edgereplay
+//
+// 用法:
+//   ./edgereplay                              預設每個情境 200 下連打
+//   ./edgereplay --taps 1000
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+
+#include <vector>
+
+#include "WiimoteData.h"
+#include "ButtonEdges.h"
+#include "SendScheduler.h"     // WiiMote_i2c/src
+#include "ToolCheck.h"   // tools/common
+
+#define SIM_TAPS             200
+#define SIM_TAP_US           5000      // 按下與放開各 5ms
+#define SIM_LOOP_US          1000      // S1 loop() 的間隔
+#define SIM_INTERVAL_US      20000     // 與 WiiMote_i2c/src/main.cpp 的 SEND_INTERVAL_MS 相同
+#define SIM_MIN_SPACING_US   1000      // SEND_MIN_SPACING_US
+#define SIM_HEARTBEAT_US     250000    // SEND_HEARTBEAT_MS
+
+// 一個 Wiimote 回報: 到達 S1 的時間與按鈕 (wiimoteButtonSet 格式)
+struct Report {
+    uint32_t us;
+    uint32_t buttons;
+};
+
+/**
+ * 產生連打: buttons[] 依序輪流，每一下按下 SIM_TAP_US 再放開 SIM_TAP_US
+ * @param held 整段期間一直按住的按鈕 (與連打的按鈕組合)
+ */
+static std::vector<Report> makeTaps(const uint32_t* buttons, size_t count, uint32_t taps, uint32_t held) {
+    std::vector<Report> reports;
+    uint32_t t = 100000;
+    reports.push_back({ t, held });
+    for (uint32_t i = 0; i < taps; i++) {
+        t += SIM_TAP_US;
+        reports.push_back({ t, held | buttons[i % count] });
+        t += SIM_TAP_US;
+        reports.push_back({ t, held });
+    }
+    return reports;
+}
+
+// 依照 updatePlayer() / sendPlayerState() 的 S1
+struct S1Model {
+    WiimoteState current;
+    WiimoteState sent;
+    ButtonEdgeTracker edges;
+    SendScheduler scheduler;
+    bool sendWhenFull;      // false: 舊的寫法，全部回報處理完才檢查 full()
+    std::vector<std::vector<uint8_t> > wire;
+    uint32_t maxEdges;      // 單一封包帶的中間狀態數
+
+    S1Model(SendPolicy policy, bool whenFull)
+        : scheduler(policy, SIM_INTERVAL_US, SIM_MIN_SPACING_US, SIM_HEARTBEAT_US), sendWhenFull(whenFull), maxEdges(0) {
+        memset(&current, 0, sizeof(current));
+        memset(&sent, 0, sizeof(sent));
+        current.flags = WIIMOTE_FLAG_CONNECTED;
+    }
+
+    void send(uint32_t now, bool force) {
+        if (wiimoteStateDiff(current, sent) != 0) {
+            scheduler.markChanged();
+        }
+        if (!scheduler.shouldSend(now) && !force) {
+            return;
+        }
+        scheduler.onSent(now);
+        uint8_t fields = wiimoteStateDiff(current, sent);
+        if (edges.needsReplay()) {
+            edges.store(current);
+            fields |= STATE_FIELD_EDGES | STATE_FIELD_BUTTONS;
+            if (current.edgeCount > maxEdges) {
+                maxEdges = current.edgeCount;
+            }
+        }
+        edges.clear();
+        std::vector<uint8_t> payload(WIIMOTE_STATE_MAX_SIZE);
+        payload.resize(wiimoteStateEncode(payload.data(), current, fields));
+        wire.push_back(payload);
+        sent = current;
+    }
+
+    // 一次 loop(): 處理 queue 中所有的回報
+    void loop(uint32_t now, const Report* queue, size_t count) {
+        for (size_t i = 0; i < count; i++) {
+            current.buttons = (uint16_t)queue[i].buttons;
+            current.extButtons = (uint8_t)(queue[i].buttons >> 16);
+            edges.update(queue[i].buttons);
+            if (sendWhenFull && edges.full()) {
+                send(now, true);
+            }
+        }
+        if (!sendWhenFull && edges.full()) {
+            send(now, true);
+        }
+        send(now, false);
+    }
+};
+
+// 依照 handleWiimoteState() 的 S3: 記錄每個 USB 報告的按鈕
+struct S3Model {
+    WiimoteState state;
+    uint32_t applied;
+    uint32_t replays;
+    std::vector<uint32_t> usb;
+
+    S3Model() : applied(0), replays(0) { memset(&state, 0, sizeof(state)); }
+
+    void apply(uint32_t buttons) {
+        if (usb.empty() || usb.back() != buttons) {
+            usb.push_back(buttons);
+        }
+    }
+
+    bool receive(const std::vector<uint8_t>& payload) {
+        uint8_t fields = 0;
+        if (!wiimoteStateDecode(payload.data(), payload.size(), state, &fields)) {
+            return false;
+        }
+        uint32_t buttons = wiimoteButtonSet(state);
+        if (fields & STATE_FIELD_EDGES) {
+            for (uint8_t i = 0; i < state.edgeCount && i < WIIMOTE_EDGE_MAX; i++) {
+                uint32_t replay = wiimoteEdgeState(state, i);
+                if (replay != applied) {
+                    apply(replay);
+                    applied = replay;
+                    replays++;
+                }
+            }
+        }
+        apply(buttons);
+        applied = buttons;
+        return true;
+    }
+};
+
+struct RunResult {
+    std::vector<uint32_t> expected;   // S1 看到的按鈕序列 (去掉重複)
+    std::vector<uint32_t> usb;
+    size_t frames;
+    uint32_t maxEdges;
+    uint32_t maxQueued;               // 單次 loop 排隊的變化數
+    uint32_t replays;
+    bool decodeOk;
+};
+
+/**
+ * 以假時鐘執行一個情境
+ * @param stallUs S1 loop 每隔 stallEveryUs 停頓的長度 (藍牙堆疊一次交出一批回報)，0: 不停頓
+ */
+static RunResult run(const std::vector<Report>& reports, SendPolicy policy, bool sendWhenFull,
+                     uint32_t stallUs, uint32_t stallEveryUs) {
+    RunResult r;
+    S1Model s1(policy, sendWhenFull);
+    S3Model s3;
+    size_t next = 0;
+    uint32_t now = reports.front().us;
+    uint32_t nextStallUs = now + stallEveryUs;
+    r.maxQueued = 0;
+    while (next < reports.size() || now < reports.back().us + 2 * SIM_INTERVAL_US) {
+        size_t first = next;
+        while (next < reports.size() && reports[next].us <= now) {
+            next++;
+        }
+        uint32_t changes = 0;
+        for (size_t i = first; i < next; i++) {
+            changes += (i == 0 || reports[i].buttons != reports[i - 1].buttons) ? 1 : 0;
+        }
+        if (changes > r.maxQueued) {
+            r.maxQueued = changes;
+        }
+        s1.loop(now, reports.data() + first, next - first);
+        now += SIM_LOOP_US;
+        if (stallUs && (int32_t)(now - nextStallUs) >= 0) {
+            now += stallUs;
+            nextStallUs = now + stallEveryUs;
+        }
+    }
+    r.decodeOk = true;
+    for (size_t i = 0; i < s1.wire.size(); i++) {
+        r.decodeOk = s3.receive(s1.wire[i]) && r.decodeOk;
+    }
+    for (size_t i = 0; i < reports.size(); i++) {
+        if (r.expected.empty() || r.expected.back() != reports[i].buttons) {
+            r.expected.push_back(reports[i].buttons);
+        }
+    }
+    r.usb = s3.usb;
+    r.frames = s1.wire.size();
+    r.maxEdges = s1.maxEdges;
+    r.replays = s3.replays;
+    return r;
+}
+
+// 序列中進入 state 的次數 (每一下連打都是進入一次「按住的按鈕 + 這一下的按鈕」)
+static uint32_t countPresses(const std::vector<uint32_t>& seq, uint32_t state) {
+    uint32_t presses = 0;
+    for (size_t i = 0; i < seq.size(); i++) {
+        if (seq[i] == state && (i == 0 || seq[i - 1] != state)) {
+            presses++;
+        }
+    }
+    return presses;
+}
+
+static void testScenario(const char* name, const std::vector<Report>& reports, SendPolicy policy,
+                         uint32_t stallUs, uint32_t stallEveryUs, const uint32_t* buttons, size_t count,
+                         uint32_t held) {
+    RunResult r = run(reports, policy, true, stallUs, stallEveryUs);
+    printf("%s: %zu reports, %zu frames, up to %u changes queued per loop, up to %u edges per frame, %u replays\n",
+           name, reports.size(), r.frames, r.maxQueued, r.maxEdges, r.replays);
+    char label[96];
+    char detail[96];
+    snprintf(label, sizeof(label), "%s: states decode", name);
+    check(r.decodeOk, label);
+    snprintf(label, sizeof(label), "%s: USB reports match every S1 state in order", name);
+    snprintf(detail, sizeof(detail), "(%zu reports, expected %zu)", r.usb.size(), r.expected.size());
+    check(r.usb == r.expected, label, detail);
+    for (size_t i = 0; i < count; i++) {
+        uint32_t want = countPresses(r.expected, held | buttons[i]);
+        uint32_t got = countPresses(r.usb, held | buttons[i]);
+        snprintf(label, sizeof(label), "%s: every tap of 0x%05X pressed", name, (unsigned)buttons[i]);
+        snprintf(detail, sizeof(detail), "(%u of %u)", got, want);
+        check(got == want, label, detail);
+    }
+    if (stallUs) {
+        snprintf(label, sizeof(label), "%s: burst exceeds WIIMOTE_EDGE_MAX", name);
+        snprintf(detail, sizeof(detail), "(%u changes)", r.maxQueued);
+        check(r.maxQueued > WIIMOTE_EDGE_MAX + 1, label, detail);
+    }
+}
+
+// 邊緣欄位的線上格式: 只帶 edgeCount 個中間狀態，解碼時 edgeCount 不超過 WIIMOTE_EDGE_MAX
+static void testEdgeField() {
+    printf("edge field:\n");
+    WiimoteState state;
+    wiimoteStateReset(state);
+    state.buttons = BUTTON_A;
+    state.edgeCount = 1;
+    state.edgeStates[0][0] = (uint8_t)BUTTON_B;
+    uint8_t payload[WIIMOTE_STATE_MAX_SIZE];
+    size_t len = wiimoteStateEncode(payload, state, STATE_FIELD_BUTTONS | STATE_FIELD_EDGES);
+    char detail[64];
+    snprintf(detail, sizeof(detail), "(%zu bytes)", len);
+    check(len == WIIMOTE_STATE_HEADER_SIZE + 3 + 1 + 3, "one edge encodes one edge state", detail);
+    check(wiimoteStateEncode(payload, state, STATE_FIELD_BUTTONS) == WIIMOTE_STATE_HEADER_SIZE + 3,
+          "no edge bytes without STATE_FIELD_EDGES");
+
+    len = wiimoteStateEncode(payload, state, STATE_FIELD_BUTTONS | STATE_FIELD_EDGES);
+    WiimoteState decoded;
+    wiimoteStateReset(decoded);
+    decoded.edgeCount = 3;
+    bool ok = wiimoteStateDecode(payload, len, decoded, NULL);
+    check(ok && decoded.edgeCount == 1 && decoded.edgeStates[0][0] == (uint8_t)BUTTON_B, "edge state round trip");
+    check(!wiimoteStateDecode(payload, len - 1, decoded, NULL), "truncated edge states are rejected");
+
+    // 收到超過上限的 edgeCount 時只取前 WIIMOTE_EDGE_MAX 個
+    uint8_t oversized[WIIMOTE_STATE_HEADER_SIZE + 1 + 9 * 3] = { WIIMOTE_STATE_VERSION, STATE_FIELD_EDGES, 9 };
+    ok = wiimoteStateDecode(oversized, sizeof(oversized), decoded, NULL);
+    snprintf(detail, sizeof(detail), "(edgeCount %u)", decoded.edgeCount);
+    check(ok && decoded.edgeCount == WIIMOTE_EDGE_MAX, "edgeCount is clamped to WIIMOTE_EDGE_MAX", detail);
+    state.edgeCount = 9;
+    len = wiimoteStateEncode(payload, state, STATE_FIELD_EDGES);
+    check(len == WIIMOTE_STATE_HEADER_SIZE + 1 + WIIMOTE_EDGE_MAX * 3 && payload[2] == WIIMOTE_EDGE_MAX,
+          "encoder clamps edgeCount to WIIMOTE_EDGE_MAX");
+}
+
+int main(int argc, char** argv) {
+    uint32_t taps = SIM_TAPS;
+    for (int i = 1; i < argc; i++) {
+        if (strcmp(argv[i], "--taps") == 0 && i + 1 < argc) {
+            taps = (uint32_t)atoi(argv[++i]);
+        } else {
+            fprintf(stderr, "usage: %s [--taps N]\n", argv[0]);
+            return 2;
+        }
+    }
+    if (taps < 10) {
+        fprintf(stderr, "taps must be >= 10\n");
+        return 2;
+    }
+
+    testEdgeField();
+
+    static const uint32_t single[] = { BUTTON_A };
+    static const uint32_t mixed[] = { BUTTON_A, BUTTON_B, BUTTON_TWO, BUTTON_A | BUTTON_B };
+    static const uint32_t nunchuk[] = { BUTTON_C, BUTTON_Z, BUTTON_C | BUTTON_Z };
+
+    std::vector<Report> aTaps = makeTaps(single, 1, taps, 0);
+    std::vector<Report> mixedTaps = makeTaps(mixed, 4, taps, 0);
+    std::vector<Report> czTaps = makeTaps(nunchuk, 3, taps, BUTTON_ONE);
+
+    // 固定 20ms: 每個封包之間約有 4 個變化 (3 個中間狀態)
+    testScenario("fixed 20ms", aTaps, SEND_POLICY_FIXED_RATE, 0, 0, single, 1, 0);
+    // 變化即送，但 loop 每 30ms 停頓 45ms: 一次排隊約 10 個變化
+    testScenario("on-change, stalled loop", mixedTaps, SEND_POLICY_ON_CHANGE, 45000, 30000, mixed, 4, 0);
+    // 固定 20ms 加上停頓: 每次停頓後都超過記錄上限
+    testScenario("fixed 20ms, stalled loop", mixedTaps, SEND_POLICY_FIXED_RATE, 60000, 10000, mixed, 4, 0);
+    // Nunchuk C/Z 在第 16、17 位元，同時按住 1
+    testScenario("nunchuk C/Z, stalled loop", czTaps, SEND_POLICY_HYBRID, 45000, 30000, nunchuk, 3, BUTTON_ONE);
+
+    // 舊的寫法: 全部處理完才檢查 full()，停頓時必定遺失點擊
+    RunResult old = run(mixedTaps, SEND_POLICY_FIXED_RATE, false, 60000, 10000);
+    uint32_t lost = 0;
+    for (size_t i = 0; i < 4; i++) {
+        lost += countPresses(old.expected, mixed[i]) - countPresses(old.usb, mixed[i]);
+    }
+    printf("check full() after draining: %u of %u taps lost\n", lost, taps);
+    check(lost > 0, "test detects taps lost when full() is checked after draining");
+
+    return checkSummary();
+}
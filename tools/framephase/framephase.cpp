@@ -0,0 +1,330 @@
+// 檔案: framephase.cpp
+// 作用: 在 Linux 上模擬 USB 主機的 SOF，檢查 S3 的 frame 相位估計與計時器排程 (SwitchPro_i2c/src/UsbFramePhase.h)，
+//       並比較兩種排程下「報告內容產生 -> 主機輪詢」的資料年齡分布
+//
+// 主機的 SOF 以固定的 ppm 誤差與隨機相位產生，frame number 暫存器照實際硬體每個 SOF 加一 (11 位元)。
+// 裝置端與韌體相同: 每次計時器觸發取樣一次 frame number，交給 UsbFrameTimer 決定下一次觸發；
+// 報告 tick 喚醒輸入任務 (延遲 WAKE_MIN_US ~ WAKE_MAX_US)，映射後交給端點，在下一個 SOF 被主機取走。
+// 檢查:
+//   - 100 ms 內鎖定，之後估計的 SOF 與實際相差不超過鎖定寬度 (解除鎖定的區間寬度的一半)
+//   - 對齊 SOF 時所有 tick 產生的報告都趕上下一次輪詢，年齡不超過 lead
+//   - 主機重新列舉 (frame number 跳動) 或暫停 (frame number 停住) 後退回任意相位並重新鎖定
+//   - 32 位元時間回繞時仍維持鎖定
+// 再量測主機上每次計時器觸發 (取樣 + 排程) 的耗時。
+//
+// 編譯 (在專案根目錄):
+//   g++ -std=c++17 -O2 -ISwitchPro_i2c/src -Itools/common tools/framephase/framephase.cpp -o framephase
+//
+// 用法:
+//   ./framephase                              預設 lead 150 µs、主機時鐘 +250 ppm
+//   ./framephase --lead 100 --ppm -400 --seconds 20
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+
+#include "UsbFramePhase.h"     // SwitchPro_i2c/src
+#include "LatencyHistogram.h"  // SwitchPro_i2c/src
+#include "ToolCheck.h"         // tools/common
+
+#define SIM_LEAD_US            150       // 與 main.cpp 的 USB_SOF_LEAD_US 相同
+#define SIM_PPM                250       // 主機 SOF 相對本地時鐘的誤差
+#define SIM_SECONDS            10
+#define SIM_WARMUP_US          200000    // 比較年齡分布前先讓相位鎖定
+#define SIM_LOCK_BUDGET_US     100000
+#define TIMER_JITTER_US        20        // esp_timer 任務的派送延遲 0 ~ 20 µs
+#define WAKE_MIN_US            20        // 通知 -> 輸入任務開始執行
+#define WAKE_MAX_US            60
+#define MAP_MIN_US             10        // 映射 + 交給端點
+#define MAP_MAX_US             30
+#define BENCH_ITERATIONS       2000000
+
+static uint32_t randRange(uint32_t lo, uint32_t hi) {
+    return lo + (uint32_t)(rand() % (int)(hi - lo + 1));
+}
+
+// 主機: SOF(n) = originUs + n * periodUs (本地時間，double 避免累積誤差)
+struct Host {
+    double originUs;
+    double periodUs;
+    uint32_t frameBase;
+    bool frozen;           // 暫停: frame number 停住
+    uint16_t frozenFrame;
+
+    Host(double origin, int32_t ppm) : originUs(origin), periodUs(USB_FRAME_US * (1.0 + ppm * 1e-6)),
+                                       frameBase(0), frozen(false), frozenFrame(0) {}
+
+    int64_t frameIndex(uint64_t t) const {
+        double n = ((double)t - originUs) / periodUs;
+        return n >= 0 ? (int64_t)n : (int64_t)n - 1;
+    }
+    uint16_t frameNumber(uint64_t t) const {
+        if (frozen) return frozenFrame;
+        return (uint16_t)((frameBase + (uint64_t)frameIndex(t)) & USB_FRAME_NUMBER_MASK);
+    }
+    // t 之後的第一個 SOF (主機取走端點中的報告)
+    uint64_t nextSof(uint64_t t) const {
+        double s = originUs + (double)(frameIndex(t) + 1) * periodUs;
+        uint64_t u = (uint64_t)s;
+        return u > t ? u : t + 1;
+    }
+    // 離 t 最近的 SOF
+    double nearestSof(uint64_t t) const {
+        double n = ((double)t - originUs) / periodUs;
+        double k = n >= 0 ? (double)(int64_t)(n + 0.5) : -(double)(int64_t)(-n + 0.5);
+        return originUs + k * periodUs;
+    }
+    // 重新列舉: t 所在的 frame 編號為 newFrame，這個 frame 在 t 之前 phaseUs 開始
+    void restart(uint64_t t, uint32_t newFrame, double phaseUs) {
+        originUs = (double)t - phaseUs;
+        frameBase = newFrame;
+    }
+};
+
+// 裝置: 計時器回呼 + 輸入任務；時間用 64 位元模擬，傳給韌體的程式碼時截成 32 位元 (與 esp_timer_get_time() 相同)
+struct Device {
+    Host& host;
+    UsbFramePhase phase;
+    UsbFrameTimer timer;
+    uint32_t leadUs;
+    uint64_t fireUs;             // 下一次計時器觸發
+    uint64_t lastTickUs;
+    uint32_t epochUs;            // 本地時間的 32 位元偏移 (測試回繞)
+    uint32_t ticks;
+    uint32_t maxTickGapUs;
+    uint32_t unlockedSamples;
+    double maxErrorUs;           // 鎖定時估計 SOF 與實際 SOF 的最大差
+    bool trackError;
+    LatencyHistogram age;
+    uint32_t late;               // 趕不上下一次輪詢 (年齡 > 1 frame) 的報告
+
+    Device(Host& h, uint32_t lead, uint64_t start, uint32_t epoch)
+        : host(h), leadUs(lead), fireUs(start), lastTickUs(0), epochUs(epoch), ticks(0), maxTickGapUs(0),
+          unlockedSamples(0), maxErrorUs(0), trackError(false), late(0) {
+        timer.reset(local(start));
+    }
+
+    uint32_t local(uint64_t t) const { return (uint32_t)t + epochUs; }
+
+    void resetStats() {
+        age.reset();
+        late = 0;
+        maxTickGapUs = 0;
+        unlockedSamples = 0;
+        maxErrorUs = 0;
+    }
+
+    // 執行到 endUs 為止
+    void run(uint64_t endUs) {
+        while (fireUs < endUs) {
+            uint64_t t = fireUs;
+            phase.sample(local(t), host.frameNumber(t));
+            if (trackError) {
+                if (!phase.locked()) {
+                    unlockedSamples++;
+                } else {
+                    // 估計的下一個 SOF 與實際的比較 (換回 64 位元時間)
+                    double est = (double)t + (int32_t)(phase.nextSof(local(t)) - local(t));
+                    double err = est - host.nearestSof((uint64_t)est);
+                    if (err < 0) err = -err;
+                    if (err > maxErrorUs) maxErrorUs = err;
+                }
+            }
+            bool tick;
+            uint32_t delay = timer.fire(local(t), phase, leadUs, tick);
+            fireUs = t + delay + randRange(0, TIMER_JITTER_US);
+            if (tick) {
+                if (lastTickUs != 0 && t - lastTickUs > maxTickGapUs) {
+                    maxTickGapUs = (uint32_t)(t - lastTickUs);
+                }
+                lastTickUs = t;
+                ticks++;
+                // 輸入任務產生報告並交給端點，主機在下一個 SOF 取走
+                uint64_t produced = t + randRange(WAKE_MIN_US, WAKE_MAX_US) + randRange(MAP_MIN_US, MAP_MAX_US);
+                uint32_t a = (uint32_t)(host.nextSof(produced) - produced);
+                age.record(a);
+                if (a > USB_FRAME_US) late++;
+            }
+        }
+    }
+
+    // 從目前時間起到鎖定為止的時間 (µs)，超過 limitUs 回傳 limitUs
+    uint32_t runUntilLocked(uint32_t limitUs) {
+        uint64_t start = fireUs;
+        while (!phase.locked() && fireUs - start < limitUs) {
+            run(fireUs + 1);
+        }
+        return (uint32_t)(fireUs - start);
+    }
+};
+
+static void printAge(const char* name, const LatencyHistogram& h) {
+    printf("    %-5s n=%u min=%u mean=%u p50=%u p99=%u max=%u\n", name, h.count(), h.min(), h.mean(),
+           h.percentile(500), h.percentile(990), h.max());
+}
+
+static void testLock(int32_t ppm) {
+    printf("lock (%+d ppm)\n", ppm);
+    char detail[96];
+    for (int run = 0; run < 20; run++) {
+        Host host(randRange(0, 999) + 0.5, ppm);
+        Device dev(host, 0, 5000 + randRange(0, 999), 0);
+        uint32_t lockUs = dev.runUntilLocked(SIM_LOCK_BUDGET_US * 2);
+        dev.resetStats();
+        dev.trackError = true;
+        dev.run(dev.fireUs + 2000000);
+        if (run == 0 || lockUs > SIM_LOCK_BUDGET_US || dev.unlockedSamples > 0 || dev.maxErrorUs > USB_FRAME_LOCK_US) {
+            snprintf(detail, sizeof(detail), "(run %d: locked after %u us, max error %.1f us, %u unlocked samples)",
+                     run, lockUs, dev.maxErrorUs, dev.unlockedSamples);
+            check(lockUs <= SIM_LOCK_BUDGET_US && dev.unlockedSamples == 0 && dev.maxErrorUs <= USB_FRAME_LOCK_US,
+                  "locks and stays locked", detail);
+        }
+    }
+}
+
+static void testCompare(uint32_t leadUs, int32_t ppm, uint32_t seconds) {
+    printf("data age at poll (%u s each, lead %u us, %+d ppm)\n", seconds, leadUs, ppm);
+    char detail[96];
+    Host host(437.25, ppm);
+
+    Device asap(host, 0, 1000, 0);
+    asap.run(SIM_WARMUP_US);
+    asap.resetStats();
+    asap.run(SIM_WARMUP_US + (uint64_t)seconds * 1000000);
+
+    Device sof(host, leadUs, 1000, 0);
+    sof.run(SIM_WARMUP_US);
+    sof.resetStats();
+    sof.trackError = true;
+    sof.run(SIM_WARMUP_US + (uint64_t)seconds * 1000000);
+
+    printAge("asap", asap.age);
+    printAge("sof", sof.age);
+    // 時鐘誤差讓任意相位在測試期間掃過至少一個 frame 時，平均才會接近半個 frame
+    if ((uint64_t)seconds * (uint32_t)(ppm < 0 ? -ppm : ppm) >= USB_FRAME_US) {
+        snprintf(detail, sizeof(detail), "(mean %u us)", asap.age.mean());
+        check(asap.age.mean() > USB_FRAME_US / 4 && asap.age.mean() < USB_FRAME_US * 3 / 4,
+              "arbitrary phase averages about half a frame", detail);
+    }
+    snprintf(detail, sizeof(detail), "(max %u us, %u late, %u unlocked samples)", sof.age.max(), sof.late, sof.unlockedSamples);
+    check(sof.age.max() <= leadUs && sof.late == 0 && sof.unlockedSamples == 0, "aligned reports all make the next poll", detail);
+    snprintf(detail, sizeof(detail), "(%u vs %u ticks)", sof.ticks, asap.ticks);
+    uint32_t diff = sof.ticks > asap.ticks ? sof.ticks - asap.ticks : asap.ticks - sof.ticks;
+    check(diff < asap.ticks / 100, "one tick per frame in both modes", detail);
+}
+
+static void testReenumerate(uint32_t leadUs) {
+    printf("re-enumeration\n");
+    char detail[96];
+    Host host(120.0, -300);
+    Device dev(host, leadUs, 1000, 0);
+    dev.run(SIM_WARMUP_US);
+    check(dev.phase.locked(), "locked before re-enumeration");
+    uint32_t resyncs = dev.phase.resyncs();
+    host.restart(dev.fireUs, 1234, 611.0);
+    dev.resetStats();
+    dev.run(dev.fireUs + 1);
+    uint32_t lockUs = dev.runUntilLocked(SIM_LOCK_BUDGET_US * 2);
+    dev.run(dev.fireUs + 2 * USB_FRAME_US);   // 鎖定前排好的 tick 還在任意相位
+    snprintf(detail, sizeof(detail), "(%u resyncs, locked after %u us)", dev.phase.resyncs() - resyncs, lockUs);
+    check(dev.phase.resyncs() > resyncs && lockUs <= SIM_LOCK_BUDGET_US, "detects the jump and relocks", detail);
+    snprintf(detail, sizeof(detail), "(max gap %u us)", dev.maxTickGapUs);
+    // 重新鎖定時 tick 移到新的相位，最多晚半個 frame
+    check(dev.maxTickGapUs <= USB_FRAME_US * 3 / 2 + TIMER_JITTER_US, "ticks keep running through the relock", detail);
+    dev.resetStats();
+    dev.trackError = true;
+    dev.run(dev.fireUs + 1000000);
+    snprintf(detail, sizeof(detail), "(max age %u us, max error %.1f us)", dev.age.max(), dev.maxErrorUs);
+    check(dev.age.max() <= leadUs && dev.unlockedSamples == 0, "aligned again at the new phase", detail);
+}
+
+static void testSuspend(uint32_t leadUs) {
+    printf("suspend\n");
+    char detail[96];
+    Host host(800.0, 100);
+    Device dev(host, leadUs, 1000, 0);
+    dev.run(SIM_WARMUP_US);
+    host.frozenFrame = host.frameNumber(dev.fireUs);
+    host.frozen = true;
+    dev.resetStats();
+    dev.run(dev.fireUs + 50000);
+    check(!dev.phase.locked(), "frozen frame number drops the lock");
+    snprintf(detail, sizeof(detail), "(max gap %u us)", dev.maxTickGapUs);
+    check(dev.maxTickGapUs <= USB_FRAME_US + TIMER_JITTER_US + 2 * USB_FRAME_PROBE_US, "falls back to 1 ms ticks", detail);
+    // 恢復: frame number 從停住的值之後繼續 (主機時鐘沒停，但裝置看不到中間的 SOF)
+    host.frozen = false;
+    host.restart(dev.fireUs, host.frozenFrame + 1, 300.0);
+    uint32_t lockUs = dev.runUntilLocked(SIM_LOCK_BUDGET_US * 2);
+    snprintf(detail, sizeof(detail), "(locked after %u us)", lockUs);
+    check(lockUs <= SIM_LOCK_BUDGET_US, "relocks after resume", detail);
+}
+
+static void testWrap(uint32_t leadUs) {
+    printf("32-bit wrap\n");
+    char detail[96];
+    Host host(55.0, 250);
+    // 本地時間在模擬開始 1 秒後回繞
+    Device dev(host, leadUs, 1000, 0u - 1000000u - 1000u);
+    dev.run(SIM_WARMUP_US);
+    dev.resetStats();
+    dev.trackError = true;
+    dev.run(dev.fireUs + 3000000);
+    snprintf(detail, sizeof(detail), "(max age %u us, max error %.1f us)", dev.age.max(), dev.maxErrorUs);
+    check(dev.unlockedSamples == 0 && dev.age.max() <= leadUs && dev.late == 0, "stays aligned across the wrap", detail);
+}
+
+static void bench(uint32_t iterations) {
+    UsbFramePhase phase;
+    UsbFrameTimer timer;
+    uint32_t t = 1000;
+    volatile uint32_t sink = 0;
+    uint64_t start = nowNs();
+    for (uint32_t i = 0; i < iterations; i++) {
+        // 本地時鐘比主機快 250 ppm，每次觸發前進約一個 frame
+        phase.sample(t, (uint16_t)((uint64_t)t * 3999 / 4000000));
+        bool tick;
+        uint32_t delay = timer.fire(t, phase, SIM_LEAD_US, tick);
+        sink += delay + tick;
+        t += delay;
+    }
+    double ns = (double)(nowNs() - start) / iterations;
+    printf("timer fire: %.1f ns on host\n", ns);
+    printf("state: %zu + %zu bytes\n", sizeof(UsbFramePhase), sizeof(UsbFrameTimer));
+}
+
+int main(int argc, char** argv) {
+    uint32_t leadUs = SIM_LEAD_US;
+    int32_t ppm = SIM_PPM;
+    uint32_t seconds = SIM_SECONDS;
+    uint32_t iterations = BENCH_ITERATIONS;
+    for (int i = 1; i < argc; i++) {
+        if (strcmp(argv[i], "--lead") == 0 && i + 1 < argc) {
+            leadUs = (uint32_t)atoi(argv[++i]);
+        } else if (strcmp(argv[i], "--ppm") == 0 && i + 1 < argc) {
+            ppm = atoi(argv[++i]);
+        } else if (strcmp(argv[i], "--seconds") == 0 && i + 1 < argc) {
+            seconds = (uint32_t)atoi(argv[++i]);
+        } else if (strcmp(argv[i], "--iterations") == 0 && i + 1 < argc) {
+            iterations = (uint32_t)atoi(argv[++i]);
+        } else {
+            fprintf(stderr, "usage: %s [--lead US] [--ppm N] [--seconds N] [--iterations N]\n", argv[0]);
+            return 2;
+        }
+    }
+    if (leadUs <= WAKE_MAX_US + MAP_MAX_US + TIMER_JITTER_US || leadUs >= USB_FRAME_US / 2 || seconds == 0 ||
+        iterations == 0 || ppm < -500 || ppm > 500) {
+        fprintf(stderr, "lead must be %u..%u us, ppm within +/-500, seconds and iterations > 0\n",
+                WAKE_MAX_US + MAP_MAX_US + TIMER_JITTER_US + 1, USB_FRAME_US / 2 - 1);
+        return 2;
+    }
+    srand(1);
+
+    testLock(ppm);
+    testLock(-ppm);
+    testCompare(leadUs, ppm, seconds);
+    testReenumerate(leadUs);
+    testSuspend(leadUs);
+    testWrap(leadUs);
+    bench(iterations);
+    return checkSummary();
+}
@@ -0,0 +1,210 @@
+// 檔案: gesturereplay.cpp
+// 作用: 在 Linux 上重播加速度樣本，檢查手勢偵測 (SwitchPro_i2c/src/GestureDetector.h) 的虛擬按鈕，
+//       並量測主機上每個樣本的耗時
+//
+// 樣本檔 (預設 tools/gesturereplay/traces.txt) 每行一個 8 位元加速度樣本，中間穿插 expect 行描述預期結果，
+// 格式說明見樣本檔開頭。S3 的 /status 也會列出目前的手勢特徵，方便對照實機動作。
+//
+// 編譯 (在專案根目錄):
+//   g++ -std=c++17 -O2 -Icommon/WiimoteLink -ISwitchPro_i2c/src -Itools/common
+//       tools/gesturereplay/gesturereplay.cpp common/WiimoteLink/WiimoteData.cpp -o gesturereplay
+//
+// 用法:
+//   ./gesturereplay                                 重播預設樣本並量測
+//   ./gesturereplay my_trace.txt                    重播自己錄的樣本
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+
+#include "WiimoteData.h"
+#include "GestureDetector.h"   // SwitchPro_i2c/src
+#include "ToolCheck.h"         // tools/common
+
+#define REPLAY_PERIOD_US       10000     // 加速度樣本間隔 (100 Hz)
+#define REPLAY_TICK_US         1000      // S3 的 USB frame 計時器
+#define REPLAY_SHAKE_TENTHS    12        // 與設定檔預設值相同
+#define REPLAY_SWING_TENTHS    20
+#define REPLAY_ITERATIONS      1000000
+#define REPLAY_MAX_SAMPLES     4096
+
+struct Replay {
+    GestureDetector detectors[2];   // [0] Wiimote, [1] Nunchuk
+    GestureResponse response;
+    uint8_t source;
+    uint32_t t;
+    int lineNo;
+    uint8_t samples[REPLAY_MAX_SAMPLES][3];   // 給量測用
+    uint32_t sampleCount;
+
+    Replay() : source(0), t(0), lineNo(0), sampleCount(0) {
+        gestureResponseBuild(response, REPLAY_SHAKE_TENTHS, REPLAY_SWING_TENTHS);
+        WiimoteAccelCalibration cal;
+        wiimoteNunchukAccelCalibrationDefault(cal);
+        detectors[1].setCalibration(cal);
+    }
+
+    void fail(const char* fmt, const char* detail) {
+        printf("  line %d: ", lineNo);
+        printf(fmt, detail);
+        printf("\n");
+        checkFailures++;
+    }
+
+    // 兩個偵測器都推進 (與韌體的 frameTick 相同)
+    void advance(uint32_t us) {
+        for (uint32_t dt = REPLAY_TICK_US; dt <= us; dt += REPLAY_TICK_US) {
+            detectors[0].tick(t + dt);
+            detectors[1].tick(t + dt);
+        }
+        t += us;
+    }
+
+    void sample(const char* args) {
+        unsigned x, y, z;
+        if (sscanf(args, "%u %u %u", &x, &y, &z) != 3 || x > 255 || y > 255 || z > 255) {
+            fail("malformed sample: %s", args);
+            return;
+        }
+        if (sampleCount < REPLAY_MAX_SAMPLES) {
+            samples[sampleCount][0] = (uint8_t)x;
+            samples[sampleCount][1] = (uint8_t)y;
+            samples[sampleCount][2] = (uint8_t)z;
+            sampleCount++;
+        }
+        detectors[source].input((uint8_t)x, (uint8_t)y, (uint8_t)z, response, t);
+        advance(REPLAY_PERIOD_US);
+    }
+
+    // "expect shake on" / "expect swing off"
+    void expectButton(const char* args) {
+        char name[16];
+        char state[8];
+        if (sscanf(args, "%15s %7s", name, state) != 2) {
+            fail("malformed expect: %s", args);
+            return;
+        }
+        uint8_t bit = strcmp(name, "shake") == 0 ? GESTURE_SHAKE : strcmp(name, "swing") == 0 ? GESTURE_SWING : 0;
+        if (bit == 0) {
+            fail("unknown gesture: %s", name);
+            return;
+        }
+        bool want = strcmp(state, "on") == 0;
+        bool got = (detectors[source].buttons() & bit) != 0;
+        checkCount++;
+        if (want != got) {
+            char detail[96];
+            const GestureDetector& d = detectors[source];
+            snprintf(detail, sizeof(detail), "%s %s (energy=%d peak=%d crossings=%u)", name, got ? "on" : "off",
+                     (int)d.meanEnergy(), (int)d.peak(), d.crossingCount());
+            fail("button mismatch, got %s", detail);
+        }
+    }
+
+    // "expect count shake=N swing=M"
+    void expectCount(const char* args) {
+        unsigned shakes, swings;
+        if (sscanf(args, "shake=%u swing=%u", &shakes, &swings) != 2) {
+            fail("malformed expect count: %s", args);
+            return;
+        }
+        const GestureDetector& d = detectors[source];
+        checkCount++;
+        if (d.shakeCount() != shakes || d.swingCount() != swings) {
+            char detail[64];
+            snprintf(detail, sizeof(detail), "shake=%u swing=%u", d.shakeCount(), d.swingCount());
+            fail("count mismatch, got %s", detail);
+        }
+    }
+
+    void line(char* s) {
+        lineNo++;
+        s[strcspn(s, "\r\n")] = '\0';
+        while (*s == ' ' || *s == '\t') s++;
+        if (*s == '\0' || *s == '#') {
+            return;
+        }
+        if (strncmp(s, "S ", 2) == 0) {
+            sample(s + 2);
+        } else if (strncmp(s, "expect count ", 13) == 0) {
+            expectCount(s + 13);
+        } else if (strncmp(s, "expect ", 7) == 0) {
+            expectButton(s + 7);
+        } else if (strncmp(s, "wait ", 5) == 0) {
+            advance((uint32_t)atoi(s + 5) * 1000);
+        } else if (strcmp(s, "source wiimote") == 0) {
+            source = 0;
+        } else if (strcmp(s, "source nunchuk") == 0) {
+            source = 1;
+        } else if (strcmp(s, "reset") == 0) {
+            detectors[source].reset();
+        } else {
+            fail("unknown line: %s", s);
+        }
+    }
+};
+
+static int runReplay(Replay& replay, const char* path) {
+    FILE* f = fopen(path, "r");
+    if (f == NULL) {
+        fprintf(stderr, "cannot open %s\n", path);
+        return -1;
+    }
+    char buf[256];
+    printf("replay %s:\n", path);
+    while (fgets(buf, sizeof(buf), f) != NULL) {
+        replay.line(buf);
+    }
+    fclose(f);
+    printf("  %u samples, %d checks, %d failed\n", replay.sampleCount, checkCount, checkFailures);
+    return 0;
+}
+
+static void runTiming(const Replay& replay, uint32_t iterations) {
+    if (replay.sampleCount == 0) {
+        return;
+    }
+    GestureDetector detector;
+    uint32_t t = 0;
+    volatile uint32_t sink = 0;
+
+    uint64_t start = nowNs();
+    for (uint32_t i = 0; i < iterations; i++) {
+        const uint8_t* s = replay.samples[i % replay.sampleCount];
+        sink += detector.input(s[0], s[1], s[2], replay.response, t);
+        sink += detector.tick(t + REPLAY_TICK_US);
+        sink += detector.buttons();
+        t += REPLAY_PERIOD_US;
+    }
+    uint64_t elapsed = nowNs() - start;
+
+    printf("timing (%u samples):\n", iterations);
+    printf("  host        %.1f ns per sample (input + tick)\n", (double)elapsed / iterations);
+    printf("  memory      %u bytes per detector\n", (unsigned)sizeof(GestureDetector));
+}
+
+int main(int argc, char** argv) {
+    const char* path = "tools/gesturereplay/traces.txt";
+    uint32_t iterations = REPLAY_ITERATIONS;
+    for (int i = 1; i < argc; i++) {
+        if (strcmp(argv[i], "--iterations") == 0 && i + 1 < argc) {
+            iterations = (uint32_t)atoi(argv[++i]);
+        } else if (argv[i][0] != '-') {
+            path = argv[i];
+        } else {
+            fprintf(stderr, "usage: %s [traces.txt] [--iterations N]\n", argv[0]);
+            return 2;
+        }
+    }
+    if (iterations == 0) {
+        fprintf(stderr, "iterations must be > 0\n");
+        return 2;
+    }
+
+    static Replay replay;
+    if (runReplay(replay, path) < 0) {
+        return 2;
+    }
+    runTiming(replay, iterations);
+    return checkSummary();
+}
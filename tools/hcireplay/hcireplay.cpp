@@ -0,0 +1,402 @@
+// 檔案: hcireplay.cpp
+// 作用: 在 Linux 上以合成的 HCI 封包驅動 WiiMote_i2c/lib/ESP32Wiimote/TinyWiimote.cpp，
+//       檢查同時連線多支 Wiimote 時的連線槽、回報分流與各連線的擴充偵測，並量測主機上每個回報的處理耗時
+//
+// 每支 Wiimote 走一次完整的流程: 查詢結果 -> 名稱 -> 建立連線 -> L2CAP 連線 / 設定 -> HID 回報，
+// 控制器送出的命令與輸出報告都從 TwHciInterface 攔截下來比對。檢查:
+//   - 每支 Wiimote 佔一個槽，燈號預設為玩家編號，輸出報告只送到自己的連線
+//   - 回報依連線分到各自的佇列，內容不會混到別支
+//   - Nunchuk 的偵測 (寫入 / 讀取控制暫存器) 與回報模式只影響插著 Nunchuk 的那一支
+//   - 一支斷線時其他連線不受影響、不重設控制器並重新查詢，同一支重新連上時回到原本的槽
+//   - 槽位已滿時多出來的連線立刻斷開；最多一支 (預設) 時連上後不再查詢
+//   - 全部斷線時跟單一 Wiimote 一樣重設控制器
+//
+// 編譯 (在專案根目錄):
+//   g++ -std=c++17 -O2 -IWiiMote_i2c/lib/ESP32Wiimote -Itools/common tools/hcireplay/hcireplay.cpp
+//       WiiMote_i2c/lib/ESP32Wiimote/TinyWiimote.cpp -o hcireplay
+//
+// 用法:
+//   ./hcireplay                          預設最多 4 支
+//   ./hcireplay --wiimotes 2 --iterations 500000
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <stdint.h>
+#include <stddef.h>
+#include <string.h>
+
+#include "TinyWiimote.h"   // WiiMote_i2c/lib/ESP32Wiimote
+#include "ToolCheck.h"     // tools/common
+
+#define SIM_PACKETS_MAX        64        // 一次步驟最多攔截的封包數
+#define SIM_PACKET_SIZE        80
+#define SIM_HANDLE_BASE        0x0080    // 第 i 支 Wiimote 的連線 handle (重新連線時再加 0x10)
+#define SIM_CID                0x0041    // Wiimote 端的 L2CAP CID
+#define BENCH_ITERATIONS       2000000
+
+// HCI 命令 opcode (OGF << 10 | OCF)
+#define OP_RESET               0x0C03
+#define OP_INQUIRY             0x0401
+#define OP_INQUIRY_CANCEL      0x0402
+#define OP_CREATE_CONNECTION   0x0405
+#define OP_DISCONNECT          0x0406
+
+// --- 攔截 TinyWiimote 送給控制器的封包 ---
+struct Packet {
+    uint8_t data[SIM_PACKET_SIZE];
+    size_t len;
+};
+static Packet sent[SIM_PACKETS_MAX];
+static int sentCount = 0;
+
+static void capture(uint8_t* data, size_t len) {
+    if (sentCount < SIM_PACKETS_MAX) {
+        Packet& p = sent[sentCount++];
+        p.len = len < SIM_PACKET_SIZE ? len : SIM_PACKET_SIZE;
+        memcpy(p.data, data, p.len);
+    }
+}
+
+static int countCommand(uint16_t opcode) {
+    int n = 0;
+    for (int i = 0; i < sentCount; i++) {
+        if (sent[i].data[0] == 0x01 && (sent[i].data[1] | (sent[i].data[2] << 8)) == opcode) {
+            n++;
+        }
+    }
+    return n;
+}
+
+static uint16_t aclHandle(const Packet& p) {
+    return (uint16_t)(p.data[1] | ((p.data[2] & 0x0F) << 8));
+}
+
+// 送到 handle 的 Wiimote 輸出報告 (a2 RR ...)，找不到時為 NULL
+static const uint8_t* findOutput(uint16_t handle, uint8_t report) {
+    for (int i = 0; i < sentCount; i++) {
+        const Packet& p = sent[i];
+        if (p.data[0] == 0x02 && aclHandle(p) == handle && p.len > 10 && p.data[9] == 0xA2 && p.data[10] == report) {
+            return p.data + 9;
+        }
+    }
+    return NULL;
+}
+
+// 除了 handle 以外的連線有沒有收到這個輸出報告
+static bool outputElsewhere(uint16_t handle, uint8_t report) {
+    for (int i = 0; i < sentCount; i++) {
+        const Packet& p = sent[i];
+        if (p.data[0] == 0x02 && aclHandle(p) != handle && p.len > 10 && p.data[9] == 0xA2 && p.data[10] == report) {
+            return true;
+        }
+    }
+    return false;
+}
+
+// --- 合成控制器送來的封包 ---
+static void hciEvent(uint8_t code, const uint8_t* params, uint8_t len) {
+    uint8_t buf[260];
+    buf[0] = 0x04;
+    buf[1] = code;
+    buf[2] = len;
+    memcpy(buf + 3, params, len);
+    handleHciData(buf, 3 + len, 0);
+}
+
+static void commandComplete(uint16_t opcode) {
+    uint8_t p[] = { 0x01, (uint8_t)opcode, (uint8_t)(opcode >> 8), 0x00, 0, 0, 0, 0, 0, 0 };
+    hciEvent(0x0E, p, sizeof(p));
+}
+
+static void aclL2cap(uint16_t handle, uint16_t cid, const uint8_t* payload, uint8_t len, int64_t recvTimeUs = 0) {
+    uint8_t buf[SIM_PACKET_SIZE];
+    uint16_t l2capLen = (uint16_t)(4 + len);
+    buf[0] = 0x02;
+    buf[1] = (uint8_t)handle;
+    buf[2] = (uint8_t)(((handle >> 8) & 0x0F) | (0b10 << 4));
+    buf[3] = (uint8_t)l2capLen;
+    buf[4] = (uint8_t)(l2capLen >> 8);
+    buf[5] = len;
+    buf[6] = 0;
+    buf[7] = (uint8_t)cid;
+    buf[8] = (uint8_t)(cid >> 8);
+    memcpy(buf + 9, payload, len);
+    handleHciData(buf, 9 + len, recvTimeUs);
+}
+
+static void hidReport(uint16_t handle, const uint8_t* report, uint8_t len, int64_t recvTimeUs = 0) {
+    aclL2cap(handle, 0x0045, report, len, recvTimeUs);
+}
+
+struct SimWiimote {
+    uint8_t addr[6];   // 依 HCI 封包內的順序 (低位元組在前)
+    uint16_t handle;
+};
+
+static void makeWiimote(SimWiimote& w, uint8_t n, uint16_t handle) {
+    static const uint8_t base[6] = { 0x10, 0x20, 0x30, 0x9E, 0x1A, 0x00 };
+    memcpy(w.addr, base, 6);
+    w.addr[0] = (uint8_t)(base[0] + n);
+    w.handle = handle;
+}
+
+static void inquiryResult(const SimWiimote& w) {
+    uint8_t p[15] = { 0x01 };
+    memcpy(p + 1, w.addr, 6);
+    p[7] = 0x01;                                // Page_Scan_Repetition_Mode
+    p[10] = 0x04; p[11] = 0x25; p[12] = 0x00;   // Class_of_Device (Wiimote)
+    p[13] = 0x12; p[14] = 0x34;                 // Clock_Offset
+    hciEvent(0x02, p, sizeof(p));
+}
+
+static void remoteNameComplete(const SimWiimote& w) {
+    uint8_t p[255] = { 0x00 };
+    memcpy(p + 1, w.addr, 6);
+    strcpy((char*)p + 7, "Nintendo RVL-CNT-01");
+    hciEvent(0x07, p, sizeof(p));
+}
+
+static void connectionComplete(const SimWiimote& w, uint8_t status = 0x00) {
+    uint8_t p[11] = { status, (uint8_t)w.handle, (uint8_t)(w.handle >> 8) };
+    memcpy(p + 3, w.addr, 6);
+    p[9] = 0x01;   // ACL
+    hciEvent(0x03, p, sizeof(p));
+}
+
+static void disconnectionComplete(uint16_t handle) {
+    uint8_t p[4] = { 0x00, (uint8_t)handle, (uint8_t)(handle >> 8), 0x13 };
+    hciEvent(0x05, p, sizeof(p));
+}
+
+static void statusReport(uint16_t handle, bool extension) {
+    uint8_t r[] = { 0xA1, 0x20, 0x00, 0x00, (uint8_t)(extension ? 0x02 : 0x00), 0x00, 0x00, 0xC0 };
+    hidReport(handle, r, sizeof(r));
+}
+
+/**
+ * 讓一支 Wiimote 從查詢結果走到第一個 HID 回報 (沒有擴充控制器的狀態回報)
+ * @return 名稱確認後有送出 create_connection
+ */
+static bool connectWiimote(const SimWiimote& w) {
+    sentCount = 0;
+    inquiryResult(w);
+    remoteNameComplete(w);
+    bool created = countCommand(OP_CREATE_CONNECTION) == 1;
+    connectionComplete(w);
+    // L2CAP connection response: 03 ID LL LL DCID SCID RESULT STATUS
+    uint8_t connRes[] = { 0x03, 0x01, 0x08, 0x00, (uint8_t)SIM_CID, (uint8_t)(SIM_CID >> 8), 0x45, 0x00, 0, 0, 0, 0 };
+    aclL2cap(w.handle, 0x0001, connRes, sizeof(connRes));
+    // L2CAP configuration request with MTU 185
+    uint8_t confReq[] = { 0x04, 0x02, 0x08, 0x00, 0x45, 0x00, 0x00, 0x00, 0x01, 0x02, 0xB9, 0x00 };
+    aclL2cap(w.handle, 0x0001, confReq, sizeof(confReq));
+    statusReport(w.handle, false);
+    return created;
+}
+
+static void drain(uint8_t number) {
+    while (TinyWiimoteAvailable(number) > 0) {
+        TinyWiimoteRead(number);
+    }
+}
+
+static void startStack(uint8_t maxWiimotes) {
+    TwHciInterface hci = { capture };
+    TinyWiimoteInit(hci);
+    TinyWiimoteSetMaxWiimotes(maxWiimotes);
+    sentCount = 0;
+    TinyWiimoteResetDevice();
+    commandComplete(0x0C03);   // reset
+    commandComplete(0x1009);   // read_bd_addr
+    commandComplete(0x0C13);   // write_local_name
+    commandComplete(0x0C24);   // write_class_of_device
+    commandComplete(0x0C1A);   // write_scan_enable -> inquiry
+}
+
+static void testSingle() {
+    printf("single Wiimote (default):\n");
+    startStack(1);
+    check(TinyWiimoteMaxWiimotes() == 1 && countCommand(OP_INQUIRY) == 1, "inquiry after setup");
+    SimWiimote w;
+    makeWiimote(w, 0, SIM_HANDLE_BASE);
+    bool created = connectWiimote(w);
+    check(created && countCommand(OP_INQUIRY_CANCEL) == 1, "inquiry cancelled for the connection");
+    const uint8_t* leds = findOutput(w.handle, 0x11);
+    check(TinyWiimoteConnected(0) && leds != NULL && (leds[2] >> 4) == 0x1, "player 1 LED");
+    check(countCommand(OP_INQUIRY) == 0, "no inquiry once the only slot is taken");
+    sentCount = 0;
+    disconnectionComplete(w.handle);
+    check(!TinyWiimoteConnected(0) && countCommand(OP_RESET) == 1, "controller reset after the last disconnect");
+}
+
+static void testMulti(uint8_t count) {
+    char detail[96];
+    printf("%u Wiimotes:\n", count);
+    startStack(count);
+    SimWiimote w[TW_MAX_WIIMOTES];
+    bool ledsOk = true, inquiryOk = true, routedLeds = true;
+    for (uint8_t i = 0; i < count; i++) {
+        makeWiimote(w[i], i, (uint16_t)(SIM_HANDLE_BASE + i));
+        connectWiimote(w[i]);
+        const uint8_t* leds = findOutput(w[i].handle, 0x11);
+        ledsOk = ledsOk && TinyWiimoteConnected(i) && leds != NULL && (leds[2] >> 4) == (1 << i);
+        routedLeds = routedLeds && !outputElsewhere(w[i].handle, 0x11);
+        // 還有空位就繼續查詢，最後一支連上後停止
+        inquiryOk = inquiryOk && countCommand(OP_INQUIRY) == (i + 1 < count ? 1 : 0);
+    }
+    check(ledsOk && TinyWiimoteConnectedCount() == count, "each Wiimote gets its own slot and player LED");
+    check(routedLeds, "output reports only go to their own connection");
+    check(inquiryOk, "inquiry continues until all slots are taken");
+
+    // 回報分流: 每支送一個不同的按鈕回報
+    for (uint8_t i = 0; i < count; i++) {
+        drain(i);
+    }
+    for (uint8_t i = 0; i < count; i++) {
+        uint8_t r[] = { 0xA1, 0x30, 0x00, (uint8_t)(1 << i) };
+        hidReport(w[i].handle, r, sizeof(r), 1000 + i);
+    }
+    bool routed = true;
+    for (uint8_t i = 0; i < count; i++) {
+        if (TinyWiimoteAvailable(i) != 1) {
+            routed = false;
+            continue;
+        }
+        TinyWiimoteData d = TinyWiimoteRead(i);
+        routed = routed && d.number == i && d.len == 4 && d.data[3] == (1 << i) && d.recvTimeUs == 1000 + i;
+    }
+    check(routed, "reports are queued per connection");
+
+    if (count < 2) {
+        return;
+    }
+    // Nunchuk 只插在最後一支
+    uint8_t n = (uint8_t)(count - 1);
+    sentCount = 0;
+    statusReport(w[n].handle, true);
+    check(findOutput(w[n].handle, 0x16) != NULL && !outputElsewhere(w[n].handle, 0x16),
+          "extension probe only on that connection");
+    uint8_t ack[] = { 0xA1, 0x22, 0x00, 0x00, 0x16, 0x00 };
+    hidReport(w[n].handle, ack, sizeof(ack));
+    hidReport(w[n].handle, ack, sizeof(ack));
+    check(findOutput(w[n].handle, 0x17) != NULL, "controller type read after both writes");
+    sentCount = 0;
+    uint8_t type[] = { 0xA1, 0x21, 0x00, 0x00, 0x50, 0x00, 0xFA, 0x00, 0x00, 0xA4, 0x20, 0x00, 0x00 };
+    hidReport(w[n].handle, type, sizeof(type));
+    const uint8_t* mode = findOutput(w[n].handle, 0x12);
+    bool others = true;
+    for (uint8_t i = 0; i < n; i++) {
+        others = others && !TinyWiimoteNunchukConnected(i);
+    }
+    snprintf(detail, sizeof(detail), "(mode 0x%02X)", mode != NULL ? mode[3] : 0);
+    check(TinyWiimoteNunchukConnected(n) && others && mode != NULL && mode[3] == 0x35 &&
+          !outputElsewhere(w[n].handle, 0x12), "Nunchuk mode only for that Wiimote", detail);
+
+    // 加速度計校正值也依連線保存
+    uint8_t cal[] = { 0xA1, 0x21, 0x00, 0x00, 0x90, 0x00, 0x16,
+                      0x80, 0x81, 0x82, 0x00, 0x9A, 0x9B, 0x9C, 0x00, 0x00, 0x00 };
+    uint8_t sum = 0x55;
+    for (int i = 0; i < 9; i++) sum = (uint8_t)(sum + cal[7 + i]);
+    cal[16] = sum;
+    hidReport(w[0].handle, cal, sizeof(cal));
+    uint8_t out[TW_ACCEL_CAL_SIZE];
+    check(TinyWiimoteGetAccelCalibration(out, 0) && out[0] == 0x80 && !TinyWiimoteGetAccelCalibration(out, 1),
+          "accelerometer calibration per connection");
+
+    // 中間那支斷線: 其他連線不受影響，不重設控制器，重新查詢
+    uint8_t gone = (uint8_t)(count > 2 ? 1 : 0);
+    for (uint8_t i = 0; i < count; i++) {
+        drain(i);
+    }
+    sentCount = 0;
+    disconnectionComplete(w[gone].handle);
+    bool kept = !TinyWiimoteConnected(gone) && TinyWiimoteConnectedCount() == count - 1;
+    check(kept && countCommand(OP_RESET) == 0 && countCommand(OP_INQUIRY) == 1,
+          "one disconnect keeps the others and restarts the inquiry");
+    uint8_t r[] = { 0xA1, 0x30, 0x00, 0x08 };
+    hidReport(w[gone].handle, r, sizeof(r));
+    check(TinyWiimoteAvailable(gone) == 0, "reports of a closed handle are dropped");
+
+    // 同一支以新的 handle 重新連上，回到原本的槽與燈號
+    w[gone].handle = (uint16_t)(w[gone].handle + 0x10);
+    connectWiimote(w[gone]);
+    const uint8_t* leds = findOutput(w[gone].handle, 0x11);
+    snprintf(detail, sizeof(detail), "(slot %u)", gone);
+    check(TinyWiimoteConnected(gone) && leds != NULL && (leds[2] >> 4) == (1 << gone) &&
+          TinyWiimoteConnectedCount() == count, "reconnect returns to the same slot", detail);
+
+    // 槽位已滿時又有一支完成連線 (兩支回應同一次查詢): 立刻斷開
+    SimWiimote extra;
+    makeWiimote(extra, 7, 0x00F0);
+    for (uint8_t i = 0; i < count; i++) {
+        drain(i);
+    }
+    sentCount = 0;
+    connectionComplete(extra);
+    statusReport(extra.handle, false);
+    bool untouched = true;
+    for (uint8_t i = 0; i < count; i++) {
+        untouched = untouched && TinyWiimoteConnected(i) && TinyWiimoteAvailable(i) == 0;
+    }
+    check(countCommand(OP_DISCONNECT) == 1 && findOutput(extra.handle, 0x11) == NULL && untouched,
+          "connection beyond the limit is refused");
+    sentCount = 0;
+    disconnectionComplete(extra.handle);
+    check(countCommand(OP_RESET) == 0 && countCommand(OP_INQUIRY) == 0, "refused connection leaves the others alone");
+
+    // 全部斷線時跟單一 Wiimote 一樣重設控制器
+    for (uint8_t i = 0; i < count; i++) {
+        disconnectionComplete(w[i].handle);
+    }
+    check(TinyWiimoteConnectedCount() == 0 && countCommand(OP_RESET) == 1, "reset after the last disconnect");
+}
+
+static void bench(uint8_t count, uint32_t iterations) {
+    startStack(count);
+    SimWiimote w[TW_MAX_WIIMOTES];
+    for (uint8_t i = 0; i < count; i++) {
+        makeWiimote(w[i], i, (uint16_t)(SIM_HANDLE_BASE + i));
+        connectWiimote(w[i]);
+        drain(i);
+    }
+    // 0x35: 按鈕 + 加速度計 + 16 位元組擴充 (Nunchuk)
+    uint8_t r[23] = { 0xA1, 0x35 };
+    volatile uint32_t sink = 0;
+    uint64_t start = nowNs();
+    for (uint32_t i = 0; i < iterations; i++) {
+        uint8_t n = (uint8_t)(i % count);
+        r[3] = (uint8_t)i;
+        sentCount = 0;
+        hidReport(w[n].handle, r, sizeof(r), i);
+        TinyWiimoteData d = TinyWiimoteRead(n);
+        sink += d.data[3];
+    }
+    double ns = (double)(nowNs() - start) / iterations;
+    printf("%u Wiimotes: report handling %.1f ns on host\n", count, ns);
+}
+
+int main(int argc, char** argv) {
+    uint32_t count = TW_MAX_WIIMOTES;
+    uint32_t iterations = BENCH_ITERATIONS;
+    for (int i = 1; i < argc; i++) {
+        if (strcmp(argv[i], "--wiimotes") == 0 && i + 1 < argc) {
+            count = (uint32_t)atoi(argv[++i]);
+        } else if (strcmp(argv[i], "--iterations") == 0 && i + 1 < argc) {
+            iterations = (uint32_t)atoi(argv[++i]);
+        } else {
+            fprintf(stderr, "usage: %s [--wiimotes 1..%d] [--iterations N]\n", argv[0], TW_MAX_WIIMOTES);
+            return 2;
+        }
+    }
+    if (count < 1 || count > TW_MAX_WIIMOTES || iterations == 0) {
+        fprintf(stderr, "wiimotes must be 1..%d, iterations > 0\n", TW_MAX_WIIMOTES);
+        return 2;
+    }
+
+    testSingle();
+    testMulti((uint8_t)count);
+    // 每個回報的耗時與連線數的關係 (查 handle 是線性搜尋)
+    for (uint8_t n = 1; n <= count; n++) {
+        bench(n, iterations);
+    }
+    return checkSummary();
+}
@@ -0,0 +1,257 @@
+// 檔案: irreplay.cpp
+// 作用: 在 Linux 上重播 Wiimote 紅外線回報，檢查點座標解碼 (common/WiimoteLink/WiimoteIr.cpp)
+//       與感應棒追蹤 (SwitchPro_i2c/src/IrPointer.h)，並量測主機上每個回報的耗時
+//
+// 樣本檔 (預設 tools/irreplay/samples.txt) 的 REPORT 行與 TinyWiimote 開啟 WIIMOTE_VERBOSE 時印出的相同，
+// 中間穿插 expect 行描述預期結果，格式說明見樣本檔開頭。
+//
+// 編譯 (在專案根目錄):
+//   g++ -std=c++17 -O2 -Icommon/WiimoteLink -ISwitchPro_i2c/src -Itools/common
+//       tools/irreplay/irreplay.cpp common/WiimoteLink/WiimoteIr.cpp -o irreplay
+//
+// 用法:
+//   ./irreplay                                 重播預設樣本並量測
+//   ./irreplay my_capture.txt                  重播自己錄的回報
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+
+#include "WiimoteIr.h"
+#include "IrPointer.h"         // SwitchPro_i2c/src
+#include "ToolCheck.h"         // tools/common
+
+#define REPLAY_PERIOD_US       10000     // Wiimote 回報間隔 (100 Hz)
+#define REPLAY_TICK_US         1000      // S3 的 USB frame 計時器
+#define REPLAY_RANGE_PERCENT   40        // 與設定檔預設值相同
+#define REPLAY_DEADZONE_PERCENT 2
+#define REPLAY_ITERATIONS      1000000
+#define REPLAY_MAX_REPORTS     1024
+#define REPLAY_REPORT_MAX_LEN  32
+
+struct Report {
+    uint8_t data[REPLAY_REPORT_MAX_LEN];
+    size_t len;
+};
+
+struct Replay {
+    IrPointer pointer;
+    IrResponse response;
+    WiimoteIrState ir;
+    uint32_t t;
+    int lineNo;
+    Report reports[REPLAY_MAX_REPORTS];   // 給量測用
+    uint32_t reportCount;
+
+    Replay() : t(0), lineNo(0), reportCount(0) {
+        irResponseBuild(response, REPLAY_RANGE_PERCENT, REPLAY_DEADZONE_PERCENT, 0);
+        wiimoteIrReset(ir);
+    }
+
+    void fail(const char* fmt, const char* detail) {
+        printf("  line %d: ", lineNo);
+        printf(fmt, detail);
+        printf("\n");
+        checkFailures++;
+    }
+
+    void advance(uint32_t us) {
+        for (uint32_t dt = REPLAY_TICK_US; dt <= us; dt += REPLAY_TICK_US) {
+            pointer.tick(response, t + dt);
+        }
+        t += us;
+    }
+
+    // "REPORT len=N data=A1 33 ..."
+    void report(const char* args) {
+        const char* p = strstr(args, "len=");
+        const char* data = strstr(args, "data=");
+        if (p == NULL || data == NULL) {
+            fail("malformed REPORT: %s", args);
+            return;
+        }
+        size_t len = (size_t)atoi(p + 4);
+        Report r;
+        r.len = 0;
+        data += 5;
+        while (r.len < len && r.len < REPLAY_REPORT_MAX_LEN) {
+            char* end;
+            long v = strtol(data, &end, 16);
+            if (end == data) {
+                break;
+            }
+            r.data[r.len++] = (uint8_t)v;
+            data = end;
+        }
+        if (r.len != len) {
+            fail("REPORT length mismatch: %s", args);
+            return;
+        }
+        if (reportCount < REPLAY_MAX_REPORTS) {
+            reports[reportCount++] = r;
+        }
+        if (!wiimoteIrDecode(r.data, r.len, ir)) {
+            fail("not an IR report: %s", args);
+            return;
+        }
+        pointer.input(ir, response, t);
+        advance(REPLAY_PERIOD_US);
+    }
+
+    // "expect dots x,y,s - x,y,s -"
+    void expectDots(const char* args) {
+        char buf[256];
+        strncpy(buf, args, sizeof(buf) - 1);
+        buf[sizeof(buf) - 1] = '\0';
+        bool ok = true;
+        uint8_t i = 0;
+        for (char* tok = strtok(buf, " \t"); tok != NULL; tok = strtok(NULL, " \t"), i++) {
+            if (i >= WIIMOTE_IR_DOTS) {
+                ok = false;
+                break;
+            }
+            const WiimoteIrDot& d = ir.dots[i];
+            if (strcmp(tok, "-") == 0) {
+                ok = ok && d.x == WIIMOTE_IR_NO_DOT;
+                continue;
+            }
+            unsigned x, y, s;
+            if (sscanf(tok, "%u,%u,%u", &x, &y, &s) != 3) {
+                ok = false;
+                break;
+            }
+            ok = ok && d.x == x && d.y == y && d.size == s;
+        }
+        ok = ok && i == WIIMOTE_IR_DOTS;
+        checkCount++;
+        if (!ok) {
+            char got[128];
+            int n = 0;
+            for (uint8_t k = 0; k < WIIMOTE_IR_DOTS; k++) {
+                const WiimoteIrDot& d = ir.dots[k];
+                if (d.x == WIIMOTE_IR_NO_DOT) {
+                    n += snprintf(got + n, sizeof(got) - n, " -");
+                } else {
+                    n += snprintf(got + n, sizeof(got) - n, " %u,%u,%u", d.x, d.y, d.size);
+                }
+            }
+            fail("dots mismatch, got%s", got);
+        }
+    }
+
+    // "expect stick X Y [tolerance]"
+    void expectStick(const char* args) {
+        int x, y, tol = 0;
+        if (sscanf(args, "%d %d %d", &x, &y, &tol) < 2) {
+            fail("malformed expect stick: %s", args);
+            return;
+        }
+        checkCount++;
+        if (abs((int)pointer.x() - x) > tol || abs((int)pointer.y() - y) > tol) {
+            char got[64];
+            snprintf(got, sizeof(got), "%u %u (want %d %d +-%d)", pointer.x(), pointer.y(), x, y, tol);
+            fail("stick mismatch, got %s", got);
+        }
+    }
+
+    // "expect state tracking|holding|idle"
+    void expectState(const char* args) {
+        const char* state = pointer.holding() ? "holding" : pointer.tracking() ? "tracking" : "idle";
+        checkCount++;
+        if (strncmp(args, state, strlen(state)) != 0) {
+            fail("state mismatch, got %s", state);
+        }
+    }
+
+    void line(char* s) {
+        lineNo++;
+        s[strcspn(s, "\r\n")] = '\0';
+        while (*s == ' ' || *s == '\t') s++;
+        if (*s == '\0' || *s == '#') {
+            return;
+        }
+        if (strncmp(s, "REPORT ", 7) == 0) {
+            report(s + 7);
+        } else if (strncmp(s, "expect dots ", 12) == 0) {
+            expectDots(s + 12);
+        } else if (strncmp(s, "expect stick ", 13) == 0) {
+            expectStick(s + 13);
+        } else if (strncmp(s, "expect state ", 13) == 0) {
+            expectState(s + 13);
+        } else if (strncmp(s, "wait ", 5) == 0) {
+            advance((uint32_t)atoi(s + 5) * 1000);
+        } else if (strcmp(s, "reset") == 0) {
+            pointer.reset();
+            wiimoteIrReset(ir);
+        } else {
+            fail("unknown line: %s", s);
+        }
+    }
+};
+
+static int runReplay(Replay& replay, const char* path) {
+    FILE* f = fopen(path, "r");
+    if (f == NULL) {
+        fprintf(stderr, "cannot open %s\n", path);
+        return -1;
+    }
+    char buf[512];
+    printf("replay %s:\n", path);
+    while (fgets(buf, sizeof(buf), f) != NULL) {
+        replay.line(buf);
+    }
+    fclose(f);
+    printf("  %u reports, %d checks, %d failed\n", replay.reportCount, checkCount, checkFailures);
+    return 0;
+}
+
+static void runTiming(const Replay& replay, uint32_t iterations) {
+    if (replay.reportCount == 0) {
+        return;
+    }
+    IrPointer pointer;
+    WiimoteIrState ir;
+    wiimoteIrReset(ir);
+    uint32_t t = 0;
+    volatile uint32_t sink = 0;
+
+    uint64_t start = nowNs();
+    for (uint32_t i = 0; i < iterations; i++) {
+        const Report& r = replay.reports[i % replay.reportCount];
+        sink += wiimoteIrDecode(r.data, r.len, ir);
+        sink += pointer.input(ir, replay.response, t);
+        sink += pointer.tick(replay.response, t + REPLAY_TICK_US);
+        sink += pointer.x() + pointer.y();
+        t += REPLAY_PERIOD_US;
+    }
+    uint64_t elapsed = nowNs() - start;
+
+    printf("timing (%u reports): %.1f ns per report (decode + input + tick) on host\n", iterations,
+           (double)elapsed / iterations);
+}
+
+int main(int argc, char** argv) {
+    const char* path = "tools/irreplay/samples.txt";
+    uint32_t iterations = REPLAY_ITERATIONS;
+    for (int i = 1; i < argc; i++) {
+        if (strcmp(argv[i], "--iterations") == 0 && i + 1 < argc) {
+            iterations = (uint32_t)atoi(argv[++i]);
+        } else if (argv[i][0] != '-') {
+            path = argv[i];
+        } else {
+            fprintf(stderr, "usage: %s [samples.txt] [--iterations N]\n", argv[0]);
+            return 2;
+        }
+    }
+    if (iterations == 0) {
+        fprintf(stderr, "iterations must be > 0\n");
+        return 2;
+    }
+
+    static Replay replay;
+    if (runReplay(replay, path) < 0) {
+        return 2;
+    }
+    runTiming(replay, iterations);
+    return checkSummary();
+}
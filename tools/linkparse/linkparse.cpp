@@ -0,0 +1,342 @@
+// 檔案: linkparse.cpp
+// 作用: 在 Linux 上檢查 UART 連線的訊框解析 (common/WiimoteLink 的 LinkFrameParser) 遇到損毀資料時的重新同步並量測吞吐量
+//
+// 以 linkEncodeFrame 產生長度、型別、序號各不相同的訊框串流，再分別注入:
+//   - 單一位元翻轉 (標頭、長度、資料或 CRC 任一位置)
+//   - 截斷的訊框 (只送出前半段就接上下一個訊框)
+//   - 偽造的 A5 5A 標頭 (帶任意長度，後面是雜訊或真正的訊框)
+//   - 訊框交界處遺失的位元組
+//   - 隨機混合以上所有損毀的長串流
+// 每個解出的訊框都必須與原本的訊框逐位元組相同 (否則算錯誤解碼)，未受損的訊框一個都不能遺失，
+// 並記錄從損毀的位置到下一個正確訊框開頭之間解析器吃掉的位元組數 (重新同步的距離)。
+// 最後量測主機上乾淨串流的解析速度 (MB/s)，只用來比較修改前後，不代表 ESP32 上的速度。
+// 註: CRC-16 本身約有 1/65536 的機率放過受損的訊框，換用其他 --seed 或很大的 --frames 時偶爾會出現
+// 這類錯誤解碼，會印出位置以便確認；預設的參數必須完全正確。
+//
+// 編譯 (在專案根目錄):
+//   g++ -std=c++17 -O2 -Icommon/WiimoteLink -Itools/common tools/linkparse/linkparse.cpp
+//       common/WiimoteLink/WiimoteLink.cpp -o linkparse
+//
+// 用法:
+//   ./linkparse                               預設 5000 個訊框
+//   ./linkparse --frames 20000 --seed 7
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+
+#include <vector>
+
+#include "WiimoteLink.h"
+#include "ToolCheck.h"   // tools/common
+
+#define BENCH_FRAMES           5000
+#define BENCH_MB               64        // 量測吞吐量時解析的資料量
+#define FUZZ_CORRUPT_PERCENT   5         // 隨機模式下每個訊框受損的機率
+
+static uint32_t rngState = 1;
+
+static uint32_t rnd() {
+    rngState ^= rngState << 13;
+    rngState ^= rngState >> 17;
+    rngState ^= rngState << 5;
+    return rngState;
+}
+
+static uint32_t rndRange(uint32_t n) {
+    return n == 0 ? 0 : rnd() % n;
+}
+
+// 一個原始訊框: 資料前兩個位元組是訊框編號，解出來時用來找回原本的訊框
+struct SourceFrame {
+    uint8_t type;
+    uint8_t seq;
+    uint8_t len;
+    uint8_t payload[LINK_MAX_PAYLOAD];
+    uint8_t wire[LINK_MAX_FRAME_SIZE];
+    size_t wireLen;
+};
+
+static std::vector<SourceFrame> makeFrames(size_t count) {
+    std::vector<SourceFrame> frames(count);
+    for (size_t i = 0; i < count; i++) {
+        SourceFrame& f = frames[i];
+        // 解析器不看類型，任何值都必須原樣解出
+        f.type = (uint8_t)rnd();
+        f.seq = (uint8_t)i;
+        f.len = (uint8_t)(2 + rndRange(LINK_MAX_PAYLOAD - 1));
+        f.payload[0] = (uint8_t)(i & 0xFF);
+        f.payload[1] = (uint8_t)(i >> 8);
+        for (uint8_t k = 2; k < f.len; k++) {
+            // 刻意讓資料裡常出現同步位元組，考驗解析器不會把它當成訊框開頭
+            uint32_t r = rndRange(8);
+            f.payload[k] = r == 0 ? LINK_SYNC0 : (r == 1 ? LINK_SYNC1 : (uint8_t)rnd());
+        }
+        f.wireLen = linkEncodeFrame(f.wire, f.type, f.seq, f.payload, f.len);
+    }
+    return frames;
+}
+
+// 組好的串流: 每個訊框在串流中的開頭位置，以及它是否完整無損 (必須被解出)
+struct Stream {
+    std::vector<uint8_t> bytes;
+    std::vector<size_t> start;
+    std::vector<bool> intact;
+    std::vector<size_t> damageAt;   // 每次損毀在串流中的位置 (遞增)
+};
+
+static void appendFrame(Stream& s, const SourceFrame& f, bool intact) {
+    s.start.push_back(s.bytes.size());
+    s.intact.push_back(intact);
+    s.bytes.insert(s.bytes.end(), f.wire, f.wire + f.wireLen);
+}
+
+enum Damage {
+    DAMAGE_NONE,
+    DAMAGE_BIT_FLIP,
+    DAMAGE_TRUNCATE,
+    DAMAGE_FAKE_HEADER,
+    DAMAGE_DROP,
+    DAMAGE_COUNT
+};
+
+static const char* const damageNames[DAMAGE_COUNT] = { "clean", "bit flip", "truncated", "fake header", "dropped bytes" };
+
+// 依序放入訊框，讓 damageOf(i) 決定第 i 個訊框前後的損毀
+template <typename DamageOf>
+static Stream buildStream(const std::vector<SourceFrame>& frames, DamageOf damageOf) {
+    Stream s;
+    for (size_t i = 0; i < frames.size(); i++) {
+        const SourceFrame& f = frames[i];
+        switch (damageOf(i)) {
+        case DAMAGE_BIT_FLIP: {
+            size_t at = s.bytes.size();
+            appendFrame(s, f, false);
+            size_t pos = rndRange((uint32_t)f.wireLen);
+            s.bytes[at + pos] ^= (uint8_t)(1u << rndRange(8));
+            s.damageAt.push_back(at + pos);
+            break;
+        }
+        case DAMAGE_TRUNCATE: {
+            size_t keep = 1 + rndRange((uint32_t)f.wireLen - 1);
+            s.damageAt.push_back(s.bytes.size() + keep);
+            s.start.push_back(s.bytes.size());
+            s.intact.push_back(false);
+            s.bytes.insert(s.bytes.end(), f.wire, f.wire + keep);
+            break;
+        }
+        case DAMAGE_FAKE_HEADER: {
+            // 偽造的標頭: 合理或不合理的長度，後面是一段雜訊，真正的訊框接在後面
+            s.damageAt.push_back(s.bytes.size());
+            s.bytes.push_back(LINK_SYNC0);
+            s.bytes.push_back(LINK_SYNC1);
+            s.bytes.push_back((uint8_t)rnd());
+            s.bytes.push_back((uint8_t)rnd());
+            s.bytes.push_back((uint8_t)rndRange(256));
+            uint32_t noise = rndRange(LINK_MAX_FRAME_SIZE);
+            for (uint32_t k = 0; k < noise; k++) {
+                s.bytes.push_back((uint8_t)rnd());
+            }
+            appendFrame(s, f, true);
+            break;
+        }
+        case DAMAGE_DROP: {
+            // 訊框交界處遺失 1 ~ 4 個位元組: 可能是上一個訊框的結尾、這個訊框的開頭，或兩者都有
+            uint32_t drop = 1 + rndRange(4);
+            uint32_t fromPrev = rndRange(drop + 1);
+            if (!s.intact.empty() && fromPrev > 0 && s.bytes.size() - s.start.back() > fromPrev) {
+                s.bytes.resize(s.bytes.size() - fromPrev);
+                s.intact.back() = false;
+            } else {
+                fromPrev = 0;
+            }
+            uint32_t fromThis = drop - fromPrev;
+            s.damageAt.push_back(s.bytes.size());
+            if (fromThis == 0) {
+                appendFrame(s, f, true);
+            } else {
+                s.start.push_back(s.bytes.size());
+                s.intact.push_back(false);
+                s.bytes.insert(s.bytes.end(), f.wire + fromThis, f.wire + f.wireLen);
+            }
+            break;
+        }
+        default:
+            appendFrame(s, f, true);
+            break;
+        }
+    }
+    return s;
+}
+
+struct ParseResult {
+    size_t decoded;
+    size_t wrong;          // 與原本訊框不同，或順序倒退的解碼
+    size_t lost;           // 完整無損卻沒有被解出的訊框
+    size_t borrowed;       // 受損的前一個訊框剛好借用這個訊框的同步位元組而變成正確訊框
+    size_t resyncs;
+    size_t resyncTotal;
+    size_t resyncMax;      // 損毀位置到下一個解出的訊框開頭之間的位元組數
+    LinkStats stats;
+};
+
+static ParseResult parseStream(const std::vector<SourceFrame>& frames, const Stream& s) {
+    ParseResult r;
+    memset(&r, 0, sizeof(r));
+    std::vector<bool> seen(frames.size(), false);
+    LinkFrameParser parser;
+    long lastIndex = -1;
+    size_t nextDamage = 0;
+    size_t pendingDamage = 0;
+    bool havePending = false;
+    size_t pos = 0;
+
+    for (pos = 0; pos < s.bytes.size(); pos++) {
+        while (nextDamage < s.damageAt.size() && s.damageAt[nextDamage] <= pos) {
+            if (!havePending) {
+                pendingDamage = s.damageAt[nextDamage];
+                havePending = true;
+            }
+            nextDamage++;
+        }
+        parser.feed(s.bytes[pos], [&](const LinkFrame& frame) {
+            r.decoded++;
+            size_t index = frame.len >= 2 ? (size_t)(frame.payload[0] | (frame.payload[1] << 8)) : frames.size();
+            bool same = index < frames.size() && (long)index > lastIndex;
+            if (same) {
+                const SourceFrame& f = frames[index];
+                same = f.type == frame.type && f.seq == frame.seq && f.len == frame.len &&
+                       memcmp(f.payload, frame.payload, f.len) == 0;
+            }
+            if (!same) {
+                printf("  wrong decode at byte %zu: type 0x%02X seq %u len %u\n", pos, frame.type, frame.seq, frame.len);
+                r.wrong++;
+                return;
+            }
+            lastIndex = (long)index;
+            seen[index] = true;
+            if (havePending) {
+                size_t frameStart = pos + 1 - frames[index].wireLen;
+                size_t distance = frameStart > pendingDamage ? frameStart - pendingDamage : 0;
+                r.resyncs++;
+                r.resyncTotal += distance;
+                if (distance > r.resyncMax) {
+                    r.resyncMax = distance;
+                }
+                havePending = false;
+            }
+        });
+    }
+    for (size_t i = 0; i < frames.size(); i++) {
+        if (!s.intact[i] || seen[i]) {
+            continue;
+        }
+        // 被截掉的尾端剛好等於下一個訊框的開頭 (例如 CRC 最後一個位元組是 A5) 時，
+        // 串流與「前一個訊框完整、這個訊框少了開頭」無法分辨，任何解析器都只能解出前一個
+        if (i > 0 && !s.intact[i - 1] && seen[i - 1]) {
+            r.borrowed++;
+        } else {
+            r.lost++;
+        }
+    }
+    r.stats = parser.stats();
+    return r;
+}
+
+// 每個類型的損毀都隔幾個訊框注入一次，未受損的訊框必須全部解出
+static void testDamage(const std::vector<SourceFrame>& frames, Damage damage) {
+    Stream s = buildStream(frames, [&](size_t i) {
+        return (i % 7 == 3) ? damage : DAMAGE_NONE;
+    });
+    ParseResult r = parseStream(frames, s);
+    size_t expected = 0;
+    for (size_t i = 0; i < frames.size(); i++) {
+        expected += s.intact[i] ? 1 : 0;
+    }
+    printf("%s: %zu bytes, %zu damaged spots, decoded %zu (intact %zu), resync avg %.1f max %zu bytes, "
+           "borrowed %zu, crc %u length %u dropped %u\n",
+           damageNames[damage], s.bytes.size(), s.damageAt.size(), r.decoded, expected,
+           r.resyncs ? (double)r.resyncTotal / r.resyncs : 0.0, r.resyncMax, r.borrowed,
+           (unsigned)r.stats.crcErrors, (unsigned)r.stats.lengthErrors, (unsigned)r.stats.droppedBytes);
+
+    char name[64];
+    char detail[96];
+    snprintf(name, sizeof(name), "%s: no wrong decodes", damageNames[damage]);
+    snprintf(detail, sizeof(detail), "(%zu)", r.wrong);
+    check(r.wrong == 0, name, detail);
+    snprintf(name, sizeof(name), "%s: every intact frame decoded", damageNames[damage]);
+    snprintf(detail, sizeof(detail), "(lost %zu)", r.lost);
+    check(r.lost == 0, name, detail);
+    if (damage != DAMAGE_NONE) {
+        // 解析器遇到錯誤只丟掉一個位元組再重新掃描，所以下一個訊框開頭之前最多浪費一個訊框加上插入的雜訊
+        snprintf(name, sizeof(name), "%s: resync within one frame", damageNames[damage]);
+        snprintf(detail, sizeof(detail), "(max %zu bytes)", r.resyncMax);
+        check(r.resyncMax <= 2 * LINK_MAX_FRAME_SIZE, name, detail);
+    }
+}
+
+// 隨機混合所有損毀，並在訊框之間插入雜訊
+static void testFuzz(const std::vector<SourceFrame>& frames) {
+    Stream s = buildStream(frames, [&](size_t) {
+        if (rndRange(100) >= FUZZ_CORRUPT_PERCENT) {
+            return DAMAGE_NONE;
+        }
+        return (Damage)(DAMAGE_BIT_FLIP + rndRange(DAMAGE_COUNT - DAMAGE_BIT_FLIP));
+    });
+    ParseResult r = parseStream(frames, s);
+    printf("fuzz: %zu bytes, %zu damaged spots, decoded %zu, resync avg %.1f max %zu bytes, borrowed %zu\n",
+           s.bytes.size(), s.damageAt.size(), r.decoded,
+           r.resyncs ? (double)r.resyncTotal / r.resyncs : 0.0, r.resyncMax, r.borrowed);
+    char detail[64];
+    snprintf(detail, sizeof(detail), "(%zu)", r.wrong);
+    check(r.wrong == 0, "fuzz: no wrong decodes", detail);
+    snprintf(detail, sizeof(detail), "(lost %zu)", r.lost);
+    check(r.lost == 0, "fuzz: every intact frame decoded", detail);
+}
+
+// 傳回乾淨串流的解析速度 (MB/s)
+static double benchmark(const std::vector<SourceFrame>& frames) {
+    Stream s = buildStream(frames, [](size_t) { return DAMAGE_NONE; });
+    size_t rounds = (size_t)BENCH_MB * 1024 * 1024 / s.bytes.size() + 1;
+    LinkFrameParser parser;
+    volatile uint32_t sink = 0;
+    uint64_t t0 = nowNs();
+    for (size_t n = 0; n < rounds; n++) {
+        parser.feed(s.bytes.data(), s.bytes.size(), [&](const LinkFrame& frame) {
+            sink = sink + frame.len;
+        });
+    }
+    uint64_t t1 = nowNs();
+    double mb = (double)rounds * s.bytes.size() / (1024.0 * 1024.0);
+    return mb / ((t1 - t0) / 1e9);
+}
+
+int main(int argc, char** argv) {
+    uint32_t count = BENCH_FRAMES;
+    uint32_t seed = 1;
+    for (int i = 1; i < argc; i++) {
+        if (strcmp(argv[i], "--frames") == 0 && i + 1 < argc) {
+            count = (uint32_t)atoi(argv[++i]);
+        } else if (strcmp(argv[i], "--seed") == 0 && i + 1 < argc) {
+            seed = (uint32_t)atoi(argv[++i]);
+        } else {
+            fprintf(stderr, "usage: %s [--frames N] [--seed N]\n", argv[0]);
+            return 2;
+        }
+    }
+    if (count < 16 || count > 65535 || seed == 0) {
+        fprintf(stderr, "frames must be 16..65535, seed != 0\n");
+        return 2;
+    }
+    rngState = seed;
+
+    std::vector<SourceFrame> frames = makeFrames(count);
+    for (int d = DAMAGE_NONE; d < DAMAGE_COUNT; d++) {
+        testDamage(frames, (Damage)d);
+    }
+    testFuzz(frames);
+
+    printf("parse: %.1f MB/s on host\n", benchmark(frames));
+
+    return checkSummary();
+}
@@ -0,0 +1,128 @@
+// 檔案: PosixLinkTransport.h
+// 作用: Linux 上的連線傳輸層 (pty 或 Unix socket)，供 linksim 在電腦上執行 S1/S3 流程
+//
+// 只在電腦上編譯，不屬於韌體。
+
+#pragma once
+#include "LinkTransport.h"
+
+#include <errno.h>
+#include <fcntl.h>
+#include <stdlib.h>
+#include <string.h>
+#include <sys/socket.h>
+#include <sys/un.h>
+#include <termios.h>
+#include <unistd.h>
+
+class PosixLinkTransport : public LinkTransport {
+public:
+    // fd 會被設為非阻塞，並在解構時關閉
+    explicit PosixLinkTransport(int fd) : _fd(fd) {
+        fcntl(_fd, F_SETFL, fcntl(_fd, F_GETFL) | O_NONBLOCK);
+    }
+    ~PosixLinkTransport() override {
+        if (_fd >= 0) {
+            close(_fd);
+        }
+    }
+
+    size_t write(const uint8_t* data, size_t len) override {
+        size_t done = 0;
+        while (done < len) {
+            ssize_t n = ::write(_fd, data + done, len - done);
+            if (n > 0) {
+                done += (size_t)n;
+            } else if (n < 0 && errno == EINTR) {
+                continue;
+            } else if (n < 0 && errno == EAGAIN) {
+                usleep(50);  // 對方來不及讀，模擬 UART 的 TX FIFO 滿
+            } else {
+                break;
+            }
+        }
+        return done;
+    }
+
+    size_t read(uint8_t* out, size_t maxLen) override {
+        ssize_t n = ::read(_fd, out, maxLen);
+        return n > 0 ? (size_t)n : 0;
+    }
+
+    int fd() const { return _fd; }
+
+private:
+    int _fd;
+};
+
+// --- 建立連線用的 fd ---
+
+// pty 主端；slaveName 回傳從端路徑 (例如 /dev/pts/3)，另一個行程可直接開啟
+inline int linkOpenPty(char* slaveName, size_t nameLen) {
+    int master = posix_openpt(O_RDWR | O_NOCTTY);
+    if (master < 0 || grantpt(master) != 0 || unlockpt(master) != 0) {
+        return -1;
+    }
+    const char* name = ptsname(master);
+    if (!name) {
+        return -1;
+    }
+    strncpy(slaveName, name, nameLen - 1);
+    slaveName[nameLen - 1] = '\0';
+
+    // 原始模式: 不做換行轉換與回顯，位元組原樣傳遞
+    struct termios tio;
+    tcgetattr(master, &tio);
+    cfmakeraw(&tio);
+    tcsetattr(master, TCSANOW, &tio);
+    return master;
+}
+
+// 開啟 pty 從端 (或任何序列埠裝置) 並設為原始模式
+inline int linkOpenTty(const char* path) {
+    int fd = open(path, O_RDWR | O_NOCTTY);
+    if (fd < 0) {
+        return -1;
+    }
+    struct termios tio;
+    tcgetattr(fd, &tio);
+    cfmakeraw(&tio);
+    tcsetattr(fd, TCSANOW, &tio);
+    return fd;
+}
+
+// 在 path 上等待一個 Unix socket 連線，回傳已連線的 fd
+inline int linkListenUnix(const char* path) {
+    int server = socket(AF_UNIX, SOCK_STREAM, 0);
+    if (server < 0) {
+        return -1;
+    }
+    struct sockaddr_un addr;
+    memset(&addr, 0, sizeof(addr));
+    addr.sun_family = AF_UNIX;
+    strncpy(addr.sun_path, path, sizeof(addr.sun_path) - 1);
+    unlink(path);
+    if (bind(server, (struct sockaddr*)&addr, sizeof(addr)) != 0 || listen(server, 1) != 0) {
+        close(server);
+        return -1;
+    }
+    int fd = accept(server, NULL, NULL);
+    close(server);
+    return fd;
+}
+
+inline int linkConnectUnix(const char* path) {
+    int fd = socket(AF_UNIX, SOCK_STREAM, 0);
+    if (fd < 0) {
+        return -1;
+    }
+    struct sockaddr_un addr;
+    memset(&addr, 0, sizeof(addr));
+    addr.sun_family = AF_UNIX;
+    strncpy(addr.sun_path, path, sizeof(addr.sun_path) - 1);
+    if (connect(fd, (struct sockaddr*)&addr, sizeof(addr)) != 0) {
+        close(fd);
+        return -1;
+    }
+    return fd;
+}
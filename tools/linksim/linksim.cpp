@@ -0,0 +1,553 @@
+// 檔案: linksim.cpp
+// 作用: 在 Linux 上執行 S1 -> S3 的完整連線流程 (藍牙與 USB 除外)，用於效能量測與長時間測試
+//
+// S1 端以合成的 Wiimote 回報取代藍牙 (可設定回報率與點擊長度)，
+// S3 端以計數取代 USB 報告；中間走的是與韌體相同的訊框、速率協商、時間同步、
+// 命令通道、狀態差量編碼與快速點擊保留。
+//
+// 編譯 (在專案根目錄):
+//   g++ -std=c++17 -O2 -Icommon/WiimoteLink -IWiiMote_i2c/src -ISwitchPro_i2c/src
+//       tools/linksim/linksim.cpp common/WiimoteLink/*.cpp -o linksim
+//
+// 用法:
+//   ./linksim                              單一行程，S1/S3 以 socketpair 相連
+//   ./linksim --pty                        單一行程，S1/S3 以 pty 相連 (與 UART 相同的 tty 路徑)
+//   ./linksim --role s3 --unix /tmp/link   兩個行程: S3 等待連線
+//   ./linksim --role s1 --unix /tmp/link   兩個行程: S1 連線
+//   ./linksim --role s1 --pty              S1 建立 pty 並印出從端路徑，S3 以 --device 開啟
+//
+// 其他參數: --seconds N  --rate HZ  --tap-us US  --policy fixed|change|hybrid  --error-ppm N
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <time.h>
+#include <sys/socket.h>
+
+#include "PosixLinkTransport.h"
+#include "WiimoteData.h"
+#include "ButtonEdges.h"
+#include "LinkBaudNegotiator.h"
+#include "LinkCommand.h"
+#include "SendScheduler.h"     // WiiMote_i2c/src
+#include "ClockSync.h"         // SwitchPro_i2c/src
+#include "LatencyHistogram.h"  // SwitchPro_i2c/src
+
+#define SIM_LINK_MAX_BAUD     5000000
+#define SIM_SEND_INTERVAL_US  20000
+#define SIM_MIN_SPACING_US    1000
+#define SIM_HEARTBEAT_US      250000
+#define SIM_KEYFRAME_MS       250
+#define SIM_CLOCK_SYNC_MS     500
+#define SIM_ACCEL_TOGGLE_MS   1000
+#define SIM_REPORTING_RESUBMIT_MS 200
+#define SIM_DRAIN_MS          500
+
+// 與韌體的 micros() / millis() 一樣各自在 32 位元回繞 (開機 71 分鐘後 µs 就會回繞)，
+// 所以排程時間一律以目前時間為起點，比較時只看差值
+static uint64_t monotonicUs() {
+    struct timespec ts;
+    clock_gettime(CLOCK_MONOTONIC, &ts);
+    return (uint64_t)ts.tv_sec * 1000000ULL + ts.tv_nsec / 1000;
+}
+
+static uint32_t nowUs() {
+    return (uint32_t)monotonicUs();
+}
+
+static uint32_t nowMs() {
+    return (uint32_t)(monotonicUs() / 1000);
+}
+
+// ---------------------------------------------------------------------------
+// 以固定機率破壞位元組的傳輸層，用來驗證重新同步
+// ---------------------------------------------------------------------------
+class FaultyLinkTransport : public LinkTransport {
+public:
+    FaultyLinkTransport(LinkTransport& inner, uint32_t errorPpm) : _inner(inner), _errorPpm(errorPpm), _corrupted(0) {}
+
+    size_t write(const uint8_t* data, size_t len) override {
+        uint8_t buf[LINK_MAX_FRAME_SIZE];
+        size_t n = len < sizeof(buf) ? len : sizeof(buf);
+        memcpy(buf, data, n);
+        for (size_t i = 0; i < n; i++) {
+            if ((uint32_t)(rand() % 1000000) < _errorPpm) {
+                buf[i] ^= (uint8_t)(1 << (rand() % 8));
+                _corrupted++;
+            }
+        }
+        return _inner.write(buf, n);
+    }
+    size_t read(uint8_t* out, size_t maxLen) override { return _inner.read(out, maxLen); }
+    void setBaud(uint32_t baud) override { _inner.setBaud(baud); }
+
+    uint32_t corrupted() const { return _corrupted; }
+
+private:
+    LinkTransport& _inner;
+    uint32_t _errorPpm;
+    uint32_t _corrupted;
+};
+
+// ---------------------------------------------------------------------------
+// S1: 合成 Wiimote 輸入 -> 狀態封包
+// ---------------------------------------------------------------------------
+static const uint16_t SIM_BUTTONS[] = {
+    BUTTON_A, BUTTON_B, BUTTON_ONE, BUTTON_TWO, BUTTON_PLUS, BUTTON_MINUS, BUTTON_UP, BUTTON_RIGHT
+};
+#define SIM_BUTTON_COUNT (sizeof(SIM_BUTTONS) / sizeof(SIM_BUTTONS[0]))
+
+static LinkTransport* s1Link = NULL;
+
+static void s1Send(uint8_t type, const void* payload, uint8_t len) { s1Link->writeFrame(type, payload, len); }
+static void s1SetBaud(uint32_t baud) { s1Link->setBaud(baud); }
+
+struct S1Sim {
+    SendScheduler scheduler;
+    WiimoteState current;
+    WiimoteState sent;
+    ButtonEdgeTracker edges;
+    uint32_t lastKeyframeMs;
+    uint32_t releaseAtUs[SIM_BUTTON_COUNT];   // 0 = 未按
+    uint32_t nextInputUs;
+    uint32_t inputPeriodUs;
+    uint32_t tapUs;
+    bool inputEnabled;
+    bool accel;
+    uint64_t taps;
+    uint64_t reports;
+    uint64_t framesSent;
+
+    S1Sim(SendPolicy policy)
+        : scheduler(policy, SIM_SEND_INTERVAL_US, SIM_MIN_SPACING_US, SIM_HEARTBEAT_US),
+          lastKeyframeMs(0), nextInputUs(0), inputPeriodUs(1000), tapUs(5000),
+          inputEnabled(true), accel(false), taps(0), reports(0), framesSent(0) {
+        wiimoteStateReset(current);
+        wiimoteStateReset(sent);
+        memset(releaseAtUs, 0, sizeof(releaseAtUs));
+    }
+};
+static S1Sim* s1 = NULL;
+
+static uint8_t s1Execute(uint8_t cmd, const uint8_t* args, uint8_t len) {
+    if (len < 1) {
+        return LINK_CMD_BAD_ARGS;
+    }
+    switch (cmd) {
+        case LINK_CMD_SET_LEDS:
+        case LINK_CMD_SET_RUMBLE:
+            return LINK_CMD_OK;
+        case LINK_CMD_SET_REPORTING:
+            s1->accel = (args[0] & LINK_REPORT_ACCEL) != 0;
+            return LINK_CMD_OK;
+        default:
+            return LINK_CMD_UNKNOWN;
+    }
+}
+
+static LinkBaudNegotiator s1Baud(LINK_BAUD_INITIATOR, { s1Send, s1SetBaud });
+static LinkCommandReceiver s1Commands(s1Send, s1Execute);
+
+static void s1HandleFrame(const LinkFrame& frame) {
+    uint32_t rxUs = nowUs();
+    if (s1Baud.handleFrame(frame, nowMs()) || s1Commands.handleFrame(frame)) {
+        return;
+    }
+    if (frame.type == LINK_MSG_TIME_REQ && frame.len == sizeof(LinkTimeSyncPayload)) {
+        LinkTimeSyncPayload sync;
+        memcpy(&sync, frame.payload, sizeof(sync));
+        sync.t1 = rxUs;
+        sync.t2 = nowUs();
+        s1Send(LINK_MSG_TIME_RESP, &sync, sizeof(sync));
+    }
+}
+
+// 產生一個合成的 Wiimote 回報: 釋放到期的按鈕，並隨機開始新的點擊
+static void s1GenerateReport(uint32_t t) {
+    uint16_t buttons = 0;
+    for (uint8_t i = 0; i < SIM_BUTTON_COUNT; i++) {
+        bool released = false;
+        if (s1->releaseAtUs[i] != 0 && (int32_t)(t - s1->releaseAtUs[i]) >= 0) {
+            s1->releaseAtUs[i] = 0;
+            released = true;  // 放開至少要維持一個回報，否則 Wiimote 上看不到這次點擊
+        }
+        if (s1->inputEnabled && !released && s1->releaseAtUs[i] == 0 && rand() % 8 == 0) {
+            s1->releaseAtUs[i] = t + s1->tapUs;
+            if (s1->releaseAtUs[i] == 0) {
+                s1->releaseAtUs[i] = 1;
+            }
+            s1->taps++;
+        }
+        if (s1->releaseAtUs[i] != 0) {
+            buttons |= SIM_BUTTONS[i];
+        }
+    }
+    s1->current.buttons = buttons;
+    if (s1->accel) {
+        s1->current.accelX = (uint8_t)(0x80 + rand() % 8);
+        s1->current.accelY = (uint8_t)(0x80 + rand() % 8);
+        s1->current.accelZ = (uint8_t)(0x98 + rand() % 8);
+    }
+    s1->current.battery = 0xC0;
+    s1->current.flags = WIIMOTE_FLAG_CONNECTED | (s1->accel ? WIIMOTE_FLAG_ACCEL : 0);
+    s1->reports++;
+}
+
+// 對應 WiiMote_i2c/src/main.cpp 的 loop()
+static void s1Step() {
+    s1Link->poll(s1HandleFrame);
+    s1Baud.task(nowMs());
+
+    uint32_t t = nowUs();
+    if ((int32_t)(t - s1->nextInputUs) >= 0) {
+        s1->nextInputUs = t + s1->inputPeriodUs;
+        s1GenerateReport(t);
+        s1->edges.update(wiimoteButtonSet(s1->current));
+        if (wiimoteStateDiff(s1->current, s1->sent) != 0) {
+            s1->current.reportTimeUs = t;
+            s1->scheduler.markChanged();
+        }
+    }
+
+    t = nowUs();
+    if (s1->scheduler.shouldSend(t) || s1->edges.full()) {
+        s1->scheduler.onSent(t);
+        uint8_t fields = wiimoteStateDiff(s1->current, s1->sent);
+        if (fields != 0) {
+            uint32_t age = t - s1->current.reportTimeUs;
+            s1->current.reportAgeUs = age > 0xFFFF ? 0xFFFF : (uint16_t)age;
+            fields |= STATE_FIELD_TIMESTAMP;
+        }
+        if (s1->edges.needsReplay()) {
+            s1->edges.store(s1->current);
+            fields |= STATE_FIELD_EDGES | STATE_FIELD_BUTTONS;
+        }
+        s1->edges.clear();
+        if (nowMs() - s1->lastKeyframeMs >= SIM_KEYFRAME_MS) {
+            s1->lastKeyframeMs = nowMs();
+            fields |= STATE_FIELD_ALL;
+        }
+        uint8_t payload[WIIMOTE_STATE_MAX_SIZE];
+        size_t payloadLen = wiimoteStateEncode(payload, s1->current, fields);
+        s1->sent = s1->current;
+        s1Send(LINK_MSG_STATE, payload, (uint8_t)payloadLen);
+        s1->framesSent++;
+    }
+}
+
+// ---------------------------------------------------------------------------
+// S3: 狀態封包 -> (模擬的) USB 報告
+// ---------------------------------------------------------------------------
+static LinkTransport* s3Link = NULL;
+
+static void s3Send(uint8_t type, const void* payload, uint8_t len) { s3Link->writeFrame(type, payload, len); }
+static void s3SetBaud(uint32_t baud) { s3Link->setBaud(baud); }
+
+enum { SIM_LAT_S1, SIM_LAT_LINK, SIM_LAT_TOTAL, SIM_LAT_COUNT };
+static const char* const SIM_LAT_NAMES[SIM_LAT_COUNT] = { "s1", "link", "total" };
+
+struct S3Sim {
+    WiimoteState state;
+    uint32_t applied;
+    uint64_t reports;        // 模擬的 USB 報告數
+    uint64_t pressEdges;     // USB 報告中出現的按下次數 (應等於 S1 的點擊數)
+    uint64_t replays;
+    uint32_t decodeErrors;
+    ClockSync clock;
+    LatencyHistogram latency[SIM_LAT_COUNT];
+    uint32_t lastSyncMs;
+    uint32_t lastToggleMs;
+    uint32_t lastReportingSubmitMs;
+    bool wantAccel;
+    uint32_t commandFailures;
+
+    S3Sim() : applied(0), reports(0), pressEdges(0), replays(0), decodeErrors(0),
+              lastSyncMs(0), lastToggleMs(0), lastReportingSubmitMs(0), wantAccel(false), commandFailures(0) {
+        wiimoteStateReset(state);
+    }
+};
+static S3Sim* s3 = NULL;
+
+static void s3CommandResult(uint8_t cmd, uint8_t status) {
+    (void)cmd;
+    if (status != LINK_CMD_OK) {
+        s3->commandFailures++;
+    }
+}
+
+static LinkBaudNegotiator s3Baud(LINK_BAUD_RESPONDER, { s3Send, s3SetBaud });
+static LinkCommandSender s3Commands({ s3Send, s3CommandResult });
+
+static void s3Report(uint32_t buttons) {
+    s3->pressEdges += (uint64_t)__builtin_popcount(buttons & ~s3->applied);
+    s3->applied = buttons;
+    s3->reports++;
+}
+
+// 對應 SwitchPro_i2c/src/main.cpp 的 handleLinkFrame()
+static void s3HandleFrame(const LinkFrame& frame) {
+    uint32_t rxUs = nowUs();
+    if (s3Baud.handleFrame(frame, nowMs()) || s3Commands.handleFrame(frame)) {
+        return;
+    }
+    switch (frame.type) {
+        case LINK_MSG_STATE: {
+            uint8_t fields = 0;
+            if (!wiimoteStateDecode(frame.payload, frame.len, s3->state, &fields)) {
+                s3->decodeErrors++;
+                break;
+            }
+            uint32_t buttons = wiimoteButtonSet(s3->state);
+            if (fields & STATE_FIELD_EDGES) {
+                for (uint8_t i = 0; i < s3->state.edgeCount && i < WIIMOTE_EDGE_MAX; i++) {
+                    uint32_t replay = wiimoteEdgeState(s3->state, i);
+                    if (replay != s3->applied) {
+                        s3Report(replay);
+                        s3->replays++;
+                    }
+                }
+            }
+            if (buttons != s3->applied) {
+                s3Report(buttons);
+            }
+            if (fields & STATE_FIELD_TIMESTAMP) {
+                uint32_t doneUs = nowUs();
+                s3->latency[SIM_LAT_S1].record(s3->state.reportAgeUs);
+                if (s3->clock.valid()) {
+                    uint32_t reportLocal = s3->clock.toLocal(s3->state.reportTimeUs);
+                    int32_t linkUs = (int32_t)(rxUs - (reportLocal + s3->state.reportAgeUs));
+                    int32_t totalUs = (int32_t)(doneUs - reportLocal);
+                    s3->latency[SIM_LAT_LINK].record(linkUs > 0 ? (uint32_t)linkUs : 0);
+                    s3->latency[SIM_LAT_TOTAL].record(totalUs > 0 ? (uint32_t)totalUs : 0);
+                }
+            }
+            break;
+        }
+        case LINK_MSG_TIME_RESP:
+            if (frame.len == sizeof(LinkTimeSyncPayload)) {
+                LinkTimeSyncPayload resp;
+                memcpy(&resp, frame.payload, sizeof(resp));
+                s3->clock.onResponse(resp, nowUs());
+            }
+            break;
+        default:
+            break;
+    }
+}
+
+// 對應 SwitchPro_i2c/src/main.cpp 的 inputTask()
+static void s3Step() {
+    s3Link->poll(s3HandleFrame);
+    uint32_t ms = nowMs();
+    s3Baud.task(ms);
+    if (s3Baud.negotiating()) {
+        return;
+    }
+    if (ms - s3->lastSyncMs >= SIM_CLOCK_SYNC_MS) {
+        s3->lastSyncMs = ms;
+        LinkTimeSyncPayload req;
+        s3->clock.makeRequest(req, nowUs());
+        s3Send(LINK_MSG_TIME_REQ, &req, sizeof(req));
+    }
+
+    // 定期切換加速度計回報，持續驗證命令通道
+    if (ms - s3->lastToggleMs >= SIM_ACCEL_TOGGLE_MS) {
+        s3->lastToggleMs = ms;
+        s3->wantAccel = !s3->wantAccel;
+    }
+    bool accelActive = (s3->state.flags & WIIMOTE_FLAG_ACCEL) != 0;
+    if (accelActive != s3->wantAccel && !s3Commands.pending(LINK_CMD_SET_REPORTING) &&
+        ms - s3->lastReportingSubmitMs >= SIM_REPORTING_RESUBMIT_MS) {
+        uint8_t features = s3->wantAccel ? LINK_REPORT_ACCEL : 0;
+        s3Commands.submit(LINK_CMD_SET_REPORTING, &features, sizeof(features));
+        s3->lastReportingSubmitMs = ms;
+    }
+    s3Commands.task(ms);
+}
+
+// ---------------------------------------------------------------------------
+
+static void printLinkStats(const char* name, const LinkTransport& link) {
+    const LinkStats& rx = link.rxStats();
+    const LinkTxStats& tx = link.txStats();
+    printf("  %s rx ok=%u crc=%u len=%u gaps=%u dropped=%u | tx frames=%u bytes=%u short=%u\n", name,
+           rx.framesOk, rx.crcErrors, rx.lengthErrors, rx.seqGaps, rx.droppedBytes,
+           tx.frames, tx.bytes, tx.shortWrites);
+}
+
+static void printS1() {
+    printf("S1 reports=%llu taps=%llu frames=%llu baud=%u\n", (unsigned long long)s1->reports,
+           (unsigned long long)s1->taps, (unsigned long long)s1->framesSent, s1Baud.currentBaud());
+    printLinkStats("S1", *s1Link);
+}
+
+static void printS3() {
+    const LinkCommandStats& cmd = s3Commands.stats();
+    printf("S3 usbReports=%llu pressEdges=%llu replays=%llu decodeErrors=%u baud=%u clock offset=%d rtt=%u\n",
+           (unsigned long long)s3->reports, (unsigned long long)s3->pressEdges,
+           (unsigned long long)s3->replays, s3->decodeErrors, s3Baud.currentBaud(),
+           s3->clock.offsetUs(), s3->clock.rttUs());
+    printf("  commands sent=%u acked=%u retries=%u failed=%u\n", cmd.sent, cmd.acked, cmd.retries, cmd.failed);
+    for (uint8_t i = 0; i < SIM_LAT_COUNT; i++) {
+        const LatencyHistogram& h = s3->latency[i];
+        printf("  latency %-5s n=%u min=%u mean=%u p99=%u max=%u us\n", SIM_LAT_NAMES[i],
+               h.count(), h.min(), h.mean(), h.percentile(990), h.max());
+    }
+    printLinkStats("S3", *s3Link);
+}
+
+static void usage(const char* prog) {
+    fprintf(stderr,
+            "usage: %s [--role both|s1|s3] [--pty] [--device PATH] [--unix PATH]\n"
+            "          [--seconds N] [--rate HZ] [--tap-us US] [--policy fixed|change|hybrid] [--error-ppm N]\n",
+            prog);
+}
+
+int main(int argc, char** argv) {
+    const char* role = "both";
+    const char* device = NULL;
+    const char* unixPath = NULL;
+    bool usePty = false;
+    uint32_t seconds = 10;
+    uint32_t rateHz = 1000;
+    uint32_t tapUs = 5000;
+    uint32_t errorPpm = 0;
+    SendPolicy policy = SEND_POLICY_ON_CHANGE;
+
+    for (int i = 1; i < argc; i++) {
+        const char* arg = argv[i];
+        const char* val = (i + 1 < argc) ? argv[i + 1] : NULL;
+        if (!strcmp(arg, "--pty")) {
+            usePty = true;
+            continue;
+        }
+        if (!val) {
+            usage(argv[0]);
+            return 2;
+        }
+        i++;
+        if (!strcmp(arg, "--role")) role = val;
+        else if (!strcmp(arg, "--device")) device = val;
+        else if (!strcmp(arg, "--unix")) unixPath = val;
+        else if (!strcmp(arg, "--seconds")) seconds = (uint32_t)atoi(val);
+        else if (!strcmp(arg, "--rate")) rateHz = (uint32_t)atoi(val);
+        else if (!strcmp(arg, "--tap-us")) tapUs = (uint32_t)atoi(val);
+        else if (!strcmp(arg, "--error-ppm")) errorPpm = (uint32_t)atoi(val);
+        else if (!strcmp(arg, "--policy")) {
+            policy = !strcmp(val, "fixed") ? SEND_POLICY_FIXED_RATE
+                   : !strcmp(val, "hybrid") ? SEND_POLICY_HYBRID : SEND_POLICY_ON_CHANGE;
+        } else {
+            usage(argv[0]);
+            return 2;
+        }
+    }
+    bool runS1 = strcmp(role, "s3") != 0;
+    bool runS3 = strcmp(role, "s1") != 0;
+
+    // --- 建立連線 ---
+    int s1Fd = -1, s3Fd = -1;
+    char ptyName[64];
+    if (runS1 && runS3) {
+        if (usePty) {
+            s1Fd = linkOpenPty(ptyName, sizeof(ptyName));
+            s3Fd = s1Fd >= 0 ? linkOpenTty(ptyName) : -1;
+        } else {
+            int fds[2];
+            if (socketpair(AF_UNIX, SOCK_STREAM, 0, fds) == 0) {
+                s1Fd = fds[0];
+                s3Fd = fds[1];
+            }
+        }
+    } else if (runS1) {
+        if (unixPath) {
+            s1Fd = linkConnectUnix(unixPath);
+        } else if (device) {
+            s1Fd = linkOpenTty(device);
+        } else {
+            s1Fd = linkOpenPty(ptyName, sizeof(ptyName));
+            if (s1Fd >= 0) {
+                printf("S1 pty: %s (run: --role s3 --device %s)\n", ptyName, ptyName);
+            }
+        }
+    } else {
+        s3Fd = unixPath ? linkListenUnix(unixPath) : device ? linkOpenTty(device) : -1;
+    }
+    if ((runS1 && s1Fd < 0) || (runS3 && s3Fd < 0)) {
+        perror("linksim: failed to open link");
+        return 1;
+    }
+
+    srand(1);
+    PosixLinkTransport* s1Posix = runS1 ? new PosixLinkTransport(s1Fd) : NULL;
+    PosixLinkTransport* s3Posix = runS3 ? new PosixLinkTransport(s3Fd) : NULL;
+    FaultyLinkTransport* s1Faulty = (runS1 && errorPpm) ? new FaultyLinkTransport(*s1Posix, errorPpm) : NULL;
+    s1Link = s1Faulty ? (LinkTransport*)s1Faulty : (LinkTransport*)s1Posix;
+    s3Link = s3Posix;
+
+    if (runS1) {
+        s1 = new S1Sim(policy);
+        s1->inputPeriodUs = rateHz ? 1000000 / rateHz : 1000;
+        s1->tapUs = tapUs;
+        s1->nextInputUs = nowUs();
+        s1->lastKeyframeMs = nowMs();
+        s1Baud.begin(nowMs(), SIM_LINK_MAX_BAUD, s1Link->rxStats());
+    }
+    if (runS3) {
+        s3 = new S3Sim();
+        // 第一次時間同步與加速度計切換在啟動後立即進行
+        s3->lastSyncMs = nowMs() - SIM_CLOCK_SYNC_MS;
+        s3->lastToggleMs = nowMs() - SIM_ACCEL_TOGGLE_MS;
+        s3->lastReportingSubmitMs = nowMs() - SIM_REPORTING_RESUBMIT_MS;
+        s3Baud.begin(nowMs(), SIM_LINK_MAX_BAUD, s3Link->rxStats());
+    }
+
+    // --- 主迴圈: 執行 seconds 秒後停止輸入，等待剩餘封包送達 ---
+    uint32_t startMs = nowMs();
+    uint32_t lastPrintMs = startMs;
+    for (;;) {
+        uint32_t ms = nowMs();
+        if (runS1) {
+            s1->inputEnabled = (ms - startMs) < seconds * 1000;
+            s1Step();
+        }
+        if (runS3) {
+            s3Step();
+        }
+        if (ms - lastPrintMs >= 1000) {
+            lastPrintMs = ms;
+            if (runS1) printS1();
+            if (runS3) printS3();
+        }
+        if (ms - startMs >= seconds * 1000 + SIM_DRAIN_MS) {
+            break;
+        }
+    }
+
+    printf("--- final ---\n");
+    if (runS1) printS1();
+    if (runS3) printS3();
+
+    int result = 0;
+    if (runS1 && runS3) {
+        if (s3->decodeErrors != 0) {
+            result = 1;
+        }
+        // 沒有產生任何輸入或延遲樣本時，下面的比對沒有意義
+        if (s1->taps == 0 || s3->latency[SIM_LAT_TOTAL].count() == 0) {
+            printf("NO INPUT: taps=%llu latency samples=%u\n",
+                   (unsigned long long)s1->taps, s3->latency[SIM_LAT_TOTAL].count());
+            result = 1;
+        }
+        // 沒有注入錯誤時，每一次點擊都必須在 S3 出現
+        if (errorPpm == 0 && s3->pressEdges != s1->taps) {
+            printf("MISMATCH: taps=%llu pressEdges=%llu\n",
+                   (unsigned long long)s1->taps, (unsigned long long)s3->pressEdges);
+            result = 1;
+        }
+        if (s1Faulty) {
+            printf("corrupted bytes: %u\n", s1Faulty->corrupted());
+        }
+    }
+    printf("%s\n", result == 0 ? "PASS" : "FAIL");
+    return result;
+}
@@ -0,0 +1,268 @@
+// 檔案: macroreplay.cpp
+// 作用: 以假時鐘推進連發與巨集 (SwitchPro_i2c/src/MacroEngine.h)，檢查每次按下 / 放開的確切時間
+//
+// 依照 S3 的做法: 每個封包呼叫 input()，1ms 計時器呼叫 tick()，回傳 true 時記錄一次輸出 (時間、按鈕、十字鍵)。
+// 時鐘由這裡決定，所以預期的時間都是精確值:
+//   - 配對巨集 (main.cpp 的 pairMacroSteps: L+R 100ms、放開 100ms、A 100ms) 從觸發的瞬間開始，
+//     每一步在預定時間後的第一個 tick 切換，tick 延遲不會累積到後面的步驟
+//   - 巨集執行期間忽略玩家的按鈕，放開並再次按下組合鍵才會重新觸發
+//   - 連發從按下的瞬間開始，第 k 次切換在 按下時間 + k * 半週期 之後的第一個 tick
+//   - micros() 在 32 位元回繞時時間仍正確
+//
+// 編譯 (在專案根目錄):
+//   g++ -std=c++17 -O2 -ISwitchPro_i2c/src -Itools/common tools/macroreplay/macroreplay.cpp -o macroreplay
+//
+// 用法:
+//   ./macroreplay
+//   ./macroreplay --jitter-us 900 --seed 7
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+
+#include <vector>
+
+#include "MacroEngine.h"   // SwitchPro_i2c/src
+#include "ToolCheck.h"   // tools/common
+
+#define TICK_JITTER_US   400     // 1ms 計時器最多晚多少 (預設)
+#define HAT_CENTERED     0x0F
+
+// 與 switch_ESP32.h 的 NSButton_* 相同
+#define NS_A        2
+#define NS_L        4
+#define NS_R        5
+#define NS_MINUS    8
+#define NS_PLUS     9
+
+// 與 WiimoteData.h 相同
+#define WII_A       0x0800
+#define WII_PLUS    0x0010
+#define WII_MINUS   0x1000
+
+// 與 main.cpp 的 pairMacroSteps / macros 相同
+static const MacroStep pairMacroSteps[] = {
+    { (1 << NS_L) | (1 << NS_R), HAT_CENTERED, 100 },
+    { 0, HAT_CENTERED, 100 },
+    { 1 << NS_A, HAT_CENTERED, 100 },
+};
+static const MacroDef macros[] = {
+    { WII_PLUS | WII_MINUS, pairMacroSteps, sizeof(pairMacroSteps) / sizeof(pairMacroSteps[0]) },
+};
+
+static uint32_t rngState = 1;
+
+static uint32_t rnd() {
+    rngState ^= rngState << 13;
+    rngState ^= rngState >> 17;
+    rngState ^= rngState << 5;
+    return rngState;
+}
+
+// 一次輸出變化
+struct OutputEvent {
+    uint32_t atUs;
+    uint16_t buttons;
+    uint8_t hat;
+};
+
+// 與 S3 相同的呼叫方式，tick 每 MACRO_TICK_US 一次，最多晚 jitterUs
+struct Rig {
+    MacroEngine engine;
+    std::vector<OutputEvent> events;
+    std::vector<uint32_t> ticks;   // 實際呼叫 tick() 的時間
+    uint32_t turbo[TURBO_BUTTON_COUNT];
+    uint32_t nextTickUs;
+    uint32_t jitterUs;
+
+    Rig(uint32_t startUs, uint32_t jitter) : nextTickUs(startUs), jitterUs(jitter) {
+        engine.setMacros(macros, sizeof(macros) / sizeof(macros[0]));
+        memset(turbo, 0, sizeof(turbo));
+    }
+
+    void record(uint32_t nowUs) {
+        OutputEvent e = { nowUs, engine.output().buttons, engine.output().hat };
+        events.push_back(e);
+    }
+
+    // 新的封包 (先把計時器推進到 nowUs 之前)
+    void input(uint32_t wiimoteButtons, uint16_t nsButtons, uint32_t nowUs) {
+        runUntil(nowUs);
+        GamepadFrame frame = { nsButtons, HAT_CENTERED, 128, 128, 128, 128 };
+        if (engine.input(wiimoteButtons, frame, turbo, nowUs)) {
+            record(nowUs);
+        }
+    }
+
+    // 呼叫所有在 endUs 之前的 tick
+    void runUntil(uint32_t endUs) {
+        while ((int32_t)(endUs - nextTickUs) > 0) {
+            uint32_t at = nextTickUs + (jitterUs ? rnd() % (jitterUs + 1) : 0);
+            if ((int32_t)(endUs - at) <= 0) {
+                break;
+            }
+            ticks.push_back(at);
+            if (engine.tick(at)) {
+                record(at);
+            }
+            nextTickUs += MACRO_TICK_US;
+        }
+    }
+
+    // 第一個不早於 dueUs 的 tick
+    uint32_t firstTickAtOrAfter(uint32_t dueUs) const {
+        for (size_t i = 0; i < ticks.size(); i++) {
+            if ((int32_t)(ticks[i] - dueUs) >= 0) {
+                return ticks[i];
+            }
+        }
+        return 0;
+    }
+};
+
+/**
+ * 比對輸出與預期的事件序列
+ * @param name 檢查名稱
+ * @param expect 預期的事件 (時間、按鈕、十字鍵)
+ */
+static void expectEvents(const char* name, const Rig& rig, const std::vector<OutputEvent>& expect) {
+    bool ok = rig.events.size() == expect.size();
+    size_t bad = 0;
+    for (size_t i = 0; ok && i < expect.size(); i++) {
+        const OutputEvent& a = rig.events[i];
+        const OutputEvent& b = expect[i];
+        if (a.atUs != b.atUs || a.buttons != b.buttons || a.hat != b.hat) {
+            ok = false;
+            bad = i;
+        }
+    }
+    char detail[128] = "";
+    if (!ok) {
+        if (rig.events.size() != expect.size()) {
+            snprintf(detail, sizeof(detail), "(%zu events, expected %zu)", rig.events.size(), expect.size());
+        } else {
+            snprintf(detail, sizeof(detail), "(event %zu: %u us 0x%04X, expected %u us 0x%04X)", bad,
+                     rig.events[bad].atUs, rig.events[bad].buttons, expect[bad].atUs, expect[bad].buttons);
+        }
+    }
+    check(ok, name, detail);
+}
+
+/**
+ * 配對巨集: 組合鍵按下的瞬間開始，每一步在預定時間後的第一個 tick 切換
+ * @param startUs 開始時間 (測試回繞時接近 2^32)
+ */
+static void testPairMacro(const char* label, uint32_t startUs, uint32_t jitterUs) {
+    printf("%s\n", label);
+    Rig rig(startUs, jitterUs);
+    const uint16_t chordNs = (1 << NS_PLUS) | (1 << NS_MINUS);
+    // 觸發時間不在 tick 上
+    uint32_t t0 = startUs + 10000 + 337;
+    rig.input(WII_PLUS | WII_MINUS, chordNs, t0);
+    // 巨集執行中玩家按下 A: 輸出不變
+    rig.input(WII_PLUS | WII_MINUS | WII_A, chordNs | (1 << NS_A), t0 + 50000);
+    rig.input(WII_PLUS | WII_MINUS, chordNs, t0 + 60000);
+    rig.runUntil(t0 + 500000);
+    // 仍按著組合鍵: 巨集結束後輸出玩家的按鈕，不會重新觸發
+    std::vector<OutputEvent> expect;
+    expect.push_back({ t0, (1 << NS_L) | (1 << NS_R), HAT_CENTERED });
+    expect.push_back({ rig.firstTickAtOrAfter(t0 + 100000), 0, HAT_CENTERED });
+    expect.push_back({ rig.firstTickAtOrAfter(t0 + 200000), 1 << NS_A, HAT_CENTERED });
+    expect.push_back({ rig.firstTickAtOrAfter(t0 + 300000), chordNs, HAT_CENTERED });
+    char name[96];
+    snprintf(name, sizeof(name), "%s: L+R at trigger, release +100ms, A +200ms, player +300ms", label);
+    expectEvents(name, rig, expect);
+    snprintf(name, sizeof(name), "%s: macro finished and ran once", label);
+    check(!rig.engine.macroRunning() && rig.engine.stats().macrosRun == 1, name);
+
+    const MacroStats& s = rig.engine.stats();
+    char detail[64];
+    snprintf(detail, sizeof(detail), "(late %u, max %u us)", s.lateFrames, s.maxLateUs);
+    snprintf(name, sizeof(name), "%s: lateness within one tick plus jitter", label);
+    // 預定時間前一刻的 tick 沒有延遲、下一個 tick 延遲最多，就會晚 MACRO_TICK_US + jitter
+    check(s.maxLateUs <= MACRO_TICK_US + jitterUs && (jitterUs > 0 || s.lateFrames == 0), name, detail);
+
+    // 放開再按下: 再執行一次，時間同樣從按下的瞬間算起
+    uint32_t t1 = t0 + 700000 + 81;
+    rig.input(0, 0, t1 - 100000);
+    rig.events.clear();
+    rig.input(WII_PLUS | WII_MINUS, chordNs, t1);
+    rig.input(0, 0, t1 + 20000);   // 提早放開不會中斷巨集
+    rig.runUntil(t1 + 500000);
+    expect.clear();
+    expect.push_back({ t1, (1 << NS_L) | (1 << NS_R), HAT_CENTERED });
+    expect.push_back({ rig.firstTickAtOrAfter(t1 + 100000), 0, HAT_CENTERED });
+    expect.push_back({ rig.firstTickAtOrAfter(t1 + 200000), 1 << NS_A, HAT_CENTERED });
+    expect.push_back({ rig.firstTickAtOrAfter(t1 + 300000), 0, HAT_CENTERED });
+    snprintf(name, sizeof(name), "%s: re-trigger after release has the same timing", label);
+    expectEvents(name, rig, expect);
+    snprintf(name, sizeof(name), "%s: macrosRun counts both runs", label);
+    check(rig.engine.stats().macrosRun == 2, name);
+}
+
+/**
+ * 連發: 按下的瞬間輸出按下，第 k 次切換在 press + k * half 之後的第一個 tick，放開立即停止
+ * @param hz 連發頻率 (與 compileMappingProfile 相同，半週期 = 500000 / hz)
+ */
+static void testTurbo(uint32_t hz, uint32_t jitterUs) {
+    char label[48];
+    snprintf(label, sizeof(label), "turbo %u Hz", hz);
+    printf("%s\n", label);
+    uint32_t half = 500000UL / hz;
+    Rig rig(0, jitterUs);
+    rig.turbo[NS_A] = half;
+    uint32_t press = 5000 + 523;
+    uint32_t release = press + 1000000 + 250;
+    rig.input(WII_A, 1 << NS_A, press);
+    rig.runUntil(release);
+    rig.input(0, 0, release);
+    rig.runUntil(release + 200000);
+
+    std::vector<OutputEvent> expect;
+    expect.push_back({ press, 1 << NS_A, HAT_CENTERED });
+    for (uint32_t k = 1;; k++) {
+        uint32_t at = rig.firstTickAtOrAfter(press + k * half);
+        if (at == 0 || (int32_t)(at - release) >= 0) {
+            break;
+        }
+        expect.push_back({ at, (uint16_t)((k & 1) ? 0 : (1 << NS_A)), HAT_CENTERED });
+    }
+    // 放開時若正好在「按下」的半週期，輸出立即變成放開
+    if (expect.back().buttons != 0) {
+        expect.push_back({ release, 0, HAT_CENTERED });
+    }
+    char name[128];
+    snprintf(name, sizeof(name), "%s: every toggle on the first tick after press + k * %u us", label, half);
+    expectEvents(name, rig, expect);
+    snprintf(name, sizeof(name), "%s: idle after release", label);
+    check(!rig.engine.active() && rig.engine.output().buttons == 0, name);
+}
+
+int main(int argc, char** argv) {
+    uint32_t jitterUs = TICK_JITTER_US;
+    uint32_t seed = 1;
+    for (int i = 1; i < argc; i++) {
+        if (strcmp(argv[i], "--jitter-us") == 0 && i + 1 < argc) {
+            jitterUs = (uint32_t)atoi(argv[++i]);
+        } else if (strcmp(argv[i], "--seed") == 0 && i + 1 < argc) {
+            seed = (uint32_t)atoi(argv[++i]);
+        } else {
+            fprintf(stderr, "usage: %s [--jitter-us N] [--seed N]\n", argv[0]);
+            return 2;
+        }
+    }
+    if (seed == 0 || jitterUs >= MACRO_TICK_US) {
+        fprintf(stderr, "seed must be != 0, jitter-us < %u\n", MACRO_TICK_US);
+        return 2;
+    }
+    rngState = seed;
+
+    testPairMacro("macro, exact ticks", 1000000, 0);
+    testPairMacro("macro, jittered ticks", 1000000, jitterUs);
+    testPairMacro("macro, across micros() wrap", 0xFFFFFFFFUL - 150000, jitterUs);
+    testTurbo(10, 0);
+    testTurbo(TURBO_MAX_HZ, 0);
+    testTurbo(TURBO_MAX_HZ, jitterUs);
+
+    return checkSummary();
+}
@@ -0,0 +1,196 @@
+// 檔案: motionbench.cpp
+// 作用: 在 Linux 上量測體感傾斜濾波 (SwitchPro_i2c/src/MotionTilt.h) 的正確性與每個回報的耗時
+//
+// 以合成的 100 Hz Wiimote 加速度串流 (靜止、傾斜、甩動，含 ±1 格雜訊) 驅動與韌體相同的程式碼，
+// 確認傾斜到滿刻度角度時輸出最大值、甩動時輸出不亂跳，
+// 再量測主機上每個樣本 (input + 一個 USB frame 的 tick) 的耗時，只用來比較修改前後。
+//
+// 編譯 (在專案根目錄):
+//   g++ -std=c++17 -O2 -Icommon/WiimoteLink -ISwitchPro_i2c/src -Itools/common
+//       tools/motionbench/motionbench.cpp common/WiimoteLink/WiimoteData.cpp -o motionbench
+//
+// 用法:
+//   ./motionbench                    預設 100 Hz
+//   ./motionbench --rate 200 --iterations 2000000
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <math.h>
+
+#include "WiimoteData.h"
+#include "MotionTilt.h"        // SwitchPro_i2c/src
+#include "ToolCheck.h"         // tools/common
+
+#define BENCH_RATE_HZ          100
+#define BENCH_ITERATIONS       1000000
+#define BENCH_RANGE_DEG        45
+#define BENCH_DEADZONE_DEG     5
+#define BENCH_SHAKE_MAX_DEV    24        // 甩動時輸出離中心的容許量 (0~255 刻度)
+
+static const double PI = 3.14159265358979323846;
+
+// 以預設校正值把加速度 (g) 換成 S1 送出的 8 位元讀數
+static uint8_t rawAxis(double g, int noise) {
+    double counts = (WIIMOTE_ACCEL_ZERO_DEFAULT + g * (WIIMOTE_ACCEL_GRAVITY_DEFAULT - WIIMOTE_ACCEL_ZERO_DEFAULT)) / 4.0;
+    int v = (int)lround(counts) + noise;
+    return (uint8_t)(v < 0 ? 0 : v > 255 ? 255 : v);
+}
+
+static int noise() {
+    return rand() % 3 - 1;
+}
+
+struct Stream {
+    MotionTilt tilt;
+    MotionResponse response;
+    uint32_t t;
+    uint32_t periodUs;
+    bool quiet;   // 不加雜訊 (放在桌上時讀數通常不變)
+
+    explicit Stream(uint32_t rateHz) : t(0), periodUs(1000000 / rateHz), quiet(false) {
+        motionResponseBuild(response, true, BENCH_RANGE_DEG, BENCH_DEADZONE_DEG, 0);
+    }
+
+    // 送出一個樣本，中間每 1 ms 推進一次 (與 S3 的 USB frame 計時器相同)
+    void sample(double gx, double gy, double gz) {
+        int nx = quiet ? 0 : noise();
+        int ny = quiet ? 0 : noise();
+        int nz = quiet ? 0 : noise();
+        tilt.input(rawAxis(gx, nx), rawAxis(gy, ny), rawAxis(gz, nz), response, t);
+        for (uint32_t dt = 1000; dt < periodUs; dt += 1000) {
+            tilt.tick(response, t + dt);
+        }
+        t += periodUs;
+    }
+
+    // 直握往右傾 deg 度 (+X 讀數變大)，保持 seconds 秒
+    void holdRoll(double deg, double seconds, uint32_t rateHz) {
+        uint32_t n = (uint32_t)(seconds * rateHz);
+        for (uint32_t i = 0; i < n; i++) {
+            sample(sin(deg * PI / 180.0), 0.0, cos(deg * PI / 180.0));
+        }
+    }
+};
+
+// 以公式計算的期望輸出 (往右為正，0~255)
+static int expectedX(double deg) {
+    double v = (sin(deg * PI / 180.0) - sin(BENCH_DEADZONE_DEG * PI / 180.0)) /
+               (sin(BENCH_RANGE_DEG * PI / 180.0) - sin(BENCH_DEADZONE_DEG * PI / 180.0));
+    if (v < 0) v = 0;
+    if (v > 1) v = 1;
+    return 128 + (int)lround(v * 127);
+}
+
+static void runCorrectness(uint32_t rateHz) {
+    Stream s(rateHz);
+    char what[64];
+
+    printf("correctness (%u Hz, range %d deg, deadzone %d deg):\n", rateHz, BENCH_RANGE_DEG, BENCH_DEADZONE_DEG);
+    s.holdRoll(0, 1.0, rateHz);
+    check(s.tilt.x() == 128 && s.tilt.y() == 128, "flat -> center");
+    printf("    x=%u y=%u\n", s.tilt.x(), s.tilt.y());
+
+    // 8 位元讀數一格約 1/26 g，滿刻度角度上可能差一格 (約 8 個刻度)
+    s.holdRoll(BENCH_RANGE_DEG, 1.0, rateHz);
+    check(s.tilt.x() >= 247 && s.tilt.y() == 128, "roll 45 deg -> >= 247");
+    printf("    x=%u y=%u\n", s.tilt.x(), s.tilt.y());
+
+    s.holdRoll(BENCH_RANGE_DEG + 5, 1.0, rateHz);
+    check(s.tilt.x() == 255 && s.tilt.y() == 128, "roll 50 deg -> full right");
+    printf("    x=%u y=%u\n", s.tilt.x(), s.tilt.y());
+
+    s.holdRoll(20, 1.0, rateHz);
+    int want = expectedX(20);
+    snprintf(what, sizeof(what), "roll 20 deg -> %d (+-12)", want);
+    check(abs((int)s.tilt.x() - want) <= 12, what);
+    printf("    x=%u\n", s.tilt.x());
+
+    // 從平放快速傾斜: 100 ms 內要追上一半以上
+    s.holdRoll(0, 1.0, rateHz);
+    s.holdRoll(30, 0.1, rateHz);
+    int half = (128 + expectedX(30)) / 2;
+    snprintf(what, sizeof(what), "roll 0 -> 30 deg, 100 ms later >= %d", half);
+    check(s.tilt.x() >= half, what);
+    printf("    x=%u\n", s.tilt.x());
+
+    // 平放甩動: X 軸 ±2g、8 Hz，持續 1 秒
+    s.holdRoll(0, 1.0, rateHz);
+    int maxDev = 0;
+    uint32_t steadyCount = 0;
+    uint32_t n = rateHz;
+    for (uint32_t i = 0; i < n; i++) {
+        double shake = 2.0 * sin(2 * PI * 8.0 * i / rateHz);
+        s.sample(shake, 0.0, 1.0);
+        int dev = abs((int)s.tilt.x() - 128);
+        if (dev > maxDev) maxDev = dev;
+        if (s.tilt.steady()) steadyCount++;
+    }
+    snprintf(what, sizeof(what), "shake +-2g 8 Hz -> deviation <= %d", BENCH_SHAKE_MAX_DEV);
+    check(maxDev <= BENCH_SHAKE_MAX_DEV, what);
+    printf("    max deviation=%d, steady samples=%u/%u\n", maxDev, steadyCount, n);
+
+    // 停止甩動後回到中心，且讀數不變時濾波收斂，不再需要 1 ms 計時器
+    s.quiet = true;
+    s.holdRoll(0, 2.0, rateHz);
+    check(s.tilt.x() == 128 && s.tilt.y() == 128, "after shake -> center");
+    check(!s.tilt.active(), "settled -> frame tick idle");
+    printf("    x=%u y=%u\n", s.tilt.x(), s.tilt.y());
+}
+
+static void runTiming(uint32_t rateHz, uint32_t iterations) {
+    // 預先產生樣本，量測時只跑濾波本身
+    const uint32_t tableSize = 4096;
+    static uint8_t table[4096][3];
+    for (uint32_t i = 0; i < tableSize; i++) {
+        double a = 2 * PI * i / tableSize;
+        double shake = (i / 512) % 2 ? 1.5 * sin(a * 64) : 0.0;
+        table[i][0] = rawAxis(sin(a) * 0.8 + shake, noise());
+        table[i][1] = rawAxis(cos(a * 3) * 0.5, noise());
+        table[i][2] = rawAxis(0.6, noise());
+    }
+
+    MotionTilt tilt;
+    MotionResponse response;
+    motionResponseBuild(response, true, BENCH_RANGE_DEG, BENCH_DEADZONE_DEG, 0);
+    uint32_t periodUs = 1000000 / rateHz;
+    uint32_t t = 0;
+    volatile uint32_t sink = 0;
+
+    uint64_t start = nowNs();
+    for (uint32_t i = 0; i < iterations; i++) {
+        const uint8_t* raw = table[i % tableSize];
+        sink += tilt.input(raw[0], raw[1], raw[2], response, t);
+        sink += tilt.tick(response, t + 1000);
+        sink += tilt.x() + tilt.y();
+        t += periodUs;
+    }
+    uint64_t elapsed = nowNs() - start;
+
+    printf("timing (%u samples): %.1f ns per sample (input + tick) on host\n", iterations,
+           (double)elapsed / iterations);
+}
+
+int main(int argc, char** argv) {
+    uint32_t rateHz = BENCH_RATE_HZ;
+    uint32_t iterations = BENCH_ITERATIONS;
+    for (int i = 1; i < argc; i++) {
+        if (strcmp(argv[i], "--rate") == 0 && i + 1 < argc) {
+            rateHz = (uint32_t)atoi(argv[++i]);
+        } else if (strcmp(argv[i], "--iterations") == 0 && i + 1 < argc) {
+            iterations = (uint32_t)atoi(argv[++i]);
+        } else {
+            fprintf(stderr, "usage: %s [--rate HZ] [--iterations N]\n", argv[0]);
+            return 2;
+        }
+    }
+    if (rateHz < 10 || rateHz > 1000 || iterations == 0) {
+        fprintf(stderr, "rate must be 10..1000 Hz\n");
+        return 2;
+    }
+    srand(1);
+
+    runCorrectness(rateHz);
+    runTiming(rateHz, iterations);
+    return checkSummary();
+}
@@ -0,0 +1,328 @@
+// 檔案: nunchukstick.cpp
+// 作用: 以合成的 Nunchuk 原始值檢查搖桿校正與死區處理 (SwitchPro_i2c/src/NunchukStick.h) 並量測主機上每個報告的耗時
+//
+// 依照 S3 的呼叫方式: 插上時呼叫 onConnect()，每個報告呼叫 update()。檢查:
+//   - 插上後由靜止的報告估計中心，推著搖桿或中心太偏時沿用原本的中心
+//   - 轉一圈後學到上下限，推到底輸出 0 / 255 (Y 軸反向)
+//   - 單一雜訊值不會撐大範圍，連續兩個報告超出範圍才擴大 (取較保守的一個)
+//   - 圓形死區 (不是方形)、軸向死區、反死區、外圈範圍
+//   - 斜向推到底落在半徑 128 的圓上
+//   - 各種設定下沿著每個方向推出去輸出單調變化，正負方向對稱
+//   - 不合理的校正值 / 設定會被修正
+//
+// 編譯 (在專案根目錄):
+//   g++ -std=c++17 -O2 -ISwitchPro_i2c/src -Itools/common tools/nunchukstick/nunchukstick.cpp -o nunchukstick
+//
+// 用法:
+//   ./nunchukstick
+//   ./nunchukstick --iterations 20000000
+
+#include <math.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+
+#include "NunchukStick.h"   // SwitchPro_i2c/src
+#include "ToolCheck.h"   // tools/common
+
+#define BENCH_ITERATIONS  10000000
+#define CENTER_X          131         // 合成 Nunchuk 的靜止位置與半徑 (原始值)
+#define CENTER_Y          125
+#define EXTENT            100
+
+static uint32_t rngState = 1;
+
+static uint32_t rnd() {
+    rngState ^= rngState << 13;
+    rngState ^= rngState >> 17;
+    rngState ^= rngState << 5;
+    return rngState;
+}
+
+static double radius(const NunchukStick& s) {
+    double dx = (double)s.x() - 128;
+    double dy = (double)s.y() - 128;
+    return sqrt(dx * dx + dy * dy);
+}
+
+// 送一個相對於合成中心的位置 (Nunchuk 往上為 +y)
+static void push(NunchukStick& s, int dx, int dy) {
+    int x = CENTER_X + dx;
+    int y = CENTER_Y + dy;
+    s.update((uint8_t)(x < 0 ? 0 : (x > 255 ? 255 : x)), (uint8_t)(y < 0 ? 0 : (y > 255 ? 255 : y)));
+}
+
+/**
+ * 插上、靜止 8 個報告估計中心，再轉兩圈學到上下限
+ * @param settings 死區等設定
+ */
+static void calibrated(NunchukStick& s, const NunchukSettings& settings) {
+    NunchukCalibration cal;
+    nunchukCalibrationDefault(cal);
+    s.begin(cal, settings);
+    s.onConnect();
+    for (int i = 0; i < NUNCHUK_CENTER_SAMPLES; i++) {
+        push(s, 0, 0);
+    }
+    for (int a = 0; a < 720; a++) {
+        double t = a * M_PI / 180;
+        push(s, (int)lround(EXTENT * cos(t)), (int)lround(EXTENT * sin(t)));
+    }
+    push(s, 0, 0);
+}
+
+static void testCenter() {
+    printf("center capture\n");
+    NunchukCalibration cal;
+    NunchukSettings settings;
+    nunchukCalibrationDefault(cal);
+    nunchukSettingsDefault(settings);
+
+    NunchukStick s;
+    s.begin(cal, settings);
+    s.update(128, 128);
+    check(s.x() == 128 && s.y() == 128 && !s.capturing(), "default calibration: raw 128 is center");
+
+    s.onConnect();
+    // 靜止時的小雜訊 (±1) 仍算靜止
+    for (int i = 0; i < NUNCHUK_CENTER_SAMPLES; i++) {
+        push(s, (i & 1) ? 1 : -1, (i & 2) ? 1 : -1);
+    }
+    char detail[64];
+    snprintf(detail, sizeof(detail), "(%u, %u)", s.calibration().centerX, s.calibration().centerY);
+    check(!s.capturing() && s.calibration().centerX == CENTER_X && s.calibration().centerY == CENTER_Y && s.takeDirty(),
+          "8 still reports set the center", detail);
+    push(s, 0, 0);
+    check(s.x() == 128 && s.y() == 128, "rest position outputs 128/128 after capture");
+
+    NunchukStick held;
+    held.begin(cal, settings);
+    held.onConnect();
+    for (int i = 0; i < NUNCHUK_CENTER_SAMPLES; i++) {
+        held.update((uint8_t)(160 + i), 128);
+    }
+    check(held.calibration().centerX == 128 && !held.capturing(), "stick held at connect keeps the old center");
+
+    NunchukStick drift;
+    drift.begin(cal, settings);
+    drift.onConnect();
+    for (int i = 0; i < NUNCHUK_CENTER_SAMPLES; i++) {
+        drift.update(128 + NUNCHUK_CENTER_MAX_DRIFT + 10, 128);
+    }
+    check(drift.calibration().centerX == 128, "implausible center is rejected");
+}
+
+static void testExtents() {
+    printf("extents\n");
+    NunchukSettings settings;
+    nunchukSettingsDefault(settings);
+    NunchukStick s;
+    calibrated(s, settings);
+    const NunchukCalibration& c = s.calibration();
+    char detail[96];
+    snprintf(detail, sizeof(detail), "(x %u..%u, y %u..%u)", c.minX, c.maxX, c.minY, c.maxY);
+    check(c.minX == CENTER_X - EXTENT && c.maxX == CENTER_X + EXTENT && c.minY == CENTER_Y - EXTENT &&
+          c.maxY == CENTER_Y + EXTENT, "two turns learn the full range", detail);
+
+    bool ok = true;
+    push(s, EXTENT, 0);
+    ok = ok && s.x() == 255 && s.y() == 128;
+    push(s, -EXTENT, 0);
+    ok = ok && s.x() == 0 && s.y() == 128;
+    push(s, 0, EXTENT);
+    ok = ok && s.x() == 128 && s.y() == 0;
+    push(s, 0, -EXTENT);
+    ok = ok && s.x() == 128 && s.y() == 255;
+    check(ok, "full tilt reaches 0/255, Y inverted");
+
+    // 一個雜訊值 (0) 夾在正常值之間: 範圍不變
+    NunchukStick g;
+    calibrated(g, settings);
+    g.takeDirty();
+    g.update(0, CENTER_Y);
+    push(g, 0, 0);
+    check(g.calibration().minX == CENTER_X - EXTENT && !g.takeDirty(), "single out-of-range report is ignored");
+
+    // 連續兩個: 擴大到較保守 (離中心較近) 的那個
+    g.update(20, CENTER_Y);
+    g.update(10, CENTER_Y);
+    snprintf(detail, sizeof(detail), "(minX %u)", g.calibration().minX);
+    check(g.calibration().minX == 20 && g.takeDirty(), "two consecutive reports expand to the nearer one", detail);
+}
+
+static void testDeadzones() {
+    printf("deadzones\n");
+    NunchukSettings settings;
+    nunchukSettingsDefault(settings);   // 徑向死區 8%、外圈 95%
+    NunchukStick s;
+    calibrated(s, settings);
+
+    bool inside = true;
+    for (int dx = -8; dx <= 8; dx++) {
+        for (int dy = -8; dy <= 8; dy++) {
+            if (dx * dx + dy * dy <= 64) {
+                push(s, dx, dy);
+                inside = inside && s.x() == 128 && s.y() == 128;
+            }
+        }
+    }
+    check(inside, "everything inside the 8% circle outputs center");
+    push(s, 7, 7);   // 9.9%: 每一軸都在 8% 內，方形死區會吃掉，圓形不會
+    check(s.x() != 128 && s.y() != 128, "radial deadzone is round, not square");
+    push(s, 9, 0);
+    uint8_t plain = s.x();
+    check(plain > 128 && plain <= 131, "just outside the deadzone starts near zero");
+
+    push(s, 95, 0);
+    uint8_t atOuter = s.x();
+    push(s, 90, 0);
+    char detail[64];
+    snprintf(detail, sizeof(detail), "(95%% -> %u, 90%% -> %u)", atOuter, s.x());
+    check(atOuter == 255 && s.x() < 255, "outer range 95% already outputs full", detail);
+
+    settings.antiDeadzone = 20;
+    s.setSettings(settings);
+    push(s, 9, 0);
+    snprintf(detail, sizeof(detail), "(%u)", s.x());
+    // 反死區 20%: 約 0.2 * 127 = 25
+    check(s.x() >= 128 + 25 && s.x() <= 128 + 30, "anti-deadzone 20% jumps to about 20%", detail);
+    push(s, 5, 0);
+    check(s.x() == 128, "anti-deadzone keeps the deadzone itself at center");
+
+    settings.antiDeadzone = 0;
+    settings.axialDeadzone = 10;
+    s.setSettings(settings);
+    push(s, 60, 9);
+    uint8_t yInside = s.y();
+    push(s, 60, 15);
+    snprintf(detail, sizeof(detail), "(9%% -> %u, 15%% -> %u)", yInside, s.y());
+    check(yInside == 128 && s.y() < 128, "axial deadzone 10% zeroes the minor axis only", detail);
+}
+
+static void testGate() {
+    printf("circular gate\n");
+    NunchukSettings settings;
+    nunchukSettingsDefault(settings);
+    NunchukStick s;
+    calibrated(s, settings);
+    bool ok = true;
+    char detail[64] = "";
+    static const int corners[4][2] = { {1, 1}, {1, -1}, {-1, 1}, {-1, -1} };
+    for (int i = 0; i < 4; i++) {
+        push(s, corners[i][0] * EXTENT, corners[i][1] * EXTENT);
+        double r = radius(s);
+        // 0~255 的中心是 128: 正向最多 127、負向最多 128
+        if (r < 126.5 || r > 129.0) {
+            ok = false;
+            snprintf(detail, sizeof(detail), "(%d,%d radius %.1f)", corners[i][0], corners[i][1], r);
+        }
+    }
+    check(ok, "square corners are clipped to radius 128", detail);
+}
+
+static void testMonotonic() {
+    printf("monotonic\n");
+    static const NunchukSettings variants[] = {
+        { 0, 8, 0, 95 },
+        { 0, 0, 0, 100 },
+        { 10, 8, 20, 95 },
+        { 25, 30, 50, 60 },
+    };
+    static const int rays[8][2] = { {1, 0}, {-1, 0}, {0, 1}, {0, -1}, {1, 1}, {1, -1}, {-1, 1}, {-1, -1} };
+    bool monotonic = true;
+    bool symmetric = true;
+    char detail[96] = "";
+    for (size_t v = 0; v < sizeof(variants) / sizeof(variants[0]); v++) {
+        NunchukStick s;
+        calibrated(s, variants[v]);
+        for (int k = 0; k < 8; k++) {
+            double last = 0;
+            for (int d = 0; d <= EXTENT + 20; d++) {
+                push(s, rays[k][0] * d, rays[k][1] * d);
+                double r = radius(s);
+                if (r + 1.0 < last) {
+                    monotonic = false;
+                    snprintf(detail, sizeof(detail), "(variant %zu ray %d,%d at %d: %.1f < %.1f)", v, rays[k][0],
+                             rays[k][1], d, r, last);
+                }
+                last = r > last ? r : last;
+            }
+        }
+        for (int d = 0; d <= EXTENT; d++) {
+            push(s, d, 0);
+            int pos = s.x() - 128;
+            push(s, -d, 0);
+            int neg = 128 - s.x();
+            // 正向最多 127、負向最多 128，允許 1 的差
+            symmetric = symmetric && abs(pos - neg) <= 1;
+        }
+    }
+    check(monotonic, "magnitude never decreases along any ray", detail);
+    check(symmetric, "+x and -x are mirror images");
+}
+
+static void testSanitize() {
+    printf("sanitize\n");
+    NunchukCalibration cal = { 250, 128, 0, 255, 0, 255 };
+    NunchukSettings settings = { 90, 60, 95, 20 };
+    nunchukSanitize(cal, settings);
+    NunchukCalibration def;
+    nunchukCalibrationDefault(def);
+    check(memcmp(&cal, &def, sizeof(cal)) == 0, "off-center calibration falls back to default");
+    check(settings.axialDeadzone == 50 && settings.antiDeadzone == 90 && settings.outerRange == 95 &&
+          settings.radialDeadzone == 50, "settings are clamped");
+    NunchukSettings overlap = { 0, 50, 0, 50 };
+    nunchukSanitize(def, overlap);
+    check(overlap.radialDeadzone == 0, "deadzone at or beyond the outer range is dropped");
+}
+
+static double benchmark(uint32_t iterations) {
+    NunchukSettings settings = { 10, 8, 20, 95 };
+    NunchukStick s;
+    calibrated(s, settings);
+    static uint8_t samples[4096][2];
+    for (int i = 0; i < 4096; i++) {
+        // 落在校正範圍內，避免一直擴大範圍而重建表
+        samples[i][0] = (uint8_t)(CENTER_X - EXTENT + rnd() % (2 * EXTENT + 1));
+        samples[i][1] = (uint8_t)(CENTER_Y - EXTENT + rnd() % (2 * EXTENT + 1));
+    }
+    uint32_t sink = 0;
+    uint64_t start = nowNs();
+    for (uint32_t i = 0; i < iterations; i++) {
+        const uint8_t* p = samples[i & 4095];
+        s.update(p[0], p[1]);
+        sink += s.x() + s.y();
+    }
+    uint64_t elapsed = nowNs() - start;
+    if (sink == 0xDEADBEEF) {
+        printf(" ");
+    }
+    return (double)elapsed / iterations;
+}
+
+int main(int argc, char** argv) {
+    uint32_t iterations = BENCH_ITERATIONS;
+    for (int i = 1; i < argc; i++) {
+        if (strcmp(argv[i], "--iterations") == 0 && i + 1 < argc) {
+            iterations = (uint32_t)atoi(argv[++i]);
+        } else {
+            fprintf(stderr, "usage: %s [--iterations N]\n", argv[0]);
+            return 2;
+        }
+    }
+    if (iterations == 0) {
+        fprintf(stderr, "iterations must be > 0\n");
+        return 2;
+    }
+
+    testCenter();
+    testExtents();
+    testDeadzones();
+    testGate();
+    testMonotonic();
+    testSanitize();
+
+    printf("update: %.1f ns/report on host\n", benchmark(iterations));
+
+    return checkSummary();
+}
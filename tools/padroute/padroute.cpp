@@ -0,0 +1,532 @@
+// 檔案: padroute.cpp
+// 作用: 在 Linux 上檢查多個 NSGamepad 共用一個 HID 介面時的報告描述元與報告路由
+//       (SwitchPro_i2c/lib/switch_ESP32/NSGamepadRouter.cpp)，並量測主機上每次 update + service 的耗時
+//
+// 描述元: 逐項解析 HID 描述元，確認單一手把維持 HORIPAD 相容 (沒有 report ID)，
+//         多個手把各自是一個 Game Pad 應用集合、report ID 不重複、每個報告 8 位元組。
+// 路由: 模擬主機每 1ms 輪詢一次 IN 端點，各手把以自己的節奏改變狀態，確認:
+//   - 每個報告帶正確的 report ID 與該手把的內容，沒變化的手把不送 (keepalive 除外)
+//   - 一個手把每次輪詢都有變化時，其他手把的變化最多晚 (手把數) 個 frame
+//   - 所有手把同時連打時，每個手把的每次點擊都有按下與放開的報告，順序不變
+//   - 全部忙碌時輪流使用端點
+//   - 端點忙碌時只動搖桿的報告合併，按鈕變化各自排隊，佇列滿時丟掉的變化有計數
+//   - 排隊報告的 tag 在真正送出時交回 (合併時保留最舊的)，service() 只在送出時回傳 true
+//
+// 編譯 (在專案根目錄):
+//   g++ -std=c++17 -O2 -ISwitchPro_i2c/lib/switch_ESP32 -Itools/common tools/padroute/padroute.cpp
+//       SwitchPro_i2c/lib/switch_ESP32/NSGamepadRouter.cpp -o padroute
+//
+// 用法:
+//   ./padroute                          預設 4 個手把
+//   ./padroute --pads 2 --iterations 500000
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+
+#include "NSGamepadRouter.h"   // SwitchPro_i2c/lib/switch_ESP32
+#include "ToolCheck.h"         // tools/common
+
+#define SIM_FRAME_US           1000      // 主機輪詢間隔
+#define SIM_LOOP_US            250       // 輸入任務呼叫 loop() 的間隔
+#define SIM_SECONDS            5
+#define SIM_LOG_MAX            40000
+#define BENCH_ITERATIONS       2000000
+
+// --- HID 描述元解析 (只處理這個描述元會用到的項目) ---
+struct DescriptorInfo {
+    bool ok;                 // 項目格式正確、集合配對
+    uint8_t collections;     // 最外層的 Game Pad 應用集合數
+    uint8_t ids[8];          // 各集合的 report ID (0 = 沒有)
+    uint16_t inputBits[8];   // 各集合的 Input 位元數
+    bool duplicateId;
+};
+
+static DescriptorInfo parseDescriptor(const uint8_t* d, size_t len) {
+    DescriptorInfo info;
+    memset(&info, 0, sizeof(info));
+    info.ok = true;
+    uint32_t reportSize = 0, reportCount = 0, usagePage = 0, usage = 0;
+    int depth = 0;
+    int current = -1;
+    size_t i = 0;
+    while (i < len) {
+        uint8_t prefix = d[i];
+        uint8_t size = prefix & 0x03;
+        if (size == 3) size = 4;
+        if (i + 1 + size > len) {
+            info.ok = false;
+            break;
+        }
+        uint32_t value = 0;
+        for (uint8_t b = 0; b < size; b++) {
+            value |= (uint32_t)d[i + 1 + b] << (8 * b);
+        }
+        switch (prefix & 0xFC) {
+            case 0x04: usagePage = value; break;                 // Usage Page
+            case 0x08: usage = value; break;                     // Usage
+            case 0x74: reportSize = value; break;                // Report Size
+            case 0x94: reportCount = value; break;               // Report Count
+            case 0x84:                                           // Report ID
+                if (current < 0 || value == 0 || info.ids[current] != 0) {
+                    info.ok = false;
+                } else {
+                    for (int c = 0; c < current; c++) {
+                        if (info.ids[c] == value) info.duplicateId = true;
+                    }
+                    info.ids[current] = (uint8_t)value;
+                }
+                break;
+            case 0xA0:                                           // Collection
+                if (depth == 0) {
+                    if (value != 0x01 || usagePage != 0x01 || usage != 0x05 || info.collections == 8) {
+                        info.ok = false;
+                    } else {
+                        current = info.collections++;
+                    }
+                }
+                depth++;
+                break;
+            case 0xC0:                                           // End Collection
+                if (--depth < 0) info.ok = false;
+                break;
+            case 0x80:                                           // Input
+                if (current < 0 || depth == 0) {
+                    info.ok = false;
+                } else {
+                    info.inputBits[current] += (uint16_t)(reportSize * reportCount);
+                }
+                break;
+            default:
+                break;
+        }
+        i += 1 + size;
+    }
+    if (depth != 0) info.ok = false;
+    return info;
+}
+
+static void testDescriptors(uint8_t pads) {
+    printf("descriptors\n");
+    char detail[96];
+    uint8_t buf[512];
+    uint16_t single = nsGamepadReportDescriptor(0, buf);
+    check(single == nsGamepadReportDescriptor(0, NULL), "size query matches");
+    DescriptorInfo info = parseDescriptor(buf, single);
+    snprintf(detail, sizeof(detail), "(%u bytes, %u input bits)", single, info.inputBits[0]);
+    check(info.ok && info.collections == 1 && info.ids[0] == 0 &&
+          info.inputBits[0] == 8 * sizeof(HID_NSGamepadReport_Data_t),
+          "single pad: one Game Pad collection without report ID", detail);
+
+    // 與 USBHID 相同: 依註冊順序把各手把的描述元接在一起
+    size_t len = 0;
+    for (uint8_t p = 0; p < pads; p++) {
+        uint16_t n = nsGamepadReportDescriptor(p + 1, buf + len);
+        check(n == single + 2, "report ID adds one item");
+        len += n;
+    }
+    info = parseDescriptor(buf, len);
+    bool idsOk = true;
+    bool bitsOk = true;
+    for (uint8_t p = 0; p < info.collections; p++) {
+        idsOk = idsOk && info.ids[p] == p + 1;
+        bitsOk = bitsOk && info.inputBits[p] == 8 * sizeof(HID_NSGamepadReport_Data_t);
+    }
+    snprintf(detail, sizeof(detail), "(%zu bytes, %u collections)", len, info.collections);
+    check(info.ok && info.collections == pads && idsOk && bitsOk && !info.duplicateId,
+          "combined: one collection per pad, IDs 1..N, 8-byte reports", detail);
+}
+
+static void testRegistration() {
+    printf("registration\n");
+    NSGamepadRouter r;
+    check(r.addPad(0) == 0 && r.addPad(0) == NSGAMEPAD_NO_PAD, "only one pad without report ID");
+    r.clear();
+    check(r.addPad(1) == 0 && r.addPad(0) == NSGAMEPAD_NO_PAD, "report ID 0 cannot join other pads");
+    check(r.addPad(1) == NSGAMEPAD_NO_PAD, "duplicate report ID refused");
+    check(r.addPad(2) == 1 && r.addPad(3) == 2 && r.addPad(4) == 3 && r.addPad(5) == NSGAMEPAD_NO_PAD,
+          "at most NSGAMEPAD_MAX_PADS pads");
+    check(r.padCount() == NSGAMEPAD_MAX_PADS && r.reportId(3) == 4, "pad index keeps registration order");
+}
+
+// --- 路由模擬 ---
+struct Sent {
+    uint32_t us;
+    uint8_t id;
+    HID_NSGamepadReport_Data_t report;
+};
+
+struct Sim {
+    NSGamepadRouter router;
+    uint8_t pads;
+    HID_NSGamepadReport_Data_t state[NSGAMEPAD_MAX_PADS];
+    uint32_t generation[NSGAMEPAD_MAX_PADS];
+    bool busy;
+    uint32_t now;
+    uint32_t nextPollUs;
+    Sent* log;
+    size_t logCount;
+
+    Sim(uint8_t count, bool reportIds) : pads(count), busy(false), now(0), nextPollUs(SIM_FRAME_US), logCount(0) {
+        log = new Sent[SIM_LOG_MAX];
+        for (uint8_t p = 0; p < pads; p++) {
+            router.addPad(reportIds ? p + 1 : 0);
+            memset(&state[p], 0, sizeof(state[p]));
+            state[p].dPad = 0x0F;
+            state[p].leftXAxis = state[p].leftYAxis = state[p].rightXAxis = 0x80;
+            state[p].rightYAxis = (uint8_t)(p * 10);     // 每個手把的內容帶自己的記號
+            generation[p] = 1;
+        }
+    }
+    ~Sim() { delete[] log; }
+
+    static bool submit(uint8_t id, const HID_NSGamepadReport_Data_t& report, uint32_t tag, void* context) {
+        Sim* s = (Sim*)context;
+        s->busy = true;
+        if (s->logCount < SIM_LOG_MAX) {
+            s->log[s->logCount].us = s->now;
+            s->log[s->logCount].id = id;
+            s->log[s->logCount].report = report;
+            s->logCount++;
+        }
+        return true;
+    }
+
+    void set(uint8_t p, uint16_t buttons, uint8_t x) {
+        if (state[p].buttons != buttons || state[p].leftXAxis != x) {
+            state[p].buttons = buttons;
+            state[p].leftXAxis = x;
+            generation[p]++;
+        }
+    }
+
+    // 與韌體相同: 每個手把的 loop() 更新自己的佇列，再由 task() 服務共用端點
+    void loop() {
+        for (uint8_t p = 0; p < pads; p++) {
+            router.update(p, state[p], generation[p], busy);
+        }
+        router.service(!busy, now / 1000, submit, this);
+    }
+
+    // 推進時間: 主機每 SIM_FRAME_US 取走端點中的報告
+    void advance(uint32_t us) {
+        uint32_t end = now + us;
+        while (now < end) {
+            now += SIM_LOOP_US;
+            while (now >= nextPollUs) {
+                busy = false;
+                nextPollUs += SIM_FRAME_US;
+            }
+            loop();
+        }
+    }
+
+    uint8_t padOf(uint8_t id) const {
+        for (uint8_t p = 0; p < pads; p++) {
+            if (router.reportId(p) == id) return p;
+        }
+        return NSGAMEPAD_NO_PAD;
+    }
+
+    // 每個報告都屬於一個手把，且帶著該手把的記號
+    bool routed() const {
+        for (size_t i = 0; i < logCount; i++) {
+            uint8_t p = padOf(log[i].id);
+            if (p == NSGAMEPAD_NO_PAD || log[i].report.rightYAxis != p * 10) return false;
+        }
+        return true;
+    }
+};
+
+static void testIsolation(uint8_t pads) {
+    printf("busy pad vs. idle pads (%u pads)\n", pads);
+    char detail[128];
+    Sim s(pads, pads > 1);
+    s.advance(200000);
+    size_t start = s.logCount;
+    uint32_t worstUs = 0;
+    uint32_t presses = 0;
+    uint32_t missed = 0;
+    // 手把 0 每次 loop() 都改變搖桿；其他手把每 37ms 輪流按一次按鈕
+    for (uint32_t t = 0; t < SIM_SECONDS * 1000000; t += SIM_LOOP_US) {
+        s.set(0, 0, (uint8_t)(t / SIM_LOOP_US));
+        if (pads > 1 && t % 37000 == 0) {
+            uint8_t p = 1 + (uint8_t)((t / 37000) % (pads - 1));
+            uint16_t b = (uint16_t)(s.state[p].buttons ^ 0x0004);
+            s.set(p, b, 0x80);
+            size_t before = s.logCount;
+            uint32_t changedUs = s.now;
+            uint32_t deliveredUs = 0;
+            for (uint32_t w = 0; w < 20000 && deliveredUs == 0; w += SIM_LOOP_US) {
+                s.set(0, 0, (uint8_t)((t + w) / SIM_LOOP_US));
+                s.advance(SIM_LOOP_US);
+                for (size_t i = before; i < s.logCount; i++) {
+                    if (s.padOf(s.log[i].id) == p && s.log[i].report.buttons == b) {
+                        deliveredUs = s.log[i].us;
+                        break;
+                    }
+                }
+            }
+            presses++;
+            if (deliveredUs == 0) {
+                missed++;
+            } else if (deliveredUs - changedUs > worstUs) {
+                worstUs = deliveredUs - changedUs;
+            }
+            continue;
+        }
+        s.advance(SIM_LOOP_US);
+    }
+    uint32_t perPad[NSGAMEPAD_MAX_PADS] = {0};
+    for (size_t i = start; i < s.logCount; i++) {
+        perPad[s.padOf(s.log[i].id)]++;
+    }
+    check(s.routed(), "every report carries its pad's ID and content");
+    if (pads > 1) {
+        snprintf(detail, sizeof(detail), "(%u changes, worst %u us, %u missed)", presses, worstUs, missed);
+        check(missed == 0 && worstUs <= (uint32_t)pads * SIM_FRAME_US, "idle pad's change waits at most one turn", detail);
+        uint32_t others = 0;
+        for (uint8_t p = 1; p < pads; p++) others += perPad[p];
+        snprintf(detail, sizeof(detail), "(%u reports for %u changes)", others, presses);
+        check(others == presses, "pads without changes stay quiet", detail);
+    }
+    snprintf(detail, sizeof(detail), "(%u reports in %u s)", perPad[0], SIM_SECONDS);
+    check(perPad[0] + (pads > 1 ? presses : 0) >= SIM_SECONDS * 1000 * 95 / 100, "busy pad still uses the free frames",
+          detail);
+}
+
+// 所有手把同時隨機連打: 每次點擊 (按下、放開各維持 1 ~ 3 個 loop) 都要有按下與放開的報告
+static void testTaps(uint8_t pads) {
+    printf("taps on all pads (%u pads)\n", pads);
+    char detail[128];
+    Sim s(pads, pads > 1);
+    s.advance(200000);
+    size_t start = s.logCount;
+    srand(3);
+    uint32_t taps[NSGAMEPAD_MAX_PADS] = {0};
+    uint32_t holdUntil[NSGAMEPAD_MAX_PADS] = {0};
+    for (uint32_t t = 0; t < SIM_SECONDS * 1000000; t += SIM_LOOP_US) {
+        for (uint8_t p = 0; p < pads; p++) {
+            if (t < holdUntil[p]) continue;
+            // 放開後至少等 12ms 才能再按 (約 40 次/秒以下的連打)
+            if (s.state[p].buttons) {
+                s.set(p, 0, 0x80);
+                holdUntil[p] = t + 12000 + (uint32_t)(rand() % 8) * SIM_LOOP_US;
+            } else {
+                s.set(p, 0x0004, 0x80);
+                taps[p]++;
+                holdUntil[p] = t + (1 + (uint32_t)(rand() % 3)) * SIM_LOOP_US;
+            }
+        }
+        s.advance(SIM_LOOP_US);
+    }
+    s.advance(20000);
+    bool ok = s.routed();
+    for (uint8_t p = 0; p < pads; p++) {
+        uint32_t presses = 0;
+        uint16_t prev = 0;
+        for (size_t i = start; i < s.logCount; i++) {
+            if (s.padOf(s.log[i].id) != p) continue;
+            uint16_t b = s.log[i].report.buttons;
+            if (b && !prev) presses++;
+            prev = b;
+        }
+        snprintf(detail, sizeof(detail), "(pad %u: %u taps, %u presses reported)", p, taps[p], presses);
+        check(presses == taps[p] && prev == 0, "every tap reaches the host", detail);
+    }
+    check(ok, "every report carries its pad's ID and content");
+}
+
+// 所有手把每次 loop() 都有變化: 端點輪流分配
+static void testFairness(uint8_t pads) {
+    printf("all pads busy (%u pads)\n", pads);
+    char detail[128];
+    Sim s(pads, pads > 1);
+    s.advance(200000);
+    size_t start = s.logCount;
+    for (uint32_t t = 0; t < SIM_SECONDS * 1000000; t += SIM_LOOP_US) {
+        for (uint8_t p = 0; p < pads; p++) {
+            s.set(p, 0, (uint8_t)(t / SIM_LOOP_US + p));
+        }
+        s.advance(SIM_LOOP_US);
+    }
+    uint32_t count[NSGAMEPAD_MAX_PADS] = {0};
+    uint32_t lastUs[NSGAMEPAD_MAX_PADS] = {0};
+    uint32_t maxGapUs = 0;
+    for (size_t i = start; i < s.logCount; i++) {
+        uint8_t p = s.padOf(s.log[i].id);
+        count[p]++;
+        if (lastUs[p] != 0 && s.log[i].us - lastUs[p] > maxGapUs) maxGapUs = s.log[i].us - lastUs[p];
+        lastUs[p] = s.log[i].us;
+    }
+    uint32_t lo = count[0], hi = count[0];
+    for (uint8_t p = 1; p < pads; p++) {
+        if (count[p] < lo) lo = count[p];
+        if (count[p] > hi) hi = count[p];
+    }
+    snprintf(detail, sizeof(detail), "(%u..%u reports per pad)", lo, hi);
+    check(hi - lo <= 1, "equal share of the endpoint", detail);
+    snprintf(detail, sizeof(detail), "(max gap %u us)", maxGapUs);
+    check(maxGapUs <= (uint32_t)pads * SIM_FRAME_US, "each pad sends every N frames", detail);
+    check(s.routed(), "every report carries its pad's ID and content");
+}
+
+// 端點一直忙碌時的佇列: 只動搖桿的報告合併，按鈕變化各佔一格，佇列滿時才丟掉並計數
+static void testQueue() {
+    printf("queue while the endpoint is busy\n");
+    char detail[96];
+    Sim s(1, false);
+    s.advance(200000);
+    s.busy = true;
+    s.nextPollUs = 0xFFFFFFFF;
+    size_t start = s.logCount;
+    NSGamepadRouter& r = s.router;
+    uint32_t gen = s.generation[0];
+    HID_NSGamepadReport_Data_t report = s.state[0];
+    bool kept = true;
+    // 只動搖桿: 與最後一格合併
+    for (uint8_t x = 0; x < 5; x++) {
+        report.leftXAxis = x;
+        kept = r.update(0, report, ++gen, true) && kept;
+    }
+    snprintf(detail, sizeof(detail), "(%u queued, %u coalesced)", r.pending(0) ? 1u : 0u, r.stats(0).coalesced);
+    check(kept && r.stats(0).coalesced == 4, "axis-only changes replace the last report", detail);
+    // 按下 / 放開交替: 每個變化各佔一格，直到佇列滿
+    uint16_t expected[NSGAMEPAD_QUEUE + 2];
+    uint32_t n = 0;
+    expected[n++] = 0;
+    for (uint32_t i = 1; i < NSGAMEPAD_QUEUE; i++) {
+        report.buttons = (uint16_t)(i & 1 ? 0x0004 : 0);
+        kept = r.update(0, report, ++gen, true) && kept;
+        expected[n++] = report.buttons;
+    }
+    snprintf(detail, sizeof(detail), "(%u dropped)", r.stats(0).dropped);
+    check(kept && r.stats(0).dropped == 0, "every edge keeps its own slot until the queue is full", detail);
+    // 佇列已滿: 最新的狀態取代最後一格，被取代的變化計入 dropped
+    report.buttons = 0x0008;
+    bool keptFull = r.update(0, report, ++gen, true);
+    expected[n - 1] = report.buttons;
+    snprintf(detail, sizeof(detail), "(%u dropped)", r.stats(0).dropped);
+    check(!keptFull && r.stats(0).dropped == 1, "a change pushed out of a full queue is counted", detail);
+    // 主機開始輪詢: 依序送出，最後是最新的狀態
+    s.state[0] = report;
+    s.generation[0] = gen;
+    s.nextPollUs = s.now + SIM_FRAME_US;
+    s.advance(20000);
+    bool inOrder = s.logCount - start == n;
+    for (uint32_t i = 0; inOrder && i < n; i++) {
+        inOrder = s.log[start + i].report.buttons == expected[i];
+    }
+    snprintf(detail, sizeof(detail), "(%zu reports, %u expected)", s.logCount - start, n);
+    check(inOrder, "queued reports go out in order and end with the newest state", detail);
+}
+
+// tag 跟著排隊的報告，送出時才交回
+static void testTags() {
+    printf("tags of queued reports\n");
+    char detail[96];
+    NSGamepadRouter r;
+    r.addPad(0);
+    r.keepalive(0, 0);
+    struct Sink {
+        uint32_t tags[8];
+        uint32_t count;
+        static bool submit(uint8_t id, const HID_NSGamepadReport_Data_t& rep, uint32_t tag, void* context) {
+            Sink* sink = (Sink*)context;
+            sink->tags[sink->count++ % 8] = tag;
+            return true;
+        }
+    } sink;
+    memset(&sink, 0, sizeof(sink));
+    HID_NSGamepadReport_Data_t report;
+    memset(&report, 0, sizeof(report));
+    report.buttons = 0x0004;
+    r.update(0, report, 1, true, 7);
+    report.leftXAxis = 10;
+    r.update(0, report, 2, true, 8);    // 只動搖桿: 合併，保留 7
+    report.buttons = 0;
+    r.update(0, report, 3, true, 9);
+    bool busySent = r.service(false, 0, Sink::submit, &sink);
+    bool first = r.service(true, 0, Sink::submit, &sink);
+    bool second = r.service(true, 0, Sink::submit, &sink);
+    bool idle = r.service(true, 0, Sink::submit, &sink);
+    snprintf(detail, sizeof(detail), "(tags %u, %u)", sink.tags[0], sink.tags[1]);
+    check(sink.count == 2 && sink.tags[0] == 7 && sink.tags[1] == 9, "each report comes back with its oldest tag",
+          detail);
+    check(!busySent && first && second && !idle, "service() returns true only when it submitted a report", "");
+}
+
+// 沒有變化時每個手把各自送 keepalive
+static void testKeepalive(uint8_t pads) {
+    printf("keepalive (%u pads)\n", pads);
+    char detail[96];
+    Sim s(pads, pads > 1);
+    s.advance(200000);
+    size_t start = s.logCount;
+    s.advance(1000000);
+    uint32_t count[NSGAMEPAD_MAX_PADS] = {0};
+    for (size_t i = start; i < s.logCount; i++) {
+        count[s.padOf(s.log[i].id)]++;
+    }
+    bool ok = true;
+    for (uint8_t p = 0; p < pads; p++) {
+        ok = ok && count[p] >= 9 && count[p] <= 11 && s.router.stats(p).keepalives >= 9;
+    }
+    snprintf(detail, sizeof(detail), "(pad 0: %u in 1 s)", count[0]);
+    check(ok, "idle pads resend every NSGAMEPAD_KEEPALIVE_MS", detail);
+}
+
+static void bench(uint8_t pads, uint32_t iterations) {
+    NSGamepadRouter r;
+    for (uint8_t p = 0; p < pads; p++) r.addPad(pads > 1 ? p + 1 : 0);
+    HID_NSGamepadReport_Data_t report;
+    memset(&report, 0, sizeof(report));
+    struct Sink {
+        static bool submit(uint8_t id, const HID_NSGamepadReport_Data_t& rep, uint32_t tag, void* context) {
+            *(volatile uint32_t*)context += id + rep.leftXAxis;
+            return true;
+        }
+    };
+    volatile uint32_t sink = 0;
+    uint64_t start = nowNs();
+    for (uint32_t i = 0; i < iterations; i++) {
+        uint8_t p = (uint8_t)(i % pads);
+        report.leftXAxis = (uint8_t)i;
+        report.buttons = (uint16_t)((i >> 3) & 1);
+        r.update(p, report, i, (i & 3) != 0);
+        r.service((i & 3) == 0, i >> 8, Sink::submit, (void*)&sink);
+    }
+    double ns = (double)(nowNs() - start) / iterations;
+    printf("update + service: %.1f ns on host\n", ns);
+    printf("state: %zu bytes for %u pads\n", sizeof(NSGamepadRouter), NSGAMEPAD_MAX_PADS);
+}
+
+int main(int argc, char** argv) {
+    uint32_t pads = NSGAMEPAD_MAX_PADS;
+    uint32_t iterations = BENCH_ITERATIONS;
+    for (int i = 1; i < argc; i++) {
+        if (strcmp(argv[i], "--pads") == 0 && i + 1 < argc) {
+            pads = (uint32_t)atoi(argv[++i]);
+        } else if (strcmp(argv[i], "--iterations") == 0 && i + 1 < argc) {
+            iterations = (uint32_t)atoi(argv[++i]);
+        } else {
+            fprintf(stderr, "usage: %s [--pads 1..%u] [--iterations N]\n", argv[0], NSGAMEPAD_MAX_PADS);
+            return 2;
+        }
+    }
+    if (pads < 1 || pads > NSGAMEPAD_MAX_PADS || iterations == 0) {
+        fprintf(stderr, "pads must be 1..%u, iterations > 0\n", NSGAMEPAD_MAX_PADS);
+        return 2;
+    }
+
+    testDescriptors((uint8_t)pads);
+    testRegistration();
+    testIsolation((uint8_t)pads);
+    testTaps((uint8_t)pads);
+    testFairness((uint8_t)pads);
+    testKeepalive((uint8_t)pads);
+    testQueue();
+    testTags();
+    bench((uint8_t)pads, iterations);
+    return checkSummary();
+}
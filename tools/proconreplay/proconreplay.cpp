@@ -0,0 +1,428 @@
+// 檔案: proconreplay.cpp
+// 作用: 在 Linux 上重播 Switch 主機對 Pro 控制器的 USB 命令，檢查
+//       SwitchPro_i2c/lib/switch_ESP32/ProControllerProtocol.cpp 的握手、子命令回覆、
+//       0x30 報告的週期與報告描述元，並量測主機上產生一個 0x30 報告的耗時
+//
+// 記錄檔 (預設 tools/proconreplay/transcript.txt) 每行一個主機輸出或預期的裝置報告，
+// 格式說明見記錄檔開頭；以 usbmon / Wireshark 錄到的實機記錄可以照同樣格式貼上。
+//
+// 編譯 (在專案根目錄):
+//   g++ -std=c++17 -O2 -ISwitchPro_i2c/lib/switch_ESP32 -Itools/common
+//       tools/proconreplay/proconreplay.cpp SwitchPro_i2c/lib/switch_ESP32/ProControllerProtocol.cpp -o proconreplay
+//
+// 用法:
+//   ./proconreplay                         重播預設記錄並量測
+//   ./proconreplay my_capture.txt          重播自己錄的記錄
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+
+#include "ProControllerProtocol.h"
+#include "ToolCheck.h"         // tools/common
+
+#define REPLAY_TICK_US         1000      // 每 1 ms 向協定要一次報告 (USB full speed frame)
+#define REPLAY_ITERATIONS      1000000
+#define REPLAY_PENDING_MAX     64
+#define REPLAY_WILDCARD        0x100     // 記錄檔中的 ".."
+
+static const uint8_t REPLAY_MAC[6] = { 0x98, 0xB6, 0xE9, 0x01, 0x02, 0x03 };
+
+/**
+ * 解析十六進位位元組，".." 為萬用字元
+ * @return 位元組數，格式錯誤時為 -1
+ */
+static int parseHex(const char* s, uint16_t* out, int max) {
+    int n = 0;
+    while (*s) {
+        while (*s == ' ' || *s == '\t') s++;
+        if (*s == '\0' || *s == '#') {
+            break;
+        }
+        if (n >= max) {
+            return -1;
+        }
+        if (s[0] == '.' && s[1] == '.') {
+            out[n++] = REPLAY_WILDCARD;
+            s += 2;
+            continue;
+        }
+        char* end;
+        long v = strtol(s, &end, 16);
+        if (end == s || v < 0 || v > 0xFF) {
+            return -1;
+        }
+        out[n++] = (uint16_t)v;
+        s = end;
+    }
+    return n;
+}
+
+struct Report {
+    uint8_t data[PRO_REPORT_SIZE];
+    uint32_t t;
+};
+
+struct Replay {
+    ProControllerProtocol protocol;
+    ProControllerInput input;
+    uint32_t t;
+    int lineNo;
+    uint32_t outputs;
+    Report pending[REPLAY_PENDING_MAX];   // 已送出但尚未比對的報告
+    int pendingCount;
+    uint32_t streamed;                    // 上一次 wait 期間的 0x30 報告數
+    uint32_t maxGapUs;                    // 上一次 wait 期間 0x30 報告的最大間隔
+    uint32_t lastFullUs;
+    bool haveFull;
+    ProControllerStats totals;            // reset 之前的統計
+
+    Replay() : t(0), lineNo(0), outputs(0), pendingCount(0), streamed(0),
+               maxGapUs(0), lastFullUs(0), haveFull(false) {
+        memset(&totals, 0, sizeof(totals));
+        protocol.setMac(REPLAY_MAC);
+        proControllerInputReset(input);
+    }
+
+    void fail(const char* fmt, const char* detail) {
+        printf("  line %d: ", lineNo);
+        printf(fmt, detail);
+        printf("\n");
+        checkFailures++;
+    }
+
+    // 把這一刻該送的報告全部收下 (與 ProControllerGamepad::send 相同)
+    void poll(bool force) {
+        Report r;
+        for (int i = 0; i <= PRO_REPLY_QUEUE && protocol.nextReport(r.data, t, force); i++) {
+            r.t = t;
+            if (r.data[0] == PRO_REPORT_FULL) {
+                streamed++;
+                if (haveFull && t - lastFullUs > maxGapUs) {
+                    maxGapUs = t - lastFullUs;
+                }
+                lastFullUs = t;
+                haveFull = true;
+            }
+            if (pendingCount < REPLAY_PENDING_MAX) {
+                pending[pendingCount++] = r;
+            } else {
+                // 沒有人比對的 0x30 報告太多: 丟掉最舊的
+                memmove(pending, pending + 1, sizeof(Report) * (REPLAY_PENDING_MAX - 1));
+                pending[REPLAY_PENDING_MAX - 1] = r;
+            }
+        }
+    }
+
+    void advance(uint32_t us) {
+        for (uint32_t dt = 0; dt < us; dt += REPLAY_TICK_US) {
+            t += REPLAY_TICK_US;
+            poll(false);
+        }
+    }
+
+    // "H> 01 00 00 01 40 40 00 01 40 40 02": 主機輸出 (第一個位元組是 report ID)，之後時間前進 1 ms
+    void hostOutput(const char* args) {
+        uint16_t bytes[PRO_REPORT_SIZE];
+        int n = parseHex(args, bytes, PRO_REPORT_SIZE);
+        if (n < 1) {
+            fail("malformed output: %s", args);
+            return;
+        }
+        uint8_t data[PRO_REPORT_SIZE];
+        for (int i = 0; i < n; i++) {
+            if (bytes[i] == REPLAY_WILDCARD) {
+                fail("wildcard in output: %s", args);
+                return;
+            }
+            data[i] = (uint8_t)bytes[i];
+        }
+        // 實際的輸出報告固定 63 位元組，沒寫出來的補 0
+        memset(data + n, 0, sizeof(data) - n);
+        protocol.handleOutput(data[0], data + 1, PRO_REPORT_SIZE - 1);
+        outputs++;
+        poll(false);
+        advance(REPLAY_TICK_US);
+    }
+
+    // "D< 81 01 00 03 ..": 下一個同 ID 的裝置報告 (之前的 0x30 報告略過)，只比對寫出來的位元組
+    void deviceReport(const char* args) {
+        uint16_t want[PRO_REPORT_SIZE];
+        int n = parseHex(args, want, PRO_REPORT_SIZE);
+        checkCount++;
+        if (n < 1 || want[0] == REPLAY_WILDCARD) {
+            fail("malformed report: %s", args);
+            return;
+        }
+        int found = -1;
+        for (int i = 0; i < pendingCount; i++) {
+            if (pending[i].data[0] == want[0]) {
+                found = i;
+                break;
+            }
+            if (pending[i].data[0] != PRO_REPORT_FULL) {
+                char got[8];
+                snprintf(got, sizeof(got), "%02X", pending[i].data[0]);
+                fail("unexpected report %s before the expected one", got);
+                break;
+            }
+        }
+        if (found < 0) {
+            fail("report not sent: %s", args);
+            return;
+        }
+        const uint8_t* data = pending[found].data;
+        bool ok = true;
+        for (int i = 0; i < n; i++) {
+            ok = ok && (want[i] == REPLAY_WILDCARD || want[i] == data[i]);
+        }
+        if (!ok) {
+            char got[PRO_REPORT_SIZE * 3 + 1];
+            int len = 0;
+            for (int i = 0; i < n; i++) {
+                len += snprintf(got + len, sizeof(got) - len, " %02X", data[i]);
+            }
+            fail("report mismatch, got%s", got);
+        }
+        memmove(pending, pending + found + 1, sizeof(Report) * (pendingCount - found - 1));
+        pendingCount -= found + 1;
+    }
+
+    // "input BUTTONS HAT LX LY RX RY": NSGamepad 格式的輸入 (按鈕為十六進位)，之後時間前進 1 ms
+    void setInput(const char* args) {
+        unsigned buttons, hat, lx, ly, rx, ry;
+        if (sscanf(args, "%x %u %u %u %u %u", &buttons, &hat, &lx, &ly, &rx, &ry) != 6) {
+            fail("malformed input: %s", args);
+            return;
+        }
+        proControllerInputFromGamepad(input, (uint16_t)buttons, (uint8_t)hat, (uint8_t)lx, (uint8_t)ly,
+                                      (uint8_t)rx, (uint8_t)ry);
+        protocol.setInput(input);
+        poll(true);
+        advance(REPLAY_TICK_US);
+    }
+
+    // "wait MS": 只推進時間，並重新統計 0x30 報告
+    void wait(uint32_t ms) {
+        streamed = 0;
+        maxGapUs = 0;
+        advance(ms * 1000);
+    }
+
+    void expectValue(const char* what, unsigned got, unsigned lo, unsigned hi) {
+        checkCount++;
+        if (got < lo || got > hi) {
+            char detail[96];
+            snprintf(detail, sizeof(detail), "%s = %u (want %u..%u)", what, got, lo, hi);
+            fail("mismatch: %s", detail);
+        }
+    }
+
+    // "expect state S" / "expect imu 0|1" / "expect lights XX" / "expect rumble 0|1"
+    // "expect streamed MIN MAX" / "expect gap MAX_US" / "expect unknown N" / "expect dropped N"
+    void expect(const char* args) {
+        static const char* STATES[] = { "idle", "handshake", "streaming" };
+        char what[16];
+        unsigned a = 0, b = 0;
+        int n = sscanf(args, "%15s %x %u", what, &a, &b);
+        if (n < 2 && strcmp(what, "state") != 0) {
+            fail("malformed expect: %s", args);
+            return;
+        }
+        if (strcmp(what, "state") == 0) {
+            const char* state = STATES[protocol.state()];
+            checkCount++;
+            if (strstr(args, state) == NULL) {
+                fail("state mismatch, got %s", state);
+            }
+        } else if (strcmp(what, "imu") == 0) {
+            expectValue("imu", protocol.imuEnabled(), a, a);
+        } else if (strcmp(what, "lights") == 0) {
+            expectValue("lights", protocol.playerLights(), a, a);
+        } else if (strcmp(what, "rumble") == 0) {
+            expectValue("rumble", protocol.rumbleActive(), a, a);
+        } else if (strcmp(what, "streamed") == 0) {
+            sscanf(args, "%15s %u %u", what, &a, &b);
+            expectValue("0x30 reports", streamed, a, n == 3 ? b : a);
+        } else if (strcmp(what, "gap") == 0) {
+            sscanf(args, "%15s %u", what, &a);
+            expectValue("0x30 gap us", maxGapUs, 0, a);
+        } else if (strcmp(what, "unknown") == 0) {
+            sscanf(args, "%15s %u", what, &a);
+            expectValue("unknown", protocol.stats().unknown, a, a);
+        } else if (strcmp(what, "dropped") == 0) {
+            sscanf(args, "%15s %u", what, &a);
+            expectValue("dropped", protocol.stats().dropped, a, a);
+        } else {
+            fail("unknown expect: %s", args);
+        }
+    }
+
+    void line(char* s) {
+        lineNo++;
+        s[strcspn(s, "\r\n")] = '\0';
+        while (*s == ' ' || *s == '\t') s++;
+        if (*s == '\0' || *s == '#') {
+            return;
+        }
+        if (strncmp(s, "H> ", 3) == 0) {
+            hostOutput(s + 3);
+        } else if (strncmp(s, "D< ", 3) == 0) {
+            deviceReport(s + 3);
+        } else if (strncmp(s, "input ", 6) == 0) {
+            setInput(s + 6);
+        } else if (strncmp(s, "expect ", 7) == 0) {
+            expect(s + 7);
+        } else if (strncmp(s, "wait ", 5) == 0) {
+            wait((uint32_t)atoi(s + 5));
+        } else if (strcmp(s, "flush") == 0) {
+            pendingCount = 0;
+        } else if (strcmp(s, "reset") == 0) {
+            const ProControllerStats& stats = protocol.stats();
+            totals.replies += stats.replies;
+            totals.fullReports += stats.fullReports;
+            totals.spiReads += stats.spiReads;
+            protocol.reset();
+            proControllerInputReset(input);
+            pendingCount = 0;
+            haveFull = false;
+        } else {
+            fail("unknown line: %s", s);
+        }
+    }
+};
+
+/**
+ * 走訪報告描述元，統計每個 report ID 的輸入 / 輸出位元數
+ * 原廠描述元: 0x30 / 0x21 / 0x81 輸入與 0x01 / 0x10 / 0x80 / 0x82 輸出都是 63 位元組
+ */
+static void checkDescriptor() {
+    uint32_t inputBits[256] = { 0 };
+    uint32_t outputBits[256] = { 0 };
+    uint32_t reportSize = 0, reportCount = 0;
+    uint8_t reportId = 0;
+    int depth = 0;
+    bool ok = true;
+    const uint8_t* d = PRO_CONTROLLER_REPORT_DESCRIPTOR;
+    size_t len = PRO_CONTROLLER_REPORT_DESCRIPTOR_SIZE;
+    for (size_t i = 0; i < len;) {
+        uint8_t prefix = d[i];
+        uint8_t size = prefix & 0x03;
+        if (size == 3) {
+            size = 4;
+        }
+        if (i + 1 + size > len) {
+            ok = false;
+            break;
+        }
+        uint32_t value = 0;
+        for (uint8_t k = 0; k < size; k++) {
+            value |= (uint32_t)d[i + 1 + k] << (8 * k);
+        }
+        switch (prefix & 0xFC) {
+            case 0x74: reportSize = value; break;
+            case 0x94: reportCount = value; break;
+            case 0x84: reportId = (uint8_t)value; break;
+            case 0x80: inputBits[reportId] += reportSize * reportCount; break;
+            case 0x90: outputBits[reportId] += reportSize * reportCount; break;
+            case 0xA0: depth++; break;
+            case 0xC0: depth--; break;
+            default: break;
+        }
+        i += 1 + size;
+    }
+    ok = ok && depth == 0;
+    static const uint8_t INPUTS[] = { PRO_REPORT_FULL, PRO_REPORT_SUBCMD_REPLY, PRO_REPORT_USB_REPLY };
+    static const uint8_t OUTPUTS[] = { PRO_OUTPUT_SUBCMD, PRO_OUTPUT_RUMBLE, PRO_OUTPUT_USB, 0x82 };
+    uint32_t total = 0;
+    for (uint8_t id : INPUTS) {
+        ok = ok && inputBits[id] == (PRO_REPORT_SIZE - 1) * 8;
+        total += inputBits[id];
+    }
+    for (uint8_t id : OUTPUTS) {
+        ok = ok && outputBits[id] == (PRO_REPORT_SIZE - 1) * 8;
+        total += outputBits[id];
+    }
+    ok = ok && inputBits[0] == 0 && outputBits[0] == 0;
+    printf("descriptor: %zu bytes, %u report bits in 7 reports, %s\n", len, total, ok ? "ok" : "MISMATCH");
+    checkCount++;
+    if (!ok) {
+        checkFailures++;
+    }
+}
+
+static int runReplay(Replay& replay, const char* path) {
+    FILE* f = fopen(path, "r");
+    if (f == NULL) {
+        fprintf(stderr, "cannot open %s\n", path);
+        return -1;
+    }
+    char buf[512];
+    printf("replay %s:\n", path);
+    while (fgets(buf, sizeof(buf), f) != NULL) {
+        replay.line(buf);
+    }
+    fclose(f);
+    const ProControllerStats& s = replay.protocol.stats();
+    printf("  %u outputs, %u replies, %u 0x30 reports, %u SPI reads, %d checks, %d failed\n", replay.outputs,
+           replay.totals.replies + s.replies, replay.totals.fullReports + s.fullReports,
+           replay.totals.spiReads + s.spiReads, checkCount, checkFailures);
+    return 0;
+}
+
+// 串流中每 1 ms 換一次輸入: setInput + nextReport (含 IMU)
+static void runTiming(uint32_t iterations) {
+    ProControllerProtocol protocol;
+    static const uint8_t START[] = { 0x04 };
+    static const uint8_t IMU_ON[] = { 0x00, 0x00, 0x01, 0x40, 0x40, 0x00, 0x01, 0x40, 0x40, 0x40, 0x01 };
+    protocol.handleOutput(PRO_OUTPUT_USB, START, sizeof(START));
+    protocol.handleOutput(PRO_OUTPUT_SUBCMD, IMU_ON, sizeof(IMU_ON));
+    uint8_t out[PRO_REPORT_SIZE];
+    protocol.nextReport(out, 0);
+    ProControllerInput in;
+    proControllerInputReset(in);
+    volatile uint32_t sink = 0;
+    uint32_t t = 0;
+
+    uint64_t start = nowNs();
+    for (uint32_t i = 0; i < iterations; i++) {
+        t += REPLAY_TICK_US;
+        proControllerInputFromGamepad(in, (uint16_t)(i & 0x3FFF), (uint8_t)(i & 7), (uint8_t)i, (uint8_t)(i >> 3),
+                                      0x80, 0x80);
+        in.accel[2] = (int16_t)i;
+        sink += protocol.setInput(in);
+        sink += protocol.nextReport(out, t);
+        sink += out[PRO_REPORT_SIZE - 1];
+    }
+    uint64_t elapsed = nowNs() - start;
+
+    printf("timing (%u reports):\n", iterations);
+    printf("  host        %.1f ns per 0x30 report (convert + setInput + nextReport)\n", (double)elapsed / iterations);
+}
+
+int main(int argc, char** argv) {
+    const char* path = "tools/proconreplay/transcript.txt";
+    uint32_t iterations = REPLAY_ITERATIONS;
+    for (int i = 1; i < argc; i++) {
+        if (strcmp(argv[i], "--iterations") == 0 && i + 1 < argc) {
+            iterations = (uint32_t)atoi(argv[++i]);
+        } else if (argv[i][0] != '-') {
+            path = argv[i];
+        } else {
+            fprintf(stderr, "usage: %s [transcript.txt] [--iterations N]\n", argv[0]);
+            return 2;
+        }
+    }
+    if (iterations == 0) {
+        fprintf(stderr, "iterations must be > 0\n");
+        return 2;
+    }
+
+    checkDescriptor();
+    static Replay replay;
+    if (runReplay(replay, path) < 0) {
+        return 2;
+    }
+    runTiming(iterations);
+    return checkSummary();
+}
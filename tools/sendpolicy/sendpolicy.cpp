@@ -0,0 +1,284 @@
+// 檔案: sendpolicy.cpp
+// 作用: 以假時鐘比較 S1 三種發送策略 (WiiMote_i2c/src/SendScheduler.h) 的「按下到送上線路」延遲與頻寬
+//
+// 以固定亂數種子產生一段玩家輸入 (一般的按放、5ms 的快速連打、長時間閒置)，Wiimote 在按鈕改變時送出回報
+// (--accel 時改為每 10ms 一個回報，加速度每次都不同)。S1 依照 updatePlayer() 累積按鈕邊緣、由 SendScheduler 決定送出，
+// 訊框以 wiimoteStateEncode + linkEncodeFrame 的實際長度在 UART 上排隊 (8N1，一次只能送一個訊框)。
+// 每一次按下記錄「帶有這次按下的 Wiimote 回報到達 S1」到「帶有它的訊框最後一個位元組離開 UART」的時間，
+// 依策略印出平均、p99 與最大值 (精確值，不經過直方圖)，以及每秒的訊框數與位元組數。
+// 所有時間都是模擬的，結果每次都相同。
+//
+// 編譯 (在專案根目錄):
+//   g++ -std=c++17 -O2 -Icommon/WiimoteLink -IWiiMote_i2c/src -Itools/common tools/sendpolicy/sendpolicy.cpp
+//       common/WiimoteLink/WiimoteData.cpp common/WiimoteLink/WiimoteLink.cpp -o sendpolicy
+//
+// 用法:
+//   ./sendpolicy                              預設 115200 baud (開機時的基本速率)、60 秒的輸入
+//   ./sendpolicy --baud 921600 --seconds 300 --accel --seed 7
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+
+#include <algorithm>
+#include <vector>
+
+#include "WiimoteData.h"
+#include "WiimoteLink.h"
+#include "ButtonEdges.h"
+#include "SendScheduler.h"     // WiiMote_i2c/src
+#include "ToolCheck.h"   // tools/common
+
+#define SIM_BAUD             115200
+#define SIM_SECONDS          60
+#define SIM_LOOP_US          250       // S1 loop() 的間隔
+#define SIM_ACCEL_REPORT_US  10000     // 加速度計開啟時 Wiimote 每 10ms 回報一次
+#define SIM_INTERVAL_US      20000     // 與 WiiMote_i2c/src/main.cpp 的 SEND_INTERVAL_MS 相同
+#define SIM_MIN_SPACING_US   1000      // SEND_MIN_SPACING_US
+#define SIM_HEARTBEAT_US     250000    // SEND_HEARTBEAT_MS
+#define SIM_KEYFRAME_US      250000    // STATE_KEYFRAME_MS
+
+static uint32_t rngState = 1;
+
+static uint32_t rnd() {
+    rngState ^= rngState << 13;
+    rngState ^= rngState >> 17;
+    rngState ^= rngState << 5;
+    return rngState;
+}
+
+static uint32_t rndRange(uint32_t lo, uint32_t hi) {
+    return lo + rnd() % (hi - lo + 1);
+}
+
+// 按鈕在 atUs 變成 buttons (wiimoteButtonSet 格式)
+struct InputEdge {
+    uint32_t atUs;
+    uint32_t buttons;
+};
+
+/**
+ * 產生玩家輸入: 一般按放、快速連打與閒置交錯
+ */
+static std::vector<InputEdge> makeInput(uint32_t seconds) {
+    static const uint32_t buttons[] = { BUTTON_A, BUTTON_B, BUTTON_ONE, BUTTON_TWO, BUTTON_C, BUTTON_Z };
+    const uint32_t count = sizeof(buttons) / sizeof(buttons[0]);
+    std::vector<InputEdge> edges;
+    uint32_t t = 100000;
+    const uint32_t endUs = seconds * 1000000U;
+    while (t < endUs) {
+        uint32_t kind = rndRange(0, 9);
+        uint32_t b = buttons[rndRange(0, count - 1)];
+        if (kind < 6) {
+            // 一般按放
+            edges.push_back({ t, b });
+            t += rndRange(30000, 150000);
+            edges.push_back({ t, 0 });
+            t += rndRange(20000, 400000);
+        } else if (kind < 9) {
+            // 5ms 的快速連打
+            uint32_t taps = rndRange(3, 12);
+            for (uint32_t i = 0; i < taps; i++) {
+                edges.push_back({ t, b });
+                t += 5000;
+                edges.push_back({ t, 0 });
+                t += 5000;
+            }
+            t += rndRange(50000, 300000);
+        } else {
+            // 閒置 (只剩心跳與關鍵幀)
+            t += rndRange(500000, 3000000);
+        }
+    }
+    return edges;
+}
+
+// 一個策略的結果
+struct PolicyResult {
+    std::vector<uint32_t> latencyUs;  // 每一次按下的延遲
+    uint32_t presses;
+    uint32_t frames;
+    uint64_t bytes;
+};
+
+// S1 的一次按下: 帶有它的回報到達 S1 的時間，等待下一個送出的訊框
+struct PendingPress {
+    uint32_t reportUs;
+};
+
+/**
+ * 以假時鐘執行一個策略
+ * @param accel true: Wiimote 每 SIM_ACCEL_REPORT_US 回報一次 (加速度每次都不同)；false: 只在按鈕改變時回報
+ */
+static PolicyResult run(SendPolicy policy, const std::vector<InputEdge>& input, uint32_t seconds,
+                        uint32_t baud, bool accel) {
+    PolicyResult r;
+    r.presses = 0;
+    r.frames = 0;
+    r.bytes = 0;
+    SendScheduler scheduler(policy, SIM_INTERVAL_US, SIM_MIN_SPACING_US, SIM_HEARTBEAT_US);
+    ButtonEdgeTracker edges;
+    WiimoteState current;
+    WiimoteState sent;
+    memset(&current, 0, sizeof(current));
+    memset(&sent, 0, sizeof(sent));
+    current.flags = WIIMOTE_FLAG_CONNECTED | (accel ? WIIMOTE_FLAG_ACCEL : 0);
+    current.battery = 0xC0;
+
+    std::vector<PendingPress> pending;
+    size_t nextEdge = 0;
+    uint32_t buttons = 0;            // 實際的按鈕
+    uint32_t reported = 0;           // 最後一個回報的按鈕
+    uint32_t nextAccelReportUs = 0;
+    uint32_t lastKeyframeUs = 0;
+    uint32_t wireFreeUs = 0;         // UART 送完目前排隊的位元組的時間
+    uint8_t seq = 0;
+    const uint32_t endUs = seconds * 1000000U + SIM_HEARTBEAT_US;
+    const double usPerByte = 10.0 * 1000000.0 / baud;
+
+    for (uint32_t now = 0; now < endUs; now += SIM_LOOP_US) {
+        // 1. 這段期間 Wiimote 送來的回報 (按鈕改變就回報；加速度計開啟時另外定期回報)
+        bool changed = false;
+        while (nextEdge < input.size() && input[nextEdge].atUs <= now) {
+            buttons = input[nextEdge++].buttons;
+            changed = true;
+        }
+        bool accelReport = accel && now >= nextAccelReportUs;
+        if (changed || accelReport) {
+            if (accelReport) {
+                nextAccelReportUs = now + SIM_ACCEL_REPORT_US;
+                current.accelX = (uint8_t)(0x80 + rnd() % 8);
+                current.accelY = (uint8_t)(0x80 + rnd() % 8);
+                current.accelZ = (uint8_t)(0x98 + rnd() % 8);
+            }
+            if (buttons & ~reported) {
+                pending.push_back({ now });
+                r.presses++;
+            }
+            reported = buttons;
+            current.buttons = (uint16_t)buttons;
+            current.extButtons = (uint8_t)(buttons >> 16);
+            edges.update(buttons);
+        }
+
+        // 2. 依照 sendPlayerState() 決定是否送出
+        if (wiimoteStateDiff(current, sent) != 0) {
+            scheduler.markChanged();
+        }
+        if (!scheduler.shouldSend(now) && !edges.full()) {
+            continue;
+        }
+        scheduler.onSent(now);
+        uint8_t fields = wiimoteStateDiff(current, sent);
+        if (fields != 0) {
+            fields |= STATE_FIELD_TIMESTAMP;
+        }
+        if (edges.needsReplay()) {
+            edges.store(current);
+            fields |= STATE_FIELD_EDGES | STATE_FIELD_BUTTONS;
+        }
+        edges.clear();
+        if (now - lastKeyframeUs >= SIM_KEYFRAME_US) {
+            lastKeyframeUs = now;
+            fields |= STATE_FIELD_ALL;
+        }
+        sent = current;
+
+        uint8_t payload[WIIMOTE_STATE_MAX_SIZE];
+        uint8_t frame[LINK_MAX_FRAME_SIZE];
+        size_t payloadLen = wiimoteStateEncode(payload, current, fields);
+        size_t frameLen = linkEncodeFrame(frame, LINK_MSG_STATE, seq++, payload, (uint8_t)payloadLen);
+        uint32_t startUs = wireFreeUs > now ? wireFreeUs : now;
+        wireFreeUs = startUs + (uint32_t)(frameLen * usPerByte + 0.5);
+        r.frames++;
+        r.bytes += frameLen;
+        for (size_t i = 0; i < pending.size(); i++) {
+            r.latencyUs.push_back(wireFreeUs - pending[i].reportUs);
+        }
+        pending.clear();
+    }
+    return r;
+}
+
+static uint32_t percentile(std::vector<uint32_t> v, uint32_t permille) {
+    if (v.empty()) {
+        return 0;
+    }
+    std::sort(v.begin(), v.end());
+    size_t index = ((uint64_t)v.size() * permille + 999) / 1000;
+    return v[index > 0 ? index - 1 : 0];
+}
+
+static uint32_t average(const std::vector<uint32_t>& v) {
+    uint64_t sum = 0;
+    for (size_t i = 0; i < v.size(); i++) {
+        sum += v[i];
+    }
+    return v.empty() ? 0 : (uint32_t)(sum / v.size());
+}
+
+int main(int argc, char** argv) {
+    uint32_t baud = SIM_BAUD;
+    uint32_t seconds = SIM_SECONDS;
+    uint32_t seed = 1;
+    bool accel = false;
+    for (int i = 1; i < argc; i++) {
+        if (strcmp(argv[i], "--baud") == 0 && i + 1 < argc) {
+            baud = (uint32_t)atoi(argv[++i]);
+        } else if (strcmp(argv[i], "--seconds") == 0 && i + 1 < argc) {
+            seconds = (uint32_t)atoi(argv[++i]);
+        } else if (strcmp(argv[i], "--seed") == 0 && i + 1 < argc) {
+            seed = (uint32_t)atoi(argv[++i]);
+        } else if (strcmp(argv[i], "--accel") == 0) {
+            accel = true;
+        } else {
+            fprintf(stderr, "usage: %s [--baud N] [--seconds N] [--seed N] [--accel]\n", argv[0]);
+            return 2;
+        }
+    }
+    if (baud == 0 || seconds == 0 || seconds > 3600 || seed == 0) {
+        fprintf(stderr, "baud must be > 0, seconds 1..3600, seed != 0\n");
+        return 2;
+    }
+    rngState = seed;
+    std::vector<InputEdge> input = makeInput(seconds);
+
+    static const SendPolicy policies[] = { SEND_POLICY_FIXED_RATE, SEND_POLICY_ON_CHANGE, SEND_POLICY_HYBRID };
+    static const char* const names[] = { "fixed", "change", "hybrid" };
+    PolicyResult results[3];
+    printf("%u s of input, %u baud, %s reports\n", seconds, baud, accel ? "100 Hz accel" : "on-change");
+    printf("policy   presses  press->wire avg    p99     max (us)  frames/s  bytes/s\n");
+    for (int p = 0; p < 3; p++) {
+        rngState = seed + 1;   // 每個策略的加速度雜訊相同
+        results[p] = run(policies[p], input, seconds, baud, accel);
+        const PolicyResult& r = results[p];
+        printf("%-8s %7u  %15u %7u %7u  %8.1f %8.0f\n", names[p], r.presses,
+               average(r.latencyUs), percentile(r.latencyUs, 990),
+               r.latencyUs.empty() ? 0 : *std::max_element(r.latencyUs.begin(), r.latencyUs.end()),
+               (double)r.frames / seconds, (double)r.bytes / seconds);
+    }
+
+    char detail[96];
+    for (int p = 0; p < 3; p++) {
+        char name[64];
+        snprintf(name, sizeof(name), "%s: every press reaches the wire", names[p]);
+        snprintf(detail, sizeof(detail), "(%zu of %u)", results[p].latencyUs.size(), results[p].presses);
+        check(results[p].presses > 0 && results[p].latencyUs.size() == results[p].presses, name, detail);
+    }
+    // 固定頻率平均要等半個間隔；變化即送與混合模式只差 loop 間隔、最小間隔與訊框傳輸時間
+    snprintf(detail, sizeof(detail), "(change %u us, fixed %u us)",
+             average(results[1].latencyUs), average(results[0].latencyUs));
+    check(average(results[1].latencyUs) < average(results[0].latencyUs), "change: lower average than fixed", detail);
+    snprintf(detail, sizeof(detail), "(change %u us, fixed %u us)",
+             percentile(results[1].latencyUs, 990), percentile(results[0].latencyUs, 990));
+    check(percentile(results[1].latencyUs, 990) < percentile(results[0].latencyUs, 990),
+          "change: lower p99 than fixed", detail);
+    snprintf(detail, sizeof(detail), "(hybrid %u us, fixed %u us)",
+             percentile(results[2].latencyUs, 990), percentile(results[0].latencyUs, 990));
+    check(percentile(results[2].latencyUs, 990) < percentile(results[0].latencyUs, 990),
+          "hybrid: lower p99 than fixed", detail);
+    snprintf(detail, sizeof(detail), "(p99 %u us)", percentile(results[0].latencyUs, 990));
+    check(percentile(results[0].latencyUs, 990) <= SIM_INTERVAL_US + 2000, "fixed: p99 within one interval", detail);
+
+    return checkSummary();
+}
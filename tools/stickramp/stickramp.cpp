@@ -0,0 +1,281 @@
+// 檔案: stickramp.cpp
+// 作用: 以假時鐘檢查方向鍵 -> 類比搖桿的漸進輸出 (SwitchPro_i2c/src/StickRamp.h) 並量測主機上每個 frame 的耗時
+//
+// 依照 S3 的呼叫方式: 方向鍵改變時呼叫 input()，每個 USB frame (1ms) 呼叫 tick()。檢查:
+//   - 四種曲線表從 0 單調遞增到 1.0，ease-in 在線性之下、ease-out 在線性之上、smoothstep 對稱
+//   - 加速在 rampUp 時間推到底、減速在 rampDown 時間回到中心 (±2ms)，過程中單調變化，另一軸維持置中
+//   - 加速途中放開從目前的位置開始減速，不會跳動
+//   - 斜向推到底時落在半徑 128 的圓上 (不是方形的角落)，慢走鍵依比例縮小幅度
+//   - rampUp / rampDown 為 0 時立即推到底 / 回中心，四個正方向與原本的 0/128/255 相同
+//   - 長時間沒有呼叫 (dt 很大) 與 micros() 回繞時時間仍正確
+//
+// 編譯 (在專案根目錄):
+//   g++ -std=c++17 -O2 -ISwitchPro_i2c/src -Itools/common tools/stickramp/stickramp.cpp -o stickramp
+//
+// 用法:
+//   ./stickramp
+//   ./stickramp --iterations 20000000
+
+#include <math.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+
+#include "StickRamp.h"   // SwitchPro_i2c/src
+#include "ToolCheck.h"   // tools/common
+
+#define BENCH_ITERATIONS      10000000
+#define FRAME_US              1000
+#define WALK_BUTTON           0x0400    // BUTTON_B
+#define RAMP_TOLERANCE_MS     2
+
+static double radius(const StickRamp& s) {
+    double dx = (double)s.x() - 128;
+    double dy = (double)s.y() - 128;
+    return sqrt(dx * dx + dy * dy);
+}
+
+static void testCurves() {
+    printf("curves\n");
+    static const char* const names[STICK_CURVE_COUNT] = { "linear", "ease-in", "ease-out", "smoothstep" };
+    StickResponse r[STICK_CURVE_COUNT];
+    for (uint8_t c = 0; c < STICK_CURVE_COUNT; c++) {
+        stickResponseBuild(r[c], 100, 100, c, 0, 100);
+        bool monotonic = true;
+        for (uint32_t i = 1; i < STICK_RAMP_TABLE_SIZE; i++) {
+            monotonic = monotonic && r[c].curve[i] >= r[c].curve[i - 1];
+        }
+        char name[64];
+        snprintf(name, sizeof(name), "%s: 0 to 1.0, non-decreasing", names[c]);
+        check(monotonic && r[c].curve[0] == 0 && r[c].curve[STICK_RAMP_TABLE_SIZE - 1] == STICK_Q15_ONE, name);
+    }
+    bool below = true;
+    bool above = true;
+    bool symmetric = true;
+    for (uint32_t i = 1; i + 1 < STICK_RAMP_TABLE_SIZE; i++) {
+        below = below && r[STICK_CURVE_EASE_IN].curve[i] < r[STICK_CURVE_LINEAR].curve[i];
+        above = above && r[STICK_CURVE_EASE_OUT].curve[i] > r[STICK_CURVE_LINEAR].curve[i];
+        int32_t sum = r[STICK_CURVE_S].curve[i] + r[STICK_CURVE_S].curve[STICK_RAMP_TABLE_SIZE - 1 - i];
+        symmetric = symmetric && abs(sum - STICK_Q15_ONE) <= 8;
+    }
+    check(below, "ease-in below linear");
+    check(above, "ease-out above linear");
+    check(symmetric, "smoothstep symmetric around the midpoint");
+}
+
+/**
+ * 從中心推到底再放開，記錄到達的時間
+ * @param curve STICK_CURVE_*
+ * @param startUs 開始時間 (測試回繞時接近 2^32)
+ */
+static void testRamp(const char* label, uint16_t upMs, uint16_t downMs, uint8_t curve, uint32_t startUs) {
+    printf("%s\n", label);
+    StickResponse r;
+    stickResponseBuild(r, upMs, downMs, curve, WALK_BUTTON, 50);
+    StickRamp s;
+    uint32_t t = startUs;
+    s.tick(r, t);
+    s.input(1, 0, false, r, t);
+    // settle: 加速進度到底 (active() 變 false)；輸出的 255 依曲線可能早幾毫秒出現
+    int32_t settleMs = -1;
+    int32_t fullMs = -1;
+    bool rising = true;
+    bool otherAxis = true;
+    uint8_t last = s.x();
+    for (uint32_t ms = 1; ms <= (uint32_t)upMs + 50; ms++) {
+        s.tick(r, t + ms * FRAME_US);
+        rising = rising && s.x() >= last;
+        otherAxis = otherAxis && s.y() == 128;
+        last = s.x();
+        if (fullMs < 0 && s.x() == 255) {
+            fullMs = (int32_t)ms;
+        }
+        if (settleMs < 0 && !s.active()) {
+            settleMs = (int32_t)ms;
+        }
+    }
+    char name[96];
+    char detail[64];
+    snprintf(detail, sizeof(detail), "(settled %d ms, 255 at %d ms)", settleMs, fullMs);
+    snprintf(name, sizeof(name), "%s: full tilt after %u ms", label, upMs);
+    check(settleMs >= 0 && abs(settleMs - (int32_t)upMs) <= RAMP_TOLERANCE_MS && fullMs >= 0 && fullMs <= settleMs,
+          name, detail);
+    snprintf(name, sizeof(name), "%s: rises monotonically on one axis", label);
+    check(rising && otherAxis && s.x() == 255, name);
+
+    t += ((uint32_t)upMs + 50) * FRAME_US;
+    s.input(0, 0, false, r, t);
+    int32_t centerMs = -1;
+    settleMs = -1;
+    bool falling = true;
+    last = s.x();
+    for (uint32_t ms = 1; ms <= (uint32_t)downMs + 50; ms++) {
+        s.tick(r, t + ms * FRAME_US);
+        falling = falling && s.x() <= last;
+        last = s.x();
+        if (centerMs < 0 && s.x() == 128) {
+            centerMs = (int32_t)ms;
+        }
+        if (settleMs < 0 && !s.active()) {
+            settleMs = (int32_t)ms;
+        }
+    }
+    snprintf(detail, sizeof(detail), "(settled %d ms, 128 at %d ms)", settleMs, centerMs);
+    snprintf(name, sizeof(name), "%s: back to center after %u ms", label, downMs);
+    check(settleMs >= 0 && abs(settleMs - (int32_t)downMs) <= RAMP_TOLERANCE_MS && centerMs >= 0 &&
+          centerMs <= settleMs, name, detail);
+    snprintf(name, sizeof(name), "%s: falls monotonically, idle at center", label);
+    check(falling && !s.active() && s.x() == 128 && s.y() == 128, name);
+}
+
+static void testReleaseMidRamp() {
+    printf("release mid-ramp\n");
+    StickResponse r;
+    stickResponseBuild(r, 100, 100, STICK_CURVE_LINEAR, 0, 100);
+    StickRamp s;
+    uint32_t t = 1000;
+    s.tick(r, t);
+    s.input(0, -1, false, r, t);
+    for (uint32_t ms = 1; ms <= 40; ms++) {
+        s.tick(r, t + ms * FRAME_US);
+    }
+    uint8_t before = s.y();
+    s.input(0, 0, false, r, t + 40 * FRAME_US);
+    uint8_t after = s.y();
+    s.tick(r, t + 41 * FRAME_US);
+    char detail[64];
+    snprintf(detail, sizeof(detail), "(%u -> %u -> %u)", before, after, s.y());
+    // 推到 40% 時放開: 停在原地，下一個 frame 往中心退一小步
+    check(before < 128 && after == before && s.y() > after && s.y() - after <= 3, "release continues from the current position",
+          detail);
+    int32_t centerMs = -1;
+    for (uint32_t ms = 42; ms <= 200 && centerMs < 0; ms++) {
+        s.tick(r, t + ms * FRAME_US);
+        if (s.y() == 128) {
+            centerMs = (int32_t)(ms - 40);
+        }
+    }
+    snprintf(detail, sizeof(detail), "(%d ms)", centerMs);
+    check(centerMs >= 38 && centerMs <= 42, "release from 40% takes 40% of rampDown", detail);
+}
+
+static void testGateAndWalk() {
+    printf("circular gate and walk\n");
+    StickResponse r;
+    stickResponseBuild(r, 0, 0, STICK_CURVE_LINEAR, WALK_BUTTON, 50);
+    static const int8_t dirs[8][2] = { {1, 0}, {-1, 0}, {0, 1}, {0, -1}, {1, 1}, {1, -1}, {-1, 1}, {-1, -1} };
+    bool onCircle = true;
+    bool walkHalf = true;
+    char detail[96] = "";
+    for (int i = 0; i < 8; i++) {
+        StickRamp s;
+        s.input(dirs[i][0], dirs[i][1], false, r, 1000);
+        double full = radius(s);
+        s.input(dirs[i][0], dirs[i][1], true, r, 2000);
+        double walk = radius(s);
+        // 0~255 的中心是 128: 正向最多 127、負向最多 128
+        if (full < 126.5 || full > 129.0) {
+            onCircle = false;
+            snprintf(detail, sizeof(detail), "(dir %d,%d radius %.1f)", dirs[i][0], dirs[i][1], full);
+        }
+        if (fabs(walk - full / 2) > 1.5) {
+            walkHalf = false;
+        }
+    }
+    check(onCircle, "all 8 directions at full tilt land on radius 128", detail);
+    check(walkHalf, "walk at 50% halves the radius");
+
+    // 沒有設定慢走鍵時 walk 參數不影響輸出
+    StickResponse noWalk;
+    stickResponseBuild(noWalk, 0, 0, STICK_CURVE_LINEAR, 0, 50);
+    StickRamp s;
+    s.input(1, 0, true, noWalk, 1000);
+    check(s.x() == 255, "walk ignored when no walk button is set");
+}
+
+static void testSnap() {
+    printf("snap (ramp 0)\n");
+    StickResponse r;
+    stickResponseBuild(r, 0, 0, STICK_CURVE_EASE_IN, 0, 100);
+    StickRamp s;
+    bool ok = true;
+    s.input(1, 0, false, r, 10);
+    ok = ok && s.x() == 255 && s.y() == 128 && !s.active();
+    s.input(-1, 0, false, r, 11);
+    ok = ok && s.x() == 0 && s.y() == 128;
+    s.input(0, -1, false, r, 12);
+    ok = ok && s.x() == 128 && s.y() == 0;
+    s.input(0, 1, false, r, 13);
+    ok = ok && s.x() == 128 && s.y() == 255;
+    s.input(0, 0, false, r, 14);
+    ok = ok && s.x() == 128 && s.y() == 128 && !s.active();
+    check(ok, "cardinal directions snap to 0/128/255 like the old mapping");
+}
+
+static void testLongGap() {
+    printf("long gap\n");
+    StickResponse r;
+    stickResponseBuild(r, 2000, 2000, STICK_CURVE_LINEAR, 0, 100);
+    StickRamp s;
+    s.tick(r, 1000);
+    s.input(1, 0, false, r, 1000);
+    // 10 秒沒有呼叫: 只推進 STICK_RAMP_MAX_DT_US，不會溢位
+    s.tick(r, 1000 + 10000000);
+    char detail[48];
+    snprintf(detail, sizeof(detail), "(x %u)", s.x());
+    check(s.x() > 128 && s.x() < 140 && s.active(), "10 s gap advances at most STICK_RAMP_MAX_DT_US", detail);
+}
+
+static double benchmark(uint32_t iterations) {
+    StickResponse r;
+    stickResponseBuild(r, 120, 60, STICK_CURVE_EASE_IN, WALK_BUTTON, 50);
+    StickRamp s;
+    uint32_t t = 0;
+    uint32_t sink = 0;
+    uint64_t start = nowNs();
+    for (uint32_t i = 0; i < iterations; i++) {
+        // 每 200 個 frame 換一次方向，讓加速與減速都持續進行
+        if (i % 200 == 0) {
+            uint32_t phase = i / 200;
+            s.input((int8_t)(phase % 3) - 1, (int8_t)((phase / 3) % 3) - 1, (phase & 4) != 0, r, t);
+        }
+        sink += s.tick(r, t);
+        sink += s.x();
+        t += FRAME_US;
+    }
+    uint64_t elapsed = nowNs() - start;
+    if (sink == 0xDEADBEEF) {
+        printf(" ");
+    }
+    return (double)elapsed / iterations;
+}
+
+int main(int argc, char** argv) {
+    uint32_t iterations = BENCH_ITERATIONS;
+    for (int i = 1; i < argc; i++) {
+        if (strcmp(argv[i], "--iterations") == 0 && i + 1 < argc) {
+            iterations = (uint32_t)atoi(argv[++i]);
+        } else {
+            fprintf(stderr, "usage: %s [--iterations N]\n", argv[0]);
+            return 2;
+        }
+    }
+    if (iterations == 0) {
+        fprintf(stderr, "iterations must be > 0\n");
+        return 2;
+    }
+
+    testCurves();
+    testRamp("linear 100/100", 100, 100, STICK_CURVE_LINEAR, 1000);
+    testRamp("ease-in 120/60", 120, 60, STICK_CURVE_EASE_IN, 1000);
+    testRamp("smoothstep 2000/2000", 2000, 2000, STICK_CURVE_S, 1000);
+    testRamp("ease-out across micros() wrap", 100, 100, STICK_CURVE_EASE_OUT, 0xFFFFFFFFUL - 80000);
+    testReleaseMidRamp();
+    testGateAndWalk();
+    testSnap();
+    testLongGap();
+
+    printf("tick: %.1f ns/frame on host\n", benchmark(iterations));
+
+    return checkSummary();
+}
@@ -0,0 +1,327 @@
+// 檔案: translatebench.cpp
+// 作用: 比較按鈕轉換查表 (SwitchPro_i2c/src/ButtonTranslation.h) 與原本逐項映射迴圈的結果與耗時
+//
+// 原本的做法 (查表之前的 applyButtonState):
+//   - 方向鍵: D-Pad 模式呼叫 dPad(up, down, left, right)，搖桿模式以 if/else 串判斷 8 個方向
+//   - 按鈕: releaseAll() 後逐一檢查 buttonMappings[]，有按下就 press()
+// 這裡以 OldGamepad 重現 NSGamepad 的 press / dPad / 搖桿寫入，與查表版本比較:
+//   - 所有 18 位元遮罩 (含 Nunchuk C/Z) 在 D-Pad 與左搖桿模式、橫握與直握映射下輸出完全相同
+//   - 以隨機遮罩量測兩者在主機上每個封包的耗時 (只比較兩種做法，不代表 ESP32 上的時間)
+// 實機上的 CPU 週期數由 S3 的 /status ("translate") 與序列埠摘要回報。
+//
+// 編譯 (在專案根目錄):
+//   g++ -std=c++17 -O2 -Icommon/WiimoteLink -ISwitchPro_i2c/src -Itools/common
+//       tools/translatebench/translatebench.cpp -o translatebench
+//
+// 用法:
+//   ./translatebench
+//   ./translatebench --iterations 20000000
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+
+#include "WiimoteData.h"
+#include "ButtonTranslation.h"   // SwitchPro_i2c/src
+#include "ToolCheck.h"   // tools/common
+
+#define BENCH_ITERATIONS   10000000
+#define BENCH_MASKS        4096
+#define ALL_MASKS          0x40000UL  // 16 個 Wiimote 按鈕 + Nunchuk C/Z
+
+// 與 switch_ESP32.h 的 NSButton_* 相同
+enum {
+    NS_Y = 0, NS_B, NS_A, NS_X, NS_L, NS_R, NS_ZL, NS_ZR, NS_MINUS, NS_PLUS,
+    NS_LSTICK, NS_RSTICK, NS_HOME, NS_CAPTURE
+};
+
+// 與 SwitchPro_i2c/src/main.cpp 的 buttonMappings[] (橫握) 相同
+static constexpr ButtonMapping sidewaysMappings[] = {
+    {BUTTON_TWO,   NS_A},
+    {BUTTON_ONE,   NS_B},
+    {BUTTON_A,     NS_L},
+    {BUTTON_B,     NS_R},
+    {BUTTON_PLUS,  NS_PLUS},
+    {BUTTON_MINUS, NS_MINUS},
+    {BUTTON_HOME,  NS_HOME},
+    {BUTTON_Z,     NS_X},
+    {BUTTON_C,     NS_Y}
+};
+
+// 與 nunchukButtonMappings[] (直握) 相同
+static constexpr ButtonMapping uprightMappings[] = {
+    {BUTTON_A,     NS_A},
+    {BUTTON_B,     NS_B},
+    {BUTTON_ONE,   NS_X},
+    {BUTTON_TWO,   NS_Y},
+    {BUTTON_PLUS,  NS_PLUS},
+    {BUTTON_MINUS, NS_MINUS},
+    {BUTTON_HOME,  NS_HOME},
+    {BUTTON_C,     NS_L},
+    {BUTTON_Z,     NS_ZL}
+};
+
+// 與 MAPPING_HOLD_DIRECTIONS 相同
+static constexpr DirectionMapping sidewaysDirections = { BUTTON_RIGHT, BUTTON_LEFT, BUTTON_UP, BUTTON_DOWN };
+static constexpr DirectionMapping uprightDirections = { BUTTON_UP, BUTTON_DOWN, BUTTON_LEFT, BUTTON_RIGHT };
+
+static constexpr ButtonTranslation sidewaysDpad =
+    makeButtonTranslation(sidewaysMappings, sidewaysDirections, DIRECTION_TARGET_DPAD);
+static constexpr ButtonTranslation sidewaysStick =
+    makeButtonTranslation(sidewaysMappings, sidewaysDirections, DIRECTION_TARGET_LEFT_STICK);
+
+// 報告中與按鈕映射有關的欄位
+struct PadOutput {
+    uint16_t buttons;
+    uint8_t hat;
+    uint8_t leftX;
+    uint8_t leftY;
+    uint8_t rightX;
+    uint8_t rightY;
+};
+
+static bool sameOutput(const PadOutput& a, const PadOutput& b) {
+    return a.buttons == b.buttons && a.hat == b.hat && a.leftX == b.leftX && a.leftY == b.leftY &&
+           a.rightX == b.rightX && a.rightY == b.rightY;
+}
+
+// ---------------------------------------------------------------------------
+// 原本的做法: NSGamepad 的 press / dPad 加上逐項迴圈與 if/else 串
+// ---------------------------------------------------------------------------
+struct OldGamepad {
+    PadOutput report;
+    uint32_t generation;   // NSGamepad 每次欄位改變都會遞增
+
+    void buttons(uint16_t b) {
+        if (report.buttons != b) {
+            report.buttons = b;
+            generation++;
+        }
+    }
+    void press(uint8_t b) {
+        if (b > 15) b = 15;
+        buttons((uint16_t)(report.buttons | (1u << b)));
+    }
+    void releaseAll() { buttons(0); }
+    void dPad(uint8_t d) {
+        if (report.hat != d) {
+            report.hat = d;
+            generation++;
+        }
+    }
+    void dPad(bool up, bool down, bool left, bool right) {
+        static const uint8_t BITS2DIR[16] = {
+            BUTTON_HAT_CENTERED, BUTTON_HAT_RIGHT, BUTTON_HAT_LEFT, BUTTON_HAT_CENTERED,
+            BUTTON_HAT_DOWN, BUTTON_HAT_DOWN_RIGHT, BUTTON_HAT_DOWN_LEFT, BUTTON_HAT_CENTERED,
+            BUTTON_HAT_UP, BUTTON_HAT_UP_RIGHT, BUTTON_HAT_UP_LEFT, BUTTON_HAT_CENTERED,
+            BUTTON_HAT_CENTERED, BUTTON_HAT_CENTERED, BUTTON_HAT_CENTERED, BUTTON_HAT_CENTERED
+        };
+        dPad(BITS2DIR[(up << 3) | (down << 2) | (left << 1) | right]);
+    }
+    void leftXAxis(uint8_t v) { if (report.leftX != v) { report.leftX = v; generation++; } }
+    void leftYAxis(uint8_t v) { if (report.leftY != v) { report.leftY = v; generation++; } }
+    void rightXAxis(uint8_t v) { if (report.rightX != v) { report.rightX = v; generation++; } }
+    void rightYAxis(uint8_t v) { if (report.rightY != v) { report.rightY = v; generation++; } }
+};
+
+static void oldAnalogStick(OldGamepad& pad, uint32_t buttons, const DirectionMapping& d) {
+    bool up = buttons & d.up;
+    bool down = buttons & d.down;
+    bool left = buttons & d.left;
+    bool right = buttons & d.right;
+    uint8_t x = 128;
+    uint8_t y = 128;
+    if (up && right) {
+        x = 255; y = 0;
+    } else if (up && left) {
+        x = 0; y = 0;
+    } else if (down && right) {
+        x = 255; y = 255;
+    } else if (down && left) {
+        x = 0; y = 255;
+    } else if (up) {
+        y = 0;
+    } else if (down) {
+        y = 255;
+    } else if (left) {
+        x = 0;
+    } else if (right) {
+        x = 255;
+    }
+    // 相反方向同時按下時該軸回到中心
+    if (up && down) {
+        y = 128;
+    }
+    if (left && right) {
+        x = 128;
+    }
+    pad.leftXAxis(x);
+    pad.leftYAxis(y);
+    pad.rightXAxis(128);
+}
+
+template <size_t N>
+__attribute__((noinline)) static void oldApply(OldGamepad& pad, uint32_t buttons, const ButtonMapping (&m)[N],
+                                               const DirectionMapping& d, bool dpadMode) {
+    if (dpadMode) {
+        pad.dPad((buttons & d.up) != 0, (buttons & d.down) != 0, (buttons & d.left) != 0, (buttons & d.right) != 0);
+        pad.leftXAxis(128);
+        pad.leftYAxis(128);
+        pad.rightXAxis(128);
+    } else {
+        if (buttons & (d.up | d.down | d.left | d.right)) {
+            oldAnalogStick(pad, buttons, d);
+        } else {
+            pad.leftXAxis(128);
+            pad.leftYAxis(128);
+            pad.rightXAxis(128);
+        }
+        pad.dPad(BUTTON_HAT_CENTERED);
+    }
+    pad.releaseAll();
+    for (size_t i = 0; i < N; i++) {
+        if (buttons & m[i].wiimoteButton) {
+            pad.press(m[i].nsButton);
+        }
+    }
+}
+
+// 查表版本: 與 applyButtonState() 的步驟 1、2 相同
+__attribute__((noinline)) static void tableApply(PadOutput& out, uint32_t buttons, const ButtonTranslation& t) {
+    const DirectionOutput& direction = translateDirection(t, buttons);
+    out.hat = direction.hat;
+    out.leftX = direction.leftX;
+    out.leftY = direction.leftY;
+    out.rightX = direction.rightX;
+    out.rightY = direction.rightY;
+    out.buttons = translateButtons(t, buttons);
+}
+
+static void resetOld(OldGamepad& pad) {
+    pad.report.buttons = 0;
+    pad.report.hat = BUTTON_HAT_CENTERED;
+    pad.report.leftX = pad.report.leftY = pad.report.rightX = pad.report.rightY = 128;
+    pad.generation = 0;
+}
+
+/**
+ * 所有遮罩下查表與原本做法的輸出相同
+ * @param name 情境名稱
+ * @param m 按鈕映射表
+ */
+template <size_t N>
+static void testEquivalent(const char* name, const ButtonMapping (&m)[N], const DirectionMapping& d, bool dpadMode) {
+    static ButtonTranslation table;
+    buildButtonTranslation(table, m, N, d, dpadMode ? DIRECTION_TARGET_DPAD : DIRECTION_TARGET_LEFT_STICK);
+    OldGamepad pad;
+    resetOld(pad);
+    uint32_t mismatches = 0;
+    uint32_t firstMismatch = 0;
+    for (uint32_t buttons = 0; buttons < ALL_MASKS; buttons++) {
+        PadOutput out;
+        oldApply(pad, buttons, m, d, dpadMode);
+        tableApply(out, buttons, table);
+        // 原本的做法不會重設右搖桿 Y，查表版本一律置中；兩者在這裡都是 128
+        if (!sameOutput(pad.report, out)) {
+            if (mismatches++ == 0) {
+                firstMismatch = buttons;
+            }
+        }
+    }
+    char detail[64];
+    snprintf(detail, sizeof(detail), "(%u masks differ, first 0x%05X)", mismatches, firstMismatch);
+    check(mismatches == 0, name, detail);
+}
+
+static void testConstexpr() {
+    // 編譯期產生的查表與執行期版本相同
+    static ButtonTranslation runtime;
+    buildButtonTranslation(runtime, sidewaysMappings, sizeof(sidewaysMappings) / sizeof(sidewaysMappings[0]),
+                           sidewaysDirections, DIRECTION_TARGET_DPAD);
+    bool same = memcmp(&runtime, &sidewaysDpad, sizeof(runtime)) == 0;
+    buildButtonTranslation(runtime, sidewaysMappings, sizeof(sidewaysMappings) / sizeof(sidewaysMappings[0]),
+                           sidewaysDirections, DIRECTION_TARGET_LEFT_STICK);
+    same = same && memcmp(&runtime, &sidewaysStick, sizeof(runtime)) == 0;
+    check(same, "constexpr tables match buildButtonTranslation");
+}
+
+// 隨機遮罩: 大多數封包只有 0~2 個按鈕，偶爾有方向鍵組合
+static void makeMasks(uint32_t* masks, uint32_t count) {
+    srand(7);
+    for (uint32_t i = 0; i < count; i++) {
+        uint32_t m = 0;
+        uint32_t pressed = (uint32_t)(rand() % 4);
+        for (uint32_t j = 0; j < pressed; j++) {
+            m |= 1UL << (rand() % 18);
+        }
+        masks[i] = m;
+    }
+}
+
+static double benchOld(const uint32_t* masks, uint32_t iterations, bool dpadMode) {
+    OldGamepad pad;
+    resetOld(pad);
+    uint64_t start = nowNs();
+    for (uint32_t i = 0; i < iterations; i++) {
+        oldApply(pad, masks[i & (BENCH_MASKS - 1)], sidewaysMappings, sidewaysDirections, dpadMode);
+    }
+    uint64_t elapsed = nowNs() - start;
+    if (pad.generation == 0xDEADBEEF) {
+        printf(" ");
+    }
+    return (double)elapsed / iterations;
+}
+
+static double benchTable(const uint32_t* masks, uint32_t iterations, const ButtonTranslation& t) {
+    PadOutput out;
+    uint32_t sink = 0;
+    uint64_t start = nowNs();
+    for (uint32_t i = 0; i < iterations; i++) {
+        tableApply(out, masks[i & (BENCH_MASKS - 1)], t);
+        sink += out.buttons ^ out.hat;
+    }
+    uint64_t elapsed = nowNs() - start;
+    if (sink == 0xDEADBEEF) {
+        printf(" ");
+    }
+    return (double)elapsed / iterations;
+}
+
+int main(int argc, char** argv) {
+    uint32_t iterations = BENCH_ITERATIONS;
+    for (int i = 1; i < argc; i++) {
+        if (strcmp(argv[i], "--iterations") == 0 && i + 1 < argc) {
+            iterations = (uint32_t)atoi(argv[++i]);
+        } else {
+            fprintf(stderr, "usage: %s [--iterations N]\n", argv[0]);
+            return 2;
+        }
+    }
+    if (iterations == 0) {
+        fprintf(stderr, "iterations must be > 0\n");
+        return 2;
+    }
+
+    testEquivalent("sideways d-pad: same output for all masks", sidewaysMappings, sidewaysDirections, true);
+    testEquivalent("sideways stick: same output for all masks", sidewaysMappings, sidewaysDirections, false);
+    testEquivalent("upright d-pad: same output for all masks", uprightMappings, uprightDirections, true);
+    testEquivalent("upright stick: same output for all masks", uprightMappings, uprightDirections, false);
+    testConstexpr();
+
+    static uint32_t masks[BENCH_MASKS];
+    makeMasks(masks, BENCH_MASKS);
+    static const char* const modes[2] = { "d-pad", "stick" };
+    for (int mode = 0; mode < 2; mode++) {
+        bool dpadMode = mode == 0;
+        double oldNs = benchOld(masks, iterations, dpadMode);
+        double tableNs = benchTable(masks, iterations, dpadMode ? sidewaysDpad : sidewaysStick);
+        printf("%s: loop %.1f ns, table %.1f ns per packet on host (x%.1f)\n", modes[mode], oldNs, tableNs,
+               oldNs / tableNs);
+        char name[48];
+        snprintf(name, sizeof(name), "%s: table faster than loop", modes[mode]);
+        check(tableNs < oldNs, name);
+    }
+    printf("table: %zu bytes per direction mode\n", sizeof(ButtonTranslation));
+
+    return checkSummary();
+}